@@ -40,7 +40,6 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <netinet/in.h>
-#include <jpeglib.h>
 
 #include <indigo/indigo_driver_xml.h>
 #include <indigo/indigo_ccd_driver.h>
@@ -213,233 +212,173 @@ static bool execute_command(indigo_device *device, char *command, ...) {
 
 #define astrometry_save_config indigo_platesolver_save_config
 
+#define MAX_XY_STARS		150
+
+static bool write_xy_file(indigo_device *device, const char *path, indigo_star_detection *stars, int count) {
+	// FITS binary table as written by image2xy, X and Y are 1-based
+	long size = FITS_HEADER_SIZE * 2 + ((count * 12 + FITS_HEADER_SIZE - 1) / FITS_HEADER_SIZE) * FITS_HEADER_SIZE;
+	char *buffer = indigo_safe_malloc(size), *p = buffer;
+	memset(buffer, ' ', FITS_HEADER_SIZE * 2);
+	int t = sprintf(p, "SIMPLE  = %20c", 'T'); p[t] = ' ';
+	t = sprintf(p += 80, "BITPIX  = %20d", 8); p[t] = ' ';
+	t = sprintf(p += 80, "NAXIS   = %20d", 0); p[t] = ' ';
+	t = sprintf(p += 80, "EXTEND  = %20c", 'T'); p[t] = ' ';
+	t = sprintf(p += 80, "END"); p[t] = ' ';
+	p = buffer + FITS_HEADER_SIZE;
+	t = sprintf(p, "XTENSION= 'BINTABLE'"); p[t] = ' ';
+	t = sprintf(p += 80, "BITPIX  = %20d", 8); p[t] = ' ';
+	t = sprintf(p += 80, "NAXIS   = %20d", 2); p[t] = ' ';
+	t = sprintf(p += 80, "NAXIS1  = %20d", 12); p[t] = ' ';
+	t = sprintf(p += 80, "NAXIS2  = %20d", count); p[t] = ' ';
+	t = sprintf(p += 80, "PCOUNT  = %20d", 0); p[t] = ' ';
+	t = sprintf(p += 80, "GCOUNT  = %20d", 1); p[t] = ' ';
+	t = sprintf(p += 80, "TFIELDS = %20d", 3); p[t] = ' ';
+	t = sprintf(p += 80, "TTYPE1  = 'X       '"); p[t] = ' ';
+	t = sprintf(p += 80, "TFORM1  = 'E       '"); p[t] = ' ';
+	t = sprintf(p += 80, "TTYPE2  = 'Y       '"); p[t] = ' ';
+	t = sprintf(p += 80, "TFORM2  = 'E       '"); p[t] = ' ';
+	t = sprintf(p += 80, "TTYPE3  = 'FLUX    '"); p[t] = ' ';
+	t = sprintf(p += 80, "TFORM3  = 'E       '"); p[t] = ' ';
+	t = sprintf(p += 80, "IMAGEW  = %20d", ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width); p[t] = ' ';
+	t = sprintf(p += 80, "IMAGEH  = %20d", ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height); p[t] = ' ';
+	t = sprintf(p += 80, "END"); p[t] = ' ';
+	uint32_t *row = (uint32_t *)(buffer + FITS_HEADER_SIZE * 2);
+	for (int i = 0; i < count; i++) {
+		float values[3] = { stars[i].x + 1, stars[i].y + 1, stars[i].luminance };
+		for (int j = 0; j < 3; j++) {
+			uint32_t value;
+			memcpy(&value, values + j, sizeof(value));
+			*row++ = htonl(value);
+		}
+	}
+	bool result = false;
+	int handle = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (handle >= 0) {
+		result = indigo_write(handle, buffer, size);
+		int saved_errno = errno;
+		close(handle);
+		errno = saved_errno;
+	}
+	free(buffer);
+	return result;
+}
+
 static void *astrometry_solve(indigo_platesolver_task *task) {
 	indigo_device *device = task->device;
 	void *image = task->image;
 	unsigned long image_size = task->size;
-	if (pthread_mutex_trylock(&DEVICE_CONTEXT->config_mutex) == 0) {
-		void *intermediate_image = NULL;
+	pthread_mutex_lock(&DEVICE_CONTEXT->config_mutex);
+	indigo_star_detection stars[MAX_XY_STARS];
+	int star_count = 0;
+	char path[INDIGO_VALUE_SIZE];
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
-		char *base = tempnam(NULL, "image");
+	// intermediate files are small, keep them in memory if possible
+	char *base = tempnam(access("/dev/shm", W_OK) ? NULL : "/dev/shm", "image");
 #pragma clang diagnostic pop
-		// convert any input image to FITS file
-		int handle = open(base, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-		if (handle < 0) {
+	snprintf(path, sizeof(path), "%s.xy", base);
+	// extract star list in process
+	if (indigo_platesolver_find_stars(image, image_size, (int)AGENT_PLATESOLVER_HINTS_DOWNSAMPLE_ITEM->number.value, MAX_XY_STARS, stars, &star_count, &ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width, &ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height)) {
+		if (star_count == 0) {
 			AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
-			indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Can't create temporary image file");
+			indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "No stars detected");
 			goto cleanup;
 		}
-		if (!strncmp("SIMPLE", (const char *)image, 6)) {
-			// FITS - copy only
-			indigo_write(handle, (const char *)image, image_size);
-			ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width = ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height = 0;
-		} else {
-			int byte_per_pixel = 0, components = 0;
-			if (!strncmp("RAW1", (const char *)(image), 4)) {
-				// 8 bit RAW
-				byte_per_pixel = 1;
-				components = 1;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width = ((indigo_raw_header *)image)->width;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height = ((indigo_raw_header *)image)->height;
-				image = image + sizeof(indigo_raw_header);
-			} else if (!strncmp("RAW2", (const char *)(image), 4)) {
-				// 16 bit RAW
-				byte_per_pixel = 2;
-				components = 1;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width = ((indigo_raw_header *)image)->width;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height = ((indigo_raw_header *)image)->height;
-				image = image + sizeof(indigo_raw_header);
-			} else if (!strncmp("RAW3", (const char *)(image), 4)) {
-				// 8 bit RGB
-				byte_per_pixel = 1;
-				components = 3;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width = ((indigo_raw_header *)image)->width;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height = ((indigo_raw_header *)image)->height;
-				image = image + sizeof(indigo_raw_header);
-			} else if (!strncmp("RAW6", (const char *)(image), 4)) {
-				// 16 bit RGB
-				byte_per_pixel = 2;
-				components = 3;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width = ((indigo_raw_header *)image)->width;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height = ((indigo_raw_header *)image)->height;
-				image = image + sizeof(indigo_raw_header);
-			} else if (!strncmp("JFIF", (const char *)(image + 6), 4)) {
-				// JPEG
-				struct jpeg_decompress_struct cinfo;
-				struct jpeg_error_mgr jerr;
-				cinfo.err = jpeg_std_error(&jerr);
-				jpeg_create_decompress(&cinfo);
-				jpeg_mem_src(&cinfo, image, image_size);
-				int rc = jpeg_read_header(&cinfo, TRUE);
-				if (rc < 0) {
-					AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
-					indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Broken JPEG file");
-					goto cleanup;
-				}
-				jpeg_start_decompress(&cinfo);
-				byte_per_pixel = 1;
-				components = cinfo.output_components;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width = cinfo.output_width;
-				ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height = cinfo.output_height;
-				int row_stride = ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width * components;
-				image = intermediate_image = indigo_safe_malloc(image_size = ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height * row_stride);
-				while (cinfo.output_scanline < cinfo.output_height) {
-					unsigned char *buffer_array[1];
-					buffer_array[0] = intermediate_image + (cinfo.output_scanline) * row_stride;
-					jpeg_read_scanlines(&cinfo, buffer_array, 1);
-				}
-				jpeg_finish_decompress(&cinfo);
-				jpeg_destroy_decompress(&cinfo);
-			} else {
-				image = NULL;
-			}
-			if (image == NULL) {
-				AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
-				indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Unsupported image format");
-				close(handle);
-				goto cleanup;
-			}
-			int pixel_count = ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width * ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height;
-			image_size = pixel_count * byte_per_pixel + FITS_HEADER_SIZE;
-			if (image_size % FITS_HEADER_SIZE) {
-				image_size = (image_size / FITS_HEADER_SIZE + 1) * FITS_HEADER_SIZE;
-			}
-			char *buffer = indigo_safe_malloc(image_size), *p = buffer;
-			memset(buffer, ' ', image_size);
-			int t = sprintf(p, "SIMPLE  = %20c", 'T'); p[t] = ' ';
-			t = sprintf(p += 80, "BITPIX  = %20d", byte_per_pixel * 8); p[t] = ' ';
-			t = sprintf(p += 80, "NAXIS   = %20d", 2); p[t] = ' ';
-			t = sprintf(p += 80, "NAXIS1  = %20d", ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width); p[t] = ' ';
-			t = sprintf(p += 80, "NAXIS2  = %20d", ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height); p[t] = ' ';
-			t = sprintf(p += 80, "EXTEND  = %20c", 'T'); p[t] = ' ';
-			if (byte_per_pixel == 2) {
-				t = sprintf(p += 80, "BZERO   = %20d", 32768); p[t] = ' ';
-				t = sprintf(p += 80, "BSCALE  = %20d", 1); p[t] = ' ';
-			}
-			t = sprintf(p += 80, "END"); p[t] = ' ';
-			p = buffer + FITS_HEADER_SIZE;
-			if (components == 1) {
-				// mono
-				if (byte_per_pixel == 2) {
-					// 16 bit RAW - swap endian
-					short *in = image;
-					short *out = (short *)p;
-					for (int i = 0; i < pixel_count; i++) {
-						int value = *in++ - 32768;
-						*out++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-					}
-				} else {
-					// 8 bit RAW
-					memcpy(p, image, pixel_count);
-				}
-			} else {
-				// RGB
-				if (byte_per_pixel == 2) {
-					// 16 bit RGB - average and swap endian
-					short *in = image;
-					short *out = (short *)p;
-					for (int i = 0; i < pixel_count; i++) {
-						int value = (in[0] + in[1] + in[2]) / 3 - 32768;
-						in += 3;
-						*out++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-					}
-				} else {
-					// 8 bit RGB - average
-					char *in = image;
-					char *out = p;
-					for (int i = 0; i < pixel_count; i++) {
-						int value = (in[0] + in[1] + in[2]) / 3;
-						in += 3;
-						*out++ = value;
-					}
-				}
-			}
-			indigo_write(handle, buffer, image_size);
-			free(buffer);
-			indigo_safe_free(intermediate_image);
+		if (!write_xy_file(device, path, stars, star_count)) {
+			AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Can't write star list (%s)", strerror(errno));
+			goto cleanup;
 		}
-		close(handle);
-		// execute astrometry.net plate solver
-		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_BUSY_STATE;
-		AGENT_PLATESOLVER_WCS_RA_ITEM->number.value = 0;
-		AGENT_PLATESOLVER_WCS_DEC_ITEM->number.value = 0;
-		AGENT_PLATESOLVER_WCS_WIDTH_ITEM->number.value = 0;
-		AGENT_PLATESOLVER_WCS_HEIGHT_ITEM->number.value = 0;
-		AGENT_PLATESOLVER_WCS_SCALE_ITEM->number.value = 0;
-		AGENT_PLATESOLVER_WCS_ANGLE_ITEM->number.value = 0;
-		AGENT_PLATESOLVER_WCS_INDEX_ITEM->number.value = 0;
-		AGENT_PLATESOLVER_WCS_PARITY_ITEM->number.value = 0;
-		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Running plate solver on \"%s\" ...", base);
-		char path[INDIGO_VALUE_SIZE];
-		snprintf(path, sizeof((path)), "%s/.indigo/astrometry/astrometry.cfg", getenv("HOME"));
-		handle = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	} else if (!strncmp("SIMPLE", (const char *)image, 6)) {
+		// other FITS formats - use image2xy
+		int handle = open(base, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 		if (handle < 0) {
 			AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
-			indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Can't create astrometry.cfg");
+			indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Can't create temporary image file");
 			goto cleanup;
 		}
-		char config[INDIGO_VALUE_SIZE];
-		snprintf(config, sizeof(config), "add_path %s/.indigo/astrometry\n", getenv("HOME"));
-		indigo_write(handle, config, strlen(config));
-		for (int k = 0; k < AGENT_PLATESOLVER_USE_INDEX_PROPERTY->count; k++) {
-			indigo_item *item = AGENT_PLATESOLVER_USE_INDEX_PROPERTY->items + k;
-			if (item->sw.value) {
-				for (int l = 0; index_files[l]; l++) {
-					if (!strncmp(item->name, index_files[l], 10)) {
-						snprintf(config, sizeof(config), "index %s\n", index_files[l]);
-						indigo_write(handle, config, strlen(config));
-					}
-				}
-			}
-		}
+		indigo_write(handle, (const char *)image, image_size);
 		close(handle);
-		char hints[512] = "";
-		int hints_index = 0;
-		if (ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width == 0 || ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height == 0) {
-			hints_index += sprintf(hints + hints_index, " -v");
-		}
-		if (AGENT_PLATESOLVER_HINTS_DOWNSAMPLE_ITEM->number.value > 1) {
-			hints_index += sprintf(hints + hints_index, " -d %d", (int)AGENT_PLATESOLVER_HINTS_DOWNSAMPLE_ITEM->number.value);
-		}
-		if (!execute_command(device, "image2xy -O%s -o %s.xy %s", hints, base, base)) {
+		ASTROMETRY_DEVICE_PRIVATE_DATA->frame_width = ASTROMETRY_DEVICE_PRIVATE_DATA->frame_height = 0;
+		char hints[32] = "";
+		if (AGENT_PLATESOLVER_HINTS_DOWNSAMPLE_ITEM->number.value > 1)
+			sprintf(hints, " -d %d", (int)AGENT_PLATESOLVER_HINTS_DOWNSAMPLE_ITEM->number.value);
+		if (!execute_command(device, "image2xy -O -v%s -o %s %s", hints, path, base)) {
 			AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
 			indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "image2xy failed");
 			goto cleanup;
 		}
-		*hints = 0;
-		hints_index = 0;
-		if (AGENT_PLATESOLVER_HINTS_RADIUS_ITEM->number.value > 0) {
-			hints_index += sprintf(hints + hints_index, " --ra %g --dec %g --radius %g", AGENT_PLATESOLVER_HINTS_RA_ITEM->number.value * 15, AGENT_PLATESOLVER_HINTS_DEC_ITEM->number.value, AGENT_PLATESOLVER_HINTS_RADIUS_ITEM->number.value);
-		}
-		if (AGENT_PLATESOLVER_HINTS_PARITY_ITEM->number.value != 0) {
-			hints_index += sprintf(hints + hints_index, " --parity %s", AGENT_PLATESOLVER_HINTS_PARITY_ITEM->number.value > 0 ? "pos" : "neg");
-		}
-		if (AGENT_PLATESOLVER_HINTS_DEPTH_ITEM->number.value > 0) {
-			hints_index += sprintf(hints + hints_index, " --depth %d", (int)AGENT_PLATESOLVER_HINTS_DEPTH_ITEM->number.value);
-		}
-		if (AGENT_PLATESOLVER_HINTS_CPU_LIMIT_ITEM->number.value > 0) {
-			hints_index += sprintf(hints + hints_index, " --cpulimit %d", (int)AGENT_PLATESOLVER_HINTS_CPU_LIMIT_ITEM->number.value);
-		}
-		INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->failed = true;
-		if (!execute_command(device, "solve-field --overwrite --no-plots --no-remove-lines --no-verify-uniformize --sort-column FLUX --uniformize 0%s --config %s/.indigo/astrometry/astrometry.cfg --axy %s.axy %s.xy", hints, getenv("HOME"), base, base))
-			AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
-		if (INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->failed)
-			AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
-		if (AGENT_PLATESOLVER_WCS_PROPERTY->state == INDIGO_BUSY_STATE)
-			AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_OK_STATE;
-		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, NULL);
-		if (AGENT_PLATESOLVER_WCS_PROPERTY->state == INDIGO_OK_STATE)
-			indigo_platesolver_sync(device);
-	cleanup:
-		execute_command(device, "rm -rf %s %s.xy %s.axy %s.wcs %s.corr %s.match %s.rdls %s.solved %s-indx.xyls", base, base, base, base, base, base, base, base, base);
-		free(base);
-		pthread_mutex_unlock(&DEVICE_CONTEXT->config_mutex);
 	} else {
-		INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Solver is busy");
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Unsupported image format");
+		goto cleanup;
+	}
+	// execute astrometry.net plate solver
+	AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_BUSY_STATE;
+	AGENT_PLATESOLVER_WCS_RA_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_DEC_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_WIDTH_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_HEIGHT_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_SCALE_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_ANGLE_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_INDEX_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_PARITY_ITEM->number.value = 0;
+	indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Running plate solver on \"%s\" ...", base);
+	snprintf(path, sizeof((path)), "%s/.indigo/astrometry/astrometry.cfg", getenv("HOME"));
+	int handle = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (handle < 0) {
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Can't create astrometry.cfg");
+		goto cleanup;
+	}
+	char config[INDIGO_VALUE_SIZE];
+	snprintf(config, sizeof(config), "add_path %s/.indigo/astrometry\n", getenv("HOME"));
+	indigo_write(handle, config, strlen(config));
+	for (int k = 0; k < AGENT_PLATESOLVER_USE_INDEX_PROPERTY->count; k++) {
+		indigo_item *item = AGENT_PLATESOLVER_USE_INDEX_PROPERTY->items + k;
+		if (item->sw.value) {
+			for (int l = 0; index_files[l]; l++) {
+				if (!strncmp(item->name, index_files[l], 10)) {
+					snprintf(config, sizeof(config), "index %s\n", index_files[l]);
+					indigo_write(handle, config, strlen(config));
+				}
+			}
+		}
+	}
+	close(handle);
+	char hints[512] = "";
+	int hints_index = 0;
+	if (AGENT_PLATESOLVER_HINTS_RADIUS_ITEM->number.value > 0) {
+		hints_index += sprintf(hints + hints_index, " --ra %g --dec %g --radius %g", AGENT_PLATESOLVER_HINTS_RA_ITEM->number.value * 15, AGENT_PLATESOLVER_HINTS_DEC_ITEM->number.value, AGENT_PLATESOLVER_HINTS_RADIUS_ITEM->number.value);
+	}
+	if (AGENT_PLATESOLVER_HINTS_PARITY_ITEM->number.value != 0) {
+		hints_index += sprintf(hints + hints_index, " --parity %s", AGENT_PLATESOLVER_HINTS_PARITY_ITEM->number.value > 0 ? "pos" : "neg");
+	}
+	if (AGENT_PLATESOLVER_HINTS_DEPTH_ITEM->number.value > 0) {
+		hints_index += sprintf(hints + hints_index, " --depth %d", (int)AGENT_PLATESOLVER_HINTS_DEPTH_ITEM->number.value);
+	}
+	if (AGENT_PLATESOLVER_HINTS_CPU_LIMIT_ITEM->number.value > 0) {
+		hints_index += sprintf(hints + hints_index, " --cpulimit %d", (int)AGENT_PLATESOLVER_HINTS_CPU_LIMIT_ITEM->number.value);
+	}
+	INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->failed = true;
+	if (!execute_command(device, "solve-field --overwrite --no-plots --no-remove-lines --no-verify-uniformize --sort-column FLUX --uniformize 0%s --config %s/.indigo/astrometry/astrometry.cfg --axy %s.axy %s.xy", hints, getenv("HOME"), base, base))
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+	if (INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->failed)
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+	if (AGENT_PLATESOLVER_WCS_PROPERTY->state == INDIGO_BUSY_STATE)
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_OK_STATE;
+	indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, NULL);
+	if (AGENT_PLATESOLVER_WCS_PROPERTY->state == INDIGO_OK_STATE)
+		indigo_platesolver_sync(device);
+cleanup:
+	unlink(base);
+	static const char *suffixes[] = { ".xy", ".axy", ".wcs", ".corr", ".match", ".rdls", ".solved", "-indx.xyls" };
+	for (int i = 0; i < sizeof(suffixes) / sizeof(char *); i++) {
+		snprintf(path, sizeof(path), "%s%s", base, suffixes[i]);
+		unlink(path);
 	}
-	free(task->image);
-	free(task);
+	free(base);
+	pthread_mutex_unlock(&DEVICE_CONTEXT->config_mutex);
 	return NULL;
 }
 
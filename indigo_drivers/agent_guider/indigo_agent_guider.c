@@ -37,6 +37,8 @@
 #include <indigo/indigo_filter.h>
 #include <indigo/indigo_ccd_driver.h>
 #include <indigo/indigo_raw_utils.h>
+#include <indigo/indigo_metrics.h>
+#include <indigo/indigo_image_pool.h>
 
 #include "indigo_agent_guider.h"
 
@@ -141,6 +143,9 @@ typedef struct {
 	double rmse_ra_threshold, rmse_dec_threshold;
 	unsigned long rmse_count;
 	void *last_image;
+	int pending_images;
+	pthread_mutex_t image_mutex;
+	pthread_cond_t image_cond;
 	enum { IGNORE = -2, PREVIEW, GUIDING, INIT, CLEAR_DEC, CLEAR_RA, MOVE_NORTH, MOVE_SOUTH, MOVE_WEST, MOVE_EAST, FAILED, DONE } phase;
 	double stack_x[MAX_STACK], stack_y[MAX_STACK];
 	int stack_size;
@@ -171,7 +176,28 @@ static void save_config(indigo_device *device) {
 	}
 }
 
-static indigo_property_state capture_raw_frame(indigo_device *device) {
+static void wait_for_image(indigo_device *device) {
+	pthread_mutex_lock(&DEVICE_PRIVATE_DATA->image_mutex);
+	while (DEVICE_PRIVATE_DATA->pending_images > 0)
+		pthread_cond_wait(&DEVICE_PRIVATE_DATA->image_cond, &DEVICE_PRIVATE_DATA->image_mutex);
+	pthread_mutex_unlock(&DEVICE_PRIVATE_DATA->image_mutex);
+}
+
+static void image_fetched(indigo_item *blob_item, bool success, indigo_device *device) {
+	pthread_mutex_lock(&DEVICE_PRIVATE_DATA->image_mutex);
+	indigo_release_image_buffer(DEVICE_PRIVATE_DATA->last_image);
+	if (success) {
+		DEVICE_PRIVATE_DATA->last_image = blob_item->blob.value;
+	} else {
+		indigo_release_image_buffer(blob_item->blob.value);
+		DEVICE_PRIVATE_DATA->last_image = NULL;
+	}
+	DEVICE_PRIVATE_DATA->pending_images--;
+	pthread_cond_broadcast(&DEVICE_PRIVATE_DATA->image_cond);
+	pthread_mutex_unlock(&DEVICE_PRIVATE_DATA->image_mutex);
+}
+
+static indigo_property_state _capture_raw_frame(indigo_device *device) {
 	char *ccd_name = FILTER_DEVICE_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX];
 	indigo_property_state state = INDIGO_ALERT_STATE;
 	indigo_property *device_exposure_property, *agent_exposure_property, *device_format_property;
@@ -191,27 +217,18 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
 			return INDIGO_ALERT_STATE;
 		indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, ccd_name, CCD_EXPOSURE_PROPERTY_NAME, CCD_EXPOSURE_ITEM_NAME, AGENT_GUIDER_SETTINGS_EXPOSURE_ITEM->number.value);
-		for (int i = 0; i < BUSY_TIMEOUT * 1000 && !FILTER_DEVICE_CONTEXT->property_removed && (state = agent_exposure_property->state) != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE; i++)
-			indigo_usleep(1000);
-		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		indigo_filter_wait_result result = indigo_filter_wait_state(device, agent_exposure_property, INDIGO_BUSY_STATE, true, AGENT_ABORT_PROCESS_PROPERTY, NULL, BUSY_TIMEOUT);
+		if (result == INDIGO_FILTER_WAIT_ABORTED)
 			return INDIGO_ALERT_STATE;
-		if (FILTER_DEVICE_CONTEXT->property_removed || state != INDIGO_BUSY_STATE) {
+		if (result != INDIGO_FILTER_WAIT_OK) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE didn't become busy in %d second(s)", BUSY_TIMEOUT);
 			indigo_usleep(ONE_SECOND_DELAY);
 			continue;
 		}
-		double reported_exposure_time = agent_exposure_property->items[0].number.value;
-		while (!FILTER_DEVICE_CONTEXT->property_removed && (state = agent_exposure_property->state) == INDIGO_BUSY_STATE) {
-			if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				return INDIGO_ALERT_STATE;
-			if (reported_exposure_time > 1) {
-				indigo_usleep(200000);
-			} else {
-				indigo_usleep(10000);
-			}
-		}
-		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		result = indigo_filter_wait_state(device, agent_exposure_property, INDIGO_BUSY_STATE, false, AGENT_ABORT_PROCESS_PROPERTY, NULL, 0);
+		if (result == INDIGO_FILTER_WAIT_ABORTED || AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
 			return INDIGO_ALERT_STATE;
+		state = result == INDIGO_FILTER_WAIT_OK ? agent_exposure_property->state : INDIGO_ALERT_STATE;
 		if (state != INDIGO_OK_STATE) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become OK");
 			indigo_usleep(ONE_SECOND_DELAY);
@@ -225,6 +242,7 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 	}
 	if (AGENT_GUIDER_STATS_PHASE_ITEM->number.value == IGNORE)
 		return agent_exposure_property->state;
+	wait_for_image(device);
 	indigo_raw_header *header = (indigo_raw_header *)(DEVICE_PRIVATE_DATA->last_image);
 	if (header == NULL || (header->signature != INDIGO_RAW_MONO8 && header->signature != INDIGO_RAW_MONO16 && header->signature != INDIGO_RAW_RGB24 && header->signature != INDIGO_RAW_RGB48)) {
 		indigo_send_message(device, "No RAW image received");
@@ -392,6 +410,13 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 	return state;
 }
 
+static indigo_property_state capture_raw_frame(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "capture_raw_frame", device->name);
+	indigo_property_state state = _capture_raw_frame(device);
+	INDIGO_TRACING_END("agent", "capture_raw_frame");
+	return state;
+}
+
 #define GRID	32
 
 static void select_subframe(indigo_device *device) {
@@ -486,9 +511,7 @@ static indigo_property_state pulse_guide(indigo_device *device, double ra, doubl
 		double values[] = { ra > 0 ? ra * 1000 : 0, ra < 0 ? -ra * 1000 : 0 };
 		indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, guider_name, GUIDER_GUIDE_RA_PROPERTY_NAME, 2, names, values);
 		FILTER_DEVICE_CONTEXT->property_removed = false;
-		for (int i = 0; i < 200 && !FILTER_DEVICE_CONTEXT->property_removed && agent_guide_property->state == INDIGO_BUSY_STATE; i++) {
-			indigo_usleep(50000);
-		}
+		indigo_filter_wait_state(device, agent_guide_property, INDIGO_BUSY_STATE, false, NULL, NULL, 10);
 	}
 	if (dec) {
 		if (!indigo_filter_cached_property(device, INDIGO_FILTER_GUIDER_INDEX, GUIDER_GUIDE_DEC_PROPERTY_NAME, &remote_guide_property, &agent_guide_property)) {
@@ -499,14 +522,13 @@ static indigo_property_state pulse_guide(indigo_device *device, double ra, doubl
 		double values[] = { dec > 0 ? dec * 1000 : 0, dec < 0 ? -dec * 1000 : 0 };
 		indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, guider_name, GUIDER_GUIDE_DEC_PROPERTY_NAME, 2, names, values);
 		FILTER_DEVICE_CONTEXT->property_removed = false;
-		for (int i = 0; i < 200 && !FILTER_DEVICE_CONTEXT->property_removed && agent_guide_property->state == INDIGO_BUSY_STATE; i++) {
-			indigo_usleep(50000);
-		}
+		indigo_filter_wait_state(device, agent_guide_property, INDIGO_BUSY_STATE, false, NULL, NULL, 10);
 	}
 	return INDIGO_OK_STATE;
 }
 
 static void preview_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "preview_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	AGENT_GUIDER_STATS_PHASE_ITEM->number.value = PREVIEW;
 	AGENT_GUIDER_STATS_FRAME_ITEM->number.value =
@@ -549,6 +571,7 @@ static void preview_process(indigo_device *device) {
 		indigo_update_property(device, AGENT_ABORT_PROCESS_PROPERTY, NULL);
 	}
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "preview_process");
 }
 
 static void change_step(indigo_device *device, double q) {
@@ -587,6 +610,7 @@ static bool guide_and_capture_frame(indigo_device *device, double ra, double dec
 static void guide_process(indigo_device *device);
 
 static void _calibrate_process(indigo_device *device, bool will_guide) {
+	INDIGO_TRACING_BEGIN("agent", "calibrate_process", device->name);
 	double last_drift = 0, dec_angle = 0;
 	int last_count = 0;
 	AGENT_GUIDER_STATS_PHASE_ITEM->number.value = DEVICE_PRIVATE_DATA->phase = INIT;
@@ -855,6 +879,7 @@ static void _calibrate_process(indigo_device *device, bool will_guide) {
 		indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
 		indigo_set_timer(device, 0, guide_process, NULL);
 	}
+	INDIGO_TRACING_END("agent", "calibrate_process");
 }
 
 static void calibrate_process(indigo_device *device) {
@@ -870,6 +895,7 @@ static void calibrate_and_guide_process(indigo_device *device) {
 }
 
 static void guide_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "guide_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	AGENT_GUIDER_STATS_PHASE_ITEM->number.value = IGNORE;
 	AGENT_GUIDER_STATS_FRAME_ITEM->number.value =
@@ -1009,10 +1035,12 @@ static void guide_process(indigo_device *device) {
 				}
 				if (reported_delay_time > 1) {
 					reported_delay_time -= 0.2;
-					indigo_usleep(200000);
+					if (indigo_filter_wait_state(device, AGENT_ABORT_PROCESS_PROPERTY, INDIGO_BUSY_STATE, true, NULL, NULL, 0.2) == INDIGO_FILTER_WAIT_OK)
+						break;
 				} else {
 					reported_delay_time -= 0.01;
-					indigo_usleep(10000);
+					if (indigo_filter_wait_state(device, AGENT_ABORT_PROCESS_PROPERTY, INDIGO_BUSY_STATE, true, NULL, NULL, 0.01) == INDIGO_FILTER_WAIT_OK)
+						break;
 				}
 			}
 			AGENT_GUIDER_STATS_DELAY_ITEM->number.value = 0;
@@ -1037,9 +1065,11 @@ static void guide_process(indigo_device *device) {
 	}
 	restore_subframe(device);
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "guide_process");
 }
 
 static void find_stars_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "find_stars_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	AGENT_GUIDER_STATS_PHASE_ITEM->number.value = PREVIEW;
 	AGENT_GUIDER_STATS_FRAME_ITEM->number.value =
@@ -1066,6 +1096,7 @@ static void find_stars_process(indigo_device *device) {
 		indigo_update_property(device, AGENT_ABORT_PROCESS_PROPERTY, NULL);
 	}
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "find_stars_process");
 }
 
 static void abort_process(indigo_device *device) {
@@ -1169,6 +1200,8 @@ static indigo_result agent_device_attach(indigo_device *device) {
 		// --------------------------------------------------------------------------------
 		CONNECTION_PROPERTY->hidden = true;
 		pthread_mutex_init(&DEVICE_PRIVATE_DATA->mutex, NULL);
+		pthread_mutex_init(&DEVICE_PRIVATE_DATA->image_mutex, NULL);
+		pthread_cond_init(&DEVICE_PRIVATE_DATA->image_cond, NULL);
 		indigo_load_properties(device, false);
 		INDIGO_DEVICE_ATTACH_LOG(DRIVER_NAME, device->name);
 		return agent_enumerate_properties(device, NULL, NULL);
@@ -1341,7 +1374,10 @@ static indigo_result agent_device_detach(indigo_device *device) {
 	indigo_release_property(AGENT_GUIDER_DEC_MODE_PROPERTY);
 	indigo_delete_frame_digest(&DEVICE_PRIVATE_DATA->reference);
 	pthread_mutex_destroy(&DEVICE_PRIVATE_DATA->mutex);
-	indigo_safe_free(DEVICE_PRIVATE_DATA->last_image);
+	wait_for_image(device);
+	pthread_mutex_destroy(&DEVICE_PRIVATE_DATA->image_mutex);
+	pthread_cond_destroy(&DEVICE_PRIVATE_DATA->image_cond);
+	indigo_release_image_buffer(DEVICE_PRIVATE_DATA->last_image);
 	return indigo_filter_device_detach(device);
 }
 
@@ -1350,15 +1386,19 @@ static indigo_result agent_device_detach(indigo_device *device) {
 static indigo_result agent_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
 	if (*FILTER_CLIENT_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX] && !strcmp(property->device, FILTER_CLIENT_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX])) {
 		if (property->state == INDIGO_OK_STATE && !strcmp(property->name, CCD_IMAGE_PROPERTY_NAME)) {
-			if (strchr(property->device, '@'))
-				indigo_populate_http_blob_item(property->items);
-			if (property->items->blob.value) {
-				CLIENT_PRIVATE_DATA->last_image = indigo_safe_realloc(CLIENT_PRIVATE_DATA->last_image, property->items->blob.size);
+			pthread_mutex_lock(&CLIENT_PRIVATE_DATA->image_mutex);
+			if (strchr(property->device, '@') && *property->items->blob.url) {
+				CLIENT_PRIVATE_DATA->pending_images++;
+				indigo_populate_http_blob_item_async(property->items, (indigo_blob_fetch_callback)image_fetched, FILTER_CLIENT_CONTEXT->device);
+			} else if (property->items->blob.value) {
+				CLIENT_PRIVATE_DATA->last_image = indigo_resize_image_buffer(CLIENT_PRIVATE_DATA->last_image, property->items->blob.size);
+				assert(CLIENT_PRIVATE_DATA->last_image != NULL);
 				memcpy(CLIENT_PRIVATE_DATA->last_image, property->items->blob.value, property->items->blob.size);
 			} else if (CLIENT_PRIVATE_DATA->last_image) {
-				free(CLIENT_PRIVATE_DATA->last_image);
+				indigo_release_image_buffer(CLIENT_PRIVATE_DATA->last_image);
 				CLIENT_PRIVATE_DATA->last_image = NULL;
 			}
+			pthread_mutex_unlock(&CLIENT_PRIVATE_DATA->image_mutex);
 		}
 	}
 	return indigo_filter_update_property(client, device, property, message);
@@ -43,6 +43,8 @@
 #include <indigo/indigo_ccd_driver.h>
 #include <indigo/indigo_io.h>
 #include <indigo/indigo_raw_utils.h>
+#include <indigo/indigo_metrics.h>
+#include <indigo/indigo_image_pool.h>
 
 #include "indigo_agent_imager.h"
 
@@ -155,6 +157,9 @@ typedef struct {
 	double drift_x, drift_y;
 	int bin_x, bin_y;
 	void *last_image;
+	int pending_images;
+	pthread_mutex_t image_mutex;
+	pthread_cond_t image_cond;
 	int stack_size;
 	pthread_mutex_t mutex;
 	double focus_exposure;
@@ -294,7 +299,28 @@ static void restore_subframe(indigo_device *device) {
 	}
 }
 
-static indigo_property_state capture_raw_frame(indigo_device *device) {
+static void wait_for_image(indigo_device *device) {
+	pthread_mutex_lock(&DEVICE_PRIVATE_DATA->image_mutex);
+	while (DEVICE_PRIVATE_DATA->pending_images > 0)
+		pthread_cond_wait(&DEVICE_PRIVATE_DATA->image_cond, &DEVICE_PRIVATE_DATA->image_mutex);
+	pthread_mutex_unlock(&DEVICE_PRIVATE_DATA->image_mutex);
+}
+
+static void image_fetched(indigo_item *blob_item, bool success, indigo_device *device) {
+	pthread_mutex_lock(&DEVICE_PRIVATE_DATA->image_mutex);
+	indigo_release_image_buffer(DEVICE_PRIVATE_DATA->last_image);
+	if (success) {
+		DEVICE_PRIVATE_DATA->last_image = blob_item->blob.value;
+	} else {
+		indigo_release_image_buffer(blob_item->blob.value);
+		DEVICE_PRIVATE_DATA->last_image = NULL;
+	}
+	DEVICE_PRIVATE_DATA->pending_images--;
+	pthread_cond_broadcast(&DEVICE_PRIVATE_DATA->image_cond);
+	pthread_mutex_unlock(&DEVICE_PRIVATE_DATA->image_mutex);
+}
+
+static indigo_property_state _capture_raw_frame(indigo_device *device) {
 	char *ccd_name = FILTER_DEVICE_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX];
 	indigo_property_state state = INDIGO_ALERT_STATE;
 	indigo_property *device_exposure_property, *agent_exposure_property, *device_format_property;
@@ -311,22 +337,19 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 	for (int exposure_attempt = 0; exposure_attempt < 3; exposure_attempt++) {
 		if (FILTER_DEVICE_CONTEXT->property_removed)
 			return INDIGO_ALERT_STATE;
-		while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-			indigo_usleep(200000);
+		indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
 			return INDIGO_ALERT_STATE;
 		indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, device_exposure_property->device, CCD_EXPOSURE_PROPERTY_NAME, CCD_EXPOSURE_ITEM_NAME, AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target);
-		for (int i = 0; i < BUSY_TIMEOUT * 1000 && !FILTER_DEVICE_CONTEXT->property_removed && (state = agent_exposure_property->state) != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE && AGENT_PAUSE_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE; i++)
-			indigo_usleep(1000);
-		if (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
-			while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				indigo_usleep(200000);
+		indigo_filter_wait_result result = indigo_filter_wait_state(device, agent_exposure_property, INDIGO_BUSY_STATE, true, AGENT_ABORT_PROCESS_PROPERTY, AGENT_PAUSE_PROCESS_PROPERTY, BUSY_TIMEOUT);
+		if (result == INDIGO_FILTER_WAIT_PAUSED) {
+			indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 			exposure_attempt--;
 			continue;
 		}
-		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		if (result == INDIGO_FILTER_WAIT_ABORTED)
 			return INDIGO_ALERT_STATE;
-		if (FILTER_DEVICE_CONTEXT->property_removed || state != INDIGO_BUSY_STATE) {
+		if (result != INDIGO_FILTER_WAIT_OK) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE didn't become busy in %d second(s)", BUSY_TIMEOUT);
 			indigo_usleep(ONE_SECOND_DELAY);
 			continue;
@@ -334,27 +357,20 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 		double reported_exposure_time = agent_exposure_property->items[0].number.value;
 		AGENT_IMAGER_STATS_EXPOSURE_ITEM->number.value = reported_exposure_time;
 		indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
-		while (!FILTER_DEVICE_CONTEXT->property_removed && (state = agent_exposure_property->state) == INDIGO_BUSY_STATE) {
-			if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				return INDIGO_ALERT_STATE;
+		while ((result = indigo_filter_wait_state(device, agent_exposure_property, INDIGO_BUSY_STATE, false, AGENT_ABORT_PROCESS_PROPERTY, NULL, reported_exposure_time > 1 ? 0.5 : 0)) == INDIGO_FILTER_WAIT_TIMEOUT) {
 			if (reported_exposure_time != agent_exposure_property->items[0].number.value) {
 				AGENT_IMAGER_STATS_EXPOSURE_ITEM->number.value = reported_exposure_time = agent_exposure_property->items[0].number.value;
 				indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 			}
-			if (reported_exposure_time > 1) {
-				indigo_usleep(200000);
-			} else {
-				indigo_usleep(10000);
-			}
 		}
 		if (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
-			while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				indigo_usleep(200000);
+			indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 			exposure_attempt--;
 			continue;
 		}
-		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		if (result == INDIGO_FILTER_WAIT_ABORTED || AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
 			return INDIGO_ALERT_STATE;
+		state = result == INDIGO_FILTER_WAIT_OK ? agent_exposure_property->state : INDIGO_ALERT_STATE;
 		if (state != INDIGO_OK_STATE) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become OK");
 			indigo_usleep(ONE_SECOND_DELAY);
@@ -367,8 +383,13 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 		return INDIGO_ALERT_STATE;
 	}
 	if ((AGENT_IMAGER_SELECTION_X_ITEM->number.value > 0 && AGENT_IMAGER_SELECTION_Y_ITEM->number.value > 0) || DEVICE_PRIVATE_DATA->allow_subframing || DEVICE_PRIVATE_DATA->find_stars) {
-		indigo_raw_header *header = (indigo_raw_header *)(DEVICE_PRIVATE_DATA->last_image);
+		wait_for_image(device);
+		// last_image can be replaced by the next image while it is analysed, keep own reference
+		pthread_mutex_lock(&DEVICE_PRIVATE_DATA->image_mutex);
+		indigo_raw_header *header = (indigo_raw_header *)indigo_retain_image_buffer(DEVICE_PRIVATE_DATA->last_image);
+		pthread_mutex_unlock(&DEVICE_PRIVATE_DATA->image_mutex);
 		if (header == NULL || (header->signature != INDIGO_RAW_MONO8 && header->signature != INDIGO_RAW_MONO16 && header->signature != INDIGO_RAW_RGB24 && header->signature != INDIGO_RAW_RGB48)) {
+			indigo_release_image_buffer(header);
 			indigo_send_message(device, "No RAW image received");
 			return INDIGO_ALERT_STATE;
 		}
@@ -424,13 +445,22 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 			}
 		}
 		indigo_selection_psf(header->signature, (void*)header + sizeof(indigo_raw_header), AGENT_IMAGER_SELECTION_X_ITEM->number.value, AGENT_IMAGER_SELECTION_Y_ITEM->number.value, AGENT_IMAGER_SELECTION_RADIUS_ITEM->number.value, header->width, header->height, &AGENT_IMAGER_STATS_FWHM_ITEM->number.value, &AGENT_IMAGER_STATS_HFD_ITEM->number.value, &AGENT_IMAGER_STATS_PEAK_ITEM->number.value);
+		indigo_release_image_buffer(header);
 	}
 	AGENT_IMAGER_STATS_FRAME_ITEM->number.value++;
 	indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 	return INDIGO_OK_STATE;
 }
 
+static indigo_property_state capture_raw_frame(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "capture_raw_frame", device->name);
+	indigo_property_state state = _capture_raw_frame(device);
+	INDIGO_TRACING_END("agent", "capture_raw_frame");
+	return state;
+}
+
 static void preview_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "preview_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	int upload_mode = save_switch_state(device, INDIGO_FILTER_CCD_INDEX, CCD_UPLOAD_MODE_PROPERTY_NAME);
 	int image_format = save_switch_state(device, INDIGO_FILTER_CCD_INDEX, CCD_IMAGE_FORMAT_PROPERTY_NAME);
@@ -451,6 +481,61 @@ static void preview_process(indigo_device *device) {
 	}
 	restore_subframe(device);
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "preview_process");
+}
+
+static bool start_dithering(indigo_device *device) {
+	for (int item_index = 0; item_index < FILTER_DEVICE_CONTEXT->filter_related_agent_list_property->count; item_index++) {
+		indigo_item *agent = FILTER_DEVICE_CONTEXT->filter_related_agent_list_property->items + item_index;
+		if (agent->sw.value && !strncmp(agent->name, "Guider Agent", 12)) {
+			static const char *item_names[] = { AGENT_GUIDER_SETTINGS_DITH_X_ITEM_NAME, AGENT_GUIDER_SETTINGS_DITH_Y_ITEM_NAME };
+			double x_value = fabs(AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target) * (drand48() - 0.5);
+			double y_value = AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target > 0 ? AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target * (drand48() - 0.5) : 0;
+			double item_values[] = { x_value, y_value };
+			DEVICE_PRIVATE_DATA->dithering_started = false;
+			DEVICE_PRIVATE_DATA->dithering_finished = false;
+			indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, agent->name, AGENT_GUIDER_SETTINGS_PROPERTY_NAME, 2, item_names, item_values);
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool wait_for_dithering_flag(indigo_device *device, bool *flag, double timeout) {
+	struct timespec end;
+	clock_gettime(CLOCK_REALTIME, &end);
+	end.tv_sec += (int)timeout;
+	end.tv_nsec += 1000000000L * (timeout - (int)timeout);
+	normalize_timespec(&end);
+	pthread_mutex_lock(&FILTER_DEVICE_CONTEXT->wait_mutex);
+	while (!*flag && AGENT_ABORT_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE) {
+		if (pthread_cond_timedwait(&FILTER_DEVICE_CONTEXT->wait_cond, &FILTER_DEVICE_CONTEXT->wait_mutex, &end) == ETIMEDOUT)
+			break;
+	}
+	bool result = *flag;
+	pthread_mutex_unlock(&FILTER_DEVICE_CONTEXT->wait_mutex);
+	return result;
+}
+
+static bool wait_for_dithering(indigo_device *device) {
+	wait_for_dithering_flag(device, &DEVICE_PRIVATE_DATA->dithering_started, 3); // wait up to 3s to start dithering
+	if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		return false;
+	if (DEVICE_PRIVATE_DATA->dithering_started) {
+		INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Dithering started");
+		wait_for_dithering_flag(device, &DEVICE_PRIVATE_DATA->dithering_finished, AGENT_IMAGER_DITHERING_TIME_LIMIT_ITEM->number.value); // wait up to time limit to finish dithering
+		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+			return false;
+		if (DEVICE_PRIVATE_DATA->dithering_finished) {
+			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Dithering finished");
+		} else {
+			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Dithering failed");
+			indigo_send_message(device, "Dithering failed to settle down, maybe the timeout is too short");
+			if (indigo_filter_wait_state(device, AGENT_ABORT_PROCESS_PROPERTY, INDIGO_BUSY_STATE, true, NULL, NULL, 0.2) == INDIGO_FILTER_WAIT_OK)
+				return false;
+		}
+	}
+	return true;
 }
 
 static bool exposure_batch(indigo_device *device) {
@@ -477,6 +562,7 @@ static bool exposure_batch(indigo_device *device) {
 		}
 	}
 	set_headers(device);
+	bool dithering = light_frame && AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target != 0;
 	FILTER_DEVICE_CONTEXT->property_removed = false;
 	AGENT_IMAGER_STATS_BATCH_ITEM->number.value++;
 	for (int remaining_exposures = AGENT_IMAGER_BATCH_COUNT_ITEM->number.target; remaining_exposures != 0; remaining_exposures--) {
@@ -487,22 +573,19 @@ static bool exposure_batch(indigo_device *device) {
 		for (int exposure_attempt = 0; exposure_attempt < 3; exposure_attempt++) {
 			if (FILTER_DEVICE_CONTEXT->property_removed)
 				return INDIGO_ALERT_STATE;
-			while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				indigo_usleep(200000);
+			indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 			if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
 				return false;
 			indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, ccd_name, CCD_EXPOSURE_PROPERTY_NAME, CCD_EXPOSURE_ITEM_NAME, AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target);
-			for (int i = 0; i < BUSY_TIMEOUT * 1000 && !FILTER_DEVICE_CONTEXT->property_removed && (state = agent_exposure_property->state) != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE && AGENT_PAUSE_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE; i++)
-				indigo_usleep(1000);
-			if (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
-				while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-					indigo_usleep(200000);
+			indigo_filter_wait_result result = indigo_filter_wait_state(device, agent_exposure_property, INDIGO_BUSY_STATE, true, AGENT_ABORT_PROCESS_PROPERTY, AGENT_PAUSE_PROCESS_PROPERTY, BUSY_TIMEOUT);
+			if (result == INDIGO_FILTER_WAIT_PAUSED) {
+				indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 				exposure_attempt--;
 				continue;
 			}
-			if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+			if (result == INDIGO_FILTER_WAIT_ABORTED)
 				return false;
-			if (FILTER_DEVICE_CONTEXT->property_removed || state != INDIGO_BUSY_STATE) {
+			if (result != INDIGO_FILTER_WAIT_OK) {
 				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become busy in %d second(s)", BUSY_TIMEOUT);
 				indigo_usleep(ONE_SECOND_DELAY);
 				continue;
@@ -510,25 +593,20 @@ static bool exposure_batch(indigo_device *device) {
 			double reported_exposure_time = agent_exposure_property->items[0].number.value;
 			AGENT_IMAGER_STATS_EXPOSURE_ITEM->number.value = reported_exposure_time;
 			indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
-			while (!FILTER_DEVICE_CONTEXT->property_removed && (state = agent_exposure_property->state) == INDIGO_BUSY_STATE) {
+			while ((result = indigo_filter_wait_state(device, agent_exposure_property, INDIGO_BUSY_STATE, false, AGENT_ABORT_PROCESS_PROPERTY, NULL, reported_exposure_time > 1 ? 0.5 : 0)) == INDIGO_FILTER_WAIT_TIMEOUT) {
 				if (reported_exposure_time != agent_exposure_property->items[0].number.value) {
 					AGENT_IMAGER_STATS_EXPOSURE_ITEM->number.value = reported_exposure_time = agent_exposure_property->items[0].number.value;
 					indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 				}
-				if (reported_exposure_time > 1) {
-					indigo_usleep(200000);
-				} else {
-					indigo_usleep(10000);
-				}
 			}
 			if (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
-				while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-					indigo_usleep(200000);
+				indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 				exposure_attempt--;
 				continue;
 			}
-			if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+			if (result == INDIGO_FILTER_WAIT_ABORTED || AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
 				return false;
+			state = result == INDIGO_FILTER_WAIT_OK ? agent_exposure_property->state : INDIGO_ALERT_STATE;
 			if (state != INDIGO_OK_STATE) {
 				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become OK");
 				indigo_usleep(ONE_SECOND_DELAY);
@@ -542,53 +620,15 @@ static bool exposure_batch(indigo_device *device) {
 		}
 		if (light_frame) {
 			if (remaining_exposures != 0) {
-				if (AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target != 0) {
-					for (int item_index = 0; item_index < FILTER_DEVICE_CONTEXT->filter_related_agent_list_property->count; item_index++) {
-						indigo_item *agent = FILTER_DEVICE_CONTEXT->filter_related_agent_list_property->items + item_index;
-						if (agent->sw.value && !strncmp(agent->name, "Guider Agent", 12)) {
-							static const char *item_names[] = { AGENT_GUIDER_SETTINGS_DITH_X_ITEM_NAME, AGENT_GUIDER_SETTINGS_DITH_Y_ITEM_NAME };
-							double x_value = fabs(AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target) * (drand48() - 0.5);
-							double y_value = AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target > 0 ? AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target * (drand48() - 0.5) : 0;
-							double item_values[] = { x_value, y_value };
-							DEVICE_PRIVATE_DATA->dithering_started = false;
-							indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, agent->name, AGENT_GUIDER_SETTINGS_PROPERTY_NAME, 2, item_names, item_values);
-							for (int i = 0; i < 15; i++) { // wait up to 3s to start dithering
-								if (DEVICE_PRIVATE_DATA->dithering_started) {
-									break;
-								}
-								if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-									return false;
-								indigo_usleep(200000);
-							}
-							if (DEVICE_PRIVATE_DATA->dithering_started) {
-								INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Dithering started");
-								DEVICE_PRIVATE_DATA->dithering_finished = false;
-								double time_limit = AGENT_IMAGER_DITHERING_TIME_LIMIT_ITEM->number.value * 5;
-								for (int i = 0; i < time_limit; i++) { // wait up to time limit to finish dithering
-									if (DEVICE_PRIVATE_DATA->dithering_finished) {
-										INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Dithering finished");
-										break;
-									}
-									if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-										return false;
-									indigo_usleep(200000);
-								}
-								if (!DEVICE_PRIVATE_DATA->dithering_finished) {
-									INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Dithering failed");
-									indigo_send_message(device, "Dithering failed to settle down, maybe the timeout is too short");
-									indigo_usleep(200000);
-								}
-							}
-							break;
-						}
-					}
+				if (dithering && start_dithering(device)) {
+					if (!wait_for_dithering(device))
+						return false;
 				}
 				double reported_delay_time = AGENT_IMAGER_BATCH_DELAY_ITEM->number.target;
 				AGENT_IMAGER_STATS_DELAY_ITEM->number.value = reported_delay_time;
 				indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 				while (reported_delay_time > 0) {
-					while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-						indigo_usleep(200000);
+					indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 					if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
 						return false;
 					if (reported_delay_time < floor(AGENT_IMAGER_STATS_DELAY_ITEM->number.value)) {
@@ -600,10 +640,10 @@ static bool exposure_batch(indigo_device *device) {
 					}
 					if (reported_delay_time > 1) {
 						reported_delay_time -= 0.2;
-						indigo_usleep(200000);
+						indigo_filter_wait_state(device, AGENT_ABORT_PROCESS_PROPERTY, INDIGO_BUSY_STATE, true, NULL, AGENT_PAUSE_PROCESS_PROPERTY, 0.2);
 					} else {
 						reported_delay_time -= 0.01;
-						indigo_usleep(10000);
+						indigo_filter_wait_state(device, AGENT_ABORT_PROCESS_PROPERTY, INDIGO_BUSY_STATE, true, NULL, AGENT_PAUSE_PROCESS_PROPERTY, 0.01);
 					}
 				}
 				AGENT_IMAGER_STATS_DELAY_ITEM->number.value = 0;
@@ -615,6 +655,7 @@ static bool exposure_batch(indigo_device *device) {
 }
 
 static void exposure_batch_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "exposure_batch_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	DEVICE_PRIVATE_DATA->allow_subframing = false;
 	DEVICE_PRIVATE_DATA->find_stars = false;
@@ -644,10 +685,10 @@ static void exposure_batch_process(indigo_device *device) {
 	indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 	indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "exposure_batch_process");
 }
 
 static bool streaming_batch(indigo_device *device) {
-	indigo_property_state state = INDIGO_ALERT_STATE;
 	char *ccd_name = FILTER_DEVICE_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX];
 	indigo_property *device_streaming_property, *agent_streaming_property;
 	AGENT_IMAGER_STATS_EXPOSURE_ITEM->number.value = 0;
@@ -673,16 +714,14 @@ static bool streaming_batch(indigo_device *device) {
 	double values[] = { AGENT_IMAGER_BATCH_COUNT_ITEM->number.target, AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target };
 	indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, ccd_name, CCD_STREAMING_PROPERTY_NAME, 2, names, values);
 	FILTER_DEVICE_CONTEXT->property_removed = false;
-	for (int i = 0; i < BUSY_TIMEOUT * 1000 && !FILTER_DEVICE_CONTEXT->property_removed && (state = agent_streaming_property->state) != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE && AGENT_PAUSE_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE; i++)
-		indigo_usleep(1000);
-	if (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE || AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+	indigo_filter_wait_result result = indigo_filter_wait_state(device, agent_streaming_property, INDIGO_BUSY_STATE, true, AGENT_ABORT_PROCESS_PROPERTY, AGENT_PAUSE_PROCESS_PROPERTY, BUSY_TIMEOUT);
+	if (result == INDIGO_FILTER_WAIT_PAUSED || result == INDIGO_FILTER_WAIT_ABORTED)
 		return false;
-	if (state != INDIGO_BUSY_STATE) {
+	if (result != INDIGO_FILTER_WAIT_OK) {
 		INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_STREAMING_PROPERTY didn't become busy in %d second(s)", BUSY_TIMEOUT);
 		return false;
 	}
-	while (!FILTER_DEVICE_CONTEXT->property_removed && (state = agent_streaming_property->state) == INDIGO_BUSY_STATE) {
-		indigo_usleep(20000);
+	while (indigo_filter_wait_state(device, agent_streaming_property, INDIGO_BUSY_STATE, false, NULL, NULL, 0.1) == INDIGO_FILTER_WAIT_TIMEOUT) {
 		int count = agent_streaming_property->items[count_index].number.value;
 		if (count != AGENT_IMAGER_STATS_FRAME_ITEM->number.value) {
 			AGENT_IMAGER_STATS_FRAME_ITEM->number.value = count;
@@ -695,6 +734,7 @@ static bool streaming_batch(indigo_device *device) {
 }
 
 static void streaming_batch_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "streaming_batch_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	DEVICE_PRIVATE_DATA->allow_subframing = false;
 	DEVICE_PRIVATE_DATA->find_stars = false;
@@ -723,6 +763,7 @@ static void streaming_batch_process(indigo_device *device) {
 	indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 	indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "streaming_batch_process");
 }
 
 static bool autofocus(indigo_device *device) {
@@ -809,29 +850,25 @@ static bool autofocus(indigo_device *device) {
 			}
 			indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, focuser_name, FOCUSER_STEPS_PROPERTY_NAME, FOCUSER_STEPS_ITEM_NAME, steps_with_backlash);
 		}
-		for (int i = 0; i < BUSY_TIMEOUT * 1000 && !FILTER_DEVICE_CONTEXT->property_removed && (state = agent_steps_property->state) != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE && AGENT_PAUSE_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE; i++)
-			indigo_usleep(1000);
-		if (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
-			while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				indigo_usleep(200000);
+		indigo_filter_wait_result result = indigo_filter_wait_state(device, agent_steps_property, INDIGO_BUSY_STATE, true, AGENT_ABORT_PROCESS_PROPERTY, AGENT_PAUSE_PROCESS_PROPERTY, BUSY_TIMEOUT);
+		if (result == INDIGO_FILTER_WAIT_PAUSED) {
+			indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 			continue;
 		}
-		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		if (result == INDIGO_FILTER_WAIT_ABORTED)
 			return false;
-		if (state != INDIGO_BUSY_STATE) {
+		if (result != INDIGO_FILTER_WAIT_OK) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "FOCUSER_STEPS_PROPERTY didn't become busy in %d second(s)", BUSY_TIMEOUT);
 			return false;
 		}
-		while (!FILTER_DEVICE_CONTEXT->property_removed && (state = agent_steps_property->state) == INDIGO_BUSY_STATE) {
-			indigo_usleep(200000);
-		}
+		result = indigo_filter_wait_state(device, agent_steps_property, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
+		state = result == INDIGO_FILTER_WAIT_OK ? agent_steps_property->state : INDIGO_ALERT_STATE;
 		if (state != INDIGO_OK_STATE) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "FOCUSER_STEPS_PROPERTY didn't become OK");
 			return false;
 		}
 		if (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
-			while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				indigo_usleep(200000);
+			indigo_filter_wait_state(device, AGENT_PAUSE_PROCESS_PROPERTY, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 			continue;
 		}
 		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
@@ -849,6 +886,7 @@ static bool autofocus(indigo_device *device) {
 }
 
 static void autofocus_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "autofocus_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	DEVICE_PRIVATE_DATA->allow_subframing = true;
 	DEVICE_PRIVATE_DATA->find_stars = (AGENT_IMAGER_SELECTION_X_ITEM->number.value == 0 && AGENT_IMAGER_SELECTION_Y_ITEM->number.value == 0);
@@ -876,6 +914,7 @@ static void autofocus_process(indigo_device *device) {
 	indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 	indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "autofocus_process");
 }
 
 static void park_mount(indigo_device *device) {
@@ -989,14 +1028,13 @@ static void set_property(indigo_device *device, char *name, char *value) {
 		}
 	}
 	if (device_property) {
-		indigo_usleep(200000);
-		while (!FILTER_DEVICE_CONTEXT->property_removed && device_property->state == INDIGO_BUSY_STATE) {
-			indigo_usleep(200000);
-		}
+		indigo_filter_wait_state(device, device_property, INDIGO_BUSY_STATE, true, NULL, NULL, 0.2);
+		indigo_filter_wait_state(device, device_property, INDIGO_BUSY_STATE, false, NULL, NULL, 0);
 	}
 }
 
 static void sequence_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "sequence_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	char sequence_text[INDIGO_VALUE_SIZE], *sequence_text_pnt, *value;
 	AGENT_IMAGER_STATS_BATCH_ITEM->number.value = 0;
@@ -1028,6 +1066,7 @@ static void sequence_process(indigo_device *device) {
 		indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 		AGENT_START_PROCESS_PROPERTY->state = INDIGO_ALERT_STATE;
 		indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, "No focuser is selected");
+		INDIGO_TRACING_END("agent", "sequence_process");
 		return;
 	}
 	indigo_send_message(device, "Sequence started");
@@ -1103,9 +1142,11 @@ static void sequence_process(indigo_device *device) {
 		indigo_update_property(device, AGENT_ABORT_PROCESS_PROPERTY, NULL);
 	}
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "sequence_process");
 }
 
 static void find_stars_process(indigo_device *device) {
+	INDIGO_TRACING_BEGIN("agent", "find_stars_process", device->name);
 	FILTER_DEVICE_CONTEXT->running_process = true;
 	DEVICE_PRIVATE_DATA->allow_subframing = false;
 	DEVICE_PRIVATE_DATA->find_stars = true;
@@ -1127,6 +1168,7 @@ static void find_stars_process(indigo_device *device) {
 		indigo_update_property(device, AGENT_ABORT_PROCESS_PROPERTY, NULL);
 	}
 	FILTER_DEVICE_CONTEXT->running_process = false;
+	INDIGO_TRACING_END("agent", "find_stars_process");
 }
 
 static void abort_process(indigo_device *device) {
@@ -1283,6 +1325,8 @@ static indigo_result agent_device_attach(indigo_device *device) {
 		// --------------------------------------------------------------------------------
 		CONNECTION_PROPERTY->hidden = true;
 		pthread_mutex_init(&DEVICE_PRIVATE_DATA->mutex, NULL);
+		pthread_mutex_init(&DEVICE_PRIVATE_DATA->image_mutex, NULL);
+		pthread_cond_init(&DEVICE_PRIVATE_DATA->image_cond, NULL);
 		indigo_load_properties(device, false);
 		INDIGO_DEVICE_ATTACH_LOG(DRIVER_NAME, device->name);
 		return agent_enumerate_properties(device, NULL, NULL);
@@ -1603,8 +1647,11 @@ static indigo_result agent_device_detach(indigo_device *device) {
 	indigo_release_property(AGENT_IMAGER_SEQUENCE_PROPERTY);
 	indigo_release_property(AGENT_WHEEL_FILTER_PROPERTY);
 	pthread_mutex_destroy(&DEVICE_PRIVATE_DATA->mutex);
+	wait_for_image(device);
+	pthread_mutex_destroy(&DEVICE_PRIVATE_DATA->image_mutex);
+	pthread_cond_destroy(&DEVICE_PRIVATE_DATA->image_cond);
 	indigo_safe_free(DEVICE_PRIVATE_DATA->image_buffer);
-	indigo_safe_free(DEVICE_PRIVATE_DATA->last_image);
+	indigo_release_image_buffer(DEVICE_PRIVATE_DATA->last_image);
 	return indigo_filter_device_detach(device);
 }
 
@@ -1624,8 +1671,9 @@ static void snoop_guider_stats(indigo_client *client, indigo_property *property)
 							indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
 							if (item->number.value)
 								DEVICE_PRIVATE_DATA->dithering_started = true;
-							else
+							else if (DEVICE_PRIVATE_DATA->dithering_started)
 								DEVICE_PRIVATE_DATA->dithering_finished = true;
+							indigo_filter_notify(device);
 							break;
 						}
 					}
@@ -1687,15 +1735,22 @@ static indigo_result agent_define_property(indigo_client *client, indigo_device
 static indigo_result agent_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
 	if (*FILTER_CLIENT_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX] && !strcmp(property->device, FILTER_CLIENT_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX])) {
 		if (property->state == INDIGO_OK_STATE && !strcmp(property->name, CCD_IMAGE_PROPERTY_NAME)) {
-			if (strchr(property->device, '@'))
-				indigo_populate_http_blob_item(property->items);
-			if (property->items->blob.value) {
-				CLIENT_PRIVATE_DATA->last_image = indigo_safe_realloc(CLIENT_PRIVATE_DATA->last_image, property->items->blob.size);
-				memcpy(CLIENT_PRIVATE_DATA->last_image, property->items->blob.value, property->items->blob.size);
+			pthread_mutex_lock(&CLIENT_PRIVATE_DATA->image_mutex);
+			if (strchr(property->device, '@') && *property->items->blob.url) {
+				CLIENT_PRIVATE_DATA->pending_images++;
+				indigo_populate_http_blob_item_async(property->items, (indigo_blob_fetch_callback)image_fetched, FILTER_CLIENT_CONTEXT->device);
+			} else if (property->items->blob.value) {
+				// previous image may still be analysed, replace it instead of resizing in place
+				void *image = indigo_alloc_image_buffer(property->items->blob.size);
+				assert(image != NULL);
+				memcpy(image, property->items->blob.value, property->items->blob.size);
+				indigo_release_image_buffer(CLIENT_PRIVATE_DATA->last_image);
+				CLIENT_PRIVATE_DATA->last_image = image;
 			} else if (CLIENT_PRIVATE_DATA->last_image) {
-				free(CLIENT_PRIVATE_DATA->last_image);
+				indigo_release_image_buffer(CLIENT_PRIVATE_DATA->last_image);
 				CLIENT_PRIVATE_DATA->last_image = NULL;
 			}
+			pthread_mutex_unlock(&CLIENT_PRIVATE_DATA->image_mutex);
 		} else if (property->state == INDIGO_OK_STATE && !strcmp(property->name, CCD_IMAGE_FILE_PROPERTY_NAME)) {
 			pthread_mutex_lock(&CLIENT_PRIVATE_DATA->mutex);
 			setup_download(FILTER_CLIENT_CONTEXT->device);
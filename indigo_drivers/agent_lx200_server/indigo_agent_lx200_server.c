@@ -340,7 +340,7 @@ static void start_listener_thread(indigo_device *device) {
 			handler_data *data = indigo_safe_malloc(sizeof(handler_data));
 			data->client_socket = client_socket;
 			data->device = device;
-			if (!indigo_async((void *(*)(void *))start_worker_thread, data))
+			if (!indigo_start_thread((void *(*)(void *))start_worker_thread, data))
 				INDIGO_DRIVER_ERROR(LX200_SERVER_AGENT_NAME, "Can't create worker thread for connection (%s)", strerror(errno));
 		}
 	}
@@ -391,7 +391,7 @@ static bool start_server(indigo_device *device) {
 		indigo_update_property(device, LX200_CONFIGURATION_PROPERTY, NULL);
 	}
   DEVICE_PRIVATE_DATA->server_socket = server_socket;
-	if (!indigo_async((void *(*)(void *))start_listener_thread, device)) {
+	if (!indigo_start_thread((void *(*)(void *))start_listener_thread, device)) {
 		close(server_socket);
 		LX200_SERVER_PROPERTY->state = INDIGO_ALERT_STATE;
     indigo_update_property(device, LX200_SERVER_PROPERTY, "%s: Can't create listener thread (%s)", LX200_SERVER_AGENT_NAME, strerror(errno));
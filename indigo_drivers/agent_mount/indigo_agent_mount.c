@@ -617,7 +617,7 @@ static void start_lx200_server(indigo_device *device) {
 			handler_data *data = indigo_safe_malloc(sizeof(handler_data));
 			data->client_socket = client_socket;
 			data->device = device;
-			if (!indigo_async((void *(*)(void *))worker_thread, data))
+			if (!indigo_start_thread((void *(*)(void *))worker_thread, data))
 				INDIGO_DRIVER_ERROR(MOUNT_AGENT_NAME, "Can't create worker thread for connection (%s)", strerror(errno));
 		}
 	}
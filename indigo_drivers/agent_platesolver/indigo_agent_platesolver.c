@@ -0,0 +1,869 @@
+// Copyright (c) 2021 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO native plate solver agent
+ \file indigo_agent_platesolver.c
+ */
+
+#define DRIVER_VERSION 0x0001
+#define DRIVER_NAME	"indigo_agent_platesolver"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <assert.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <limits.h>
+
+#include <indigo/indigo_driver_xml.h>
+#include <indigo/indigo_filter.h>
+#include <indigo/indigo_io.h>
+#include <indigo/indigo_cat_data.h>
+#include <indigo/indigo_platesolver.h>
+
+#include "indigo_agent_platesolver.h"
+
+#define DEG2RAD	(M_PI / 180.0)
+#define RAD2DEG	(180.0 / M_PI)
+
+#define INDEX_MAGIC						0x58444E49
+#define INDEX_VERSION					1
+#define INDEX_NEIGHBOURS			5
+#define INDEX_MIN_DISTANCE		(0.1 * DEG2RAD)
+#define INDEX_MAX_DISTANCE		(8.0 * DEG2RAD)
+#define CODE_BINS							28
+#define CODE_MIN							-0.25
+#define CODE_MAX							1.25
+#define CODE_TOLERANCE				0.01
+
+#define MAX_STARS							100
+#define QUERY_STARS						14
+#define MIN_MATCHES						6
+#define GOOD_MATCHES					15
+#define MIN_SCALE							(1.0 / 3600 * DEG2RAD)
+#define MAX_SCALE							(600.0 / 3600 * DEG2RAD)
+
+#define PLATESOLVER_DEVICE_PRIVATE_DATA	((platesolver_agent_private_data *)device->private_data)
+
+typedef struct {
+	platesolver_private_data platesolver;
+} platesolver_agent_private_data;
+
+// -------------------------------------------------------------------------------- Quad hash index
+
+// quads are built for several magnitude limits, so bright stars form large quads for wide fields
+static const double index_levels[] = { 5.0, 6.5, 8.0 };
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t star_count;
+	uint32_t quad_count;
+	uint32_t bins;
+} index_header;
+
+typedef struct {
+	float code[4];
+	int32_t stars[4];
+} index_quad;
+
+static struct {
+	bool loaded;
+	void *mapping;
+	size_t mapping_size;
+	bool in_memory;
+	uint32_t *buckets;
+	index_quad *quads;
+	int star_count;
+	double (*vectors)[3];
+} index_data;
+
+static pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline double dot(const double *a, const double *b) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void radec_to_vector(double ra, double dec, double *v) {
+	v[0] = cos(dec) * cos(ra);
+	v[1] = cos(dec) * sin(ra);
+	v[2] = sin(dec);
+}
+
+static void normalize(double *v) {
+	double r = sqrt(dot(v, v));
+	v[0] /= r;
+	v[1] /= r;
+	v[2] /= r;
+}
+
+// tangent plane at t with xi pointing east and eta pointing north
+typedef struct {
+	double t[3], east[3], north[3];
+} tangent_plane;
+
+static void init_plane(tangent_plane *plane, const double *t) {
+	double r = sqrt(t[0] * t[0] + t[1] * t[1]);
+	memcpy(plane->t, t, sizeof(plane->t));
+	if (r < 1e-12) {
+		plane->east[0] = 0; plane->east[1] = 1; plane->east[2] = 0;
+	} else {
+		plane->east[0] = -t[1] / r; plane->east[1] = t[0] / r; plane->east[2] = 0;
+	}
+	plane->north[0] = t[1] * plane->east[2] - t[2] * plane->east[1];
+	plane->north[1] = t[2] * plane->east[0] - t[0] * plane->east[2];
+	plane->north[2] = t[0] * plane->east[1] - t[1] * plane->east[0];
+}
+
+static bool project(const tangent_plane *plane, const double *v, double *xi, double *eta) {
+	double d = dot(v, plane->t);
+	if (d <= 0)
+		return false;
+	*xi = dot(v, plane->east) / d;
+	*eta = dot(v, plane->north) / d;
+	return true;
+}
+
+static void deproject(const tangent_plane *plane, double xi, double eta, double *v) {
+	for (int i = 0; i < 3; i++)
+		v[i] = plane->t[i] + xi * plane->east[i] + eta * plane->north[i];
+	normalize(v);
+}
+
+// code invariant to translation, rotation and scale - the most distant stars A and B are mapped to (0,0) and (1,1), C and D must lie in the circle with diameter AB and are ordered to break the remaining symmetries
+static bool quad_code(double points[4][2], int order[4], double code[4]) {
+	double max = 0;
+	int a = 0, b = 1, c = -1, d = -1;
+	for (int i = 0; i < 4; i++) {
+		for (int j = i + 1; j < 4; j++) {
+			double dx = points[j][0] - points[i][0], dy = points[j][1] - points[i][1];
+			double distance = dx * dx + dy * dy;
+			if (distance > max) {
+				max = distance;
+				a = i;
+				b = j;
+			}
+		}
+	}
+	if (max == 0)
+		return false;
+	for (int i = 0; i < 4; i++) {
+		if (i != a && i != b) {
+			if (c < 0)
+				c = i;
+			else
+				d = i;
+		}
+	}
+	double bx = points[b][0] - points[a][0], by = points[b][1] - points[a][1];
+	for (int k = 0; k < 2; k++) {
+		int i = k ? d : c;
+		double px = points[i][0] - points[a][0], py = points[i][1] - points[a][1];
+		double wx = (px * bx + py * by) / max, wy = (py * bx - px * by) / max;
+		if ((wx - 0.5) * (wx - 0.5) + wy * wy > 0.25)
+			return false;
+		code[2 * k] = wx - wy;
+		code[2 * k + 1] = wx + wy;
+	}
+	if (code[0] + code[2] > 1) {
+		int tmp = a; a = b; b = tmp;
+		for (int i = 0; i < 4; i++)
+			code[i] = 1 - code[i];
+	}
+	if (code[0] > code[2]) {
+		int tmp = c; c = d; d = tmp;
+		double x = code[0], y = code[1];
+		code[0] = code[2];
+		code[1] = code[3];
+		code[2] = x;
+		code[3] = y;
+	}
+	order[0] = a;
+	order[1] = b;
+	order[2] = c;
+	order[3] = d;
+	return true;
+}
+
+static inline int code_bin(double value) {
+	int bin = (int)((value - CODE_MIN) / (CODE_MAX - CODE_MIN) * CODE_BINS);
+	return bin < 0 ? 0 : (bin >= CODE_BINS ? CODE_BINS - 1 : bin);
+}
+
+static inline uint32_t code_bucket(int bins[4]) {
+	return ((bins[0] * CODE_BINS + bins[1]) * CODE_BINS + bins[2]) * CODE_BINS + bins[3];
+}
+
+static void init_stars(void) {
+	int count = 0;
+	while (indigo_star_data[count].hip)
+		count++;
+	index_data.star_count = count;
+	index_data.vectors = indigo_safe_malloc(count * sizeof(double[3]));
+	for (int i = 0; i < count; i++)
+		radec_to_vector(indigo_star_data[i].ra * 15 * DEG2RAD, indigo_star_data[i].dec * DEG2RAD, index_data.vectors[i]);
+}
+
+// find catalog stars brighter than max_mag within radius around v
+static int cone_search(const double *v, double radius, double max_mag, indigo_star_entry **result, int max_count) {
+	return indigo_cat_star_cone_search(atan2(v[1], v[0]) * RAD2DEG / 15, asin(v[2]) * RAD2DEG, radius * RAD2DEG, max_mag, result, max_count);
+}
+
+typedef struct {
+	int32_t key[4];
+	uint32_t index;
+} quad_key;
+
+static int compare_key(const void *a, const void *b) {
+	return memcmp(((quad_key *)a)->key, ((quad_key *)b)->key, sizeof(((quad_key *)a)->key));
+}
+
+static int compare_int(const void *a, const void *b) {
+	return *(int *)a - *(int *)b;
+}
+
+static void *build_index(const char *path, size_t *size) {
+	int quads_size = 1024 * 1024, count = 0, cone_size = 4096;
+	index_quad *quads = indigo_safe_malloc(quads_size * sizeof(index_quad));
+	indigo_star_entry **cone = indigo_safe_malloc(cone_size * sizeof(indigo_star_entry *));
+	double min_cos = cos(INDEX_MIN_DISTANCE);
+	for (int level = 0; level < sizeof(index_levels) / sizeof(double); level++) {
+		double max_mag = index_levels[level];
+		for (int anchor = 0; anchor < index_data.star_count; anchor++) {
+			if (indigo_star_data[anchor].mag > max_mag)
+				continue;
+			double *v = index_data.vectors[anchor];
+			int cone_count = cone_search(v, INDEX_MAX_DISTANCE, max_mag, cone, cone_size);
+			// select INDEX_NEIGHBOURS nearest stars
+			int neighbours[INDEX_NEIGHBOURS];
+			double distances[INDEX_NEIGHBOURS];
+			int neighbour_count = 0;
+			for (int i = 0; i < cone_count; i++) {
+				double distance = dot(index_data.vectors[cone[i] - indigo_star_data], v);
+				if (distance > min_cos)
+					continue;
+				int j = neighbour_count < INDEX_NEIGHBOURS ? neighbour_count++ : INDEX_NEIGHBOURS;
+				for (; j > 0 && distances[j - 1] < distance; j--) {
+					if (j < INDEX_NEIGHBOURS) {
+						neighbours[j] = neighbours[j - 1];
+						distances[j] = distances[j - 1];
+					}
+				}
+				if (j < INDEX_NEIGHBOURS) {
+					neighbours[j] = (int)(cone[i] - indigo_star_data);
+					distances[j] = distance;
+				}
+			}
+			for (int i = 0; i < neighbour_count; i++) {
+				for (int j = i + 1; j < neighbour_count; j++) {
+					for (int k = j + 1; k < neighbour_count; k++) {
+						int stars[4] = { anchor, neighbours[i], neighbours[j], neighbours[k] };
+						double center[3] = { 0, 0, 0 }, points[4][2], code[4];
+						int order[4];
+						tangent_plane plane;
+						for (int l = 0; l < 4; l++)
+							for (int m = 0; m < 3; m++)
+								center[m] += index_data.vectors[stars[l]][m];
+						normalize(center);
+						init_plane(&plane, center);
+						bool projected = true;
+						for (int l = 0; l < 4 && projected; l++)
+							projected = project(&plane, index_data.vectors[stars[l]], &points[l][0], &points[l][1]);
+						if (!projected || !quad_code(points, order, code))
+							continue;
+						if (count == quads_size)
+							quads = indigo_safe_realloc(quads, (quads_size *= 2) * sizeof(index_quad));
+						index_quad *quad = quads + count++;
+						for (int l = 0; l < 4; l++) {
+							quad->code[l] = code[l];
+							quad->stars[l] = stars[order[l]];
+						}
+					}
+				}
+			}
+		}
+	}
+	free(cone);
+	// remove quads made of the same stars for different anchors or levels
+	quad_key *keys = indigo_safe_malloc(count * sizeof(quad_key));
+	for (int i = 0; i < count; i++) {
+		memcpy(keys[i].key, quads[i].stars, sizeof(keys[i].key));
+		qsort(keys[i].key, 4, sizeof(int32_t), compare_int);
+		keys[i].index = i;
+	}
+	qsort(keys, count, sizeof(quad_key), compare_key);
+	// sort unique quads to code buckets
+	uint32_t bucket_count = CODE_BINS * CODE_BINS * CODE_BINS * CODE_BINS;
+	uint32_t *buckets = indigo_safe_malloc((bucket_count + 1) * sizeof(uint32_t));
+	uint32_t *quad_buckets = indigo_safe_malloc(count * sizeof(uint32_t));
+	uint32_t unique_count = 0;
+	for (int i = 0; i < count; i++) {
+		index_quad *quad = quads + keys[i].index;
+		if (i > 0 && !compare_key(keys + i - 1, keys + i)) {
+			quad_buckets[keys[i].index] = UINT32_MAX;
+			continue;
+		}
+		int bins[4];
+		for (int l = 0; l < 4; l++)
+			bins[l] = code_bin(quad->code[l]);
+		uint32_t bucket = code_bucket(bins);
+		quad_buckets[keys[i].index] = bucket;
+		buckets[bucket + 1]++;
+		unique_count++;
+	}
+	free(keys);
+	for (uint32_t i = 0; i < bucket_count; i++)
+		buckets[i + 1] += buckets[i];
+	// index is assembled in memory with the same layout as the file, so it can be used directly if the file can't be written
+	*size = sizeof(index_header) + (bucket_count + 1) * sizeof(uint32_t) + unique_count * sizeof(index_quad);
+	index_header *header = indigo_safe_malloc(*size);
+	*header = (index_header){ INDEX_MAGIC, INDEX_VERSION, index_data.star_count, unique_count, CODE_BINS };
+	memcpy(header + 1, buckets, (bucket_count + 1) * sizeof(uint32_t));
+	index_quad *sorted = (index_quad *)((uint32_t *)(header + 1) + bucket_count + 1);
+	uint32_t *next = buckets;
+	for (int i = 0; i < count; i++) {
+		if (quad_buckets[i] != UINT32_MAX)
+			sorted[next[quad_buckets[i]]++] = quads[i];
+	}
+	free(buckets);
+	free(quad_buckets);
+	free(quads);
+	// write index to temporary file and rename it to make the update atomic
+	char tmp_path[PATH_MAX + 4];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	bool result = false;
+	int handle = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (handle >= 0) {
+		result = indigo_write(handle, (const char *)header, *size);
+		close(handle);
+		if (result && rename(tmp_path, path))
+			result = false;
+		if (!result)
+			unlink(tmp_path);
+	}
+	if (result)
+		INDIGO_DRIVER_LOG(DRIVER_NAME, "Index with %u quads created in %s", unique_count, path);
+	else
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to create index %s (%s)", path, strerror(errno));
+	return header;
+}
+
+static bool use_index(void *data, size_t size) {
+	index_header *header = data;
+	uint32_t bucket_count = CODE_BINS * CODE_BINS * CODE_BINS * CODE_BINS;
+	if (size < sizeof(index_header) || header->magic != INDEX_MAGIC || header->version != INDEX_VERSION || header->star_count != index_data.star_count || header->bins != CODE_BINS || size != sizeof(index_header) + (bucket_count + 1) * sizeof(uint32_t) + header->quad_count * sizeof(index_quad))
+		return false;
+	index_data.mapping = data;
+	index_data.mapping_size = size;
+	index_data.buckets = (uint32_t *)(header + 1);
+	index_data.quads = (index_quad *)(index_data.buckets + bucket_count + 1);
+	return true;
+}
+
+static bool map_index(const char *path) {
+	int handle = open(path, O_RDONLY);
+	if (handle < 0)
+		return false;
+	struct stat st;
+	if (fstat(handle, &st) || st.st_size < sizeof(index_header)) {
+		close(handle);
+		return false;
+	}
+	void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, handle, 0);
+	close(handle);
+	if (mapping == MAP_FAILED)
+		return false;
+	if (!use_index(mapping, st.st_size)) {
+		munmap(mapping, st.st_size);
+		return false;
+	}
+	return true;
+}
+
+static bool load_index(void) {
+	pthread_mutex_lock(&index_mutex);
+	if (!index_data.loaded) {
+		char path[PATH_MAX];
+		if (index_data.vectors == NULL)
+			init_stars();
+		snprintf(path, sizeof(path), "%s/.indigo/platesolver/index.bin", getenv("HOME"));
+		if (!map_index(path)) {
+			INDIGO_DRIVER_LOG(DRIVER_NAME, "Building index, this may take a while...");
+			size_t size;
+			void *data = build_index(path, &size);
+			if (map_index(path)) {
+				free(data);
+			} else if (use_index(data, size)) {
+				INDIGO_DRIVER_ERROR(DRIVER_NAME, "Can't use index %s, using in-memory copy", path);
+				index_data.in_memory = true;
+			} else {
+				free(data);
+			}
+		}
+		index_data.loaded = index_data.mapping != NULL;
+	}
+	pthread_mutex_unlock(&index_mutex);
+	return index_data.loaded;
+}
+
+static void *load_index_handler(void *data) {
+	load_index();
+	return NULL;
+}
+
+static void unload_index(void) {
+	pthread_mutex_lock(&index_mutex);
+	if (index_data.in_memory)
+		free(index_data.mapping);
+	else if (index_data.mapping)
+		munmap(index_data.mapping, index_data.mapping_size);
+	indigo_safe_free(index_data.vectors);
+	memset(&index_data, 0, sizeof(index_data));
+	pthread_mutex_unlock(&index_mutex);
+}
+
+// -------------------------------------------------------------------------------- Solver
+
+typedef struct {
+	indigo_star_detection *stars;
+	int star_count;
+	int width, height;
+	indigo_star_entry **cone;
+	double hint[3];
+	double hint_radius;
+	double tolerance;
+	// best solution
+	int matches;
+	int expected;
+	int pairs[MAX_STARS][2];
+} solver_context;
+
+typedef struct {
+	double ra, dec, angle, width, height, scale;
+	int parity;
+} solver_solution;
+
+typedef struct {
+	double x, y;
+	float mag;
+	int star;
+} projected_star;
+
+static int compare_projected(const void *a, const void *b) {
+	float ma = ((projected_star *)a)->mag, mb = ((projected_star *)b)->mag;
+	return ma < mb ? -1 : (ma > mb ? 1 : 0);
+}
+
+// verify candidate similarity transformation w = a * z + b in plane, z = x + i * parity * y, by matching projected catalog stars to detected stars
+static void verify(solver_context *context, const tangent_plane *plane, double ar, double ai, double br, double bi, int parity) {
+	double scale = sqrt(ar * ar + ai * ai);
+	double center[3], cx = (context->width - 1) / 2.0, cy = parity * (context->height - 1) / 2.0;
+	deproject(plane, ar * cx - ai * cy + br, ai * cx + ar * cy + bi, center);
+	double field_radius = scale * sqrt(context->width * context->width + context->height * context->height) / 2;
+	if (context->hint_radius > 0 && acos(fmin(1, dot(center, context->hint))) > context->hint_radius + field_radius)
+		return;
+	int count = cone_search(center, field_radius, 99, context->cone, index_data.star_count);
+	projected_star *projected = indigo_safe_malloc(count * sizeof(projected_star) + 1);
+	int projected_count = 0;
+	double norm = ar * ar + ai * ai;
+	for (int i = 0; i < count; i++) {
+		double xi, eta;
+		int index = (int)(context->cone[i] - indigo_star_data);
+		if (!project(plane, index_data.vectors[index], &xi, &eta))
+			continue;
+		// z = (w - b) / a
+		double wr = xi - br, wi = eta - bi;
+		double x = (wr * ar + wi * ai) / norm, y = parity * (wi * ar - wr * ai) / norm;
+		if (x >= 0 && x < context->width && y >= 0 && y < context->height) {
+			projected_star *star = projected + projected_count++;
+			star->x = x;
+			star->y = y;
+			star->mag = context->cone[i]->mag;
+			star->star = index;
+		}
+	}
+	qsort(projected, projected_count, sizeof(projected_star), compare_projected);
+	if (projected_count > 2 * context->star_count)
+		projected_count = 2 * context->star_count;
+	bool used[MAX_STARS] = { false };
+	int pairs[MAX_STARS][2], matches = 0;
+	double tolerance = context->tolerance * context->tolerance;
+	for (int i = 0; i < projected_count && matches < MAX_STARS; i++) {
+		int best = -1;
+		double best_distance = tolerance;
+		for (int j = 0; j < context->star_count; j++) {
+			if (used[j])
+				continue;
+			double dx = context->stars[j].x - projected[i].x, dy = context->stars[j].y - projected[i].y;
+			double distance = dx * dx + dy * dy;
+			if (distance < best_distance) {
+				best_distance = distance;
+				best = j;
+			}
+		}
+		if (best >= 0) {
+			used[best] = true;
+			pairs[matches][0] = best;
+			pairs[matches][1] = projected[i].star;
+			matches++;
+		}
+	}
+	int expected = projected_count < context->star_count ? projected_count : context->star_count;
+	if (matches >= MIN_MATCHES && matches >= expected / 4 && matches > context->matches) {
+		context->matches = matches;
+		context->expected = expected;
+		memcpy(context->pairs, pairs, matches * sizeof(pairs[0]));
+	}
+	free(projected);
+}
+
+// try to match image quad to index quads with similar code
+static void match_quad(solver_context *context, int image_stars[4], int parity) {
+	double points[4][2], code[4];
+	int order[4];
+	for (int i = 0; i < 4; i++) {
+		points[i][0] = context->stars[image_stars[i]].x;
+		points[i][1] = parity * context->stars[image_stars[i]].y;
+	}
+	if (!quad_code(points, order, code))
+		return;
+	int low[4], high[4], bins[4];
+	for (int i = 0; i < 4; i++) {
+		low[i] = code_bin(code[i] - CODE_TOLERANCE);
+		high[i] = code_bin(code[i] + CODE_TOLERANCE);
+	}
+	for (bins[0] = low[0]; bins[0] <= high[0]; bins[0]++) {
+		for (bins[1] = low[1]; bins[1] <= high[1]; bins[1]++) {
+			for (bins[2] = low[2]; bins[2] <= high[2]; bins[2]++) {
+				for (bins[3] = low[3]; bins[3] <= high[3]; bins[3]++) {
+					uint32_t bucket = code_bucket(bins);
+					for (uint32_t q = index_data.buckets[bucket]; q < index_data.buckets[bucket + 1]; q++) {
+						index_quad *quad = index_data.quads + q;
+						double distance = 0;
+						for (int i = 0; i < 4; i++)
+							distance += (quad->code[i] - code[i]) * (quad->code[i] - code[i]);
+						if (distance > CODE_TOLERANCE * CODE_TOLERANCE)
+							continue;
+						// fit similarity transformation from image to tangent plane at quad center
+						double center[3] = { 0, 0, 0 }, zr[4], zi[4], wr[4], wi[4];
+						tangent_plane plane;
+						for (int i = 0; i < 4; i++)
+							for (int j = 0; j < 3; j++)
+								center[j] += index_data.vectors[quad->stars[i]][j];
+						normalize(center);
+						init_plane(&plane, center);
+						double mzr = 0, mzi = 0, mwr = 0, mwi = 0;
+						bool projected = true;
+						for (int i = 0; i < 4 && projected; i++) {
+							zr[i] = points[order[i]][0];
+							zi[i] = points[order[i]][1];
+							projected = project(&plane, index_data.vectors[quad->stars[i]], wr + i, wi + i);
+							mzr += zr[i] / 4; mzi += zi[i] / 4;
+							mwr += wr[i] / 4; mwi += wi[i] / 4;
+						}
+						if (!projected)
+							continue;
+						double nr = 0, ni = 0, d = 0;
+						for (int i = 0; i < 4; i++) {
+							double dzr = zr[i] - mzr, dzi = zi[i] - mzi, dwr = wr[i] - mwr, dwi = wi[i] - mwi;
+							nr += dwr * dzr + dwi * dzi;
+							ni += dwi * dzr - dwr * dzi;
+							d += dzr * dzr + dzi * dzi;
+						}
+						if (d == 0)
+							continue;
+						double ar = nr / d, ai = ni / d;
+						double scale = sqrt(ar * ar + ai * ai);
+						if (scale < MIN_SCALE || scale > MAX_SCALE)
+							continue;
+						double br = mwr - (ar * mzr - ai * mzi), bi = mwi - (ai * mzr + ar * mzi);
+						verify(context, &plane, ar, ai, br, bi, parity);
+						if (context->matches >= GOOD_MATCHES)
+							return;
+					}
+				}
+			}
+		}
+	}
+}
+
+// solve 3x3 linear system with Cramer's rule
+static bool solve_3x3(double m[3][3], double r[3], double x[3]) {
+	double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+	if (fabs(det) < 1e-300)
+		return false;
+	for (int k = 0; k < 3; k++) {
+		double t[3][3];
+		memcpy(t, m, sizeof(t));
+		for (int i = 0; i < 3; i++)
+			t[i][k] = r[i];
+		x[k] = (t[0][0] * (t[1][1] * t[2][2] - t[1][2] * t[2][1]) - t[0][1] * (t[1][0] * t[2][2] - t[1][2] * t[2][0]) + t[0][2] * (t[1][0] * t[2][1] - t[1][1] * t[2][0])) / det;
+	}
+	return true;
+}
+
+// refine solution with affine least squares fit of all matched stars, the second pass uses tangent plane at the frame center to get correct angle
+static bool refine(solver_context *context, solver_solution *solution) {
+	double center[3] = { 0, 0, 0 }, p[3], q[3], v[3];
+	double cx = (context->width - 1) / 2.0, cy = (context->height - 1) / 2.0;
+	for (int i = 0; i < context->matches; i++)
+		for (int j = 0; j < 3; j++)
+			center[j] += index_data.vectors[context->pairs[i][1]][j];
+	normalize(center);
+	for (int pass = 0; pass < 2; pass++) {
+		tangent_plane plane;
+		init_plane(&plane, center);
+		double m[3][3] = { { 0 } }, rxi[3] = { 0 }, reta[3] = { 0 };
+		for (int i = 0; i < context->matches; i++) {
+			double x = context->stars[context->pairs[i][0]].x, y = context->stars[context->pairs[i][0]].y, xi, eta;
+			if (!project(&plane, index_data.vectors[context->pairs[i][1]], &xi, &eta))
+				continue;
+			double r[3] = { 1, x, y };
+			for (int j = 0; j < 3; j++) {
+				for (int k = 0; k < 3; k++)
+					m[j][k] += r[j] * r[k];
+				rxi[j] += r[j] * xi;
+				reta[j] += r[j] * eta;
+			}
+		}
+		if (!solve_3x3(m, rxi, p) || !solve_3x3(m, reta, q))
+			return false;
+		deproject(&plane, p[0] + p[1] * cx + p[2] * cy, q[0] + q[1] * cx + q[2] * cy, v);
+		memcpy(center, v, sizeof(center));
+	}
+	double det = p[1] * q[2] - p[2] * q[1];
+	double scale = sqrt(fabs(det)) * RAD2DEG;
+	double ra = atan2(v[1], v[0]) * RAD2DEG / 15;
+	if (ra < 0)
+		ra += 24;
+	double angle = atan2(-p[2], -q[2]) * RAD2DEG;
+	if (angle < 0)
+		angle += 360;
+	solution->ra = ra;
+	solution->dec = asin(v[2]) * RAD2DEG;
+	solution->angle = angle;
+	solution->width = context->width * scale;
+	solution->height = context->height * scale;
+	solution->scale = scale;
+	solution->parity = det > 0 ? 1 : -1;
+	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Solution RA %g, Dec %g, angle %g, scale %g\"/px, %d of %d stars matched", solution->ra, solution->dec, angle, scale * 3600, context->matches, context->expected);
+	return true;
+}
+
+// match quads of brighter stars first, stop on good enough match or time limit
+static void search(solver_context *context, int parity_hint, double cpu_limit) {
+	int query_count = context->star_count < QUERY_STARS ? context->star_count : QUERY_STARS;
+	struct timeval start, now;
+	gettimeofday(&start, NULL);
+	for (int l = 3; l < query_count && context->matches < GOOD_MATCHES; l++) {
+		for (int i = 0; i < l && context->matches < GOOD_MATCHES; i++) {
+			for (int j = i + 1; j < l && context->matches < GOOD_MATCHES; j++) {
+				for (int k = j + 1; k < l && context->matches < GOOD_MATCHES; k++) {
+					int image_stars[4] = { i, j, k, l };
+					if (parity_hint >= 0)
+						match_quad(context, image_stars, 1);
+					if (parity_hint <= 0 && context->matches < GOOD_MATCHES)
+						match_quad(context, image_stars, -1);
+				}
+			}
+		}
+		gettimeofday(&now, NULL);
+		if (cpu_limit > 0 && (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6 > cpu_limit)
+			break;
+	}
+}
+
+static void *platesolver_solve(indigo_platesolver_task *task) {
+	indigo_device *device = task->device;
+	pthread_mutex_lock(&DEVICE_CONTEXT->config_mutex);
+	indigo_star_detection stars[MAX_STARS];
+	solver_context context = { 0 };
+	context.stars = stars;
+	AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_BUSY_STATE;
+	AGENT_PLATESOLVER_WCS_RA_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_DEC_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_WIDTH_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_HEIGHT_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_SCALE_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_ANGLE_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_INDEX_ITEM->number.value = 0;
+	AGENT_PLATESOLVER_WCS_PARITY_ITEM->number.value = 0;
+	indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Running plate solver...");
+	if (!load_index()) {
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Failed to load index");
+		goto cleanup;
+	}
+	if (!indigo_platesolver_find_stars(task->image, task->size, (int)AGENT_PLATESOLVER_HINTS_DOWNSAMPLE_ITEM->number.value, MAX_STARS, stars, &context.star_count, &context.width, &context.height)) {
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Unsupported image format");
+		goto cleanup;
+	}
+	if (context.star_count < MIN_MATCHES) {
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "Not enough stars detected");
+		goto cleanup;
+	}
+	context.tolerance = fmax(5, 0.005 * sqrt(context.width * context.width + context.height * context.height));
+	context.hint_radius = AGENT_PLATESOLVER_HINTS_RADIUS_ITEM->number.value * DEG2RAD;
+	radec_to_vector(AGENT_PLATESOLVER_HINTS_RA_ITEM->number.value * 15 * DEG2RAD, AGENT_PLATESOLVER_HINTS_DEC_ITEM->number.value * DEG2RAD, context.hint);
+	context.cone = indigo_safe_malloc(index_data.star_count * sizeof(indigo_star_entry *));
+	int parity_hint = (int)AGENT_PLATESOLVER_HINTS_PARITY_ITEM->number.value;
+	double cpu_limit = AGENT_PLATESOLVER_HINTS_CPU_LIMIT_ITEM->number.value;
+	search(&context, parity_hint, cpu_limit);
+	free(context.cone);
+	solver_solution solution;
+	if (context.matches > 0 && refine(&context, &solution)) {
+		AGENT_PLATESOLVER_WCS_RA_ITEM->number.value = solution.ra;
+		AGENT_PLATESOLVER_WCS_DEC_ITEM->number.value = solution.dec;
+		AGENT_PLATESOLVER_WCS_ANGLE_ITEM->number.value = solution.angle;
+		AGENT_PLATESOLVER_WCS_WIDTH_ITEM->number.value = solution.width;
+		AGENT_PLATESOLVER_WCS_HEIGHT_ITEM->number.value = solution.height;
+		AGENT_PLATESOLVER_WCS_SCALE_ITEM->number.value = solution.scale;
+		AGENT_PLATESOLVER_WCS_PARITY_ITEM->number.value = solution.parity;
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, NULL);
+		indigo_platesolver_sync(device);
+	} else {
+		AGENT_PLATESOLVER_WCS_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, "No solution found");
+	}
+cleanup:
+	pthread_mutex_unlock(&DEVICE_CONTEXT->config_mutex);
+	return NULL;
+}
+
+// -------------------------------------------------------------------------------- INDIGO agent device implementation
+
+static indigo_result agent_enumerate_properties(indigo_device *device, indigo_client *client, indigo_property *property);
+
+static indigo_result agent_device_attach(indigo_device *device) {
+	assert(device != NULL);
+	if (indigo_platesolver_device_attach(device, DRIVER_NAME, DRIVER_VERSION, 0) == INDIGO_OK) {
+		AGENT_PLATESOLVER_USE_INDEX_PROPERTY->hidden = true;
+		// --------------------------------------------------------------------------------
+		PLATESOLVER_DEVICE_PRIVATE_DATA->platesolver.save_config = indigo_platesolver_save_config;
+		PLATESOLVER_DEVICE_PRIVATE_DATA->platesolver.solve = platesolver_solve;
+		char path[PATH_MAX];
+		snprintf(path, sizeof((path)), "%s/.indigo/", getenv("HOME"));
+		mkdir(path, 0777);
+		strcat(path, "platesolver/");
+		mkdir(path, 0777);
+		indigo_start_thread(load_index_handler, NULL);
+		indigo_load_properties(device, false);
+		INDIGO_DEVICE_ATTACH_LOG(DRIVER_NAME, device->name);
+		return agent_enumerate_properties(device, NULL, NULL);
+	}
+	return INDIGO_FAILED;
+}
+
+static indigo_result agent_enumerate_properties(indigo_device *device, indigo_client *client, indigo_property *property) {
+	if (client != NULL && client == FILTER_DEVICE_CONTEXT->client)
+		return INDIGO_OK;
+	return indigo_platesolver_enumerate_properties(device, client, property);
+}
+
+static indigo_result agent_change_property(indigo_device *device, indigo_client *client, indigo_property *property) {
+	assert(device != NULL);
+	assert(DEVICE_CONTEXT != NULL);
+	assert(property != NULL);
+	if (client == FILTER_DEVICE_CONTEXT->client)
+		return INDIGO_OK;
+	return indigo_platesolver_change_property(device, client, property);
+}
+
+static indigo_result agent_device_detach(indigo_device *device) {
+	assert(device != NULL);
+	return indigo_platesolver_device_detach(device);
+}
+
+// -------------------------------------------------------------------------------- Initialization
+
+static indigo_device *agent_device = NULL;
+static indigo_client *agent_client = NULL;
+
+indigo_result indigo_agent_platesolver(indigo_driver_action action, indigo_driver_info *info) {
+	static indigo_device agent_device_template = INDIGO_DEVICE_INITIALIZER(
+		PLATESOLVER_AGENT_NAME,
+		agent_device_attach,
+		agent_enumerate_properties,
+		agent_change_property,
+		NULL,
+		agent_device_detach
+	);
+
+	static indigo_client agent_client_template = {
+		PLATESOLVER_AGENT_NAME, false, NULL, INDIGO_OK, INDIGO_VERSION_CURRENT, NULL,
+		indigo_platesolver_client_attach,
+		indigo_platesolver_define_property,
+		indigo_platesolver_update_property,
+		indigo_platesolver_delete_property,
+		NULL,
+		indigo_platesolver_client_detach
+	};
+
+	static indigo_driver_action last_action = INDIGO_DRIVER_SHUTDOWN;
+
+	SET_DRIVER_INFO(info, PLATESOLVER_AGENT_NAME, __FUNCTION__, DRIVER_VERSION, false, last_action);
+
+	if (action == last_action)
+		return INDIGO_OK;
+
+	switch(action) {
+		case INDIGO_DRIVER_INIT:
+			last_action = action;
+			void *private_data = indigo_safe_malloc(sizeof(platesolver_agent_private_data));
+			agent_device = indigo_safe_malloc_copy(sizeof(indigo_device), &agent_device_template);
+			agent_device->private_data = private_data;
+			indigo_attach_device(agent_device);
+			agent_client = indigo_safe_malloc_copy(sizeof(indigo_client), &agent_client_template);
+			agent_client->client_context = agent_device->device_context;
+			indigo_attach_client(agent_client);
+			break;
+
+		case INDIGO_DRIVER_SHUTDOWN:
+			last_action = action;
+			if (agent_client != NULL) {
+				indigo_detach_client(agent_client);
+				free(agent_client);
+				agent_client = NULL;
+			}
+			if (agent_device != NULL) {
+				indigo_detach_device(agent_device);
+				free(agent_device);
+				agent_device = NULL;
+			}
+			unload_index();
+			break;
+
+		case INDIGO_DRIVER_INFO:
+			break;
+	}
+	return INDIGO_OK;
+}
@@ -1,4 +1,4 @@
-// Copyright (c) 2019 CloudMakers, s. r. o.
+// Copyright (c) 2021 CloudMakers, s. r. o.
 // All rights reserved.
 //
 // You can use this software under the terms of 'INDIGO Astronomy
@@ -19,33 +19,29 @@
 // version history
 // 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
 
-/** INDIGO Mount control agent
- \file indigo_cat_data.h
+/** INDIGO native plate solver agent
+ \file indigo_agent_platesolver.h
  */
 
+#ifndef agent_platesolver_h
+#define agent_platesolver_h
 
-#ifndef star_data_h
-#define star_data_h
+#include <indigo/indigo_agent.h>
 
-typedef struct {
-	int hip;
-	double ra, dec;
-	float promora, promodec, px, rv, mag;
-	char *name;
-} indigo_star_entry;
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-typedef struct {
-	char *id;
-	double ra, dec;
-	float mag, r1, r2, angle;
-	char *name;
-} indigo_dso_entry;
+#define PLATESOLVER_AGENT_NAME	"Plate Solver Agent"
+	
+/** Create native plate solver agent instance
+ */
+
+extern indigo_result indigo_agent_platesolver(indigo_driver_action action, indigo_driver_info *info);
 
-extern indigo_star_entry indigo_star_data[];
-extern indigo_dso_entry indigo_dso_data[];
+#ifdef __cplusplus
+}
+#endif
 
-extern void *indigo_add_star_json_resource(int max_mag);
-extern void *indigo_add_dso_json_resource(int max_mag);
-extern void *indigo_add_constellations_lines_json_resource(void);
+#endif /* agent_platesolver_h */
 
-#endif /* star_data_h */
@@ -56,52 +56,15 @@ typedef struct {
 // -------------------------------------------------------------------------------- Low level communication routines
 
 static bool sx_flush(indigo_device *device) {
-	char c;
-	struct timeval tv;
-	while (true) {
-		fd_set readout;
-		FD_ZERO(&readout);
-		FD_SET(PRIVATE_DATA->handle, &readout);
-		tv.tv_sec = 0;
-		tv.tv_usec = 1000;
-		long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-		if (result == 0)
-			return true;
-		if (result < 0) {
-			return false;
-		}
-		result = read(PRIVATE_DATA->handle, &c, 1);
-		if (result < 1) {
-			return false;
-		}
-	}
+	return indigo_drain(PRIVATE_DATA->handle);
 }
 
 static bool sx_command(indigo_device *device, char *command, char *response, int max) {
-	char c;
-	struct timeval tv;
-	indigo_write(PRIVATE_DATA->handle, command, strlen(command));
-	if (response != NULL) {
-		int index = 0;
-		int timeout = *command == 'K' || *command == 'R' ? 15 : 1;
-		*response = 0;
-		while (index < max) {
-			fd_set readout;
-			FD_ZERO(&readout);
-			FD_SET(PRIVATE_DATA->handle, &readout);
-			tv.tv_sec = timeout;
-			tv.tv_usec = 100000;
-			long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-			if (result <= 0)
-				break;
-			result = read(PRIVATE_DATA->handle, &c, 1);
-			if (result < 1) {
-				INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to read from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
-				return false;
-			}
-			response[index++] = c;
-		}
-		response[index] = 0;
+	long timeout = *command == 'K' || *command == 'R' ? 15100000 : 1100000;
+	indigo_transaction transaction = { .command = command, .response = response, .response_size = max + 1, .response_length = max, .timeout = timeout };
+	if (!indigo_execute_transactions(PRIVATE_DATA->handle, &transaction, 1, false, false)) {
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to execute %s on %s -> %s (%d)", command, DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
+		return false;
 	}
 	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> %s", command, response != NULL ? response : "NULL");
 	return true;
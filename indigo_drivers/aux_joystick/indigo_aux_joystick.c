@@ -801,7 +801,7 @@ static void shutdown() {
 }
 
 static bool open_joystick(indigo_device *device) {
-	indigo_async((void *(*)(void *))poll, device);
+	indigo_start_thread((void *(*)(void *))poll, device);
 	return true;
 }
 
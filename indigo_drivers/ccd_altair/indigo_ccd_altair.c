@@ -515,7 +515,7 @@ static void ccd_connect_callback(indigo_device *device) {
 		INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Altaircam_Stop() -> %08x", result);
 		indigo_cancel_timer_sync(device, &PRIVATE_DATA->temperature_timer);
 		if (PRIVATE_DATA->buffer != NULL) {
-			free(PRIVATE_DATA->buffer);
+			indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 		}
 		if (X_CCD_ADVANCED_PROPERTY)
@@ -649,8 +649,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 			return INDIGO_OK;
 		indigo_property_copy_values(CCD_EXPOSURE_PROPERTY, property, false);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -672,8 +671,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 			return INDIGO_OK;
 		indigo_property_copy_values(CCD_STREAMING_PROPERTY, property, false);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -594,7 +594,7 @@ static void apogee_close(indigo_device *device) {
 	}
 	indigo_global_unlock(device);
 	if (PRIVATE_DATA->buffer != NULL) {
-		free(PRIVATE_DATA->buffer);
+		indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 		PRIVATE_DATA->buffer = NULL;
 	}
 	pthread_mutex_unlock(&PRIVATE_DATA->usb_mutex);
@@ -879,8 +879,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		indigo_update_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 		
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -1490,7 +1489,7 @@ static void remove_all_devices() {
 			continue;
 		indigo_detach_device(*device);
 		if (((apogee_private_data *)(*device)->private_data)->buffer)
-			free(((apogee_private_data *)(*device)->private_data)->buffer);
+			indigo_free_blob_buffer(((apogee_private_data *)(*device)->private_data)->buffer);
 		free((*device)->private_data);
 		free(*device);
 		*device = NULL;
@@ -438,7 +438,7 @@ static void asi_close(indigo_device *device) {
 		INDIGO_DRIVER_DEBUG(DRIVER_NAME, "ASICloseCamera(%d, ASI_COOLER_POWER_PERC)", PRIVATE_DATA->dev_id);
 		indigo_global_unlock(device);
 		if (PRIVATE_DATA->buffer != NULL) {
-			free(PRIVATE_DATA->buffer);
+			indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 		}
 	}
@@ -1022,8 +1022,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		CCD_EXPOSURE_PROPERTY->state = INDIGO_BUSY_STATE;
 		indigo_update_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -1044,8 +1043,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		CCD_STREAMING_PROPERTY->state = INDIGO_BUSY_STATE;
 		indigo_update_property(device, CCD_STREAMING_PROPERTY, NULL);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -1664,7 +1662,7 @@ static void process_unplug_event(indigo_device *unused) {
 		if (private_data) {
 			ASICloseCamera(id);
 			if (private_data->buffer != NULL) {
-				free(private_data->buffer);
+				indigo_free_blob_buffer(private_data->buffer);
 				private_data->buffer = NULL;
 			}
 			free(private_data);
@@ -1716,7 +1714,7 @@ static void remove_all_devices() {
 		if (pds[i]) {
 			if (pds[i]->buffer != NULL) {
 				ASICloseCamera(pds[i]->dev_id);
-				free(pds[i]->buffer);
+				indigo_free_blob_buffer(pds[i]->buffer);
 				pds[i]->buffer = NULL;
 			}
 			free(pds[i]);
@@ -254,7 +254,7 @@ static void ccd_connect_callback(indigo_device *device) {
 		}
 		if (PRIVATE_DATA->handle == NULL) {
 			if (PRIVATE_DATA->buffer != NULL) {
-				free(PRIVATE_DATA->buffer);
+				indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 				PRIVATE_DATA->buffer = NULL;
 			}
 			PRIVATE_DATA->device_count--;
@@ -275,7 +275,7 @@ static void ccd_connect_callback(indigo_device *device) {
 		}
 		indigo_cancel_timer_sync(device, &PRIVATE_DATA->temperature_timer);
 		if (PRIVATE_DATA->buffer != NULL) {
-			free(PRIVATE_DATA->buffer);
+			indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 		}
 		if (--PRIVATE_DATA->device_count == 0) {
@@ -415,8 +415,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		indigo_property_copy_values(CCD_EXPOSURE_PROPERTY, property, false);
 		indigo_use_shortest_exposure_if_bias(device);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -573,7 +572,7 @@ static void guider_connect_callback(indigo_device *device) {
 	} else {
 		indigo_cancel_timer_sync(device, &PRIVATE_DATA->guider_timer);
 		if (PRIVATE_DATA->buffer != NULL) {
-			free(PRIVATE_DATA->buffer);
+			indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 		}
 		if (--PRIVATE_DATA->device_count == 0) {
@@ -913,7 +912,7 @@ static void unplug_handler(indigo_device *device) {
 			indigo_detach_device(device);
 			if (PRIVATE_DATA) {
 				if (PRIVATE_DATA->buffer)
-					free(PRIVATE_DATA->buffer);
+					indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 				free(PRIVATE_DATA);
 			}
 			free(device);
@@ -984,7 +983,7 @@ indigo_result indigo_ccd_atik(indigo_driver_action action, indigo_driver_info *i
 					indigo_detach_device(device);
 					if (PRIVATE_DATA) {
 						if (PRIVATE_DATA->buffer)
-						free(PRIVATE_DATA->buffer);
+						indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 						free(PRIVATE_DATA);
 					}
 					free(device);
@@ -190,7 +190,7 @@ static void camera_close(indigo_device *device) {
 	indigo_global_unlock(device);
 	pthread_mutex_unlock(&PRIVATE_DATA->usb_mutex);
 	if (PRIVATE_DATA->buffer != NULL) {
-		free(PRIVATE_DATA->buffer);
+		indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 		PRIVATE_DATA->buffer = NULL;
 	}
 }
@@ -295,8 +295,7 @@ static bool handle_exposure_property(indigo_device *device, indigo_property *pro
 
 	if (ok) {
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -667,7 +666,7 @@ static void process_unplug_event(indigo_device *unusued) {
 	}
 	if (private_data) {
 		if (private_data->buffer != NULL) {
-			free(private_data->buffer);
+			indigo_free_blob_buffer(private_data->buffer);
 			private_data->buffer = NULL;
 		}
 		free(private_data);
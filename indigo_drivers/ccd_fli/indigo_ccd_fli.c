@@ -394,7 +394,7 @@ static void fli_close(indigo_device *device) {
 	}
 	indigo_global_unlock(device);
 	if (PRIVATE_DATA->buffer != NULL) {
-		free(PRIVATE_DATA->buffer);
+		indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 		PRIVATE_DATA->buffer = NULL;
 	}
 }
@@ -604,8 +604,7 @@ static bool handle_exposure_property(indigo_device *device, indigo_property *pro
 
 	if (ok) {
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -1052,7 +1051,7 @@ static void process_unplug_event(indigo_device *unused) {
 		}
 		indigo_detach_device(*device);
 		fli_private_data *private_data = (*device)->private_data;
-		if (private_data->buffer) free(private_data->buffer);
+		if (private_data->buffer) indigo_free_blob_buffer(private_data->buffer);
 		free((*device)->private_data);
 		free(*device);
 		*device = NULL;
@@ -1092,7 +1091,7 @@ static void remove_all_devices() {
 			continue;
 		indigo_detach_device(*device);
 		fli_private_data *private_data = (*device)->private_data;
-		if (private_data->buffer) free(private_data->buffer);
+		if (private_data->buffer) indigo_free_blob_buffer(private_data->buffer);
 		free((*device)->private_data);
 		free(*device);
 		*device = NULL;
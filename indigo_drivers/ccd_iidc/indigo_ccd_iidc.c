@@ -447,7 +447,7 @@ static void ccd_connect_callback(indigo_device *device) {
 		indigo_cancel_timer_sync(device, &PRIVATE_DATA->temperture_timer);
 		stop_camera(device);
 		if (PRIVATE_DATA->buffer != NULL) {
-			free(PRIVATE_DATA->buffer);
+			indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 		}
 	}
@@ -552,8 +552,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		CCD_EXPOSURE_PROPERTY->state = INDIGO_BUSY_STATE;
 		indigo_update_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -569,8 +568,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		CCD_STREAMING_PROPERTY->state = INDIGO_BUSY_STATE;
 		indigo_update_property(device, CCD_STREAMING_PROPERTY, NULL);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -731,7 +729,7 @@ static int hotplug_callback(libusb_context *ctx, libusb_device *dev, libusb_hotp
 						indigo_detach_device(device);
 						dc1394_camera_free(private_data->camera);
 						if (private_data->buffer)
-							free(private_data->buffer);
+							indigo_free_blob_buffer(private_data->buffer);
 						free(private_data);
 						free(device);
 						devices[j] = NULL;
@@ -875,7 +873,7 @@ indigo_result indigo_ccd_iidc(indigo_driver_action action, indigo_driver_info *i
 			if (device != NULL) {
 				if (PRIVATE_DATA != NULL) {
 					if (PRIVATE_DATA->buffer)
-						free(PRIVATE_DATA->buffer);
+						indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 					free(PRIVATE_DATA);
 				}
 				indigo_detach_device(device);
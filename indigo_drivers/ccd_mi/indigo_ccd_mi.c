@@ -275,7 +275,7 @@ static void ccd_connect_callback(indigo_device *device) {
 		}
 		PRIVATE_DATA->downloading = false;
 		if (PRIVATE_DATA->buffer != NULL) {
-			free(PRIVATE_DATA->buffer);
+			indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 		}
 		if (--PRIVATE_DATA->device_count == 0) {
@@ -308,8 +308,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		indigo_property_copy_values(CCD_EXPOSURE_PROPERTY, property, false);
 		indigo_use_shortest_exposure_if_bias(device);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -753,7 +752,7 @@ static int hotplug_callback(libusb_context *ctx, libusb_device *dev, libusb_hotp
 					if (device->master_device == device) {
 						mi_private_data *private_data = PRIVATE_DATA;
 						if (private_data->buffer != NULL)
-							free(private_data->buffer);
+							indigo_free_blob_buffer(private_data->buffer);
 						free(private_data);
 					}
 					free(device);
@@ -801,7 +800,7 @@ indigo_result indigo_ccd_mi(indigo_driver_action action, indigo_driver_info *inf
 					if (device->master_device == device) {
 						mi_private_data *private_data = PRIVATE_DATA;
 						if (private_data->buffer != NULL)
-							free(private_data->buffer);
+							indigo_free_blob_buffer(private_data->buffer);
 						free(private_data);
 					}
 					free(device);
@@ -307,8 +307,7 @@ static void handle_exposure(indigo_device *device) {
 	pthread_mutex_lock(&PRIVATE_DATA->message_mutex);
 	PRIVATE_DATA->abort_capture = false;
 	if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-		CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+		indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 	}
 	if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 		CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -544,10 +544,13 @@ bool ptp_fuji_exposure(indigo_device *device) {
 				CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_ALERT_STATE;
 				indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
 			}
-			if (CCD_IMAGE_FILE_PROPERTY->state != INDIGO_OK_STATE) {
+			pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
+			bool image_file_failed = CCD_IMAGE_FILE_PROPERTY->state != INDIGO_OK_STATE;
+			if (image_file_failed)
 				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+			pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
+			if (image_file_failed)
 				indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
-			}
 		}
 
 	}
@@ -598,8 +601,7 @@ bool ptp_fuji_liveview(indigo_device *device) {
 			result = result && ptp_transaction_1_0_i(device, ptp_operation_GetObject, handle, &buffer, &size);
 			if (result) {
 				if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-					indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+					indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 				}
 				if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 					CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
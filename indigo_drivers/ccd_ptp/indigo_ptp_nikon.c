@@ -1076,10 +1076,13 @@ bool ptp_nikon_exposure(indigo_device *device) {
 			CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_ALERT_STATE;
 			indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
 		}
-		if (CCD_IMAGE_FILE_PROPERTY->state != INDIGO_OK_STATE) {
+		pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
+		bool image_file_failed = CCD_IMAGE_FILE_PROPERTY->state != INDIGO_OK_STATE;
+		if (image_file_failed)
 			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+		pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
+		if (image_file_failed)
 			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
-		}
 	}
 	return result && !PRIVATE_DATA->abort_capture;
 }
@@ -1092,8 +1095,7 @@ bool ptp_nikon_liveview(indigo_device *device) {
 			if (ptp_transaction_0_0_i(device, ptp_operation_nikon_GetLiveViewImg, (void **)&buffer, &size)) {
 				if ((buffer[64] & 0xFF) == 0xFF && (buffer[65] & 0xFF) == 0xD8) {
 					if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-						indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+						indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 					}
 					if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 						CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -1110,8 +1112,7 @@ bool ptp_nikon_liveview(indigo_device *device) {
 					indigo_update_property(device, CCD_STREAMING_PROPERTY, NULL);
 				} else if ((buffer[128] & 0xFF) == 0xFF && (buffer[129] & 0xFF) == 0xD8) {
 					if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-						indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+						indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 					}
 					if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 						CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -1128,8 +1129,7 @@ bool ptp_nikon_liveview(indigo_device *device) {
 					indigo_update_property(device, CCD_STREAMING_PROPERTY, NULL);
 				} else if ((buffer[384] & 0xFF) == 0xFF && (buffer[385] & 0xFF) == 0xD8) {
 					if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-						indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+						indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 					}
 					if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 						CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -277,8 +277,7 @@ static void ccd_exposure_callback(indigo_device *device) {
 		indigo_use_shortest_exposure_if_bias(device);
 		try {
 			if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-				indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+				indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 			}
 			if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 				CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -601,7 +600,7 @@ static void ccd_connect_callback(indigo_device *device) {
 				}
 			}
 			cam.put_Connected(false);
-			free(PRIVATE_DATA->buffer);
+			indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 			CONNECTION_PROPERTY->state = INDIGO_OK_STATE;
 		} catch (std::runtime_error err) {
@@ -954,7 +953,7 @@ static void remove_all_devices() {
 			continue;
 		indigo_detach_device(*device);
 		if (((qsi_private_data *)(*device)->private_data)->buffer)
-			free(((qsi_private_data *)(*device)->private_data)->buffer);
+			indigo_free_blob_buffer(((qsi_private_data *)(*device)->private_data)->buffer);
 		free((*device)->private_data);
 		free(*device);
 		*device = NULL;
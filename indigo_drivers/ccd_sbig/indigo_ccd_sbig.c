@@ -1014,8 +1014,7 @@ static bool handle_exposure_property(indigo_device *device, indigo_property *pro
 
 	if (ok) {
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -1280,14 +1279,14 @@ static void ccd_connect_callback(indigo_device *device) {
 				indigo_delete_property(device, SBIG_FREEZE_TEC_PROPERTY, NULL);
 				indigo_delete_property(device, SBIG_ABG_PROPERTY, NULL);
 				if (PRIVATE_DATA->imager_buffer != NULL) {
-					free(PRIVATE_DATA->imager_buffer);
+					indigo_free_blob_buffer(PRIVATE_DATA->imager_buffer);
 					PRIVATE_DATA->imager_buffer = NULL;
 				}
 			} else { /* Secondary CCD */
 				PRIVATE_DATA->guider_no_check_temperature = false;
 				indigo_cancel_timer_sync(device, &PRIVATE_DATA->guider_ccd_temperature_timer);
 				if (PRIVATE_DATA->guider_buffer != NULL) {
-					free(PRIVATE_DATA->guider_buffer);
+					indigo_free_blob_buffer(PRIVATE_DATA->guider_buffer);
 					PRIVATE_DATA->guider_buffer = NULL;
 				}
 			}
@@ -2538,8 +2537,8 @@ static int hotplug_callback(libusb_context *ctx, libusb_device *dev, libusb_hotp
 
 				if (private_data) {
 					/* close driver and device here */
-					if (private_data->imager_buffer) free(private_data->imager_buffer);
-					if (private_data->guider_buffer) free(private_data->guider_buffer);
+					if (private_data->imager_buffer) indigo_free_blob_buffer(private_data->imager_buffer);
+					if (private_data->guider_buffer) indigo_free_blob_buffer(private_data->guider_buffer);
 					free(private_data);
 					private_data = NULL;
 				}
@@ -2575,8 +2574,8 @@ static void remove_usb_devices() {
 	for(i = 0; i < MAX_USB_DEVICES; i++) {
 		if (pds[i]) {
 			sbig_private_data *private_data = (sbig_private_data*)pds[i];
-			if (private_data->imager_buffer) free(private_data->imager_buffer);
-			if (private_data->guider_buffer) free(private_data->guider_buffer);
+			if (private_data->imager_buffer) indigo_free_blob_buffer(private_data->imager_buffer);
+			if (private_data->guider_buffer) indigo_free_blob_buffer(private_data->guider_buffer);
 			free(pds[i]);
 		}
 	}
@@ -2599,8 +2598,8 @@ static void remove_eth_devices() {
 		devices[i] = NULL;
 	}
 	if (private_data) {
-		if (private_data->imager_buffer) free(private_data->imager_buffer);
-		if (private_data->guider_buffer) free(private_data->guider_buffer);
+		if (private_data->imager_buffer) indigo_free_blob_buffer(private_data->imager_buffer);
+		if (private_data->guider_buffer) indigo_free_blob_buffer(private_data->guider_buffer);
 		free(private_data);
 	}
 }
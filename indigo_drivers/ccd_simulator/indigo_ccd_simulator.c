@@ -23,7 +23,7 @@
  \file indigo_ccd_simulator.c
  */
 
-#define DRIVER_VERSION 0x0011
+#define DRIVER_VERSION 0x0012
 #define DRIVER_NAME	"indigo_ccd_simulator"
 
 #include <stdlib.h>
@@ -36,6 +36,7 @@
 
 #include <indigo/indigo_driver_xml.h>
 #include <indigo/indigo_io.h>
+#include <indigo/indigo_image_pool.h>
 
 #include "indigo_ccd_simulator.h"
 
@@ -46,6 +47,11 @@
 #define HOTPIXELS						1500
 #define ECLIPSE							360
 
+#define GENERATOR_CHUNK_ROWS		32
+#define GENERATOR_PHASES				4
+#define GENERATOR_MAX_RADIUS		24
+#define GENERATOR_MAX_THREADS		32
+
 // gp_bits is used as boolean
 #define is_connected                     gp_bits
 
@@ -80,9 +86,36 @@
 #define FILE_NAME_PROPERTY					PRIVATE_DATA->file_name_property
 #define FILE_NAME_ITEM							(FILE_NAME_PROPERTY->items + 0)
 
+#define GENERATOR_PROPERTY					PRIVATE_DATA->generator_property
+#define GENERATOR_DEFAULT_ITEM			(GENERATOR_PROPERTY->items + 0)
+#define GENERATOR_MONO_ITEM					(GENERATOR_PROPERTY->items + 1)
+#define GENERATOR_RGB_ITEM					(GENERATOR_PROPERTY->items + 2)
+#define GENERATOR_BAYER_ITEM				(GENERATOR_PROPERTY->items + 3)
+
+#define GENERATOR_SETTINGS_PROPERTY	PRIVATE_DATA->generator_settings_property
+#define GENERATOR_WIDTH_ITEM				(GENERATOR_SETTINGS_PROPERTY->items + 0)
+#define GENERATOR_HEIGHT_ITEM				(GENERATOR_SETTINGS_PROPERTY->items + 1)
+#define GENERATOR_STARS_ITEM				(GENERATOR_SETTINGS_PROPERTY->items + 2)
+#define GENERATOR_FWHM_ITEM					(GENERATOR_SETTINGS_PROPERTY->items + 3)
+#define GENERATOR_SKY_ITEM					(GENERATOR_SETTINGS_PROPERTY->items + 4)
+#define GENERATOR_NOISE_ITEM				(GENERATOR_SETTINGS_PROPERTY->items + 5)
+#define GENERATOR_THREADS_ITEM			(GENERATOR_SETTINGS_PROPERTY->items + 6)
+
 extern unsigned short indigo_ccd_simulator_raw_image[];
 extern unsigned char indigo_ccd_simulator_rgb_image[];
 
+typedef struct {
+	float x, y;
+	unsigned a;
+} simulator_star;
+
+typedef struct {
+	bool valid;
+	double gain, gamma;
+	int offset;
+	unsigned short table[65536];
+} simulator_lut;
+
 typedef struct {
 	indigo_device *imager, *guider, *dslr, *file;
 	indigo_property *dslr_program_property;
@@ -94,6 +127,8 @@ typedef struct {
 	indigo_property *guider_mode_property;
 	indigo_property *guider_settings_property;
 	indigo_property *file_name_property;
+	indigo_property *generator_property;
+	indigo_property *generator_settings_property;
 	int star_x[STARS], star_y[STARS], star_a[STARS], hotpixel_x[HOTPIXELS + 1], hotpixel_y[HOTPIXELS + 1];
 	char imager_image[FITS_HEADER_SIZE + 3 * WIDTH * HEIGHT + 2880];
 	char guider_image[FITS_HEADER_SIZE + 3 * WIDTH * HEIGHT + 2880];
@@ -108,6 +143,19 @@ typedef struct {
 	double ao_ra_offset, ao_dec_offset;
 	int eclipse;
 	double guide_rate;
+	simulator_lut imager_lut, guider_lut;
+	uint64_t random_state;
+	unsigned short *blur_buffer;
+	int blur_buffer_size;
+	char *synthetic_image;
+	int synthetic_width, synthetic_height, synthetic_threads;
+	simulator_star *synthetic_stars;
+	int synthetic_star_count;
+	unsigned short *synthetic_work[GENERATOR_MAX_THREADS];
+	unsigned short *psf_stamps;
+	int psf_radius;
+	double psf_sigma_x, psf_sigma_y;
+	uint64_t synthetic_frame;
 } simulator_private_data;
 
 // -------------------------------------------------------------------------------- INDIGO CCD device implementation
@@ -189,6 +237,346 @@ static void gauss_blur(unsigned short *scl, unsigned short *tcl, int w, int h, d
 	box_blur(scl, tcl, w, h, (sizes[2] - 1) / 2);
 }
 
+// fast pseudo random number generator (xorshift64*), each call yields four 16-bit samples
+
+static inline uint64_t random_seed(uint64_t seed) {
+	seed += 0x9E3779B97F4A7C15ULL;
+	seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+	seed ^= seed >> 31;
+	return seed ? seed : 1;
+}
+
+static inline uint64_t random_next(uint64_t *state) {
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static void add_noise(unsigned short *raw, int size, int fix, int range, bool replace, uint64_t *state) {
+	for (int i = 0; i < size; i += 4) {
+		uint64_t r = random_next(state);
+		for (int j = 0; j < 4 && i + j < size; j++, r >>= 16) {
+			int value = fix + (int)(((r & 0xFFFF) * range) >> 16) + (replace ? 0 : raw[i + j]);
+			raw[i + j] = (value > 65535) ? 65535 : value;
+		}
+	}
+}
+
+// offset, gain and gamma are applied through 16-bit lookup table rebuilt only if values are changed
+
+static unsigned short *gamma_lut(indigo_device *device) {
+	simulator_lut *lut = device == PRIVATE_DATA->guider ? &PRIVATE_DATA->guider_lut : &PRIVATE_DATA->imager_lut;
+	double gain = (CCD_GAIN_ITEM->number.value / 100);
+	int offset = (int)CCD_OFFSET_ITEM->number.value;
+	double gamma = CCD_GAMMA_ITEM->number.value;
+	if (!lut->valid || lut->gain != gain || lut->offset != offset || lut->gamma != gamma) {
+		for (int i = 0; i < 65536; i++) {
+			double value = i - offset;
+			if (value < 0)
+				value = 0;
+			value = gain * pow(value, gamma);
+			if (value > 65535)
+				value = 65535;
+			lut->table[i] = (unsigned short)value;
+		}
+		lut->gain = gain;
+		lut->offset = offset;
+		lut->gamma = gamma;
+		lut->valid = true;
+	}
+	return lut->table;
+}
+
+// -------------------------------------------------------------------------------- synthetic image generator
+
+// star field is rendered in chunks of GENERATOR_CHUNK_ROWS rows by a pool of threads, stars are sorted by y coordinate,
+// PSF is taken from GENERATOR_PHASES x GENERATOR_PHASES precomputed stamps with subpixel offsets
+
+typedef struct {
+	simulator_private_data *private_data;
+	unsigned short *lut;
+	void *data;
+	int frame_left, frame_top, frame_width, frame_height;
+	int horizontal_bin, vertical_bin;
+	int bpp, sky, noise;
+	bool rgb, bayer, light_frame;
+	uint64_t seed;
+	int chunks, next_chunk;
+} generator_job;
+
+typedef struct {
+	generator_job *job;
+	unsigned short *work;
+} generator_worker_data;
+
+static int compare_stars(const void *a, const void *b) {
+	float ay = ((simulator_star *)a)->y, by = ((simulator_star *)b)->y;
+	return ay < by ? -1 : ay > by ? 1 : 0;
+}
+
+static void generator_create_stars(simulator_private_data *private_data, int count) {
+	uint64_t state = random_seed(count);
+	private_data->synthetic_stars = indigo_safe_realloc(private_data->synthetic_stars, (count + 1) * sizeof(simulator_star));
+	for (int i = 0; i < count; i++) {
+		simulator_star *star = private_data->synthetic_stars + i;
+		star->x = (random_next(&state) >> 11) * 0x1.0p-53 * private_data->synthetic_width;
+		star->y = (random_next(&state) >> 11) * 0x1.0p-53 * private_data->synthetic_height;
+		double brightness = (random_next(&state) >> 11) * 0x1.0p-53;
+		star->a = 200 + (unsigned)(40000 * pow(brightness, 6));
+	}
+	qsort(private_data->synthetic_stars, count, sizeof(simulator_star), compare_stars);
+	private_data->synthetic_star_count = count;
+}
+
+static void generator_update_stamps(simulator_private_data *private_data, double fwhm, double defocus, int horizontal_bin, int vertical_bin) {
+	double sigma0 = fwhm / 2.3548;
+	double sigma = (fwhm + fabs(defocus)) / 2.3548;
+	double sigma_x = sigma / horizontal_bin;
+	double sigma_y = sigma / vertical_bin;
+	if (private_data->psf_stamps && private_data->psf_sigma_x == sigma_x && private_data->psf_sigma_y == sigma_y)
+		return;
+	int radius = (int)ceil(3 * (sigma_x > sigma_y ? sigma_x : sigma_y));
+	if (radius > GENERATOR_MAX_RADIUS)
+		radius = GENERATOR_MAX_RADIUS;
+	int stamp_size = 2 * radius + 1;
+	// flux is kept constant if star is defocused
+	double scale = 65535 * (sigma0 * sigma0) / (sigma * sigma);
+	private_data->psf_stamps = indigo_safe_realloc(private_data->psf_stamps, GENERATOR_PHASES * GENERATOR_PHASES * stamp_size * stamp_size * sizeof(unsigned short));
+	unsigned short *stamp = private_data->psf_stamps;
+	for (int py = 0; py < GENERATOR_PHASES; py++) {
+		double fy = (py + 0.5) / GENERATOR_PHASES;
+		for (int px = 0; px < GENERATOR_PHASES; px++) {
+			double fx = (px + 0.5) / GENERATOR_PHASES;
+			for (int sy = 0; sy < stamp_size; sy++) {
+				double dy = sy - radius - fy;
+				for (int sx = 0; sx < stamp_size; sx++) {
+					double dx = sx - radius - fx;
+					*stamp++ = (unsigned short)(scale * exp(-(dx * dx / (2 * sigma_x * sigma_x) + dy * dy / (2 * sigma_y * sigma_y))));
+				}
+			}
+		}
+	}
+	private_data->psf_radius = radius;
+	private_data->psf_sigma_x = sigma_x;
+	private_data->psf_sigma_y = sigma_y;
+}
+
+static void generator_render_chunk(generator_job *job, int chunk, unsigned short *work) {
+	simulator_private_data *private_data = job->private_data;
+	int width = job->frame_width;
+	int y0 = chunk * GENERATOR_CHUNK_ROWS;
+	int y1 = y0 + GENERATOR_CHUNK_ROWS;
+	if (y1 > job->frame_height)
+		y1 = job->frame_height;
+	int size = (y1 - y0) * width;
+	uint64_t state = random_seed(job->seed + chunk);
+	add_noise(work, size, job->light_frame ? job->sky : 0, job->noise, true, &state);
+	if (job->light_frame) {
+		simulator_star *stars = private_data->synthetic_stars;
+		int radius = private_data->psf_radius;
+		int stamp_size = 2 * radius + 1;
+		float min_y = (float)(job->frame_top + y0 - radius - 1) * job->vertical_bin;
+		int lo = 0, hi = private_data->synthetic_star_count;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (stars[mid].y < min_y)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (int i = lo; i < private_data->synthetic_star_count; i++) {
+			simulator_star *star = stars + i;
+			double center_y = star->y / job->vertical_bin - job->frame_top;
+			if (center_y > y1 + radius)
+				break;
+			double center_x = star->x / job->horizontal_bin - job->frame_left;
+			if (center_x < -radius - 1 || center_x > width + radius)
+				continue;
+			int ix = (int)floor(center_x), iy = (int)floor(center_y);
+			int px = (int)((center_x - ix) * GENERATOR_PHASES), py = (int)((center_y - iy) * GENERATOR_PHASES);
+			unsigned short *stamp = private_data->psf_stamps + (py * GENERATOR_PHASES + px) * stamp_size * stamp_size;
+			int sx0 = ix - radius < 0 ? radius - ix : 0;
+			int sx1 = ix + radius >= width ? width - ix + radius : stamp_size;
+			for (int sy = 0; sy < stamp_size; sy++) {
+				int y = iy - radius + sy;
+				if (y < y0 || y >= y1)
+					continue;
+				unsigned short *row = work + (y - y0) * width + ix - radius;
+				unsigned short *stamp_row = stamp + sy * stamp_size;
+				for (int sx = sx0; sx < sx1; sx++) {
+					unsigned value = row[sx] + ((star->a * stamp_row[sx]) >> 16);
+					row[sx] = value > 65535 ? 65535 : value;
+				}
+			}
+		}
+	}
+	unsigned short *lut = job->lut;
+	if (job->rgb) {
+		// slightly warm white balance
+		if (job->bpp == 8) {
+			uint8_t *out = (uint8_t *)job->data + 3 * y0 * width;
+			for (int i = 0; i < size; i++) {
+				unsigned value = lut[work[i]];
+				*out++ = value >> 8;
+				*out++ = (value * 58982) >> 24;
+				*out++ = (value * 52428) >> 24;
+			}
+		} else {
+			uint16_t *out = (uint16_t *)job->data + 3 * y0 * width;
+			for (int i = 0; i < size; i++) {
+				unsigned value = lut[work[i]];
+				*out++ = value;
+				*out++ = (value * 58982) >> 16;
+				*out++ = (value * 52428) >> 16;
+			}
+		}
+	} else if (job->bayer) {
+		// RGGB mosaic with green channel at full scale
+		static const unsigned scale[2][2] = { { 45875, 65535 }, { 65535, 39321 } };
+		for (int y = y0; y < y1; y++) {
+			unsigned short *in = work + (y - y0) * width;
+			const unsigned *row_scale = scale[y & 1];
+			if (job->bpp == 8) {
+				uint8_t *out = (uint8_t *)job->data + y * width;
+				for (int x = 0; x < width; x++)
+					out[x] = (lut[in[x]] * row_scale[x & 1]) >> 24;
+			} else {
+				uint16_t *out = (uint16_t *)job->data + y * width;
+				for (int x = 0; x < width; x++)
+					out[x] = (lut[in[x]] * row_scale[x & 1]) >> 16;
+			}
+		}
+	} else if (job->bpp == 8) {
+		uint8_t *out = (uint8_t *)job->data + y0 * width;
+		for (int i = 0; i < size; i++)
+			out[i] = lut[work[i]] >> 8;
+	} else {
+		uint16_t *out = (uint16_t *)job->data + y0 * width;
+		for (int i = 0; i < size; i++)
+			out[i] = lut[work[i]];
+	}
+}
+
+static void *generator_worker(generator_worker_data *data) {
+	generator_job *job = data->job;
+	int chunk;
+	while ((chunk = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED)) < job->chunks)
+		generator_render_chunk(job, chunk, data->work);
+	return NULL;
+}
+
+static bool generator_setup(indigo_device *device) {
+	simulator_private_data *private_data = PRIVATE_DATA;
+	int width = (int)GENERATOR_WIDTH_ITEM->number.value;
+	int height = (int)GENERATOR_HEIGHT_ITEM->number.value;
+	int threads = (int)GENERATOR_THREADS_ITEM->number.value;
+	if (threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+		threads = 1;
+	if (threads > GENERATOR_MAX_THREADS)
+		threads = GENERATOR_MAX_THREADS;
+	size_t size = FITS_HEADER_SIZE + (size_t)width * height * (GENERATOR_RGB_ITEM->sw.value ? 6 : 2) + 2880;
+	size += 2880 - size % 2880;
+	if (indigo_image_buffer_size(private_data->synthetic_image) < size) {
+		indigo_release_image_buffer(private_data->synthetic_image);
+		private_data->synthetic_image = indigo_alloc_image_buffer(size);
+		if (private_data->synthetic_image == NULL) {
+			indigo_send_message(device, "Failed to allocate %ld MB for %dx%d image", (long)(size >> 20), width, height);
+			return false;
+		}
+	}
+	for (int i = 0; i < GENERATOR_MAX_THREADS; i++) {
+		if (i < threads) {
+			// 4 more pixels for noise generator writing 4 samples at once
+			private_data->synthetic_work[i] = indigo_safe_realloc(private_data->synthetic_work[i], (GENERATOR_CHUNK_ROWS * width + 4) * sizeof(unsigned short));
+		} else if (private_data->synthetic_work[i]) {
+			free(private_data->synthetic_work[i]);
+			private_data->synthetic_work[i] = NULL;
+		}
+	}
+	private_data->synthetic_threads = threads;
+	private_data->synthetic_width = width;
+	private_data->synthetic_height = height;
+	generator_create_stars(private_data, (int)GENERATOR_STARS_ITEM->number.value);
+	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Synthetic generator %dx%d, %d stars, %d threads", width, height, private_data->synthetic_star_count, threads);
+	return true;
+}
+
+static void generator_release(simulator_private_data *private_data) {
+	indigo_release_image_buffer(private_data->synthetic_image);
+	private_data->synthetic_image = NULL;
+	indigo_safe_free(private_data->synthetic_stars);
+	private_data->synthetic_stars = NULL;
+	private_data->synthetic_star_count = 0;
+	indigo_safe_free(private_data->psf_stamps);
+	private_data->psf_stamps = NULL;
+	for (int i = 0; i < GENERATOR_MAX_THREADS; i++) {
+		indigo_safe_free(private_data->synthetic_work[i]);
+		private_data->synthetic_work[i] = NULL;
+	}
+}
+
+static void generator_create_frame(indigo_device *device) {
+	simulator_private_data *private_data = PRIVATE_DATA;
+	generator_job job = { 0 };
+	job.private_data = private_data;
+	job.horizontal_bin = (int)CCD_BIN_HORIZONTAL_ITEM->number.value;
+	job.vertical_bin = (int)CCD_BIN_VERTICAL_ITEM->number.value;
+	job.frame_left = (int)CCD_FRAME_LEFT_ITEM->number.value / job.horizontal_bin;
+	job.frame_top = (int)CCD_FRAME_TOP_ITEM->number.value / job.vertical_bin;
+	job.frame_width = (int)CCD_FRAME_WIDTH_ITEM->number.value / job.horizontal_bin;
+	job.frame_height = (int)CCD_FRAME_HEIGHT_ITEM->number.value / job.vertical_bin;
+	if (CCD_FRAME_BITS_PER_PIXEL_ITEM->number.value != 8 && CCD_FRAME_BITS_PER_PIXEL_ITEM->number.value != 16) {
+		CCD_FRAME_BITS_PER_PIXEL_ITEM->number.value = 16;
+		indigo_update_property(device, CCD_FRAME_PROPERTY, NULL);
+	}
+	job.bpp = (int)CCD_FRAME_BITS_PER_PIXEL_ITEM->number.value;
+	job.rgb = GENERATOR_RGB_ITEM->sw.value;
+	job.bayer = GENERATOR_BAYER_ITEM->sw.value;
+	job.light_frame = CCD_FRAME_TYPE_LIGHT_ITEM->sw.value || CCD_FRAME_TYPE_FLAT_ITEM->sw.value;
+	job.sky = (int)GENERATOR_SKY_ITEM->number.value;
+	job.noise = (int)GENERATOR_NOISE_ITEM->number.value;
+	job.seed = random_seed(private_data->synthetic_frame++) << 16;
+	job.lut = gamma_lut(device);
+	job.data = private_data->synthetic_image + FITS_HEADER_SIZE;
+	job.chunks = (job.frame_height + GENERATOR_CHUNK_ROWS - 1) / GENERATOR_CHUNK_ROWS;
+	if (job.light_frame)
+		generator_update_stamps(private_data, GENERATOR_FWHM_ITEM->number.value, private_data->current_position, job.horizontal_bin, job.vertical_bin);
+	int threads = private_data->synthetic_threads < job.chunks ? private_data->synthetic_threads : job.chunks;
+	pthread_t thread[GENERATOR_MAX_THREADS];
+	generator_worker_data worker_data[GENERATOR_MAX_THREADS];
+	for (int i = 0; i < threads; i++) {
+		worker_data[i].job = &job;
+		worker_data[i].work = private_data->synthetic_work[i];
+	}
+	int started = 1;
+	for (; started < threads; started++) {
+		if (pthread_create(&thread[started], NULL, (void * (*)(void*))generator_worker, &worker_data[started]) != 0)
+			break;
+	}
+	generator_worker(&worker_data[0]);
+	for (int i = 1; i < started; i++)
+		pthread_join(thread[i], NULL);
+	if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE || CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE) {
+		if (job.bayer) {
+			indigo_fits_keyword keywords[] = {
+				{ INDIGO_FITS_STRING, "BAYERPAT", .string = "RGGB", "Bayer color pattern" },
+				{ INDIGO_FITS_NUMBER, "XBAYROFF", .number = 0, "X offset of Bayer array" },
+				{ INDIGO_FITS_NUMBER, "YBAYROFF", .number = 0, "Y offset of Bayer array" },
+				{ 0 }
+			};
+			indigo_process_image(device, private_data->synthetic_image, job.frame_width, job.frame_height, job.bpp, true, true, keywords, CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE);
+		} else {
+			indigo_process_image(device, private_data->synthetic_image, job.frame_width, job.frame_height, job.rgb ? 3 * job.bpp : job.bpp, true, true, NULL, CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE);
+		}
+	}
+}
+
 static void create_frame(indigo_device *device) {
 	pthread_mutex_lock(&PRIVATE_DATA->image_mutex);
 	simulator_private_data *private_data = PRIVATE_DATA;
@@ -228,6 +616,8 @@ static void create_frame(indigo_device *device) {
 		int size = PRIVATE_DATA->file_image_header.width * PRIVATE_DATA->file_image_header.height * bpp / 8;
 		memcpy(PRIVATE_DATA->file_image, PRIVATE_DATA->raw_file_image, size + FITS_HEADER_SIZE);
 		indigo_process_image(device, PRIVATE_DATA->file_image, PRIVATE_DATA->file_image_header.width, PRIVATE_DATA->file_image_header.height, bpp, true, true, NULL, CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE);
+	} else if (device == PRIVATE_DATA->imager && PRIVATE_DATA->synthetic_image) {
+		generator_create_frame(device);
 	} else {
 		uint16_t *raw = (unsigned short *)((device == PRIVATE_DATA->guider ? private_data->guider_image : private_data->imager_image) + FITS_HEADER_SIZE);
 		int horizontal_bin = (int)CCD_BIN_HORIZONTAL_ITEM->number.value;
@@ -237,9 +627,6 @@ static void create_frame(indigo_device *device) {
 		int frame_width = (int)CCD_FRAME_WIDTH_ITEM->number.value / horizontal_bin;
 		int frame_height = (int)CCD_FRAME_HEIGHT_ITEM->number.value / vertical_bin;
 		int size = frame_width * frame_height;
-		double gain = (CCD_GAIN_ITEM->number.value / 100);
-		int offset = (int)CCD_OFFSET_ITEM->number.value;
-		double gamma = CCD_GAMMA_ITEM->number.value;
 		bool light_frame = CCD_FRAME_TYPE_LIGHT_ITEM->sw.value || CCD_FRAME_TYPE_FLAT_ITEM->sw.value;
 
 		if (device == PRIVATE_DATA->imager && light_frame) {
@@ -257,8 +644,7 @@ static void create_frame(indigo_device *device) {
 				}
 			}
 		} else {
-			for (int i = 0; i < size; i++)
-				raw[i] = (rand() & 0x7F);
+			add_noise(raw, size, 0, 128, true, &private_data->random_state);
 		}
 
 		if (device == PRIVATE_DATA->guider && light_frame) {
@@ -336,36 +722,24 @@ static void create_frame(indigo_device *device) {
 				}
 			}
 		}
-		for (int i = 0; i < size; i++) {
-			double value = raw[i] - offset;
-			if (value < 0)
-				value = 0;
-			value = gain * pow(value, gamma);
-			if (value > 65535)
-				value = 65535;
-			raw[i] = (unsigned short)value;
-		}
+		unsigned short *lut = gamma_lut(device);
+		for (int i = 0; i < size; i++)
+			raw[i] = lut[raw[i]];
 		if (private_data->current_position != 0) {
-			unsigned short *tmp = indigo_safe_malloc(2 * size);
-			gauss_blur(raw, tmp, frame_width, frame_height, private_data->current_position);
-			memcpy(raw, tmp, 2 * size);
-			free(tmp);
+			if (private_data->blur_buffer_size < size) {
+				private_data->blur_buffer = indigo_safe_realloc(private_data->blur_buffer, 2 * size);
+				private_data->blur_buffer_size = size;
+			}
+			gauss_blur(raw, private_data->blur_buffer, frame_width, frame_height, private_data->current_position);
+			memcpy(raw, private_data->blur_buffer, 2 * size);
 		}
 
-		int value;
 		if (device == PRIVATE_DATA->imager && light_frame) {
-			for (int i = 0; i < size; i++) {
-				value = raw[i] + (rand() & 0x7F);
-				raw[i] = (value > 65535) ? 65535 : value;
-			}
+			add_noise(raw, size, 0, 128, false, &private_data->random_state);
 		} else if (device == PRIVATE_DATA->guider) {
-			for (int i = 0; i < size; i++) {
-				value = raw[i] + (rand() % (int)GUIDER_IMAGE_NOISE_VAR_ITEM->number.target) + GUIDER_IMAGE_NOISE_FIX_ITEM->number.target;
-				raw[i] = (value > 65535) ? 65535 : value;
-			}
+			add_noise(raw, size, (int)GUIDER_IMAGE_NOISE_FIX_ITEM->number.target, (int)GUIDER_IMAGE_NOISE_VAR_ITEM->number.target, false, &private_data->random_state);
 		} else {
-			for (int i = 0; i < size; i++)
-				raw[i] = (rand() & 0x7F);
+			add_noise(raw, size, 0, 128, true, &private_data->random_state);
 		}
 
 		for (int i = 0; i <= GUIDER_IMAGE_HOTPIXELS_ITEM->number.target; i++) {
@@ -417,8 +791,7 @@ static void exposure_timer_callback(indigo_device *device) {
 static void streaming_timer_callback(indigo_device *device) {
 	while (CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE && CCD_STREAMING_COUNT_ITEM->number.value != 0) {
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -481,6 +854,16 @@ static void ccd_temperature_callback(indigo_device *device) {
 	indigo_reschedule_timer(device, TEMP_UPDATE, &PRIVATE_DATA->temperature_timer);
 }
 
+static void set_sensor_size(indigo_device *device, int width, int height) {
+	CCD_INFO_WIDTH_ITEM->number.value = CCD_FRAME_WIDTH_ITEM->number.max = CCD_FRAME_LEFT_ITEM->number.max = CCD_FRAME_WIDTH_ITEM->number.value = width;
+	CCD_INFO_HEIGHT_ITEM->number.value = CCD_FRAME_HEIGHT_ITEM->number.max = CCD_FRAME_TOP_ITEM->number.max = CCD_FRAME_HEIGHT_ITEM->number.value = height;
+	CCD_FRAME_LEFT_ITEM->number.value = CCD_FRAME_TOP_ITEM->number.value = 0;
+	for (int i = 0; i < CCD_MODE_PROPERTY->count; i++) {
+		int bin = 1 << i;
+		snprintf(CCD_MODE_PROPERTY->items[i].label, INDIGO_VALUE_SIZE, "RAW %dx%d", width / bin, height / bin);
+	}
+}
+
 static indigo_result ccd_enumerate_properties(indigo_device *device, indigo_client *client, indigo_property *property);
 
 static indigo_result ccd_attach(indigo_device *device) {
@@ -565,6 +948,20 @@ static indigo_result ccd_attach(indigo_device *device) {
 				indigo_init_number_item(GUIDER_IMAGE_HOTROW_ITEM, "HOTROW", "Hot row length", 0, WIDTH, 0, 0);
 				indigo_init_number_item(GUIDER_IMAGE_RA_OFFSET_ITEM, "RA_OFFSET", "RA offset", 0, HEIGHT, 0, 0);
 				indigo_init_number_item(GUIDER_IMAGE_DEC_OFFSET_ITEM, "DEC_OFFSET", "DEC offset", 0, HEIGHT, 0, 0);
+			} else if (device == PRIVATE_DATA->imager) {
+				GENERATOR_PROPERTY = indigo_init_switch_property(NULL, device->name, "IMAGER_GENERATOR", MAIN_GROUP, "Image generator", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 4);
+				indigo_init_switch_item(GENERATOR_DEFAULT_ITEM, "DEFAULT", "Built-in image", true);
+				indigo_init_switch_item(GENERATOR_MONO_ITEM, "MONO", "Synthetic mono", false);
+				indigo_init_switch_item(GENERATOR_RGB_ITEM, "RGB", "Synthetic RGB", false);
+				indigo_init_switch_item(GENERATOR_BAYER_ITEM, "BAYER", "Synthetic Bayer (RGGB)", false);
+				GENERATOR_SETTINGS_PROPERTY = indigo_init_number_property(NULL, device->name, "IMAGER_GENERATOR_SETUP", MAIN_GROUP, "Generator setup", INDIGO_OK_STATE, INDIGO_RW_PERM, 7);
+				indigo_init_number_item(GENERATOR_WIDTH_ITEM, "WIDTH", "Width (px)", 32, 16384, 0, 4096);
+				indigo_init_number_item(GENERATOR_HEIGHT_ITEM, "HEIGHT", "Height (px)", 32, 16384, 0, 3072);
+				indigo_init_number_item(GENERATOR_STARS_ITEM, "STARS", "Star count", 0, 100000, 0, 2000);
+				indigo_init_number_item(GENERATOR_FWHM_ITEM, "FWHM", "Star FWHM (px)", 1, 20, 0, 3);
+				indigo_init_number_item(GENERATOR_SKY_ITEM, "SKY", "Sky background", 0, 20000, 0, 1000);
+				indigo_init_number_item(GENERATOR_NOISE_ITEM, "NOISE", "Noise range", 1, 4096, 0, 128);
+				indigo_init_number_item(GENERATOR_THREADS_ITEM, "THREADS", "Threads (0 = auto)", 0, GENERATOR_MAX_THREADS, 1, 0);
 			}
 			// -------------------------------------------------------------------------------- CCD_INFO, CCD_BIN, CCD_MODE, CCD_FRAME
 			CCD_INFO_WIDTH_ITEM->number.value = CCD_FRAME_WIDTH_ITEM->number.max = CCD_FRAME_LEFT_ITEM->number.max = CCD_FRAME_WIDTH_ITEM->number.value = WIDTH;
@@ -604,6 +1001,7 @@ static indigo_result ccd_attach(indigo_device *device) {
 				PRIVATE_DATA->hotpixel_x[i] = rand() % (WIDTH - 200) + 100;
 				PRIVATE_DATA->hotpixel_y[i] = rand() % (HEIGHT - 200) + 100;
 			}
+			PRIVATE_DATA->random_state = random_seed(time(NULL));
 			// -------------------------------------------------------------------------------- CCD_COOLER, CCD_TEMPERATURE, CCD_COOLER_POWER
 			if (device == PRIVATE_DATA->imager) {
 				CCD_COOLER_PROPERTY->hidden = false;
@@ -658,6 +1056,12 @@ indigo_result ccd_enumerate_properties(indigo_device *device, indigo_client *cli
 			if (indigo_property_match(GUIDER_SETTINGS_PROPERTY, property))
 				indigo_define_property(device, GUIDER_SETTINGS_PROPERTY, NULL);
 		}
+		if (device == PRIVATE_DATA->imager) {
+			if (indigo_property_match(GENERATOR_PROPERTY, property))
+				indigo_define_property(device, GENERATOR_PROPERTY, NULL);
+			if (indigo_property_match(GENERATOR_SETTINGS_PROPERTY, property))
+				indigo_define_property(device, GENERATOR_SETTINGS_PROPERTY, NULL);
+		}
 	}
 	return result;
 }
@@ -715,6 +1119,18 @@ static void ccd_connect_callback(indigo_device *device) {
 				}
 				close(fd);
 			} else if (device == PRIVATE_DATA->imager) {
+				if (GENERATOR_DEFAULT_ITEM->sw.value) {
+					if (CCD_INFO_WIDTH_ITEM->number.value != WIDTH || CCD_INFO_HEIGHT_ITEM->number.value != HEIGHT)
+						set_sensor_size(device, WIDTH, HEIGHT);
+				} else {
+					pthread_mutex_lock(&PRIVATE_DATA->image_mutex);
+					bool result = generator_setup(device);
+					pthread_mutex_unlock(&PRIVATE_DATA->image_mutex);
+					if (!result)
+						goto failure;
+					if (CCD_INFO_WIDTH_ITEM->number.value != PRIVATE_DATA->synthetic_width || CCD_INFO_HEIGHT_ITEM->number.value != PRIVATE_DATA->synthetic_height)
+						set_sensor_size(device, PRIVATE_DATA->synthetic_width, PRIVATE_DATA->synthetic_height);
+				}
 				indigo_set_timer(device, TEMP_UPDATE, ccd_temperature_callback, &PRIVATE_DATA->temperature_timer);
 			}
 		}
@@ -723,13 +1139,16 @@ static void ccd_connect_callback(indigo_device *device) {
 			if (device == PRIVATE_DATA->imager) {
 				indigo_cancel_timer_sync(device, &PRIVATE_DATA->temperature_timer);
 				indigo_cancel_timer_sync(device, &PRIVATE_DATA->imager_exposure_timer);
+				pthread_mutex_lock(&PRIVATE_DATA->image_mutex);
+				generator_release(PRIVATE_DATA);
+				pthread_mutex_unlock(&PRIVATE_DATA->image_mutex);
 			} else if (device == PRIVATE_DATA->file) {
 				if (PRIVATE_DATA->file_image) {
-					free(PRIVATE_DATA->file_image);
+					indigo_free_blob_buffer(PRIVATE_DATA->file_image);
 					PRIVATE_DATA->file_image = NULL;
 				}
 				if (PRIVATE_DATA->raw_file_image) {
-					free(PRIVATE_DATA->raw_file_image);
+					indigo_free_blob_buffer(PRIVATE_DATA->raw_file_image);
 					PRIVATE_DATA->raw_file_image = NULL;
 				}
 			} else if (device == PRIVATE_DATA->guider) {
@@ -788,8 +1207,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		CCD_EXPOSURE_PROPERTY->state = INDIGO_BUSY_STATE;
 		indigo_update_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 		if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 		}
 		if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 			CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -907,11 +1325,36 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		GUIDER_SETTINGS_PROPERTY->state = INDIGO_OK_STATE;
 		indigo_update_property(device, GUIDER_SETTINGS_PROPERTY, NULL);
 		return INDIGO_OK;
+	} else if (GENERATOR_PROPERTY && indigo_property_match(GENERATOR_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- IMAGER_GENERATOR
+		if (IS_CONNECTED) {
+			GENERATOR_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, GENERATOR_PROPERTY, "Image generator can be changed only when disconnected");
+			return INDIGO_OK;
+		}
+		indigo_property_copy_values(GENERATOR_PROPERTY, property, false);
+		GENERATOR_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, GENERATOR_PROPERTY, NULL);
+		return INDIGO_OK;
+	} else if (GENERATOR_PROPERTY && indigo_property_match(GENERATOR_SETTINGS_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- IMAGER_GENERATOR_SETUP
+		if (IS_CONNECTED) {
+			GENERATOR_SETTINGS_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, GENERATOR_SETTINGS_PROPERTY, "Generator setup can be changed only when disconnected");
+			return INDIGO_OK;
+		}
+		indigo_property_copy_values(GENERATOR_SETTINGS_PROPERTY, property, false);
+		GENERATOR_SETTINGS_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, GENERATOR_SETTINGS_PROPERTY, NULL);
+		return INDIGO_OK;
 		// -------------------------------------------------------------------------------- CONFIG
 	} else if (indigo_property_match(CONFIG_PROPERTY, property)) {
 		if (indigo_switch_match(CONFIG_SAVE_ITEM, property)) {
 			if (device == PRIVATE_DATA->guider) {
 				indigo_save_property(device, NULL, GUIDER_SETTINGS_PROPERTY);
+			} else if (device == PRIVATE_DATA->imager) {
+				indigo_save_property(device, NULL, GENERATOR_PROPERTY);
+				indigo_save_property(device, NULL, GENERATOR_SETTINGS_PROPERTY);
 			} else if (device == PRIVATE_DATA->file) {
 				indigo_save_property(device, NULL, FILE_NAME_PROPERTY);
 			}
@@ -938,6 +1381,9 @@ static indigo_result ccd_detach(indigo_device *device) {
 	} else if (device == PRIVATE_DATA->guider) {
 		indigo_release_property(GUIDER_MODE_PROPERTY);
 		indigo_release_property(GUIDER_SETTINGS_PROPERTY);
+	} else if (device == PRIVATE_DATA->imager) {
+		indigo_release_property(GENERATOR_PROPERTY);
+		indigo_release_property(GENERATOR_SETTINGS_PROPERTY);
 	}
 	INDIGO_DEVICE_DETACH_LOG(DRIVER_NAME, device->name);
 	return indigo_ccd_detach(device);
@@ -1524,6 +1970,7 @@ indigo_result indigo_ccd_simulator(indigo_driver_action action, indigo_driver_in
 			}
 			if (private_data != NULL) {
 				pthread_mutex_destroy(&private_data->image_mutex);
+				indigo_safe_free(private_data->blur_buffer);
 				free(private_data);
 				private_data = NULL;
 			}
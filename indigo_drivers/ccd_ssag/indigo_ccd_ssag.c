@@ -267,7 +267,7 @@ static bool ssag_guide(indigo_device *device, guide_direction direction, int dur
 static void ssag_close(indigo_device *device) {
 	libusb_close(PRIVATE_DATA->handle);
 	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "libusb_close");
-	free(PRIVATE_DATA->buffer);
+	indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 }
 
 // -------------------------------------------------------------------------------- INDIGO CCD device implementation
@@ -364,7 +364,7 @@ static void ccd_connect_callback(indigo_device *device) {
 				ssag_abort_exposure(device);
 		}
 		if (PRIVATE_DATA->buffer != NULL) {
-			free(PRIVATE_DATA->buffer);
+			indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 		}
 		if (--PRIVATE_DATA->device_count == 0) {
@@ -591,7 +591,7 @@ static int hotplug_callback(libusb_context *ctx, libusb_device *dev, libusb_hotp
 			if ((descriptor.idVendor == SSAG_LOADER_VENDOR_ID && descriptor.idProduct == SSAG_LOADER_PRODUCT_ID) || (descriptor.idVendor == QHY5_LOADER_VENDOR_ID && descriptor.idProduct == QHY5_LOADER_PRODUCT_ID) || (descriptor.idVendor == OTI_LOADER_VENDOR_ID && descriptor.idProduct == OTI_LOADER_PRODUCT_ID)) {
 				INDIGO_DRIVER_DEBUG(DRIVER_NAME, "libusb_get_device_descriptor ->  %s (0x%04x, 0x%04x)", rc < 0 ? libusb_error_name(rc) : "OK", descriptor.idVendor, descriptor.idProduct);
 				libusb_ref_device(dev);
-				indigo_async((void *)(void *)ssag_firmware, dev);
+				indigo_start_thread((void *)(void *)ssag_firmware, dev);
 			} else if (descriptor.idVendor == SSAG_VENDOR_ID && descriptor.idProduct == SSAG_PRODUCT_ID) {
 				INDIGO_DRIVER_DEBUG(DRIVER_NAME, "libusb_get_device_descriptor ->  %s (0x%04x, 0x%04x)", rc < 0 ? libusb_error_name(rc) : "OK", descriptor.idVendor, descriptor.idProduct);
 				ssag_private_data *private_data = indigo_safe_malloc(sizeof(ssag_private_data));
@@ -636,7 +636,7 @@ static int hotplug_callback(libusb_context *ctx, libusb_device *dev, libusb_hotp
 			if (private_data != NULL) {
 				libusb_unref_device(dev);
 				if (private_data->buffer)
-					free(private_data->buffer);
+					indigo_free_blob_buffer(private_data->buffer);
 				free(private_data);
 			}
 			break;
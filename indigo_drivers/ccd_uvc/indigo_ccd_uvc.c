@@ -306,7 +306,7 @@ static void ccd_connect_callback(indigo_device *device) {
 			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "uvc_close()");
 			PRIVATE_DATA->handle = 0;
 			if (PRIVATE_DATA->buffer)
-				free(PRIVATE_DATA->buffer);
+				indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 			PRIVATE_DATA->buffer = NULL;
 		}
 		CONNECTION_PROPERTY->state = INDIGO_OK_STATE;
@@ -386,8 +386,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		}
 		if (res == UVC_SUCCESS) {
 			if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-				indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+				indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 			}
 			if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 				CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -423,8 +422,7 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		}
 		if (res == UVC_SUCCESS) {
 			if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
-				indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+				indigo_ccd_set_image_file_state(device, INDIGO_BUSY_STATE);
 			}
 			if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 				CCD_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
@@ -130,64 +130,14 @@ typedef struct {
 #define NEXDOME_SLEEP 100
 
 static bool nexdome_command(indigo_device *device, const char *command, char *response, int max, int sleep) {
-	char c;
-	struct timeval tv;
+	indigo_transaction transaction = { .command = command, .response = response, .response_size = max + 1, .terminators = "\r\n", .timeout = 3100000, .char_timeout = 100000, .delay = sleep };
 	pthread_mutex_lock(&PRIVATE_DATA->port_mutex);
-	// flush
-	while (true) {
-		fd_set readout;
-		FD_ZERO(&readout);
-		FD_SET(PRIVATE_DATA->handle, &readout);
-		tv.tv_sec = 0;
-		tv.tv_usec = 100000;
-		long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-		if (result == 0) {
-			break;
-		}
-		if (result < 0) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-		result = read(PRIVATE_DATA->handle, &c, 1);
-		if (result < 1) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-	}
-	// write command
-	indigo_write(PRIVATE_DATA->handle, command, strlen(command));
-	if (sleep > 0)
-		usleep(sleep);
-
-	// read response
-	if (response != NULL) {
-		int index = 0;
-		int timeout = 3;
-		while (index < max) {
-			fd_set readout;
-			FD_ZERO(&readout);
-			FD_SET(PRIVATE_DATA->handle, &readout);
-			tv.tv_sec = timeout;
-			tv.tv_usec = 100000;
-			timeout = 0;
-			long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-			if (result <= 0)
-				break;
-			result = read(PRIVATE_DATA->handle, &c, 1);
-			if (result < 1) {
-				pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-				INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to read from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
-				return false;
-			}
-
-			if ((c == '\n') || (c == '\r'))
-				break;
-
-			response[index++] = c;
-		}
-		response[index] = 0;
-	}
+	bool result = indigo_execute_transactions(PRIVATE_DATA->handle, &transaction, 1, true, false);
 	pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+	if (!result) {
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to execute %s on %s -> %s (%d)", command, DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
+		return false;
+	}
 	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> %s", command, response != NULL ? response : "NULL");
 	return true;
 }
@@ -166,7 +166,7 @@ static bool usbv3_open(indigo_device *device) {
 	//			FOCUSER_COMPENSATION_ITEM->number.value = compensation;
 	//		}
 	//	}
-	indigo_async((void * (*)(void*))usbv3_reader, device);
+	indigo_start_thread((void * (*)(void*))usbv3_reader, device);
 	return true;
 }
 
@@ -239,7 +239,7 @@ static void focuser_connect_callback(indigo_device *device) {
 		}
 		if (PRIVATE_DATA->handle > 0) {
 			INDIGO_DRIVER_LOG(DRIVER_NAME, "Connected to %s", name);
-			indigo_async((void * (*)(void*))wemacro_reader, device);
+			indigo_start_thread((void * (*)(void*))wemacro_reader, device);
 			indigo_define_property(device, X_RAIL_CONFIG_PROPERTY, NULL);
 			indigo_define_property(device, X_RAIL_SHUTTER_PROPERTY, NULL);
 			indigo_define_property(device, X_RAIL_EXECUTE_PROPERTY, NULL);
@@ -120,152 +120,81 @@ static bool meade_open(indigo_device *device) {
 	}
 }
 
+static void meade_fix_response(char *response) {
+	// degree sign is not ASCII
+	for (char *c = response; *c; c++)
+		if (*c < 0)
+			*c = ':';
+}
+
 static bool meade_command(indigo_device *device, char *command, char *response, int max, int sleep) {
+	indigo_transaction transaction = { .command = command, .response = response, .response_size = max + 1, .terminators = "#", .timeout = 3100000, .char_timeout = 100000, .delay = sleep };
 	pthread_mutex_lock(&PRIVATE_DATA->port_mutex);
-	char c;
-	struct timeval tv;
-	// flush
-	while (true) {
-		fd_set readout;
-		FD_ZERO(&readout);
-		FD_SET(PRIVATE_DATA->handle, &readout);
-		tv.tv_sec = 0;
-		tv.tv_usec = 100000;
-		long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-		if (result == 0)
-			break;
-		if (result < 0) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-		result = read(PRIVATE_DATA->handle, &c, 1);
-		if (result < 1) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-	}
-	// write command
-	indigo_write(PRIVATE_DATA->handle, command, strlen(command));
-	if (sleep > 0)
-		indigo_usleep(sleep);
-	// read response
-	if (response != NULL) {
-		int index = 0;
-		int timeout = 3;
-		while (index < max) {
-			fd_set readout;
-			FD_ZERO(&readout);
-			FD_SET(PRIVATE_DATA->handle, &readout);
-			tv.tv_sec = timeout;
-			tv.tv_usec = 100000;
-			timeout = 0;
-			long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-			if (result <= 0)
-				break;
-			result = read(PRIVATE_DATA->handle, &c, 1);
-			if (result < 1) {
-				INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to read from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
-				pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-				return false;
-			}
-			if (c < 0)
-				c = ':';
-			if (c == '#')
-				break;
-			response[index++] = c;
-		}
-		response[index] = 0;
-	}
+	bool result = indigo_execute_transactions(PRIVATE_DATA->handle, &transaction, 1, true, false);
 	pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+	if (!result) {
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to execute %s on %s -> %s (%d)", command, DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
+		return false;
+	}
+	if (response != NULL)
+		meade_fix_response(response);
 	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> %s", command, response != NULL ? response : "NULL");
 	return true;
 }
 
-static bool meade_command_progress(indigo_device *device, char *command, char *response, int max, int sleep) {
+static bool meade_commands(indigo_device *device, int count, char **commands, char **responses, bool *completed, int max) {
+	// independent queries are pipelined to avoid round trip for every command
+	indigo_transaction transactions[count];
+	for (int i = 0; i < count; i++) {
+		transactions[i] = (indigo_transaction){ .command = commands[i], .response = responses[i], .response_size = max + 1, .terminators = "#", .timeout = 3100000, .char_timeout = 100000 };
+		*responses[i] = 0;
+	}
 	pthread_mutex_lock(&PRIVATE_DATA->port_mutex);
-	char c;
-	struct timeval tv;
-	// flush
-	while (true) {
-		fd_set readout;
-		FD_ZERO(&readout);
-		FD_SET(PRIVATE_DATA->handle, &readout);
-		tv.tv_sec = 0;
-		tv.tv_usec = 100000;
-		long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-		if (result == 0)
+	bool result = indigo_execute_transactions(PRIVATE_DATA->handle, transactions, count, true, true);
+	for (int i = 0; i < count; i++) {
+		if (!transactions[i].complete) {
+			// missing response shifts the following ones, repeat commands one by one to get reliable results
+			for (int j = 0; j < count; j++) {
+				transactions[j].complete = false;
+				*responses[j] = 0;
+			}
+			result = indigo_execute_transactions(PRIVATE_DATA->handle, transactions, count, true, false);
 			break;
-		if (result < 0) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-		result = read(PRIVATE_DATA->handle, &c, 1);
-		if (result < 1) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
 		}
 	}
-	// write command
-	indigo_write(PRIVATE_DATA->handle, command, strlen(command));
-	if (sleep > 0)
-		indigo_usleep(sleep);
-	// read response
-	if (response != NULL) {
-		int index = 0;
-		int timeout = 3;
-		while (index < max) {
-			fd_set readout;
-			FD_ZERO(&readout);
-			FD_SET(PRIVATE_DATA->handle, &readout);
-			tv.tv_sec = timeout;
-			tv.tv_usec = 100000;
-			timeout = 0;
-			long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-			if (result <= 0)
-				break;
-			result = read(PRIVATE_DATA->handle, &c, 1);
-			if (result < 1) {
-				INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to read from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
-				pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-				return false;
-			}
-			if (c < 0)
-				c = ':';
-			if (c == '#')
-				break;
-			response[index++] = c;
+	pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+	if (!result)
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to execute %s... on %s -> %s (%d)", commands[0], DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
+	// responses read before failure or timeout of other commands are still valid
+	for (int i = 0; i < count; i++) {
+		if (completed)
+			completed[i] = transactions[i].complete;
+		if (transactions[i].complete) {
+			meade_fix_response(responses[i]);
+			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> %s", commands[i], responses[i]);
+		} else if (result) {
+			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> timeout", commands[i]);
 		}
-		response[index] = 0;
 	}
-	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "readout progress part...");
+	return result;
+}
+
+static bool meade_command_progress(indigo_device *device, char *command, char *response, int max, int sleep) {
 	char progress[128];
-	// read progress
-	int index = 0;
-	int timeout = 60;
-	while (index < sizeof(progress)) {
-		fd_set readout;
-		FD_ZERO(&readout);
-		FD_SET(PRIVATE_DATA->handle, &readout);
-		tv.tv_sec = timeout;
-		tv.tv_usec = 100000;
-		timeout = 0;
-		long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-		if (result <= 0)
-			break;
-		result = read(PRIVATE_DATA->handle, &c, 1);
-		if (result < 1) {
-			INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to read from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-		if (c < 0)
-			c = ':';
-		if (c == '#')
-			break;
-		progress[index++] = c;
-	}
-	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Progress width: %d", index);
+	indigo_transaction transactions[2] = {
+		{ .command = command, .response = response, .response_size = max + 1, .terminators = "#", .timeout = 3100000, .char_timeout = 100000, .delay = sleep },
+		{ .response = progress, .response_size = sizeof(progress), .terminators = "#", .timeout = 60100000, .char_timeout = 100000 }
+	};
+	pthread_mutex_lock(&PRIVATE_DATA->port_mutex);
+	bool result = indigo_execute_transactions(PRIVATE_DATA->handle, transactions, 2, true, false);
 	pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+	if (!result) {
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to execute %s on %s -> %s (%d)", command, DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
+		return false;
+	}
+	if (response != NULL)
+		meade_fix_response(response);
+	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Progress width: %d", transactions[1].length);
 	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> %s", command, response != NULL ? response : "NULL");
 	return true;
 }
@@ -290,34 +219,45 @@ static void meade_close(indigo_device *device) {
 }
 
 static void meade_get_coords(indigo_device *device) {
-	char response[128];
-	if (meade_command(device, ":GR#", response, sizeof(response), 0)) {
-		if (strlen(response) < 8) {
+	char ra[128], dec[128], state[128];
+	char *commands[3] = { ":GR#", ":GD#", NULL }, *responses[3] = { ra, dec, state };
+	int count = 2;
+	if (MOUNT_TYPE_MEADE_ITEM->sw.value || MOUNT_TYPE_10MICRONS_ITEM->sw.value || MOUNT_TYPE_ON_STEP_ITEM->sw.value)
+		commands[count++] = ":D#";
+	else if (MOUNT_TYPE_GEMINI_ITEM->sw.value)
+		commands[count++] = ":Gv#";
+	else if (MOUNT_TYPE_AVALON_ITEM->sw.value)
+		commands[count++] = ":X34#";
+	bool completed[3] = { false, false, false };
+	bool result = meade_commands(device, count, commands, responses, completed, sizeof(ra));
+	if (completed[0]) {
+		if (strlen(ra) < 8) {
 			if (MOUNT_TYPE_MEADE_ITEM->sw.value) {
-				meade_command(device, ":P#", response, sizeof(response), 0);
-				meade_command(device, ":GR#", response, sizeof(response), 0);
+				meade_command(device, ":P#", ra, sizeof(ra), 0);
+				meade_command(device, ":GR#", ra, sizeof(ra), 0);
 			} else if (MOUNT_TYPE_10MICRONS_ITEM->sw.value) {
 				meade_command(device, ":U1#", NULL, 0, 0);
-				meade_command(device, ":GR#", response, sizeof(response), 0);
+				meade_command(device, ":GR#", ra, sizeof(ra), 0);
 			} else if (MOUNT_TYPE_GEMINI_ITEM->sw.value || MOUNT_TYPE_AP_ITEM->sw.value || MOUNT_TYPE_ON_STEP_ITEM->sw.value) {
 				meade_command(device, ":U#", NULL, 0, 0);
-				meade_command(device, ":GR#", response, sizeof(response), 0);
+				meade_command(device, ":GR#", ra, sizeof(ra), 0);
 			}
 		}
-		MOUNT_EQUATORIAL_COORDINATES_RA_ITEM->number.value = indigo_stod(response);
-	}
-	if (meade_command(device, ":GD#", response, sizeof(response), 0)) {
-		MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM->number.value = indigo_stod(response);
+		MOUNT_EQUATORIAL_COORDINATES_RA_ITEM->number.value = indigo_stod(ra);
 	}
+	if (completed[1])
+		MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM->number.value = indigo_stod(dec);
+	// empty state response (timeout) of an idle mount is valid if no I/O error occured
+	result = result || completed[2];
 	if (MOUNT_TYPE_MEADE_ITEM->sw.value || MOUNT_TYPE_10MICRONS_ITEM->sw.value || MOUNT_TYPE_ON_STEP_ITEM->sw.value) {
-		if (meade_command(device, ":D#", response, sizeof(response), 0))
-			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = *response ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
+		if (result)
+			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = *state ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
 	} else if (MOUNT_TYPE_GEMINI_ITEM->sw.value) {
-		if (meade_command(device, ":Gv#", response, sizeof(response), 0))
-			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = (*response == 'S' || *response == 'C') ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
+		if (result)
+			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = (*state == 'S' || *state == 'C') ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
 	} else if (MOUNT_TYPE_AVALON_ITEM->sw.value) {
-		if (meade_command(device, ":X34#", response, sizeof(response), 0))
-			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = (response[1] == '5' || response[2] == '5') ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
+		if (result)
+			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = (state[1] == '5' || state[2] == '5') ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
 	} else {
 		if (PRIVATE_DATA->motioned) {
 			// After Motion NS or EW
@@ -342,72 +282,69 @@ static void meade_get_coords(indigo_device *device) {
 static void meade_get_utc(indigo_device *device) {
 	if (MOUNT_TYPE_MEADE_ITEM->sw.value || MOUNT_TYPE_GEMINI_ITEM->sw.value || MOUNT_TYPE_10MICRONS_ITEM->sw.value || MOUNT_TYPE_AP_ITEM->sw.value) {
 		struct tm tm;
-		char response[128];
+		char local_date[128], local_time[128], response[128], dst[128];
+		char *commands[4] = { ":GC#", ":GL#", ":GG#", ":GH#" }, *responses[4] = { local_date, local_time, response, dst };
 		memset(&tm, 0, sizeof(tm));
 		MOUNT_UTC_TIME_PROPERTY->state = INDIGO_ALERT_STATE;
 		char separator[2];
-		if (meade_command(device, ":GC#", response, sizeof(response), 0) && sscanf(response, "%d%c%d%c%d", &tm.tm_mon, separator, &tm.tm_mday, separator, &tm.tm_year) == 5) {
-			if (meade_command(device, ":GL#", response, sizeof(response), 0) && sscanf(response, "%d%c%d%c%d", &tm.tm_hour, separator, &tm.tm_min, separator, &tm.tm_sec) == 5) {
+		if (meade_commands(device, PRIVATE_DATA->use_dst_commands ? 4 : 3, commands, responses, NULL, sizeof(response)) && sscanf(local_date, "%d%c%d%c%d", &tm.tm_mon, separator, &tm.tm_mday, separator, &tm.tm_year) == 5) {
+			if (sscanf(local_time, "%d%c%d%c%d", &tm.tm_hour, separator, &tm.tm_min, separator, &tm.tm_sec) == 5) {
 				tm.tm_year += 100; // TODO: To be fixed in year 2100 :)
 				tm.tm_mon -= 1;
-				if (meade_command(device, ":GG#", response, sizeof(response), 0)) {
-					if (MOUNT_TYPE_AP_ITEM->sw.value && response[0] == ':') {
-						if (response[1] == 'A') {
-							switch (response[2]) {
-								case '1':
-									strcpy(response, "-05");
-									break;
-								case '2':
-									strcpy(response, "-04");
-									break;
-								case '3':
-									strcpy(response, "-03");
-									break;
-								case '4':
-									strcpy(response, "-02");
-									break;
-								case '5':
-									strcpy(response, "-01");
-									break;
-							}
-						} else if (response[1] == '@') {
-							switch (response[2]) {
-								case '4':
-									strcpy(response, "-12");
-									break;
-								case '5':
-									strcpy(response, "-11");
-									break;
-								case '6':
-									strcpy(response, "-10");
-									break;
-								case '7':
-									strcpy(response, "-09");
-									break;
-								case '8':
-									strcpy(response, "-08");
-									break;
-								case '9':
-									strcpy(response, "-07");
-									break;
-							}
-						} else if (response[1] == '0') {
-							strcpy(response, "-06");
+				if (MOUNT_TYPE_AP_ITEM->sw.value && response[0] == ':') {
+					if (response[1] == 'A') {
+						switch (response[2]) {
+							case '1':
+								strcpy(response, "-05");
+								break;
+							case '2':
+								strcpy(response, "-04");
+								break;
+							case '3':
+								strcpy(response, "-03");
+								break;
+							case '4':
+								strcpy(response, "-02");
+								break;
+							case '5':
+								strcpy(response, "-01");
+								break;
 						}
-					}
-					tm.tm_gmtoff = -atoi(response) * 3600;
-					sprintf(MOUNT_UTC_OFFSET_ITEM->text.value, "%d", -atoi(response));
-					if (PRIVATE_DATA->use_dst_commands) {
-						if (meade_command(device, ":GH#", response, sizeof(response), 0)) {
-							tm.tm_isdst = atoi(response);
+					} else if (response[1] == '@') {
+						switch (response[2]) {
+							case '4':
+								strcpy(response, "-12");
+								break;
+							case '5':
+								strcpy(response, "-11");
+								break;
+							case '6':
+								strcpy(response, "-10");
+								break;
+							case '7':
+								strcpy(response, "-09");
+								break;
+							case '8':
+								strcpy(response, "-08");
+								break;
+							case '9':
+								strcpy(response, "-07");
+								break;
 						}
-					} else {
-						tm.tm_isdst = -1;
+					} else if (response[1] == '0') {
+						strcpy(response, "-06");
 					}
-					time_t secs = mktime(&tm);
-					indigo_timetoisogm(secs, MOUNT_UTC_ITEM->text.value, INDIGO_VALUE_SIZE);
-					MOUNT_UTC_TIME_PROPERTY->state = INDIGO_OK_STATE;
 				}
+				tm.tm_gmtoff = -atoi(response) * 3600;
+				sprintf(MOUNT_UTC_OFFSET_ITEM->text.value, "%d", -atoi(response));
+				if (PRIVATE_DATA->use_dst_commands) {
+					tm.tm_isdst = atoi(dst);
+				} else {
+					tm.tm_isdst = -1;
+				}
+				time_t secs = mktime(&tm);
+				indigo_timetoisogm(secs, MOUNT_UTC_ITEM->text.value, INDIGO_VALUE_SIZE);
+				MOUNT_UTC_TIME_PROPERTY->state = INDIGO_OK_STATE;
 			}
 		}
 	}
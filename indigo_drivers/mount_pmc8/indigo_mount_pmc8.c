@@ -145,87 +145,31 @@ static bool pmc8_open(indigo_device *device) {
 }
 
 static bool pmc8_command(indigo_device *device, char *command, char *response, int max, int sleep) {
+	indigo_transaction transaction = { .command = command, .response = response, .response_size = max + 1, .terminators = "!", .keep_terminator = true, .timeout = 100000, .char_timeout = 500000, .delay = sleep };
 	pthread_mutex_lock(&PRIVATE_DATA->port_mutex);
-	char c;
-	struct timeval tv;
-	// flush
-	while (true) {
-		fd_set readout;
-		FD_ZERO(&readout);
-		FD_SET(PRIVATE_DATA->handle, &readout);
-		tv.tv_sec = 0;
-		tv.tv_usec = 10000;
-		long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-		if (result == 0)
+	bool result = indigo_drain(PRIVATE_DATA->handle);
+	for (int repeat = 10; result; repeat--) {
+		result = indigo_execute_transactions(PRIVATE_DATA->handle, &transaction, 1, false, false);
+		if (!result || response == NULL || transaction.length > 0)
 			break;
-		if (result < 0) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-		if (PRIVATE_DATA->proto == INDIGO_PROTOCOL_UDP) {
-			char buf[64];
-			result = recv(PRIVATE_DATA->handle, buf, sizeof(buf), 0);
-		} else {
-			result = read(PRIVATE_DATA->handle, &c, 1);
-		}
-		if (result < 1) {
+		if (repeat == 0) {
 			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s failed", command);
 			return false;
 		}
 	}
-	for (int repeat = 10; ; repeat--) {
-	// write command
-		if (PRIVATE_DATA->proto == INDIGO_PROTOCOL_UDP) {
-			send(PRIVATE_DATA->handle, command, strlen(command), 0);
-		} else {
-			indigo_write(PRIVATE_DATA->handle, command, strlen(command));
-		}
-		if (sleep > 0)
-			indigo_usleep(sleep);
-		// read response
-		if (response != NULL) {
-			fd_set readout;
-			FD_ZERO(&readout);
-			FD_SET(PRIVATE_DATA->handle, &readout);
-			tv.tv_sec = 0;
-			tv.tv_usec = 100000;
-			long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-			if (result == 0) {
-				if (repeat > 0) {
-					continue;
-				} else {
-					pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-					INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s failed", command);
-					return false;
-				}
-			}
-			if (PRIVATE_DATA->proto == INDIGO_PROTOCOL_UDP) {
-				long bytes_read = recv(PRIVATE_DATA->handle, response, max, 0);
-				response[bytes_read] = 0;
-			} else {
-				int bytes_read = 0;
-				while (bytes_read < max) {
-					result = read(PRIVATE_DATA->handle, &c, 1);
-					if (result < 1) {
-						break;
-					}
-					response[bytes_read++] = c;
-					if (c == '!')
-						break;
-				}
-				response[bytes_read] = 0;
-			}
-			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> %s", command, response != NULL ? response : "NULL");
-			for (char *tmp = response; *tmp; tmp++) {
-				if (*tmp == '!') {
-					*tmp = 0;
-					break;
-				}
+	pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+	if (!result)
+		return false;
+	if (response != NULL) {
+		INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> %s", command, response);
+		for (char *tmp = response; *tmp; tmp++) {
+			if (*tmp == '!') {
+				*tmp = 0;
+				break;
 			}
-			break;
 		}
 	}
-	pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
 	return true;
 }
 
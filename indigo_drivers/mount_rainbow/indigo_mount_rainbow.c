@@ -112,28 +112,13 @@ static void rainbow_close(indigo_device *device) {
 
 static void rainbow_reader(indigo_device *device) {
 	INDIGO_DRIVER_LOG(DRIVER_NAME, "Reader started");
-	char response[128], c;
-	struct timeval tv;
-	fd_set readout;
-	FD_ZERO(&readout);
-	FD_SET(PRIVATE_DATA->handle, &readout);
-	tv.tv_sec = 0;
-	tv.tv_usec = 100000;
+	char response[128];
+	indigo_read_buffer buffer = { .start = 0, .end = 0 };
+	indigo_transaction transaction = { .response = response, .response_size = sizeof(response), .terminators = "#", .keep_terminator = true, .timeout = 1000000 };
 	while (PRIVATE_DATA->handle > 0) {
-		int i = 0;
-		while (true) {
-			response[i] = 0;
-			if (i == sizeof(response) - 1)
-				break;
-//			if (select(PRIVATE_DATA->handle + 1, &readout, NULL, NULL, &tv) <= 0)
-//				break;
-			if (read(PRIVATE_DATA->handle, &c, 1) < 1)
-				break;
-			response[i++] = c;
-			if (c == '#') {
-				response[i] = 0;
-				break;
-			}
+		if (!indigo_read_buffered(PRIVATE_DATA->handle, &buffer, &transaction)) {
+			indigo_usleep(100000);
+			continue;
 		}
 		if (*response == 0)
 			continue;
@@ -154,64 +154,21 @@ static bool temma_open(indigo_device *device) {
 }
 
 static bool temma_command(indigo_device *device, char *command, bool wait) {
+	char line[128], buffer[128];
+	snprintf(line, sizeof(line), "%s\r\n", command);
+	indigo_transaction transaction = { .command = line, .response = wait ? buffer : NULL, .response_size = sizeof(buffer), .terminators = "\n", .ignored = "\r", .timeout = 300000 };
 	pthread_mutex_lock(&PRIVATE_DATA->port_mutex);
-	char c;
-	struct timeval tv;
-	// flush
-	while (true) {
-		fd_set readout;
-		FD_ZERO(&readout);
-		FD_SET(PRIVATE_DATA->handle, &readout);
-		tv.tv_sec = 0;
-		tv.tv_usec = 100000;
-		long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-		if (result == 0)
-			break;
-		if (result < 0) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-		result = read(PRIVATE_DATA->handle, &c, 1);
-		if (result < 1) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
+	if (!indigo_execute_transactions(PRIVATE_DATA->handle, &transaction, 1, true, false)) {
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to execute %s on %s -> %s (%d)", command, DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
+		pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+		return false;
 	}
-	// write command
-	indigo_write(PRIVATE_DATA->handle, command, strlen(command));
-	indigo_write(PRIVATE_DATA->handle, "\r\n", 2);
-	// read response
 	if (wait) {
-		char buffer[128];
-		int index = 0;
-		int timeout = 3;
-		int max = sizeof(buffer) - 1;
-		while (index < max) {
-			fd_set readout;
-			FD_ZERO(&readout);
-			FD_SET(PRIVATE_DATA->handle, &readout);
-			tv.tv_sec = 0;
-			tv.tv_usec = 300000;
-			timeout = 0;
-			long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-			if (result <= 0) {
-				INDIGO_DRIVER_ERROR(DRIVER_NAME, "select failed from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
-				pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-				return false;
-			}
-			result = read(PRIVATE_DATA->handle, &c, 1);
-			if (result < 1) {
-				INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to read from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
-				pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-				return false;
-			}
-			if (c == '\r')
-				continue;
-			if (c == '\n')
-				break;
-			buffer[index++] = c;
+		if (!transaction.complete && transaction.length < sizeof(buffer) - 1) {
+			INDIGO_DRIVER_ERROR(DRIVER_NAME, "Timeout reading from %s", DEVICE_PORT_ITEM->text.value);
+			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+			return false;
 		}
-		buffer[index] = 0;
 		INDIGO_DRIVER_DEBUG(DRIVER_NAME, "command '%s' -> '%s'", command, buffer);
 		switch (buffer[0]) {
 			case 'E': {
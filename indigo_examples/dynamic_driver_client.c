@@ -26,6 +26,7 @@
 #include <unistd.h>
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_client.h>
+#include <indigo/indigo_image_pool.h>
 
 #define CCD_SIMULATOR "CCD Imager Simulator"
 
@@ -102,7 +103,7 @@ static indigo_result client_update_property(indigo_client *client, indigo_device
 			indigo_log("image saved to %s...", name);
 			/* In case we have URL BLOB transfer we need to release the blob ourselves */
 			if (*property->items[0].blob.url) {
-				free(property->items[0].blob.value);
+				indigo_release_image_buffer(property->items[0].blob.value);
 				property->items[0].blob.value = NULL;
 			}
 		}
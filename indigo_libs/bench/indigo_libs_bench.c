@@ -0,0 +1,534 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO library micro benchmarks
+ \file indigo_libs_bench.c
+
+ Times hot library kernels (base64, JPEG preview, FITS/XISF/RAW image processing, star detection, donuts digest,
+ PSF measurement, XML parser, number conversions and XML escaping) on synthetic inputs generated from a fixed seed
+ for several sensor sizes and prints the results as JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_base64.h>
+#include <indigo/indigo_ccd_driver.h>
+#include <indigo/indigo_raw_utils.h>
+#include <indigo/indigo_xml.h>
+#include <indigo/indigo_driver_xml.h>
+#include <indigo/indigo_client_xml.h>
+
+#define DEFAULT_SIZES				"640x480,1920x1080,4096x3072"
+#define DEFAULT_MIN_TIME		0.5
+#define MIN_ITERATIONS			3
+#define MAX_ITERATIONS			10000
+#define MAX_STARS						50
+#define PSF_STARS						16
+#define PSF_RADIUS					8
+#define DONUTS_BORDER				8
+#define NUMBER_COUNT				65536
+#define ESCAPE_COUNT				4096
+#define TRACE_UPDATES				5000
+#define SEED								0x1DC0C0FFEEULL
+
+typedef void (*bench_kernel)(void *context);
+
+typedef struct {
+	int width;
+	int height;
+	uint16_t *mono16;								///< FITS_HEADER_SIZE + pixels + padding, pixels at FITS_HEADER_SIZE offset
+	uint8_t *rgb24;									///< same layout for 8-bit RGB image
+	void *work;											///< scratch copy processed in place by indigo_process_image()
+	unsigned long work_size;
+	double star_x[PSF_STARS];
+	double star_y[PSF_STARS];
+	int star_count;
+	unsigned char *encoded;
+	long encoded_size;
+	unsigned char *decoded;
+	int bpp;
+} image_context;
+
+static uint64_t random_state;
+static const char *kernel_filter = NULL;
+static double min_time = DEFAULT_MIN_TIME;
+static bool first_result = true;
+static volatile double sink;		///< keeps results of otherwise unused computations alive
+
+static indigo_result bench_attach(indigo_device *device) {
+	if (indigo_ccd_attach(device, "Benchmark", INDIGO_VERSION_CURRENT) == INDIGO_OK) {
+		indigo_set_switch(CCD_PREVIEW_PROPERTY, CCD_PREVIEW_DISABLED_ITEM, true);
+		indigo_set_switch(CCD_UPLOAD_MODE_PROPERTY, CCD_UPLOAD_MODE_CLIENT_ITEM, true);
+		return INDIGO_OK;
+	}
+	return INDIGO_FAILED;
+}
+
+static indigo_device bench_device = INDIGO_DEVICE_INITIALIZER(
+	"Benchmark Camera",
+	bench_attach,
+	indigo_ccd_enumerate_properties,
+	indigo_ccd_change_property,
+	NULL,
+	indigo_ccd_detach
+);
+
+// -------------------------------------------------------------------------------- helpers
+
+static uint64_t random_next(void) {
+	random_state ^= random_state >> 12;
+	random_state ^= random_state << 25;
+	random_state ^= random_state >> 27;
+	return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double random_uniform(void) {
+	return (random_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static bool is_selected(const char *kernel) {
+	if (kernel_filter == NULL)
+		return true;
+	const char *filter = kernel_filter;
+	while (*filter) {
+		const char *end = strchr(filter, ',');
+		size_t length = end ? (size_t)(end - filter) : strlen(filter);
+		if (length > 0 && !strncmp(kernel, filter, length))
+			return true;
+		if (end == NULL)
+			break;
+		filter = end + 1;
+	}
+	return false;
+}
+
+static void measure(const char *kernel, const char *input, int width, int height, double bytes, double items, bench_kernel prepare, bench_kernel run, void *context) {
+	if (!is_selected(kernel))
+		return;
+	int size = 64, count = 0;
+	double *samples = indigo_safe_malloc(size * sizeof(double));
+	if (prepare)
+		prepare(context);
+	run(context);
+	double total = 0;
+	while (count < MIN_ITERATIONS || (total < min_time && count < MAX_ITERATIONS)) {
+		if (prepare)
+			prepare(context);
+		double start = now();
+		run(context);
+		double duration = now() - start;
+		if (count == size)
+			samples = indigo_safe_realloc(samples, (size *= 2) * sizeof(double));
+		samples[count++] = duration;
+		total += duration;
+	}
+	qsort(samples, count, sizeof(double), compare_doubles);
+	double median = count & 1 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+	printf("%s    { \"kernel\": \"%s\", \"input\": \"%s\"", first_result ? "" : ",\n", kernel, input);
+	if (width > 0)
+		printf(", \"width\": %d, \"height\": %d", width, height);
+	printf(", \"iterations\": %d, \"min_ms\": %.4f, \"median_ms\": %.4f, \"mean_ms\": %.4f", count, samples[0] * 1000, median * 1000, total / count * 1000);
+	if (bytes > 0)
+		printf(", \"mb_per_second\": %.1f", bytes / median / 1e6);
+	if (bytes > 0 && width > 0)
+		printf(", \"mpixels_per_second\": %.1f", (double)width * height / median / 1e6);
+	if (items > 0)
+		printf(", \"items_per_second\": %.0f", items / median);
+	printf(" }");
+	fflush(stdout);
+	first_result = false;
+	indigo_safe_free(samples);
+}
+
+// -------------------------------------------------------------------------------- synthetic images
+
+static void create_images(image_context *image) {
+	int width = image->width, height = image->height;
+	unsigned long pixels = (unsigned long)width * height;
+	image->work_size = FITS_HEADER_SIZE + 6 * pixels + 2880;
+	image->mono16 = indigo_safe_malloc(FITS_HEADER_SIZE + 2 * pixels + 2880);
+	image->rgb24 = indigo_safe_malloc(FITS_HEADER_SIZE + 3 * pixels + 2880);
+	image->work = indigo_safe_malloc(image->work_size);
+	uint16_t *raw = image->mono16 + FITS_HEADER_SIZE / 2;
+	random_state = SEED ^ pixels;
+	for (unsigned long i = 0; i < pixels; i++) {
+		uint64_t r = random_next();
+		raw[i] = 1000 + (r & 0x3F) + ((r >> 8) & 0x3F);
+	}
+	int stars = (int)(pixels / 20000);
+	if (stars < PSF_STARS)
+		stars = PSF_STARS;
+	double sigma = 3.0 / 2.3548;
+	for (int s = 0; s < stars; s++) {
+		double x = 16 + random_uniform() * (width - 32);
+		double y = 16 + random_uniform() * (height - 32);
+		double peak = 500 + random_uniform() * random_uniform() * 40000;
+		if (s < PSF_STARS) {
+			image->star_x[s] = x;
+			image->star_y[s] = y;
+		}
+		for (int j = (int)y - 7; j <= (int)y + 7; j++) {
+			for (int i = (int)x - 7; i <= (int)x + 7; i++) {
+				double dx = i - x, dy = j - y;
+				double value = raw[j * width + i] + peak * exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+				raw[j * width + i] = value > 65535 ? 65535 : (uint16_t)value;
+			}
+		}
+	}
+	image->star_count = PSF_STARS;
+	uint8_t *rgb = image->rgb24 + FITS_HEADER_SIZE;
+	for (unsigned long i = 0; i < pixels; i++) {
+		uint8_t value = raw[i] >> 8;
+		*rgb++ = value;
+		*rgb++ = value ^ (i & 0x07);
+		*rgb++ = value >> 1;
+	}
+}
+
+static void release_images(image_context *image) {
+	indigo_safe_free(image->mono16);
+	indigo_safe_free(image->rgb24);
+	indigo_safe_free(image->work);
+	indigo_safe_free(image->encoded);
+	indigo_safe_free(image->decoded);
+}
+
+// -------------------------------------------------------------------------------- image kernels
+
+static void run_base64_encode(image_context *image) {
+	image->encoded_size = base64_encode(image->encoded, (unsigned char *)image->mono16 + FITS_HEADER_SIZE, 2L * image->width * image->height);
+}
+
+static void run_base64_decode(image_context *image) {
+	base64_decode_fast(image->decoded, image->encoded, image->encoded_size);
+}
+
+static void run_jpeg(image_context *image) {
+	void *data = image->bpp == 16 ? (void *)image->mono16 : (void *)image->rgb24;
+	void *jpeg = NULL;
+	unsigned long jpeg_size = 0;
+	indigo_raw_to_jpeg(&bench_device, data, image->width, image->height, image->bpp, true, true, &jpeg, &jpeg_size, NULL, NULL);
+	free(jpeg);
+}
+
+static void prepare_process(image_context *image) {
+	if (image->bpp == 16)
+		memcpy(image->work, image->mono16, FITS_HEADER_SIZE + 2L * image->width * image->height);
+	else
+		memcpy(image->work, image->rgb24, FITS_HEADER_SIZE + 3L * image->width * image->height);
+}
+
+static void run_process(image_context *image) {
+	indigo_process_image(&bench_device, image->work, image->width, image->height, image->bpp, true, true, NULL, false);
+}
+
+static void run_find_stars(image_context *image) {
+	indigo_star_detection stars[MAX_STARS];
+	int found = 0;
+	indigo_find_stars(INDIGO_RAW_MONO16, image->mono16 + FITS_HEADER_SIZE / 2, image->width, image->height, MAX_STARS, stars, &found);
+}
+
+static void run_donuts(image_context *image) {
+	indigo_frame_digest digest = { 0 };
+	indigo_donuts_frame_digest(INDIGO_RAW_MONO16, image->mono16 + FITS_HEADER_SIZE / 2, image->width, image->height, DONUTS_BORDER, &digest);
+	indigo_delete_frame_digest(&digest);
+}
+
+static void run_psf(image_context *image) {
+	double fwhm, hfd, peak;
+	for (int i = 0; i < image->star_count; i++)
+		indigo_selection_psf(INDIGO_RAW_MONO16, image->mono16 + FITS_HEADER_SIZE / 2, image->star_x[i], image->star_y[i], PSF_RADIUS, image->width, image->height, &fwhm, &hfd, &peak);
+}
+
+static void bench_image(int width, int height) {
+	image_context image = { width, height };
+	create_images(&image);
+	double pixels = (double)width * height;
+	image.encoded = indigo_safe_malloc(4 * pixels + 16);
+	image.decoded = indigo_safe_malloc(2 * pixels + 16);
+	run_base64_encode(&image);
+	measure("base64_encode", "mono16", width, height, 2 * pixels, 0, NULL, (bench_kernel)run_base64_encode, &image);
+	measure("base64_decode_fast", "mono16", width, height, 2 * pixels, 0, NULL, (bench_kernel)run_base64_decode, &image);
+	for (int bpp = 16; bpp <= 24; bpp += 8) {
+		const char *input = bpp == 16 ? "mono16" : "rgb24";
+		double bytes = pixels * bpp / 8;
+		image.bpp = bpp;
+		measure("raw_to_jpeg", input, width, height, bytes, 0, NULL, (bench_kernel)run_jpeg, &image);
+		indigo_device *device = &bench_device;
+		indigo_set_switch(CCD_IMAGE_FORMAT_PROPERTY, CCD_IMAGE_FORMAT_FITS_ITEM, true);
+		measure("process_image_fits", input, width, height, bytes, 0, (bench_kernel)prepare_process, (bench_kernel)run_process, &image);
+		indigo_set_switch(CCD_IMAGE_FORMAT_PROPERTY, CCD_IMAGE_FORMAT_XISF_ITEM, true);
+		measure("process_image_xisf", input, width, height, bytes, 0, (bench_kernel)prepare_process, (bench_kernel)run_process, &image);
+		indigo_set_switch(CCD_IMAGE_FORMAT_PROPERTY, CCD_IMAGE_FORMAT_RAW_ITEM, true);
+		measure("process_image_raw", input, width, height, bytes, 0, (bench_kernel)prepare_process, (bench_kernel)run_process, &image);
+	}
+	measure("find_stars", "mono16", width, height, 2 * pixels, 0, NULL, (bench_kernel)run_find_stars, &image);
+	measure("donuts_frame_digest", "mono16", width, height, 2 * pixels, 0, NULL, (bench_kernel)run_donuts, &image);
+	measure("selection_psf", "mono16", width, height, 0, image.star_count, NULL, (bench_kernel)run_psf, &image);
+	release_images(&image);
+}
+
+// -------------------------------------------------------------------------------- text kernels
+
+typedef struct {
+	double values[NUMBER_COUNT];
+	char strings[NUMBER_COUNT][32];
+} number_context;
+
+static void run_dtoa(number_context *numbers) {
+	char buffer[32];
+	for (int i = 0; i < NUMBER_COUNT; i++)
+		indigo_dtoa(numbers->values[i], buffer);
+}
+
+static void run_atod(number_context *numbers) {
+	double sum = 0;
+	for (int i = 0; i < NUMBER_COUNT; i++)
+		sum += indigo_atod(numbers->strings[i]);
+	sink = sum;
+}
+
+static void bench_numbers(void) {
+	number_context *numbers = indigo_safe_malloc(sizeof(number_context));
+	random_state = SEED;
+	for (int i = 0; i < NUMBER_COUNT; i++) {
+		switch (i & 3) {
+			case 0: // integers, e.g. positions and counts
+				numbers->values[i] = (double)(random_next() % 100000);
+				break;
+			case 1: // angles and coordinates
+				numbers->values[i] = random_uniform() * 360 - 180;
+				break;
+			default: // anything else
+				numbers->values[i] = (random_uniform() - 0.5) * pow(10, (int)(random_next() % 16) - 8);
+				break;
+		}
+		indigo_dtoa(numbers->values[i], numbers->strings[i]);
+	}
+	measure("dtoa", "numbers", 0, 0, 0, NUMBER_COUNT, NULL, (bench_kernel)run_dtoa, numbers);
+	measure("atod", "numbers", 0, 0, 0, NUMBER_COUNT, NULL, (bench_kernel)run_atod, numbers);
+	indigo_safe_free(numbers);
+}
+
+typedef struct {
+	char *strings[ESCAPE_COUNT];
+	long bytes;
+} escape_context;
+
+static void run_xml_escape(escape_context *escape) {
+	for (int i = 0; i < ESCAPE_COUNT; i++)
+		indigo_xml_escape(escape->strings[i]);
+}
+
+static void bench_escape(void) {
+	static const char *plain = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789.:-/";
+	static const char *special = "&<>\"'";
+	escape_context *escape = indigo_safe_malloc(sizeof(escape_context));
+	random_state = SEED;
+	for (int i = 0; i < ESCAPE_COUNT; i++) {
+		int length = 16 + random_next() % 113;
+		char *string = escape->strings[i] = indigo_safe_malloc(length + 1);
+		// every fourth string has nothing to escape, the rest has about 5% of special characters
+		bool escaped = i & 3;
+		for (int j = 0; j < length; j++)
+			string[j] = escaped && random_next() % 20 == 0 ? special[random_next() % 5] : plain[random_next() % strlen(plain)];
+		escape->bytes += length;
+	}
+	measure("xml_escape", "strings", 0, 0, escape->bytes, ESCAPE_COUNT, NULL, (bench_kernel)run_xml_escape, escape);
+	for (int i = 0; i < ESCAPE_COUNT; i++)
+		indigo_safe_free(escape->strings[i]);
+	indigo_safe_free(escape);
+}
+
+typedef struct {
+	int handle;
+	int parser_handle;						///< duplicate of handle, closed by indigo_xml_parse()
+	int null_handle;
+} trace_context;
+
+static long record_trace(int handle) {
+	indigo_device device = { "Trace Camera" };
+	indigo_property *properties[5];
+	properties[0] = indigo_init_number_property(NULL, device.name, CCD_EXPOSURE_PROPERTY_NAME, "Camera", "Start exposure", INDIGO_OK_STATE, INDIGO_RW_PERM, 1);
+	indigo_init_number_item(properties[0]->items, CCD_EXPOSURE_ITEM_NAME, "Start exposure", 0, 10000, 1, 0);
+	properties[1] = indigo_init_number_property(NULL, device.name, "GUIDER_STATS", "Guider", "Stats", INDIGO_OK_STATE, INDIGO_RO_PERM, 15);
+	for (int i = 0; i < 15; i++) {
+		char name[INDIGO_NAME_SIZE];
+		sprintf(name, "ITEM_%d", i);
+		indigo_init_number_item(properties[1]->items + i, name, name, -1000, 1000, 0, 0);
+	}
+	properties[2] = indigo_init_text_property(NULL, device.name, "FITS_HEADERS", "Camera", "FITS headers", INDIGO_OK_STATE, INDIGO_RW_PERM, 4);
+	for (int i = 0; i < 4; i++) {
+		char name[INDIGO_NAME_SIZE];
+		sprintf(name, "HEADER_%d", i);
+		indigo_init_text_item(properties[2]->items + i, name, name, "");
+	}
+	properties[3] = indigo_init_switch_property(NULL, device.name, "FRAME_TYPE", "Camera", "Frame type", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 8);
+	for (int i = 0; i < 8; i++) {
+		char name[INDIGO_NAME_SIZE];
+		sprintf(name, "TYPE_%d", i);
+		indigo_init_switch_item(properties[3]->items + i, name, name, i == 0);
+	}
+	properties[4] = indigo_init_light_property(NULL, device.name, "STATUS", "Camera", "Status", INDIGO_OK_STATE, 4);
+	for (int i = 0; i < 4; i++) {
+		char name[INDIGO_NAME_SIZE];
+		sprintf(name, "LIGHT_%d", i);
+		indigo_init_light_item(properties[4]->items + i, name, name, INDIGO_IDLE_STATE);
+	}
+	indigo_client *client = indigo_xml_device_adapter(handle, handle);
+	client->version = INDIGO_VERSION_CURRENT;
+	for (int i = 0; i < 5; i++)
+		client->define_property(client, &device, properties[i], NULL);
+	random_state = SEED;
+	for (int i = 0; i < TRACE_UPDATES; i++) {
+		indigo_property *property = properties[random_next() % 5];
+		property->state = random_next() % 3 ? INDIGO_OK_STATE : INDIGO_BUSY_STATE;
+		for (int j = 0; j < property->count; j++) {
+			indigo_item *item = property->items + j;
+			switch (property->type) {
+				case INDIGO_NUMBER_VECTOR:
+					item->number.value = (random_uniform() - 0.5) * 2000;
+					break;
+				case INDIGO_TEXT_VECTOR:
+					sprintf(item->text.value, "KEY%d    = '%08x' / <comment & value>", j, (unsigned)random_next());
+					break;
+				case INDIGO_SWITCH_VECTOR:
+					item->sw.value = j == i % property->count;
+					break;
+				case INDIGO_LIGHT_VECTOR:
+					item->light.value = random_next() % 4;
+					break;
+				default:
+					break;
+			}
+		}
+		client->update_property(client, &device, property, i % 10 ? NULL : "Synthetic update");
+	}
+	indigo_release_xml_device_adapter(client);
+	for (int i = 0; i < 5; i++)
+		indigo_release_property(properties[i]);
+	return 5 + TRACE_UPDATES;
+}
+
+static void prepare_xml_parse(trace_context *trace) {
+	trace->parser_handle = dup(trace->handle);
+	lseek(trace->parser_handle, 0, SEEK_SET);
+}
+
+static void run_xml_parse(trace_context *trace) {
+	indigo_device *device = indigo_xml_client_adapter("Trace", "", trace->parser_handle, trace->null_handle);
+	indigo_xml_parse(device, NULL);
+	indigo_safe_free(device->device_context);
+	indigo_safe_free(device);
+}
+
+static void bench_xml_parse(const char *trace_file) {
+	if (!is_selected("xml_parse"))
+		return;
+	trace_context trace = { -1, -1, open("/dev/null", O_WRONLY) };
+	long messages = 0;
+	if (trace_file) {
+		trace.handle = open(trace_file, O_RDONLY);
+	} else {
+		char file_name[] = "/tmp/indigo_libs_bench_XXXXXX";
+		trace.handle = mkstemp(file_name);
+		if (trace.handle >= 0) {
+			unlink(file_name);
+			messages = record_trace(trace.handle);
+		}
+	}
+	if (trace.handle < 0) {
+		indigo_error("Can't open XML trace (%s)", strerror(errno));
+		close(trace.null_handle);
+		return;
+	}
+	measure("xml_parse", trace_file ? "trace" : "synthetic_trace", 0, 0, lseek(trace.handle, 0, SEEK_END), messages, (bench_kernel)prepare_xml_parse, (bench_kernel)run_xml_parse, &trace);
+	close(trace.handle);
+	close(trace.null_handle);
+}
+
+// -------------------------------------------------------------------------------- main
+
+int main(int argc, const char * argv[]) {
+	const char *sizes = DEFAULT_SIZES;
+	const char *trace_file = NULL;
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	for (int i = 1; i < argc; i++) {
+		if ((!strcmp(argv[i], "-s") || !strcmp(argv[i], "--sizes")) && i < argc - 1) {
+			sizes = argv[++i];
+		} else if ((!strcmp(argv[i], "-k") || !strcmp(argv[i], "--kernels")) && i < argc - 1) {
+			kernel_filter = argv[++i];
+		} else if ((!strcmp(argv[i], "-t") || !strcmp(argv[i], "--time")) && i < argc - 1) {
+			min_time = atof(argv[++i]);
+		} else if ((!strcmp(argv[i], "-x") || !strcmp(argv[i], "--xml-trace")) && i < argc - 1) {
+			trace_file = argv[++i];
+		} else {
+			fprintf(stderr, "INDIGO library micro benchmarks\n");
+			fprintf(stderr, "usage: %s [-s | --sizes WxH,WxH,...] [-k | --kernels name,name,...] [-t | --time seconds] [-x | --xml-trace file]\n", argv[0]);
+			fprintf(stderr, "       -s  | --sizes WxH,...            (synthetic sensor sizes, default %s)\n", DEFAULT_SIZES);
+			fprintf(stderr, "       -k  | --kernels name,...         (kernel name prefixes, default all)\n");
+			fprintf(stderr, "       -t  | --time seconds             (minimal time per kernel, default %g)\n", DEFAULT_MIN_TIME);
+			fprintf(stderr, "       -x  | --xml-trace file           (recorded server to client XML traffic, default synthetic)\n");
+			return 1;
+		}
+	}
+	indigo_start();
+	indigo_attach_device(&bench_device);
+	printf("{\n  \"config\": { \"sizes\": \"%s\", \"min_time\": %g, \"seed\": \"0x%llx\", \"cpus\": %ld },\n  \"results\": [\n", sizes, min_time, SEED, sysconf(_SC_NPROCESSORS_ONLN));
+	const char *size = sizes;
+	while (size && *size) {
+		int width = 0, height = 0;
+		if (sscanf(size, "%dx%d", &width, &height) == 2 && width >= 64 && height >= 64)
+			bench_image(width, height);
+		else
+			indigo_error("Invalid size '%s'", size);
+		size = strchr(size, ',');
+		if (size)
+			size++;
+	}
+	bench_numbers();
+	bench_escape();
+	bench_xml_parse(trace_file);
+	printf("\n  ]\n}\n");
+	indigo_detach_device(&bench_device);
+	indigo_stop();
+	return 0;
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO binary wire protocol parser
+ \file indigo_binary.h
+ */
+
+#ifndef indigo_binary_h
+#define indigo_binary_h
+
+#include <stdint.h>
+#include <indigo/indigo_bus.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Signature sent by client before the first message, the first byte is used by server to detect the protocol.
+ */
+#define INDIGO_BINARY_SIGNATURE					"\x89IBP"
+#define INDIGO_BINARY_SIGNATURE_SIZE		4
+
+/** Message header size (type + payload length).
+ */
+#define INDIGO_BINARY_HEADER_SIZE				5
+
+/** Message types.
+ */
+typedef enum {
+	INDIGO_BINARY_GET_PROPERTIES = 1,	///< client -> server: device, name, version, flags, [group]
+	INDIGO_BINARY_ENABLE_BLOB,				///< client -> server: device, name, mode
+	INDIGO_BINARY_NEW_PROPERTY,				///< client -> server: type, device, name, token, items
+	INDIGO_BINARY_DEF_PROPERTY,				///< server -> client: id, full property definition
+	INDIGO_BINARY_SET_PROPERTY,				///< server -> client: id, state, message, (item index, value) tuples
+	INDIGO_BINARY_DEL_PROPERTY,				///< server -> client: device, name, message
+	INDIGO_BINARY_MESSAGE							///< server -> client: device, message
+} indigo_binary_message_type;
+
+/** GET_PROPERTIES flags.
+ */
+#define INDIGO_BINARY_FLAG_DELTA				0x01	///< SET_PROPERTY messages may carry changed items only
+#define INDIGO_BINARY_FLAG_SUBSCRIBE		0x02	///< device and name (with wildcards) and group string following flags are subscription filter
+
+/** BLOB item content kind in SET_PROPERTY message.
+ */
+typedef enum {
+	INDIGO_BINARY_BLOB_NONE = 0,
+	INDIGO_BINARY_BLOB_PATH,
+	INDIGO_BINARY_BLOB_URL,
+	INDIGO_BINARY_BLOB_DATA
+} indigo_binary_blob_kind;
+
+/** Growable message buffer, first INDIGO_BINARY_HEADER_SIZE bytes are reserved for header.
+ */
+typedef struct {
+	unsigned char *data;
+	long length;
+	long size;
+} indigo_binary_buffer;
+
+/** Use binary wire protocol for connections to remote INDIGO servers.
+ */
+extern bool indigo_use_binary_protocol;
+
+/** Start new message in buffer.
+ */
+extern void indigo_binary_begin(indigo_binary_buffer *buffer, indigo_binary_message_type type);
+
+/** Append values to message in buffer (network byte order).
+ */
+extern void indigo_binary_put_u8(indigo_binary_buffer *buffer, uint8_t value);
+extern void indigo_binary_put_u16(indigo_binary_buffer *buffer, uint16_t value);
+extern void indigo_binary_put_u32(indigo_binary_buffer *buffer, uint32_t value);
+extern void indigo_binary_put_u64(indigo_binary_buffer *buffer, uint64_t value);
+extern void indigo_binary_put_double(indigo_binary_buffer *buffer, double value);
+extern void indigo_binary_put_string(indigo_binary_buffer *buffer, const char *string);
+extern void indigo_binary_put_text(indigo_binary_buffer *buffer, const char *text);
+
+/** Write message to handle, payload_tail bytes are written by caller immediately after.
+ */
+extern bool indigo_binary_write(int handle, indigo_binary_buffer *buffer, long payload_tail);
+
+/** Binary wire protocol parser.
+ */
+extern void indigo_binary_parse(indigo_device *device, indigo_client *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* indigo_binary_h */
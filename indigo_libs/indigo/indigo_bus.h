@@ -178,6 +178,16 @@ typedef struct indigo_enable_blob_mode_record {
 	struct indigo_enable_blob_mode_record *next; ///< next record
 } indigo_enable_blob_mode_record;
 
+/** Subscription record, device, name and group can contain '*' and '?' wildcards, empty string matches anything
+ */
+
+typedef struct indigo_subscription_record {
+	char device[INDIGO_NAME_SIZE];				///< device name pattern
+	char name[INDIGO_NAME_SIZE];					///< property name pattern
+	char group[INDIGO_NAME_SIZE];					///< property group pattern
+	struct indigo_subscription_record *next; ///< next record
+} indigo_subscription_record;
+
 /** RAW image header.
  */
 
@@ -300,6 +310,7 @@ typedef struct indigo_device {
 	/** callback called when device is detached from the bus
 	 */
 	indigo_result (*detach)(indigo_device *device);
+	struct indigo_metric *update_metric;												///< property update counter (maintained by bus)
 } indigo_device;
 
 #define INDIGO_DEVICE_INITIALIZER(name_str, attach_cb, enumerate_properties_cb, change_property_cb, enable_blob_cb, detach_cb) { \
@@ -321,6 +332,9 @@ typedef struct indigo_device {
 }
 
 /** Client structure definition
+ With indigo_use_strict_locking callbacks of local clients and devices (is_remote == false) are never called concurrently, they are
+ serialized by one recursive bus lock, so a callback can call back into the bus. Callbacks of remote clients can be called from several
+ threads at the same time.
  */
 typedef struct indigo_client {
 	char name[INDIGO_NAME_SIZE];															///< client name
@@ -348,6 +362,8 @@ typedef struct indigo_client {
 	/** callback called when client is detached from the bus
 	 */
 	indigo_result (*detach)(indigo_client *client);
+	indigo_subscription_record *subscription_records;				///< subscribed properties (all if NULL)
+	struct indigo_client_metrics *metrics;										///< delivery metrics (maintained by bus)
 } indigo_client;
 
 /** Wire protocol adapter private data structure.
@@ -356,7 +372,10 @@ typedef struct {
 	int input;													///< input handle
 	int output;													///< output handle
 	bool web_socket;										///< connection over WebSocket (RFC6455)
+	bool web_socket_deflate;						///< permessage-deflate extension negotiated (RFC7692)
 	char url_prefix[INDIGO_NAME_SIZE];	///< server url prefix (for BLOB download)
+	bool delta_updates;									///< client accepts vectors with changed items only
+	struct indigo_delta_cache *delta_cache;	///< last item values sent to client
 } indigo_adapter_context;
 
 /** BLOB entry type.
@@ -385,6 +404,32 @@ extern void (*indigo_log_message_handler)(const char *message);
  */
 extern void indigo_log_message(const char *format, va_list args);
 
+/** If set, messages are formatted by calling thread into its own lock-free buffer and written to stderr/syslog/handler by background writer thread.
+ */
+extern bool indigo_use_async_log;
+
+/** Max number of debug and trace messages per second and thread accepted by asynchronous log (0 = unlimited).
+ */
+extern int indigo_log_rate_limit;
+
+/** Asynchronous log statistics.
+ */
+typedef struct {
+	int buffers;											///< number of per-thread buffers
+	unsigned long messages;						///< number of buffered messages
+	unsigned long rate_limited;				///< number of debug and trace messages dropped by rate limiter
+	unsigned long overflows;					///< number of debug and trace messages dropped because of full buffer
+	unsigned long synchronous;				///< number of messages written synchronously (too long or full buffer)
+} indigo_log_statistics;
+
+/** Get asynchronous log statistics.
+ */
+extern void indigo_get_log_statistics(indigo_log_statistics *statistics);
+
+/** Write out all buffered messages.
+ */
+extern void indigo_log_flush(void);
+
 /** Print diagnostic messages on trace level, wrap calls to INDIGO_TRACE() macro.
  */
 extern void indigo_trace(const char *format, ...);
@@ -435,6 +480,23 @@ extern indigo_result indigo_attach_client(indigo_client *client);
  */
 extern indigo_result indigo_detach_client(indigo_client *client);
 
+/** Add subscription filter, client receives definitions, updates and deletions of matching properties only.
+ Empty device, name and group remove all filters (default - all properties are received).
+ */
+extern indigo_result indigo_subscribe(indigo_client *client, const char *device, const char *name, const char *group);
+
+/** Remove all subscription filters of the client.
+ */
+extern void indigo_release_subscriptions(indigo_client *client);
+
+/** Test if client is subscribed to property.
+ */
+extern bool indigo_is_subscribed(indigo_client *client, indigo_property *property);
+
+/** Match string against pattern with '*' and '?' wildcards.
+ */
+extern bool indigo_wildcard_match(const char *pattern, const char *string);
+
 /** Broadcast property definition.
  */
 extern indigo_result indigo_define_property(indigo_device *device, indigo_property *property, const char *format, ...);
@@ -486,9 +548,13 @@ extern indigo_property *indigo_init_blob_property(indigo_property *property, con
 /** Resize property.
  */
 extern indigo_property *indigo_resize_property(indigo_property *property, int count);
-/** Allocate blob buffer (rounded up to 2880 bytes).
+/** Allocate zeroed blob buffer (rounded up to 2880 bytes) from image buffer pool.
+ Since build 142 the buffer is preceded by a hidden pool header, it must not be passed to free() or realloc() and drivers built against older headers must be rebuilt.
  */
 extern void *indigo_alloc_blob_buffer(long size);
+/** Return blob buffer allocated by indigo_alloc_blob_buffer() to image buffer pool (same as indigo_release_image_buffer()).
+ */
+extern void indigo_free_blob_buffer(void *buffer);
 /** Resize property.
  */
 extern void indigo_release_property(indigo_property *property);
@@ -519,9 +585,34 @@ extern void indigo_init_light_item(indigo_item *item, const char *name, const ch
 extern void indigo_init_blob_item(indigo_item *item, const char *name, const char *label);
 
 /** populate BLOB item if url is given.
+ Value is allocated from image buffer pool (existing value must be pool buffer or NULL) and should be released by indigo_release_image_buffer().
+ BLOB values cached by client adapters are pool buffers as well.
  */
 extern bool indigo_populate_http_blob_item(indigo_item *blob_item);
 
+/** Callback called from download worker thread on completion of asynchronous BLOB fetch, callback takes ownership of blob_item->blob.value.
+ Value is allocated from image buffer pool and should be released by indigo_release_image_buffer().
+ */
+typedef void (*indigo_blob_fetch_callback)(indigo_item *blob_item, bool success, void *data);
+
+/** Populate copy of BLOB item in bounded download worker pool and reuse kept-alive connections. Fetches with the same data are completed in order.
+ */
+extern void indigo_populate_http_blob_item_async(indigo_item *blob_item, indigo_blob_fetch_callback callback, void *data);
+
+/** Remember item values of defined property as sent to client.
+ */
+extern void indigo_delta_define(struct indigo_delta_cache **cache, indigo_property *property);
+/** Compare item values with last sent ones, mark changed items and remember new values. Returns number of changed items.
+ Text, number and light vectors are tracked, for other types all items are reported as changed.
+ */
+extern int indigo_delta_changes(struct indigo_delta_cache **cache, indigo_property *property, bool *changed);
+/** Forget remembered values of deleted property or device (if property name is empty).
+ */
+extern void indigo_delta_delete(struct indigo_delta_cache **cache, const char *device, const char *name);
+/** Release delta cache.
+ */
+extern void indigo_delta_release(struct indigo_delta_cache **cache);
+
 /** Test, if property matches other property.
  */
 extern bool indigo_property_match(indigo_property *property, indigo_property *other);
@@ -636,10 +727,39 @@ extern bool indigo_handle_property_async(
 	indigo_property *property
 );
 
-/** Asynchronous execution in thread.
+/** Asynchronous execution in thread pool.
  */
 extern bool indigo_async(void *fun(void *data), void *data);
 
+/** Asynchronous execution in thread pool, functions queued with the same key (e.g. device) are executed one by one in order.
+ */
+extern bool indigo_async_queue(void *key, void *fun(void *data), void *data);
+
+/** Execution in a new dedicated thread, to be used for long running functions (e.g. readers, listeners or client workers) instead of indigo_async().
+ */
+extern bool indigo_start_thread(void *fun(void *data), void *data);
+
+/** Max number of threads in indigo_async() pool (0 for twice the number of CPU cores, at least 4).
+ */
+extern int indigo_async_pool_size;
+
+/** Thread pool statistics
+ */
+typedef struct {
+	int pool_size;										///< max number of threads
+	int threads;											///< number of running threads
+	int busy;													///< number of threads executing a job
+	int queued;												///< number of jobs waiting for execution
+	unsigned long jobs;								///< number of executed jobs
+	unsigned long overflows;					///< threads started over the limit because all threads were blocked
+	double queue_latency;							///< average time spent in queue (seconds)
+	double max_queue_latency;					///< max time spent in queue (seconds)
+} indigo_async_statistics;
+
+/** Get thread pool statistics.
+ */
+extern void indigo_get_async_statistics(indigo_async_statistics *statistics);
+
 #define INDIGO_ASYNC(call, data) (indigo_async((void*(*)(void *))call, (void*)data))
 
 /** Convert sexagesimal string to double.
@@ -705,6 +825,10 @@ extern bool indigo_reshare_remote_devices;
  */
 extern bool indigo_use_host_suffix;
 
+/** Request delta updates (changed items only) from remote servers, applies to client adapters created afterwards.
+ */
+extern bool indigo_use_delta_updates;
+
 /** Is sandboxed environment (macOS only).
  */
 extern bool indigo_is_sandboxed;
@@ -721,6 +845,24 @@ extern bool indigo_proxy_blob;
  */
 extern bool indigo_use_strict_locking;
 
+/** Bus device and client table statistics
+ */
+typedef struct {
+	unsigned long broadcasts;					///< number of broadcasts (including enumerate and change requests)
+	unsigned long contended;					///< broadcasts which had to retry because table was replaced meanwhile
+	unsigned long concurrent;					///< broadcasts started while another thread was broadcasting
+	int max_concurrent;								///< max number of threads broadcasting at the same time
+	unsigned long table_updates;			///< number of attach and detach operations
+	unsigned long grace_waits;				///< detach operations waiting for running broadcasts
+	double grace_wait_time;						///< total time spent in grace waits (seconds)
+	int devices;											///< number of attached devices
+	int clients;											///< number of attached clients
+} indigo_bus_statistics;
+
+/** Get bus statistics.
+ */
+extern void indigo_get_bus_statistics(indigo_bus_statistics *statistics);
+
 /** Allocate, assert and zero
  */
 
@@ -0,0 +1,99 @@
+// Copyright (c) 2019 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO star and DSO catalog
+ \file indigo_cat_data.h
+ */
+
+
+#ifndef star_data_h
+#define star_data_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Hipparcos star entry, J2000 position (RA in hours, Dec in degrees) and proper motion, list is terminated by entry with hip == 0.
+ */
+typedef struct {
+	int hip;
+	double ra, dec;
+	float promora, promodec, px, rv, mag;
+	char *name;
+} indigo_star_entry;
+
+/** DSO entry, J2000 position (RA in hours, Dec in degrees), list is terminated by entry with id == NULL.
+ */
+typedef struct {
+	char *id;
+	double ra, dec;
+	float mag, r1, r2, angle;
+	char *name;
+} indigo_dso_entry;
+
+extern indigo_star_entry indigo_star_data[];
+extern indigo_dso_entry indigo_dso_data[];
+
+/** Find stars brighter than max_mag within radius (in degrees) around J2000 ra (in hours) and dec (in degrees), returns number of stars stored to result.
+ */
+extern int indigo_cat_star_cone_search(double ra, double dec, double radius, double max_mag, indigo_star_entry **result, int max_count);
+
+/** Find DSOs brighter than max_mag within radius (in degrees) around J2000 ra (in hours) and dec (in degrees), returns number of DSOs stored to result.
+ */
+extern int indigo_cat_dso_cone_search(double ra, double dec, double radius, double max_mag, indigo_dso_entry **result, int max_count);
+
+/** Find stars brighter than max_mag ordered by magnitude, returns number of stars stored to result.
+ */
+extern int indigo_cat_star_mag_search(double max_mag, indigo_star_entry **result, int max_count);
+
+/** Find star by Hipparcos number, returns NULL if not found.
+ */
+extern indigo_star_entry *indigo_cat_star_by_hip(int hip);
+
+/** Get apparent position of the star for the current day (RA in hours, Dec in degrees).
+ */
+extern void indigo_cat_star_apparent_position(indigo_star_entry *star, double *ra, double *dec);
+
+/** Get apparent position of the DSO for the current day (RA in hours, Dec in degrees).
+ */
+extern void indigo_cat_dso_apparent_position(indigo_dso_entry *dso, double *ra, double *dec);
+
+/** Add star GeoJSON resource, it is generated on the first request and cached until the next day.
+ */
+extern void indigo_add_star_json_resource(int max_mag);
+
+/** Add DSO GeoJSON resource, it is generated on the first request and cached until the next day.
+ */
+extern void indigo_add_dso_json_resource(int max_mag);
+
+/** Add constellation lines GeoJSON resource, it is generated on the first request and cached until the next day.
+ */
+extern void indigo_add_constellations_lines_json_resource(void);
+
+/** Release generated GeoJSON resources.
+ */
+extern void indigo_free_json_resources(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* star_data_h */
@@ -143,6 +143,26 @@ extern "C" {
  */
 #define CCD_LOCAL_MODE_PREFIX_ITEM        (CCD_LOCAL_MODE_PROPERTY->items+1)
 
+/** CCD_LOCAL_SAVE_MODE property pointer, property is mandatory, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_LOCAL_SAVE_MODE_PROPERTY      (CCD_CONTEXT->ccd_local_save_mode_property)
+
+/** CCD_LOCAL_SAVE_MODE.WRITE_BEHIND property item pointer.
+ */
+#define CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_ITEM  (CCD_LOCAL_SAVE_MODE_PROPERTY->items+0)
+
+/** CCD_LOCAL_SAVE_MODE.WRITE_BEHIND_FSYNC property item pointer.
+ */
+#define CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_FSYNC_ITEM  (CCD_LOCAL_SAVE_MODE_PROPERTY->items+1)
+
+/** CCD_LOCAL_SAVE_MODE.DIRECT_IO property item pointer.
+ */
+#define CCD_LOCAL_SAVE_MODE_DIRECT_IO_ITEM  (CCD_LOCAL_SAVE_MODE_PROPERTY->items+2)
+
+/** CCD_LOCAL_SAVE_MODE.SYNCHRONOUS property item pointer.
+ */
+#define CCD_LOCAL_SAVE_MODE_SYNCHRONOUS_ITEM  (CCD_LOCAL_SAVE_MODE_PROPERTY->items+3)
+
 /** CCD_EXPOSURE property pointer, property is mandatory, property change request handler should set property items and state and call indigo_ccd_change_property().
  */
 #define CCD_EXPOSURE_PROPERTY             (CCD_CONTEXT->ccd_exposure_property)
@@ -325,6 +345,14 @@ extern "C" {
  */
 #define CCD_IMAGE_FILE_ITEM               (CCD_IMAGE_FILE_PROPERTY->items+0)
 
+/** CCD_IMAGE_FILE.THROUGHPUT property item pointer.
+ */
+#define CCD_IMAGE_FILE_THROUGHPUT_ITEM    (CCD_IMAGE_FILE_PROPERTY->items+1)
+
+/** CCD_IMAGE_FILE.BACKLOG property item pointer.
+ */
+#define CCD_IMAGE_FILE_BACKLOG_ITEM       (CCD_IMAGE_FILE_PROPERTY->items+2)
+
 /** CCD_IMAGE property pointer, property is mandatory, read-only property.
  */
 #define CCD_IMAGE_PROPERTY                (CCD_CONTEXT->ccd_image_property)
@@ -472,6 +500,12 @@ typedef struct {
 	indigo_property *ccd_jpeg_settings;						///< CCD_JPEG_SETTINGS property pointer
 	indigo_property *ccd_rbi_flush_enable_property; ///< CCD_RBI_FLUSH_ENABLE property pointer
 	indigo_property *ccd_rbi_flush_property;			///< CCD_RBI_FLUSH property pointer
+	indigo_property *ccd_local_save_mode_property; ///< CCD_LOCAL_SAVE_MODE property pointer
+	bool exposure_traced;													///< exposure tracing event is open
+	pthread_mutex_t image_file_mutex;							///< serializes CCD_IMAGE_FILE changes of exposure and write-behind saver threads, never held while the property is published
+	int image_files_pending;											///< images queued for write-behind saver
+	unsigned long image_bytes_pending;						///< size of images queued for write-behind saver
+	double image_file_throughput;									///< disk throughput in MB/s
 } indigo_ccd_context;
 
 /** Suspend countdown.
@@ -533,6 +567,11 @@ extern void indigo_process_dslr_preview_image(indigo_device *device, void *data,
  */
 extern void indigo_finalize_video_stream(indigo_device *device);
 
+/** Set CCD_IMAGE_FILE state under image file lock and publish it after the lock is released.
+ Drivers should use it instead of direct access, the write-behind saver updates the property concurrently.
+ */
+extern void indigo_ccd_set_image_file_state(indigo_device *device, indigo_property_state state);
+
 #ifdef __cplusplus
 }
 #endif
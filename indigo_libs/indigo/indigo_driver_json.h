@@ -27,6 +27,7 @@
 #define indigo_driver_json_h
 
 #include <stdio.h>
+#include <stdint.h>
 #include <indigo/indigo_json.h>
 
 #ifdef __cplusplus
@@ -38,6 +39,10 @@ extern "C" {
 extern indigo_client *indigo_json_device_adapter(int input, int ouput, bool web_socket);
 extern void indigo_release_json_device_adapter(indigo_client *client);
 
+/** Send web socket control frame (e.g. pong or close) to client, serialized with other messages.
+ */
+extern bool indigo_json_ws_control(indigo_client *client, uint8_t opcode, const char *payload, long length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -176,8 +176,20 @@ typedef struct {
 	bool running_process;
 	bool property_removed;
 	bool (*validate_related_agent)(indigo_device *device, indigo_property *info_property, int mask);
+	pthread_mutex_t wait_mutex;
+	pthread_cond_t wait_cond;
 } indigo_filter_context;
 
+/** Result of indigo_filter_wait_state().
+ */
+typedef enum {
+	INDIGO_FILTER_WAIT_OK = 0,			///< property entered or left the state
+	INDIGO_FILTER_WAIT_TIMEOUT,			///< timeout expired
+	INDIGO_FILTER_WAIT_ABORTED,			///< abort property became busy
+	INDIGO_FILTER_WAIT_PAUSED,			///< pause property became busy
+	INDIGO_FILTER_WAIT_REMOVED			///< cached property was removed
+} indigo_filter_wait_result;
+
 /** Device attach callback function.
  */
 extern indigo_result indigo_filter_device_attach(indigo_device *device, const char* driver_name, unsigned version, indigo_device_interface device_interface);
@@ -213,6 +225,13 @@ extern bool indigo_filter_cached_property(indigo_device *device, int index, char
 /** Forward property change to a different device.
  */
 extern indigo_result indigo_filter_forward_change_property(indigo_client *client, indigo_property *property, char *device_name);
+/** Wait until cached property enters (enter == true) or leaves (enter == false) the state, abort or pause property (if not NULL) becomes busy, cached property is removed or timeout (in seconds, <= 0 for no timeout) expires.
+ Removal of cached property is reported only if property is a cached one, so waits on agent's own properties (e.g. delays waiting for abort) are not affected by property_removed flag.
+ */
+extern indigo_filter_wait_result indigo_filter_wait_state(indigo_device *device, indigo_property *property, indigo_property_state state, bool enter, indigo_property *abort_property, indigo_property *pause_property, double timeout);
+/** Wake up threads waiting in indigo_filter_wait_state() to reevaluate their conditions.
+ */
+extern void indigo_filter_notify(indigo_device *device);
 #ifdef __cplusplus
 }
 #endif
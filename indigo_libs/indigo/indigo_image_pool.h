@@ -0,0 +1,101 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO image buffer pool
+ \file indigo_image_pool.h
+
+ Process wide pool of page aligned, reference counted buffers for image frames. Requested sizes are rounded up
+ to size classes (8 classes per power of two, at least 64KB), released buffers are kept for reuse by the next
+ request of the same class as long as the pool stays within its memory budget.
+ */
+
+#ifndef indigo_image_pool_h
+#define indigo_image_pool_h
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Memory budget for buffers in use and idle buffers (bytes, 0 = half of physical memory).
+ Idle buffers are released to stay within the budget, buffers in use over the budget are still allocated, but counted as over budget.
+ */
+extern long indigo_image_pool_budget;
+
+/** Advise kernel to back buffers of 2MB and more with huge pages (Linux only, off by default).
+ */
+extern bool indigo_image_pool_huge_pages;
+
+/** Allocate buffer of at least size bytes with reference count 1, content is not initialized.
+ Returns NULL if memory can't be allocated.
+ */
+extern void *indigo_alloc_image_buffer(long size);
+
+/** Resize buffer allocated by indigo_alloc_image_buffer() (or allocate it if buffer is NULL), content is preserved.
+ Buffer is returned unchanged if it is large enough, otherwise it is replaced by a new one. Buffer must not be shared.
+ */
+extern void *indigo_resize_image_buffer(void *buffer, long size);
+
+/** Increment reference count of buffer.
+ */
+extern void *indigo_retain_image_buffer(void *buffer);
+
+/** Decrement reference count of buffer (can be NULL) and return it to pool if it is not used anymore.
+ */
+extern void indigo_release_image_buffer(void *buffer);
+
+/** Get usable size of buffer (size of its class).
+ */
+extern long indigo_image_buffer_size(void *buffer);
+
+/** Set memory budget (bytes, 0 = half of physical memory) and release idle buffers over it.
+ */
+extern void indigo_set_image_pool_budget(long budget);
+
+/** Release all idle buffers.
+ */
+extern void indigo_trim_image_pool(void);
+
+/** Image buffer pool statistics
+ */
+typedef struct {
+	long budget;											///< memory budget (bytes)
+	long used;												///< size of buffers in use (bytes)
+	long idle;												///< size of idle buffers ready for reuse (bytes)
+	long peak;												///< max size of all buffers (bytes)
+	int buffers;											///< number of buffers in use
+	int idle_buffers;									///< number of idle buffers
+	unsigned long allocations;				///< number of buffer requests
+	unsigned long reuses;							///< number of requests satisfied by idle buffer
+	unsigned long evictions;					///< number of idle buffers released to stay within budget
+	unsigned long over_budget;				///< number of requests exceeding budget
+} indigo_image_pool_statistics;
+
+/** Get image buffer pool statistics.
+ */
+extern void indigo_get_image_pool_statistics(indigo_image_pool_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* indigo_image_pool_h */
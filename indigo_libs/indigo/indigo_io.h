@@ -102,6 +102,46 @@ extern bool indigo_printf(int handle, const char *format, ...);
 
 extern int indigo_scanf(int handle, const char *format, ...);
 
+/** Discard pending input data, serial ports are flushed with tcflush(), anything else is drained without blocking.
+ */
+extern bool indigo_drain(int handle);
+
+/** Command/response transaction.
+ */
+typedef struct {
+	const char *command;						///< command to write (NULL if nothing should be written)
+	long command_length;						///< command length (0 for zero terminated command)
+	char *response;									///< response buffer (NULL if no response is expected)
+	int response_size;							///< response buffer size including terminating zero
+	int response_length;						///< fixed response length (0 if response is terminated)
+	const char *terminators;				///< characters terminating response
+	const char *ignored;						///< characters to be ignored in response
+	bool keep_terminator;						///< keep terminator in response
+	long timeout;										///< timeout for the first byte of response in us
+	long char_timeout;							///< timeout for the following bytes of response in us (0 for the same as timeout)
+	long delay;											///< delay after command is written in us
+	int length;											///< (out) length of response read
+	bool complete;									///< (out) response was terminated or has expected length before timeout
+} indigo_transaction;
+
+/** Read buffer keeping data following the response for the next read.
+ */
+typedef struct {
+	char data[1024];
+	int start, end;
+} indigo_read_buffer;
+
+/** Read response of transaction (command is not written) using persistent read buffer, e.g. for unsolicited messages.
+    Incomplete response is kept in the buffer and empty response is returned. Returns false on I/O error.
+ */
+extern bool indigo_read_buffered(int handle, indigo_read_buffer *buffer, indigo_transaction *transaction);
+
+/** Execute sequence of transactions with buffered reads, optionally flush pending input before the first one.
+    If pipeline is true, all commands are written at once before responses are read.
+    Returns false on I/O error, timeouts are reported by complete flag of particular transaction and data received before timeout are returned in its response.
+ */
+extern bool indigo_execute_transactions(int handle, indigo_transaction *transactions, int count, bool flush, bool pipeline);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,175 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO performance metrics and event tracing
+ \file indigo_metrics.h
+ */
+
+#ifndef indigo_metrics_h
+#define indigo_metrics_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Number of histogram buckets, upper bounds are 10us * 2^n, the last one is +Inf.
+ */
+#define INDIGO_METRIC_BUCKETS			21
+
+/** Metric type.
+ */
+typedef enum {
+	INDIGO_METRIC_COUNTER,
+	INDIGO_METRIC_HISTOGRAM
+} indigo_metric_type;
+
+/** Metric (counter or time histogram), values are updated with atomic operations only.
+ */
+typedef struct indigo_metric {
+	indigo_metric_type type;								///< metric type
+	const char *name;												///< metric name (static string)
+	const char *help;												///< metric description (static string)
+	const char *label_name;									///< label name (static string) or NULL
+	char label_value[128];									///< label value
+	uint64_t value;													///< counter value or number of histogram observations
+	uint64_t sum;														///< sum of histogram observations (ns)
+	uint64_t max;														///< max histogram observation (ns)
+	uint64_t buckets[INDIGO_METRIC_BUCKETS];	///< histogram buckets (not cumulative)
+	struct indigo_metric *next;							///< next registered metric
+} indigo_metric;
+
+/** Per-client metrics maintained by bus.
+ */
+typedef struct indigo_client_metrics {
+	indigo_metric *messages;								///< messages delivered to client
+	indigo_metric *bytes;										///< bytes written to remote client
+	indigo_metric *latency;									///< time spent delivering messages to client
+} indigo_client_metrics;
+
+/** Enable metrics collection (on by default).
+ */
+extern bool indigo_use_metrics;
+
+/** Get shared metric for name and label value, metric is created on the first call and never released.
+ Returns NULL if metrics are disabled or registry is full.
+ */
+extern indigo_metric *indigo_get_metric(indigo_metric_type type, const char *name, const char *help, const char *label_name, const char *label_value);
+
+/** Create private metric, it has to be released with indigo_release_metric().
+ */
+extern indigo_metric *indigo_create_metric(indigo_metric_type type, const char *name, const char *help, const char *label_name, const char *label_value);
+
+/** Release private metric.
+ */
+extern void indigo_release_metric(indigo_metric *metric);
+
+/** Increment counter (metric can be NULL).
+ */
+extern void indigo_metric_add(indigo_metric *metric, uint64_t value);
+
+/** Add time (in seconds) to histogram (metric can be NULL).
+ */
+extern void indigo_metric_observe(indigo_metric *metric, double seconds);
+
+/** Monotonic time in seconds to be used for time measurements.
+ */
+extern double indigo_metric_time(void);
+
+/** Add bytes written by current thread to the metric set by indigo_metric_set_written() (called by indigo_write()).
+ */
+extern void indigo_metric_written(long length);
+
+/** Set metric counting bytes written by current thread, previous metric is returned.
+ */
+extern indigo_metric *indigo_metric_set_written(indigo_metric *metric);
+
+/** Call function for all registered metrics.
+ */
+extern void indigo_enumerate_metrics(void (*callback)(indigo_metric *metric, void *data), void *data);
+
+/** Format all registered metrics in Prometheus text exposition format, result must be released with free().
+ */
+extern char *indigo_metrics_text(long *length);
+
+/** Resource generator for built-in HTTP server returning gzip compressed indigo_metrics_text().
+ */
+extern unsigned char *indigo_metrics_resource_generator(const char *path, unsigned *length);
+
+/** Release data returned by indigo_metrics_resource_generator() or indigo_tracing_resource_generator().
+ */
+extern void indigo_metrics_resource_release(unsigned char *data);
+
+/** Enable event tracing (off by default), use indigo_enable_tracing() to change it.
+ */
+extern bool indigo_use_tracing;
+
+/** Size of trace event ring (number of events), used when tracing is enabled for the first time.
+ */
+extern int indigo_tracing_buffer_size;
+
+/** Enable or disable event tracing, event ring is allocated on the first call and never released.
+ */
+extern void indigo_enable_tracing(bool enable);
+
+/** Record trace event (Chrome trace event format phase 'B', 'E', 'X', 'b', 'e' or 'i'), name and category must be static strings, detail is copied.
+ */
+extern void indigo_tracing_event(char phase, const char *category, const char *name, const char *detail, const void *id, double time, double duration);
+
+/** Begin scoped event on current thread.
+ */
+#define INDIGO_TRACING_BEGIN(category, name, detail) do { if (indigo_use_tracing) indigo_tracing_event('B', category, name, detail, NULL, indigo_metric_time(), 0); } while (0)
+
+/** End scoped event on current thread.
+ */
+#define INDIGO_TRACING_END(category, name) do { if (indigo_use_tracing) indigo_tracing_event('E', category, name, NULL, NULL, indigo_metric_time(), 0); } while (0)
+
+/** Record event started at start (indigo_metric_time()) and finished now.
+ */
+#define INDIGO_TRACING_COMPLETE(category, name, detail, start) do { if (indigo_use_tracing) { double now = indigo_metric_time(); indigo_tracing_event('X', category, name, detail, NULL, start, now - (start)); } } while (0)
+
+/** Begin event which can end on different thread (e.g. exposure), id identifies the event.
+ */
+#define INDIGO_TRACING_ASYNC_BEGIN(category, name, detail, id) do { if (indigo_use_tracing) indigo_tracing_event('b', category, name, detail, id, indigo_metric_time(), 0); } while (0)
+
+/** End event started with INDIGO_TRACING_ASYNC_BEGIN.
+ */
+#define INDIGO_TRACING_ASYNC_END(category, name, id) do { if (indigo_use_tracing) indigo_tracing_event('e', category, name, NULL, id, indigo_metric_time(), 0); } while (0)
+
+/** Format content of trace event ring in Chrome trace JSON format, result must be released with free().
+ */
+extern char *indigo_tracing_json(long *length);
+
+/** Save content of trace event ring in Chrome trace JSON format to file.
+ */
+extern bool indigo_tracing_save(const char *path);
+
+/** Resource generator for built-in HTTP server returning gzip compressed indigo_tracing_json().
+ */
+extern unsigned char *indigo_tracing_resource_generator(const char *path, unsigned *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* indigo_metrics_h */
@@ -460,6 +460,36 @@ typedef struct {
 	int side_of_pier;					//  East or West DEC slew?
 } indigo_alignment_point;
 
+/** Number of terms of multi point alignment model (IH, ID, CH, NP, MA, ME, TF).
+ */
+
+#define MOUNT_ALIGNMENT_MODEL_TERMS										7
+
+/** Multi point alignment model k-d tree node.
+ */
+
+typedef struct {
+	double v[3];							//  Unit vector of alignment point in HA/DEC frame
+	double dha, ddec;					//  Residual not explained by model terms in degrees
+	int side_of_pier;
+	int axis;
+	int left, right;
+} indigo_alignment_node;
+
+/** Multi point alignment model, it is fitted when alignment points change.
+ */
+
+typedef struct {
+	bool valid;
+	int term_count;
+	double terms[MOUNT_ALIGNMENT_MODEL_TERMS];	//  Model terms in degrees
+	double latitude;
+	double rms;																	//  RMS of residuals in arcseconds
+	int node_count;
+	int root;
+	indigo_alignment_node nodes[MOUNT_MAX_ALIGNMENT_POINTS];
+} indigo_alignment_model;
+
 //------------------------------------------------
 /** Mount device context structure.
  */
@@ -467,6 +497,8 @@ typedef struct {
 	indigo_device_context device_context;										///< device context base
 	int alignment_point_count;															///< number of defined alignment points
 	indigo_alignment_point alignment_points[MOUNT_MAX_ALIGNMENT_POINTS]; ///< alignment points
+	indigo_alignment_model alignment_model;									///< multi point alignment model
+	pthread_mutex_t alignment_model_mutex;									///< guards alignment model, model is fitted aside and published under it
 	indigo_property *mount_geographic_coordinates_property;	///< MOUNT_GEOGRAPHIC_COORDINATES property pointer
 	indigo_property *mount_info_property;                   ///< MOUNT_INFO property pointer
 	indigo_property *mount_lst_time_property;								///< MOUNT_LST_TIME property pointer
@@ -334,6 +334,27 @@
  */
 #define CCD_LOCAL_MODE_PREFIX_ITEM_NAME       "PREFIX"
 
+//----------------------------------------------------------------------
+/** CCD_LOCAL_SAVE_MODE property name.
+ */
+#define CCD_LOCAL_SAVE_MODE_PROPERTY_NAME     "CCD_LOCAL_SAVE_MODE"
+
+/** CCD_LOCAL_SAVE_MODE.WRITE_BEHIND property item name.
+ */
+#define CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_ITEM_NAME  "WRITE_BEHIND"
+
+/** CCD_LOCAL_SAVE_MODE.WRITE_BEHIND_FSYNC property item name.
+ */
+#define CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_FSYNC_ITEM_NAME  "WRITE_BEHIND_FSYNC"
+
+/** CCD_LOCAL_SAVE_MODE.DIRECT_IO property item name.
+ */
+#define CCD_LOCAL_SAVE_MODE_DIRECT_IO_ITEM_NAME  "DIRECT_IO"
+
+/** CCD_LOCAL_SAVE_MODE.SYNCHRONOUS property item name.
+ */
+#define CCD_LOCAL_SAVE_MODE_SYNCHRONOUS_ITEM_NAME  "SYNCHRONOUS"
+
 //----------------------------------------------------------------------
 /** CCD_EXPOSURE property name.
  */
@@ -525,6 +546,14 @@
  */
 #define CCD_IMAGE_FILE_ITEM_NAME              "FILE"
 
+/** CCD_IMAGE_FILE.THROUGHPUT property item name.
+ */
+#define CCD_IMAGE_FILE_THROUGHPUT_ITEM_NAME   "THROUGHPUT"
+
+/** CCD_IMAGE_FILE.BACKLOG property item name.
+ */
+#define CCD_IMAGE_FILE_BACKLOG_ITEM_NAME      "BACKLOG"
+
 /** CCD_IMAGE property name.
  */
 #define CCD_IMAGE_PROPERTY_NAME               "CCD_IMAGE"
@@ -2461,6 +2490,13 @@
 #define AGENT_PLATESOLVER_SYNC_SYNC_ITEM_NAME					"SYNC"
 #define AGENT_PLATESOLVER_SYNC_CENTER_ITEM_NAME				"CENTER"
 
+#define AGENT_PLATESOLVER_STATS_PROPERTY_NAME					"AGENT_PLATESOLVER_STATS"
+#define AGENT_PLATESOLVER_STATS_QUEUE_ITEM_NAME				"QUEUE"
+#define AGENT_PLATESOLVER_STATS_PROCESSED_ITEM_NAME		"PROCESSED"
+#define AGENT_PLATESOLVER_STATS_REPLACED_ITEM_NAME		"REPLACED"
+#define AGENT_PLATESOLVER_STATS_LATENCY_ITEM_NAME			"LATENCY"
+#define AGENT_PLATESOLVER_STATS_AVG_LATENCY_ITEM_NAME	"AVG_LATENCY"
+
 #define SERVER_INFO_PROPERTY_NAME											"INFO"
 #define SERVER_INFO_VERSION_ITEM_NAME									"VERSION"
 #define SERVER_INFO_SERVICE_ITEM_NAME									"SERVICE"
@@ -2497,6 +2533,60 @@
 #define SERVER_CTRL_PANEL_ITEM_NAME										"CTRL_PANEL"
 #define SERVER_WEB_APPS_ITEM_NAME											"WEB_APPS"
 
+#define SERVER_BUS_STATISTICS_PROPERTY_NAME						"BUS_STATISTICS"
+#define SERVER_BUS_BROADCASTS_ITEM_NAME								"BROADCASTS"
+#define SERVER_BUS_CONTENDED_ITEM_NAME								"CONTENDED"
+#define SERVER_BUS_CONCURRENT_ITEM_NAME								"CONCURRENT"
+#define SERVER_BUS_MAX_CONCURRENT_ITEM_NAME						"MAX_CONCURRENT"
+#define SERVER_BUS_TABLE_UPDATES_ITEM_NAME						"TABLE_UPDATES"
+#define SERVER_BUS_GRACE_WAITS_ITEM_NAME							"GRACE_WAITS"
+#define SERVER_BUS_GRACE_WAIT_TIME_ITEM_NAME					"GRACE_WAIT_TIME"
+#define SERVER_BUS_DEVICES_ITEM_NAME									"DEVICES"
+#define SERVER_BUS_CLIENTS_ITEM_NAME									"CLIENTS"
+
+#define SERVER_ASYNC_STATISTICS_PROPERTY_NAME					"ASYNC_STATISTICS"
+#define SERVER_ASYNC_POOL_SIZE_ITEM_NAME							"POOL_SIZE"
+#define SERVER_ASYNC_THREADS_ITEM_NAME								"THREADS"
+#define SERVER_ASYNC_BUSY_ITEM_NAME										"BUSY"
+#define SERVER_ASYNC_QUEUED_ITEM_NAME									"QUEUED"
+#define SERVER_ASYNC_JOBS_ITEM_NAME										"JOBS"
+#define SERVER_ASYNC_OVERFLOWS_ITEM_NAME							"OVERFLOWS"
+#define SERVER_ASYNC_QUEUE_LATENCY_ITEM_NAME					"QUEUE_LATENCY"
+#define SERVER_ASYNC_MAX_QUEUE_LATENCY_ITEM_NAME			"MAX_QUEUE_LATENCY"
+
+#define SERVER_LOG_STATISTICS_PROPERTY_NAME						"LOG_STATISTICS"
+#define SERVER_LOG_BUFFERS_ITEM_NAME									"BUFFERS"
+#define SERVER_LOG_MESSAGES_ITEM_NAME									"MESSAGES"
+#define SERVER_LOG_RATE_LIMITED_ITEM_NAME							"RATE_LIMITED"
+#define SERVER_LOG_OVERFLOWS_ITEM_NAME								"OVERFLOWS"
+#define SERVER_LOG_SYNCHRONOUS_ITEM_NAME							"SYNCHRONOUS"
+
+#define SERVER_IMAGE_POOL_PROPERTY_NAME								"IMAGE_POOL"
+#define SERVER_IMAGE_POOL_BUDGET_ITEM_NAME						"BUDGET"
+
+#define SERVER_IMAGE_POOL_STATISTICS_PROPERTY_NAME		"IMAGE_POOL_STATISTICS"
+#define SERVER_IMAGE_POOL_USED_ITEM_NAME							"USED"
+#define SERVER_IMAGE_POOL_IDLE_ITEM_NAME							"IDLE"
+#define SERVER_IMAGE_POOL_PEAK_ITEM_NAME							"PEAK"
+#define SERVER_IMAGE_POOL_BUFFERS_ITEM_NAME						"BUFFERS"
+#define SERVER_IMAGE_POOL_IDLE_BUFFERS_ITEM_NAME			"IDLE_BUFFERS"
+#define SERVER_IMAGE_POOL_ALLOCATIONS_ITEM_NAME				"ALLOCATIONS"
+#define SERVER_IMAGE_POOL_REUSES_ITEM_NAME						"REUSES"
+#define SERVER_IMAGE_POOL_EVICTIONS_ITEM_NAME					"EVICTIONS"
+#define SERVER_IMAGE_POOL_OVER_BUDGET_ITEM_NAME				"OVER_BUDGET"
+
+#define SERVER_METRICS_PROPERTY_NAME									"METRICS"
+
+#define SERVER_TRACING_PROPERTY_NAME									"TRACING"
+#define SERVER_TRACING_DISABLED_ITEM_NAME							"DISABLED"
+#define SERVER_TRACING_ENABLED_ITEM_NAME							"ENABLED"
+
+#define SERVER_TRACE_DUMP_PROPERTY_NAME								"TRACE_DUMP"
+#define SERVER_TRACE_DUMP_ITEM_NAME										"DUMP"
+
+#define SERVER_TRACE_PROPERTY_NAME										"TRACE"
+#define SERVER_TRACE_ITEM_NAME												"DATA"
+
 #define SERVER_WIFI_AP_PROPERTY_NAME									"WIFI_AP"
 #define SERVER_WIFI_AP_SSID_ITEM_NAME									"SSID"
 #define SERVER_WIFI_AP_PASSWORD_ITEM_NAME							"PASSWORD"
@@ -36,10 +36,25 @@
 extern double DELTA_T;
 extern double DELTA_UTC_UT1;
 
+/** Get local sidereal time in hours for given UTC (NULL for now) and longitude.
+ */
 extern double indigo_lst(time_t *utc, double longitude);
 extern void indigo_eq2hor(time_t *utc, double latitude, double longitude, double elevation, double ra, double dec, double *alt, double *az);
 extern void indigo_app_star(double promora, double promodec, double parallax, double rv, double *ra, double *dec);
+extern void indigo_app_star_at(time_t *utc, double promora, double promodec, double parallax, double rv, double *ra, double *dec);
 extern void indigo_topo_star(double latitude, double longitude, double elevation, double promora, double promodec, double parallax, double rv, double *ra, double *dec);
+/** Convert arrays of apparent RA/Dec (in hours and degrees) to altitude and azimuth (in degrees) for given UTC (NULL for now).
+ */
+extern void indigo_eq2hor_batch(time_t *utc, double latitude, double longitude, double elevation, int count, const double *ra, const double *dec, double *alt, double *az);
+
+/** Convert arrays of J2000 catalog RA/Dec (in hours and degrees) to apparent place in place, proper motion, parallax and radial velocity arrays can be NULL.
+ */
+extern void indigo_app_star_batch(time_t *utc, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec);
+
+/** Convert arrays of J2000 catalog RA/Dec (in hours and degrees) to topocentric place in place, proper motion, parallax and radial velocity arrays can be NULL.
+ */
+extern void indigo_topo_star_batch(time_t *utc, double latitude, double longitude, double elevation, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec);
+
 extern void indigo_topo_planet(double latitude, double longitude, double elevation, int id, double *ra, double *dec);
 
 #endif /* indigo_novas_h */
@@ -28,6 +28,7 @@
 
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_driver.h>
+#include <indigo/indigo_raw_utils.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,27 +65,49 @@ extern "C" {
 #define AGENT_PLATESOLVER_SYNC_SYNC_ITEM			(AGENT_PLATESOLVER_SYNC_PROPERTY->items+1)
 #define AGENT_PLATESOLVER_SYNC_CENTER_ITEM		(AGENT_PLATESOLVER_SYNC_PROPERTY->items+2)
 
+#define AGENT_PLATESOLVER_STATS_PROPERTY			(INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->stats_property)
+#define AGENT_PLATESOLVER_STATS_QUEUE_ITEM		(AGENT_PLATESOLVER_STATS_PROPERTY->items+0)
+#define AGENT_PLATESOLVER_STATS_PROCESSED_ITEM		(AGENT_PLATESOLVER_STATS_PROPERTY->items+1)
+#define AGENT_PLATESOLVER_STATS_REPLACED_ITEM	(AGENT_PLATESOLVER_STATS_PROPERTY->items+2)
+#define AGENT_PLATESOLVER_STATS_LATENCY_ITEM	(AGENT_PLATESOLVER_STATS_PROPERTY->items+3)
+#define AGENT_PLATESOLVER_STATS_AVG_LATENCY_ITEM	(AGENT_PLATESOLVER_STATS_PROPERTY->items+4)
+
 /** Plate solver  structure.
  */
 typedef struct {
 	indigo_device *device;
 	void *image;
 	unsigned long size;
+	unsigned long capacity;
+	double timestamp;
 } indigo_platesolver_task;
 
-/** Platesolver private data structure.
+/** Platesolver private data structure, solve is called on the worker thread for the latest queued image only.
  */
 typedef struct {
 	indigo_property *use_index_property;
 	indigo_property *hints_property;
 	indigo_property *wcs_property;
 	indigo_property *sync_mode_property;
+	indigo_property *stats_property;
 	void (*save_config)(indigo_device *);
 	void *((*solve)(indigo_platesolver_task *));
 	pthread_mutex_t mutex;
 	bool failed;
+	indigo_platesolver_task pending;
+	indigo_platesolver_task current;
+	bool pending_ready;
+	bool worker_exit;
+	int pending_fetches;
+	pthread_t worker;
+	pthread_mutex_t queue_mutex;
+	pthread_cond_t queue_cond;
 } platesolver_private_data;
 
+/** Find stars in RAW, JPEG or 8/16 bit mono FITS image binned by bin (or more to keep it under 2 Mpx), star coordinates are 0-based pixel centers in full resolution frame.
+ */
+extern bool indigo_platesolver_find_stars(void *image, unsigned long image_size, int bin, int max_stars, indigo_star_detection *stars, int *star_count, int *frame_width, int *frame_height);
+
 extern void indigo_platesolver_save_config(indigo_device *device);
 extern void indigo_platesolver_sync(indigo_device *device);
 
@@ -52,6 +52,18 @@ extern bool indigo_use_blob_buffering;
  */
 extern void indigo_server_add_resource(const char *path, unsigned char *data, unsigned length, const char *content_type);
 
+/** Resource generator, returns gzip compressed document or NULL, data must remain valid until released or while being sent if release is NULL.
+ */
+typedef unsigned char *(*indigo_server_resource_generator)(const char *path, unsigned *length);
+
+/** Release data returned by resource generator after it is sent.
+ */
+typedef void (*indigo_server_resource_release)(unsigned char *data);
+
+/** Add document generated on demand, release can be NULL.
+ */
+extern void indigo_server_add_generated_resource(const char *path, indigo_server_resource_generator generator, indigo_server_resource_release release, const char *content_type);
+
 /** Add file document.
  */
 extern void indigo_server_add_file_resource(const char *path, const char *file_name, const char *content_type);
@@ -0,0 +1,660 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO binary wire protocol parser
+ \file indigo_binary.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+
+#include <indigo/indigo_binary.h>
+#include <indigo/indigo_xml.h>
+#include <indigo/indigo_io.h>
+#include <indigo/indigo_version.h>
+#include <indigo/indigo_image_pool.h>
+
+#define PROPERTY_SIZE sizeof(indigo_property)+INDIGO_MAX_ITEMS*(sizeof(indigo_item))
+#define MAX_MESSAGE_SIZE (1024L * 1024L * 1024L)
+
+bool indigo_use_binary_protocol = false;
+
+// message encoding
+
+static void ensure_capacity(indigo_binary_buffer *buffer, long length) {
+	if (buffer->length + length > buffer->size) {
+		long size = buffer->size ? buffer->size : 1024;
+		while (size < buffer->length + length)
+			size *= 2;
+		buffer->data = indigo_safe_realloc(buffer->data, buffer->size = size);
+	}
+}
+
+void indigo_binary_begin(indigo_binary_buffer *buffer, indigo_binary_message_type type) {
+	buffer->length = 0;
+	ensure_capacity(buffer, INDIGO_BINARY_HEADER_SIZE);
+	buffer->data[0] = type;
+	buffer->length = INDIGO_BINARY_HEADER_SIZE;
+}
+
+void indigo_binary_put_u8(indigo_binary_buffer *buffer, uint8_t value) {
+	ensure_capacity(buffer, 1);
+	buffer->data[buffer->length++] = value;
+}
+
+void indigo_binary_put_u16(indigo_binary_buffer *buffer, uint16_t value) {
+	ensure_capacity(buffer, 2);
+	unsigned char *pnt = buffer->data + buffer->length;
+	pnt[0] = value >> 8;
+	pnt[1] = value;
+	buffer->length += 2;
+}
+
+void indigo_binary_put_u32(indigo_binary_buffer *buffer, uint32_t value) {
+	ensure_capacity(buffer, 4);
+	unsigned char *pnt = buffer->data + buffer->length;
+	pnt[0] = value >> 24;
+	pnt[1] = value >> 16;
+	pnt[2] = value >> 8;
+	pnt[3] = value;
+	buffer->length += 4;
+}
+
+void indigo_binary_put_u64(indigo_binary_buffer *buffer, uint64_t value) {
+	indigo_binary_put_u32(buffer, (uint32_t)(value >> 32));
+	indigo_binary_put_u32(buffer, (uint32_t)value);
+}
+
+void indigo_binary_put_double(indigo_binary_buffer *buffer, double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	indigo_binary_put_u64(buffer, bits);
+}
+
+void indigo_binary_put_string(indigo_binary_buffer *buffer, const char *string) {
+	long length = string ? strlen(string) : 0;
+	if (length > 0xFFFF)
+		length = 0xFFFF;
+	indigo_binary_put_u16(buffer, (uint16_t)length);
+	ensure_capacity(buffer, length);
+	memcpy(buffer->data + buffer->length, string, length);
+	buffer->length += length;
+}
+
+void indigo_binary_put_text(indigo_binary_buffer *buffer, const char *text) {
+	long length = text ? strlen(text) : 0;
+	indigo_binary_put_u32(buffer, (uint32_t)length);
+	ensure_capacity(buffer, length);
+	memcpy(buffer->data + buffer->length, text, length);
+	buffer->length += length;
+}
+
+bool indigo_binary_write(int handle, indigo_binary_buffer *buffer, long payload_tail) {
+	uint32_t length = (uint32_t)(buffer->length - INDIGO_BINARY_HEADER_SIZE + payload_tail);
+	buffer->data[1] = length >> 24;
+	buffer->data[2] = length >> 16;
+	buffer->data[3] = length >> 8;
+	buffer->data[4] = length;
+	return indigo_write(handle, (const char *)buffer->data, buffer->length);
+}
+
+// message decoding
+
+typedef struct {
+	unsigned char *data;
+	unsigned char *end;
+	bool error;
+} message_reader;
+
+static bool check_available(message_reader *reader, long length) {
+	if (reader->error || reader->end - reader->data < length) {
+		reader->error = true;
+		return false;
+	}
+	return true;
+}
+
+static uint8_t get_u8(message_reader *reader) {
+	if (!check_available(reader, 1))
+		return 0;
+	return *reader->data++;
+}
+
+static uint16_t get_u16(message_reader *reader) {
+	if (!check_available(reader, 2))
+		return 0;
+	uint16_t value = reader->data[0] << 8 | reader->data[1];
+	reader->data += 2;
+	return value;
+}
+
+static uint32_t get_u32(message_reader *reader) {
+	if (!check_available(reader, 4))
+		return 0;
+	uint32_t value = (uint32_t)reader->data[0] << 24 | (uint32_t)reader->data[1] << 16 | (uint32_t)reader->data[2] << 8 | reader->data[3];
+	reader->data += 4;
+	return value;
+}
+
+static uint64_t get_u64(message_reader *reader) {
+	uint64_t value = (uint64_t)get_u32(reader) << 32;
+	return value | get_u32(reader);
+}
+
+static double get_double(message_reader *reader) {
+	uint64_t bits = get_u64(reader);
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static void get_string(message_reader *reader, char *string, long size) {
+	long length = get_u16(reader);
+	*string = 0;
+	if (!check_available(reader, length))
+		return;
+	long copy = length < size ? length : size - 1;
+	memcpy(string, reader->data, copy);
+	string[copy] = 0;
+	reader->data += length;
+}
+
+typedef struct {
+	indigo_device *device;
+	indigo_client *client;
+	int count;
+	indigo_property **properties;
+	char *text;
+	long text_size;
+} parser_context;
+
+static const char *get_text(message_reader *reader, parser_context *context) {
+	long length = get_u32(reader);
+	if (!check_available(reader, length))
+		return "";
+	if (context->text_size < length + 1)
+		context->text = indigo_safe_realloc(context->text, context->text_size = length + 1);
+	memcpy(context->text, reader->data, length);
+	context->text[length] = 0;
+	reader->data += length;
+	return context->text;
+}
+
+static void get_device_name(message_reader *reader, parser_context *context, char *device_name) {
+	char value[INDIGO_NAME_SIZE];
+	get_string(reader, value, INDIGO_NAME_SIZE);
+	if (indigo_use_host_suffix && *value)
+		snprintf(device_name, INDIGO_NAME_SIZE, "%s %s", value, context->device->name);
+	else
+		indigo_copy_name(device_name, value);
+}
+
+// server side messages
+
+static void get_properties_handler(message_reader *reader, parser_context *context, indigo_property *property) {
+	indigo_client *client = context->client;
+	get_string(reader, property->device, INDIGO_NAME_SIZE);
+	get_string(reader, property->name, INDIGO_NAME_SIZE);
+	get_u16(reader); // client version, binary protocol always uses INDIGO 2.0 names
+	uint8_t flags = reader->data < reader->end ? get_u8(reader) : 0; // optional, not sent by older clients
+	if (flags & INDIGO_BINARY_FLAG_SUBSCRIBE)
+		get_string(reader, property->group, INDIGO_NAME_SIZE);
+	if (reader->error)
+		return;
+	client->version = INDIGO_VERSION_CURRENT;
+	((indigo_adapter_context *)client->client_context)->delta_updates = (flags & INDIGO_BINARY_FLAG_DELTA) != 0;
+	if (flags & INDIGO_BINARY_FLAG_SUBSCRIBE) {
+		indigo_subscribe(client, property->device, property->name, property->group);
+		// wildcards are resolved by subscription filter
+		if (strpbrk(property->device, "*?"))
+			*property->device = 0;
+		if (strpbrk(property->name, "*?"))
+			*property->name = 0;
+	}
+	indigo_enumerate_properties(client, property);
+}
+
+static void enable_blob_handler(message_reader *reader, parser_context *context, indigo_property *property) {
+	indigo_client *client = context->client;
+	get_string(reader, property->device, INDIGO_NAME_SIZE);
+	get_string(reader, property->name, INDIGO_NAME_SIZE);
+	indigo_enable_blob_mode mode = get_u8(reader);
+	if (reader->error)
+		return;
+	indigo_enable_blob_mode_record *record = client->enable_blob_mode_records;
+	indigo_enable_blob_mode_record *prev = NULL;
+	while (record) {
+		if (!strcmp(property->device, record->device) && (*record->name == 0 || !strcmp(property->name, record->name))) {
+			if (prev) {
+				prev->next = record->next;
+				free(record);
+				record = prev->next;
+			} else {
+				client->enable_blob_mode_records = record->next;
+				free(record);
+				record = client->enable_blob_mode_records;
+			}
+		} else {
+			prev = record;
+			record = record->next;
+		}
+	}
+	if (mode != INDIGO_ENABLE_BLOB_NEVER) {
+		record = indigo_safe_malloc(sizeof(indigo_enable_blob_mode_record));
+		indigo_copy_name(record->device, property->device);
+		indigo_copy_name(record->name, property->name);
+		record->mode = mode == INDIGO_ENABLE_BLOB_URL && indigo_use_blob_urls ? INDIGO_ENABLE_BLOB_URL : INDIGO_ENABLE_BLOB_ALSO;
+		record->next = client->enable_blob_mode_records;
+		client->enable_blob_mode_records = record;
+		indigo_enable_blob(client, property, record->mode);
+	} else {
+		indigo_enable_blob(client, property, INDIGO_ENABLE_BLOB_NEVER);
+	}
+}
+
+static void new_property_handler(message_reader *reader, parser_context *context, indigo_property *property) {
+	property->type = get_u8(reader);
+	property->version = INDIGO_VERSION_CURRENT;
+	get_string(reader, property->device, INDIGO_NAME_SIZE);
+	get_string(reader, property->name, INDIGO_NAME_SIZE);
+	property->access_token = get_u64(reader);
+	int count = get_u16(reader);
+	for (int i = 0; i < count && !reader->error; i++) {
+		indigo_item *item = property->items + (property->count < INDIGO_MAX_ITEMS ? property->count++ : INDIGO_MAX_ITEMS - 1);
+		get_string(reader, item->name, INDIGO_NAME_SIZE);
+		switch (property->type) {
+			case INDIGO_TEXT_VECTOR:
+				indigo_set_text_item_value(item, get_text(reader, context));
+				break;
+			case INDIGO_NUMBER_VECTOR:
+				item->number.value = get_double(reader);
+				break;
+			case INDIGO_SWITCH_VECTOR:
+				item->sw.value = get_u8(reader);
+				break;
+			default:
+				reader->error = true;
+				break;
+		}
+	}
+	if (!reader->error)
+		indigo_change_property(context->client, property);
+}
+
+// client side messages
+
+static void release_property(indigo_property *property) {
+	if (property->type == INDIGO_BLOB_VECTOR) {
+		for (int i = 0; i < property->count; i++) {
+			indigo_release_image_buffer(property->items[i].blob.value);
+		}
+	}
+	indigo_release_property(property);
+}
+
+static void def_property_handler(message_reader *reader, parser_context *context, indigo_property *other) {
+	char message[INDIGO_VALUE_SIZE];
+	uint32_t id = get_u32(reader);
+	other->type = get_u8(reader);
+	get_device_name(reader, context, other->device);
+	get_string(reader, other->name, INDIGO_NAME_SIZE);
+	get_string(reader, other->group, INDIGO_NAME_SIZE);
+	get_string(reader, other->label, INDIGO_VALUE_SIZE);
+	get_string(reader, other->hints, INDIGO_VALUE_SIZE);
+	other->state = get_u8(reader);
+	other->perm = get_u8(reader);
+	other->rule = get_u8(reader);
+	get_string(reader, message, INDIGO_VALUE_SIZE);
+	int count = get_u16(reader);
+	if (count > INDIGO_MAX_ITEMS || id > 0xFFFFF)
+		reader->error = true;
+	for (int i = 0; i < count && !reader->error; i++) {
+		indigo_item *item = other->items + other->count++;
+		get_string(reader, item->name, INDIGO_NAME_SIZE);
+		get_string(reader, item->label, INDIGO_VALUE_SIZE);
+		get_string(reader, item->hints, INDIGO_VALUE_SIZE);
+		switch (other->type) {
+			case INDIGO_TEXT_VECTOR:
+				indigo_set_text_item_value(item, get_text(reader, context));
+				break;
+			case INDIGO_NUMBER_VECTOR:
+				get_string(reader, item->number.format, INDIGO_VALUE_SIZE);
+				item->number.min = get_double(reader);
+				item->number.max = get_double(reader);
+				item->number.step = get_double(reader);
+				item->number.value = get_double(reader);
+				item->number.target = get_double(reader);
+				break;
+			case INDIGO_SWITCH_VECTOR:
+				item->sw.value = get_u8(reader);
+				break;
+			case INDIGO_LIGHT_VECTOR:
+				item->light.value = get_u8(reader);
+				break;
+			case INDIGO_BLOB_VECTOR:
+				break;
+		}
+	}
+	if (reader->error)
+		return;
+	if (id >= context->count) {
+		int count = context->count;
+		while (count <= id)
+			count *= 2;
+		context->properties = indigo_safe_realloc(context->properties, count * sizeof(indigo_property *));
+		memset(context->properties + context->count, 0, (count - context->count) * sizeof(indigo_property *));
+		context->count = count;
+	}
+	indigo_property *property = context->properties[id];
+	if (property != NULL && (strncmp(property->device, other->device, INDIGO_NAME_SIZE) || strncmp(property->name, other->name, INDIGO_NAME_SIZE) || property->type != other->type || property->count != other->count)) {
+		indigo_delete_property(context->device, property, NULL);
+		release_property(property);
+		property = NULL;
+	}
+	if (property == NULL) {
+		switch (other->type) {
+			case INDIGO_TEXT_VECTOR:
+				property = indigo_init_text_property(NULL, other->device, other->name, other->group, other->label, other->state, other->perm, other->count);
+				break;
+			case INDIGO_NUMBER_VECTOR:
+				property = indigo_init_number_property(NULL, other->device, other->name, other->group, other->label, other->state, other->perm, other->count);
+				break;
+			case INDIGO_SWITCH_VECTOR:
+				property = indigo_init_switch_property(NULL, other->device, other->name, other->group, other->label, other->state, other->perm, other->rule, other->count);
+				break;
+			case INDIGO_LIGHT_VECTOR:
+				property = indigo_init_light_property(NULL, other->device, other->name, other->group, other->label, other->state, other->count);
+				break;
+			case INDIGO_BLOB_VECTOR:
+				property = indigo_init_blob_property(NULL, other->device, other->name, other->group, other->label, other->state, other->count);
+				break;
+			default:
+				return;
+		}
+		memcpy(property->items, other->items, other->count * sizeof(indigo_item));
+		if (other->type == INDIGO_TEXT_VECTOR) {
+			for (int i = 0; i < property->count; i++)
+				other->items[i].text.long_value = NULL;
+		}
+		indigo_copy_value(property->hints, other->hints);
+		context->properties[id] = property;
+	} else {
+		if (property->type == INDIGO_TEXT_VECTOR) {
+			for (int i = 0; i < property->count; i++) {
+				if (property->items[i].text.long_value)
+					free(property->items[i].text.long_value);
+			}
+		}
+		if (property->type != INDIGO_BLOB_VECTOR)
+			memcpy(property->items, other->items, other->count * sizeof(indigo_item));
+		if (other->type == INDIGO_TEXT_VECTOR) {
+			for (int i = 0; i < property->count; i++)
+				other->items[i].text.long_value = NULL;
+		}
+		property->state = other->state;
+	}
+	INDIGO_TRACE_PARSER(indigo_trace("Binary Parser: def_property '%s' '%s' %d", property->device, property->name, id));
+	indigo_define_property(context->device, property, *message ? message : NULL);
+}
+
+static void set_property_handler(message_reader *reader, parser_context *context) {
+	char message[INDIGO_VALUE_SIZE];
+	uint32_t id = get_u32(reader);
+	indigo_property_state state = get_u8(reader);
+	get_string(reader, message, INDIGO_VALUE_SIZE);
+	int count = get_u16(reader);
+	if (reader->error || id >= context->count || context->properties[id] == NULL)
+		return;
+	indigo_property *property = context->properties[id];
+	property->state = state;
+	if (property->type == INDIGO_SWITCH_VECTOR && property->rule != INDIGO_ANY_OF_MANY_RULE) {
+		for (int j = 0; j < property->count; j++)
+			property->items[j].sw.value = false;
+	}
+	indigo_binary_blob_kind kinds[INDIGO_MAX_ITEMS] = { INDIGO_BINARY_BLOB_NONE };
+	for (int i = 0; i < count && !reader->error; i++) {
+		int index = get_u16(reader);
+		if (index >= property->count) {
+			reader->error = true;
+			break;
+		}
+		indigo_item *item = property->items + index;
+		switch (property->type) {
+			case INDIGO_TEXT_VECTOR:
+				indigo_set_text_item_value(item, get_text(reader, context));
+				break;
+			case INDIGO_NUMBER_VECTOR:
+				item->number.value = get_double(reader);
+				item->number.target = get_double(reader);
+				break;
+			case INDIGO_SWITCH_VECTOR:
+				item->sw.value = get_u8(reader);
+				break;
+			case INDIGO_LIGHT_VECTOR:
+				item->light.value = get_u8(reader);
+				break;
+			case INDIGO_BLOB_VECTOR: {
+				char value[INDIGO_VALUE_SIZE];
+				kinds[index] = get_u8(reader);
+				get_string(reader, item->blob.format, INDIGO_NAME_SIZE);
+				uint64_t size = get_u64(reader);
+				// raw data must fit into the rest of the message, size is checked before anything is allocated
+				if (size > LONG_MAX || (kinds[index] == INDIGO_BINARY_BLOB_DATA && size > (uint64_t)(reader->end - reader->data))) {
+					reader->error = true;
+					break;
+				}
+				item->blob.size = (long)size;
+				if (kinds[index] == INDIGO_BINARY_BLOB_PATH) {
+					get_string(reader, value, INDIGO_VALUE_SIZE);
+					snprintf(item->blob.url, INDIGO_VALUE_SIZE, "%s%s", ((indigo_adapter_context *)context->device->device_context)->url_prefix, value);
+				} else if (kinds[index] == INDIGO_BINARY_BLOB_URL) {
+					get_string(reader, item->blob.url, INDIGO_VALUE_SIZE);
+				} else {
+					*item->blob.url = 0;
+				}
+				break;
+			}
+		}
+	}
+	if (property->type == INDIGO_BLOB_VECTOR) {
+		// raw data of BLOB items follow metadata in item order
+		for (int i = 0; i < property->count && !reader->error; i++) {
+			indigo_item *item = property->items + i;
+			if (kinds[i] == INDIGO_BINARY_BLOB_DATA) {
+				if (!check_available(reader, item->blob.size))
+					break;
+				// cached value is a pool buffer, client may still hold a reference to the previous one
+				indigo_release_image_buffer(item->blob.value);
+				item->blob.value = indigo_alloc_image_buffer(item->blob.size);
+				assert(item->blob.value != NULL);
+				memcpy(item->blob.value, reader->data, item->blob.size);
+				reader->data += item->blob.size;
+			} else if (kinds[i] != INDIGO_BINARY_BLOB_NONE) {
+				indigo_release_image_buffer(item->blob.value);
+				item->blob.value = NULL;
+				// as in XML, size is known only after the content is fetched from url
+				item->blob.size = 0;
+				char *ext = strrchr(item->blob.url, '.');
+				if (ext && *item->blob.format == 0)
+					indigo_copy_name(item->blob.format, ext);
+			}
+		}
+	}
+	if (reader->error)
+		return;
+	INDIGO_TRACE_PARSER(indigo_trace("Binary Parser: set_property '%s' '%s' %d", property->device, property->name, id));
+	indigo_update_property(context->device, property, *message ? message : NULL);
+}
+
+static void del_property_handler(message_reader *reader, parser_context *context) {
+	char device_name[INDIGO_NAME_SIZE], name[INDIGO_NAME_SIZE], message[INDIGO_VALUE_SIZE];
+	get_device_name(reader, context, device_name);
+	get_string(reader, name, INDIGO_NAME_SIZE);
+	get_string(reader, message, INDIGO_VALUE_SIZE);
+	if (reader->error)
+		return;
+	for (int i = 0; i < context->count; i++) {
+		indigo_property *property = context->properties[i];
+		if (property != NULL && !strncmp(property->device, device_name, INDIGO_NAME_SIZE) && (*name == 0 || !strncmp(property->name, name, INDIGO_NAME_SIZE))) {
+			indigo_delete_property(context->device, property, *message ? message : NULL);
+			release_property(property);
+			context->properties[i] = NULL;
+		}
+	}
+}
+
+static void message_handler(message_reader *reader, parser_context *context) {
+	char device_name[INDIGO_NAME_SIZE], message[INDIGO_VALUE_SIZE];
+	get_device_name(reader, context, device_name);
+	get_string(reader, message, INDIGO_VALUE_SIZE);
+	if (reader->error)
+		return;
+	char text[INDIGO_NAME_SIZE + INDIGO_VALUE_SIZE + 2];
+	if (*device_name)
+		snprintf(text, sizeof(text), "%s: %s", device_name, message);
+	else
+		indigo_copy_value(text, message);
+	indigo_send_message(context->device, *text ? text : NULL);
+}
+
+void indigo_binary_parse(indigo_device *device, indigo_client *client) {
+	indigo_adapter_context *adapter_context = NULL;
+	if (device != NULL) {
+		adapter_context = (indigo_adapter_context *)device->device_context;
+	} else if (client != NULL) {
+		adapter_context = (indigo_adapter_context *)client->client_context;
+	}
+	assert(adapter_context != NULL);
+	int handle = adapter_context->input;
+	parser_context *context = indigo_safe_malloc(sizeof(parser_context));
+	context->device = device;
+	context->client = client;
+	context->count = 32;
+	context->properties = indigo_safe_malloc(context->count * sizeof(indigo_property *));
+	indigo_property *property = indigo_safe_malloc(PROPERTY_SIZE);
+	long buffer_size = 64 * 1024;
+	unsigned char *buffer = indigo_safe_malloc(buffer_size);
+	unsigned char header[INDIGO_BINARY_HEADER_SIZE];
+	if (client != NULL) {
+		if (indigo_read(handle, (char *)header, INDIGO_BINARY_SIGNATURE_SIZE) <= 0 || memcmp(header, INDIGO_BINARY_SIGNATURE, INDIGO_BINARY_SIGNATURE_SIZE)) {
+			indigo_error("Binary Parser: invalid signature");
+			goto exit_loop;
+		}
+	}
+	while (true) {
+		if (indigo_read(handle, (char *)header, INDIGO_BINARY_HEADER_SIZE) <= 0)
+			goto exit_loop;
+		long length = (uint32_t)header[1] << 24 | (uint32_t)header[2] << 16 | (uint32_t)header[3] << 8 | header[4];
+		if (length > MAX_MESSAGE_SIZE) {
+			indigo_error("Binary Parser: message too long (%ld bytes)", length);
+			goto exit_loop;
+		}
+		if (length > buffer_size)
+			buffer = indigo_safe_realloc(buffer, buffer_size = length);
+		if (length > 0 && indigo_read(handle, (char *)buffer, length) <= 0)
+			goto exit_loop;
+		INDIGO_TRACE_PROTOCOL(indigo_trace("%d → message %d, %ld bytes", handle, header[0], length));
+		message_reader reader = { buffer, buffer + length, false };
+		memset(property, 0, PROPERTY_SIZE);
+		if (client != NULL) {
+			switch (header[0]) {
+				case INDIGO_BINARY_GET_PROPERTIES:
+					get_properties_handler(&reader, context, property);
+					break;
+				case INDIGO_BINARY_ENABLE_BLOB:
+					enable_blob_handler(&reader, context, property);
+					break;
+				case INDIGO_BINARY_NEW_PROPERTY:
+					new_property_handler(&reader, context, property);
+					break;
+				default:
+					reader.error = true;
+					break;
+			}
+		} else {
+			switch (header[0]) {
+				case INDIGO_BINARY_DEF_PROPERTY:
+					def_property_handler(&reader, context, property);
+					break;
+				case INDIGO_BINARY_SET_PROPERTY:
+					set_property_handler(&reader, context);
+					break;
+				case INDIGO_BINARY_DEL_PROPERTY:
+					del_property_handler(&reader, context);
+					break;
+				case INDIGO_BINARY_MESSAGE:
+					message_handler(&reader, context);
+					break;
+				default:
+					reader.error = true;
+					break;
+			}
+		}
+		if (property->type == INDIGO_TEXT_VECTOR) {
+			for (int i = 0; i < property->count; i++) {
+				indigo_item *item = property->items + i;
+				if (item->text.long_value)
+					free(item->text.long_value);
+			}
+		}
+		if (reader.error) {
+			indigo_error("Binary Parser: malformed message %d (%ld bytes)", header[0], length);
+			goto exit_loop;
+		}
+	}
+exit_loop:
+	while (true) {
+		indigo_property *property = NULL;
+		int index;
+		for (index = 0; index < context->count; index++) {
+			property = context->properties[index];
+			if (property != NULL)
+				break;
+		}
+		if (property == NULL)
+			break;
+		indigo_device remote_device;
+		indigo_copy_name(remote_device.name, property->device);
+		remote_device.version = property->version;
+		indigo_property *all_properties = indigo_init_text_property(NULL, remote_device.name, "", "", "", INDIGO_OK_STATE, INDIGO_RO_PERM, 0);
+		indigo_delete_property(&remote_device, all_properties, NULL);
+		indigo_release_property(all_properties);
+		for (; index < context->count; index++) {
+			indigo_property *property = context->properties[index];
+			if (property != NULL && !strncmp(remote_device.name, property->device, INDIGO_NAME_SIZE)) {
+				release_property(property);
+				context->properties[index] = NULL;
+			}
+		}
+	}
+	indigo_safe_free(context->properties);
+	indigo_safe_free(context->text);
+	free(context);
+	free(property);
+	free(buffer);
+	close(handle);
+	INDIGO_TRACE_PARSER(indigo_trace("Binary Parser: parser finished"));
+}
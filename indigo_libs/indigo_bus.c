@@ -30,10 +30,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <time.h>
 #include <math.h>
 #include <assert.h>
+#include <errno.h>
 #include <pthread.h>
 #if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
 #include <sys/time.h>
@@ -46,12 +48,15 @@
 #include <winsock2.h>
 #pragma warning(disable:4996)
 #define strcasecmp stricmp
+#define strncasecmp strnicmp
 #endif
 
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_names.h>
 #include <indigo/indigo_io.h>
 #include <indigo/indigo_token.h>
+#include <indigo/indigo_metrics.h>
+#include <indigo/indigo_image_pool.h>
 
 #define MAX_DEVICES 256
 #define MAX_CLIENTS 256
@@ -59,20 +64,246 @@
 
 #define BUFFER_SIZE	1024
 
-static indigo_device *devices[MAX_DEVICES];
-static indigo_client *clients[MAX_CLIENTS];
+// Devices and clients are kept in immutable compact tables replaced on attach/detach (copy-on-write).
+// Broadcasts take a reference to current table without any lock, so they run concurrently and do not block attach/detach.
+// Replaced tables are retired and released when the last reader leaves them and no reader is about to take a reference.
+
+typedef struct bus_table {
+	struct bus_table *next;	// link in retired tables list
+	int readers;
+	int parked;							// readers blocked in attach/detach of their own
+	bool retired;
+	int count;
+	void *entries[];
+} bus_table;
+
+typedef struct bus_reader {
+	bus_table **source;
+	bus_table *table;
+	struct bus_reader *next;
+} bus_reader;
+
+static bus_table empty_device_table, empty_client_table;
+static bus_table *device_table = &empty_device_table;
+static bus_table *client_table = &empty_client_table;
+static bus_table *retired_tables = NULL;
+static int entering_readers = 0;		// readers between loading table pointer and taking reference
+static pthread_mutex_t table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t table_cond = PTHREAD_COND_INITIALIZER;
+static pthread_key_t reader_key;
+static pthread_key_t callback_key;	// depth of callback_mutex held by the thread
+static pthread_once_t reader_key_once = PTHREAD_ONCE_INIT;
+static indigo_bus_statistics statistics;
+static int active_threads = 0;
+
 static indigo_blob_entry *blobs[MAX_BLOBS];
 
 static pthread_mutex_t bus_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
-#define client_mutex bus_mutex
-#define device_mutex bus_mutex
+
+// With strict locking callbacks of local devices and clients are serialized as they always were, wire protocol adapters of remote
+// devices and clients serialize writes on their own.
+static pthread_mutex_t callback_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
 
 bool indigo_use_strict_locking = true;
 
 static pthread_mutex_t blob_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t subscription_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static bool is_started = false;
 
+static void create_reader_key(void) {
+	pthread_key_create(&reader_key, NULL);
+	pthread_key_create(&callback_key, NULL);
+}
+
+static bool callback_lock(bool is_remote) {
+	if (is_remote || !indigo_use_strict_locking)
+		return false;
+	pthread_once(&reader_key_once, create_reader_key);
+	pthread_mutex_lock(&callback_mutex);
+	pthread_setspecific(callback_key, (void *)((intptr_t)pthread_getspecific(callback_key) + 1));
+	return true;
+}
+
+static void callback_unlock(bool locked) {
+	if (locked) {
+		pthread_setspecific(callback_key, (void *)((intptr_t)pthread_getspecific(callback_key) - 1));
+		pthread_mutex_unlock(&callback_mutex);
+	}
+}
+
+static bool holds_callback_lock(void) {
+	pthread_once(&reader_key_once, create_reader_key);
+	return pthread_getspecific(callback_key) != NULL;
+}
+
+static void free_retired_tables(void) {
+	// called with table_mutex locked
+	if (__atomic_load_n(&entering_readers, __ATOMIC_SEQ_CST))
+		return;
+	bus_table **link = &retired_tables;
+	while (*link) {
+		bus_table *table = *link;
+		if (__atomic_load_n(&table->readers, __ATOMIC_SEQ_CST) == 0) {
+			*link = table->next;
+			free(table);
+		} else {
+			link = &table->next;
+		}
+	}
+}
+
+static bus_table *bus_read_lock(bus_table **source, bus_reader *reader) {
+	pthread_once(&reader_key_once, create_reader_key);
+	reader->next = pthread_getspecific(reader_key);
+	__atomic_add_fetch(&statistics.broadcasts, 1, __ATOMIC_RELAXED);
+	if (reader->next == NULL) {
+		// nested broadcasts (e.g. define_property called from enumerate_properties) are not counted as concurrent
+		int active = __atomic_add_fetch(&active_threads, 1, __ATOMIC_RELAXED);
+		if (active > 1)
+			__atomic_add_fetch(&statistics.concurrent, 1, __ATOMIC_RELAXED);
+		int max = __atomic_load_n(&statistics.max_concurrent, __ATOMIC_RELAXED);
+		while (active > max && !__atomic_compare_exchange_n(&statistics.max_concurrent, &max, active, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			;
+	}
+	__atomic_add_fetch(&entering_readers, 1, __ATOMIC_SEQ_CST);
+	bus_table *table;
+	while (true) {
+		table = __atomic_load_n(source, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&table->readers, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(source, __ATOMIC_SEQ_CST) == table)
+			break;
+		// table was replaced meanwhile, retired table is not released while entering_readers > 0
+		__atomic_sub_fetch(&table->readers, 1, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&statistics.contended, 1, __ATOMIC_RELAXED);
+	}
+	__atomic_sub_fetch(&entering_readers, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&retired_tables, __ATOMIC_SEQ_CST)) {
+		// retired tables could not be released by update or last reader because of this reader
+		pthread_mutex_lock(&table_mutex);
+		free_retired_tables();
+		pthread_mutex_unlock(&table_mutex);
+	}
+	reader->source = source;
+	reader->table = table;
+	pthread_setspecific(reader_key, reader);
+	return table;
+}
+
+static void bus_read_unlock(bus_reader *reader) {
+	pthread_setspecific(reader_key, reader->next);
+	if (reader->next == NULL)
+		__atomic_sub_fetch(&active_threads, 1, __ATOMIC_RELAXED);
+	bus_table *table = reader->table;
+	__atomic_sub_fetch(&table->readers, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&table->retired, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&table_mutex);
+		free_retired_tables();
+		pthread_cond_broadcast(&table_cond);
+		pthread_mutex_unlock(&table_mutex);
+	}
+}
+
+static bool bus_is_live(bus_reader *reader, void *entry) {
+	// entries detached while broadcast is running (e.g. from its own callback) are skipped
+	if (!__atomic_load_n(&reader->table->retired, __ATOMIC_SEQ_CST))
+		return true;
+	bool result = false;
+	pthread_mutex_lock(&table_mutex);
+	bus_table *table = *reader->source;
+	for (int i = 0; i < table->count; i++) {
+		if (table->entries[i] == entry) {
+			result = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&table_mutex);
+	return result;
+}
+
+static void park_readers(int delta) {
+	for (bus_reader *reader = pthread_getspecific(reader_key); reader; reader = reader->next)
+		reader->table->parked += delta;
+}
+
+static bool bus_table_update(bus_table **source, void *entry, bool add, int max) {
+	pthread_once(&reader_key_once, create_reader_key);
+	pthread_mutex_lock(&table_mutex);
+	bus_table *old_table = *source;
+	int index = -1;
+	for (int i = 0; i < old_table->count; i++) {
+		if (old_table->entries[i] == entry) {
+			index = i;
+			break;
+		}
+	}
+	if ((add && (index >= 0 || old_table->count >= max)) || (!add && index < 0)) {
+		pthread_mutex_unlock(&table_mutex);
+		return add && index >= 0;
+	}
+	int count = add ? old_table->count + 1 : old_table->count - 1;
+	bus_table *new_table = indigo_safe_malloc(sizeof(bus_table) + count * sizeof(void *));
+	if (add) {
+		memcpy(new_table->entries, old_table->entries, old_table->count * sizeof(void *));
+		new_table->entries[old_table->count] = entry;
+	} else {
+		memcpy(new_table->entries, old_table->entries, index * sizeof(void *));
+		memcpy(new_table->entries + index, old_table->entries + index + 1, (old_table->count - index - 1) * sizeof(void *));
+	}
+	new_table->count = count;
+	__atomic_store_n(source, new_table, __ATOMIC_SEQ_CST);
+	statistics.table_updates++;
+	if (old_table != &empty_device_table && old_table != &empty_client_table) {
+		__atomic_store_n(&old_table->retired, true, __ATOMIC_SEQ_CST);
+		old_table->next = retired_tables;
+		__atomic_store_n(&retired_tables, old_table, __ATOMIC_SEQ_CST);
+		free_retired_tables();
+	}
+	// detach called from callback (e.g. local client detaching client or unloading driver) doesn't wait, readers of other threads may be
+	// blocked on callback lock held by this thread - retired table is released by its last reader and readers recheck the entry after locking
+	if (!add && !holds_callback_lock()) {
+		// grace period - wait for broadcasts in other threads still using retired tables, so detached entry can be released
+		struct timeval start, end;
+		gettimeofday(&start, NULL);
+		bool waited = false;
+		park_readers(1);
+		pthread_cond_broadcast(&table_cond);
+		while (true) {
+			bool busy = false;
+			for (bus_table *table = retired_tables; table; table = table->next) {
+				if (__atomic_load_n(&table->readers, __ATOMIC_SEQ_CST) > table->parked) {
+					busy = true;
+					break;
+				}
+			}
+			if (!busy)
+				break;
+			waited = true;
+			pthread_cond_wait(&table_cond, &table_mutex);
+		}
+		park_readers(-1);
+		if (waited) {
+			gettimeofday(&end, NULL);
+			statistics.grace_waits++;
+			statistics.grace_wait_time += (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+		}
+	}
+	pthread_mutex_unlock(&table_mutex);
+	return true;
+}
+
+void indigo_get_bus_statistics(indigo_bus_statistics *result) {
+	pthread_mutex_lock(&table_mutex);
+	*result = statistics;
+	result->broadcasts = __atomic_load_n(&statistics.broadcasts, __ATOMIC_RELAXED);
+	result->contended = __atomic_load_n(&statistics.contended, __ATOMIC_RELAXED);
+	result->concurrent = __atomic_load_n(&statistics.concurrent, __ATOMIC_RELAXED);
+	result->max_concurrent = __atomic_load_n(&statistics.max_concurrent, __ATOMIC_RELAXED);
+	result->devices = device_table->count;
+	result->clients = client_table->count;
+	pthread_mutex_unlock(&table_mutex);
+}
+
 char *indigo_property_type_text[] = {
 	"UNDEFINED",
 	"TEXT",
@@ -113,6 +344,7 @@ void (*indigo_log_message_handler)(const char *message) = NULL;
 char indigo_local_service_name[INDIGO_NAME_SIZE] = "";
 bool indigo_reshare_remote_devices = false;
 bool indigo_use_host_suffix = true;
+bool indigo_use_delta_updates = false;
 bool indigo_is_sandboxed = false;
 bool indigo_use_blob_caching = false;
 bool indigo_proxy_blob = false;
@@ -162,17 +394,23 @@ int clock_gettime(clockid_t clk_id, struct timespec *ts) {
 }
 #endif
 
-void indigo_log_message(const char *format, va_list args) {
-	static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
-	pthread_mutex_lock(&log_mutex);
-	if (indigo_last_message == NULL) {
-		indigo_last_message = indigo_safe_malloc(LOG_MESSAGE_SIZE);
-		atexit(free_log_buffers);
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define LOG_OUTPUT_SIZE	(64 * 1024)
+
+static char log_output[LOG_OUTPUT_SIZE];
+static int log_output_length = 0;
+
+static void flush_log_output(void) {
+	if (log_output_length > 0) {
+		fwrite(log_output, 1, log_output_length, stderr);
+		log_output_length = 0;
 	}
-	vsnprintf(indigo_last_message, LOG_MESSAGE_SIZE, format, args);
-	char *line = indigo_last_message;
+}
+
+static void write_log_message(struct timeval *tmnow, char *line) {
 	if (indigo_log_message_handler != NULL) {
-		indigo_log_message_handler(indigo_last_message);
+		indigo_log_message_handler(line);
 #if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
   } else if (indigo_use_syslog) {
 		static bool initialize = true;
@@ -182,9 +420,8 @@ void indigo_log_message(const char *format, va_list args) {
 			char *eol = strchr(line, '\n');
 			if (eol)
 				*eol = 0;
-			if (eol > line)
-				syslog (LOG_NOTICE, "%s", indigo_last_message);
-			syslog (LOG_NOTICE, "%s", line);
+			if (*line)
+				syslog (LOG_NOTICE, "%s", line);
 			if (eol)
 				line = eol + 1;
 			else
@@ -192,26 +429,29 @@ void indigo_log_message(const char *format, va_list args) {
 		}
 #endif
 	} else {
-		char timestamp[16];
-		struct timeval tmnow;
-		gettimeofday(&tmnow, NULL);
+		static char timestamp[16];
+		static time_t timestamp_sec = 0;
+		if (tmnow->tv_sec != timestamp_sec) {
+			// localtime() and strftime() are called once per second only
+			timestamp_sec = tmnow->tv_sec;
 #if defined(INDIGO_WINDOWS)
-		struct tm *lt;
-		time_t rawtime;
-		lt = localtime((const time_t *) &(tmnow.tv_sec));
-		if (lt == NULL) {
-			time(&rawtime);
-			lt = localtime(&rawtime);
-		}
-		strftime (timestamp, 9, "%H:%M:%S", lt);
+			struct tm *lt;
+			time_t rawtime;
+			lt = localtime((const time_t *) &(tmnow->tv_sec));
+			if (lt == NULL) {
+				time(&rawtime);
+				lt = localtime(&rawtime);
+			}
+			strftime (timestamp, 9, "%H:%M:%S", lt);
 #else
-		strftime (timestamp, 9, "%H:%M:%S", localtime((const time_t *) &tmnow.tv_sec));
+			struct tm lt;
+			strftime (timestamp, 9, "%H:%M:%S", localtime_r((const time_t *) &tmnow->tv_sec, &lt));
 #endif
-
+		}
 #ifdef INDIGO_MACOS
-		snprintf(timestamp + 8, sizeof(timestamp) - 8, ".%06d", tmnow.tv_usec);
+		snprintf(timestamp + 8, sizeof(timestamp) - 8, ".%06d", tmnow->tv_usec);
 #else
-		snprintf(timestamp + 8, sizeof(timestamp) - 8, ".%06ld", tmnow.tv_usec);
+		snprintf(timestamp + 8, sizeof(timestamp) - 8, ".%06ld", tmnow->tv_usec);
 #endif
 		if (indigo_log_name[0] == '\0') {
 			if (indigo_main_argc == 0) {
@@ -234,21 +474,330 @@ void indigo_log_message(const char *format, va_list args) {
 			char *eol = strchr(line, '\n');
 			if (eol)
 				*eol = 0;
-			if (*line)
-				fprintf(stderr, "%s %s: %s\n", timestamp, indigo_log_name, line);
+			if (*line) {
+				// lines are collected and written to stderr by flush_log_output() to avoid a syscall per line
+				int length = snprintf(log_output + log_output_length, LOG_OUTPUT_SIZE - log_output_length, "%s %s: %s\n", timestamp, indigo_log_name, line);
+				if (log_output_length + length >= LOG_OUTPUT_SIZE) {
+					flush_log_output();
+					length = snprintf(log_output, LOG_OUTPUT_SIZE, "%s %s: %s\n", timestamp, indigo_log_name, line);
+					if (length >= LOG_OUTPUT_SIZE) {
+						fprintf(stderr, "%s %s: %s\n", timestamp, indigo_log_name, line);
+						length = 0;
+					}
+				}
+				log_output_length += length;
+			}
 			if (eol)
 				line = eol + 1;
 			else
 				line = NULL;
 		}
 	}
+}
+
+// Asynchronous logging - every thread writes formatted messages to its own single producer/single consumer ring,
+// log writer thread (or any thread holding log_mutex) merges them by sequence number and writes them out.
+
+#define LOG_RING_SIZE		(64 * 1024)
+#define LOG_RECORD_SIZE	(16 * 1024)
+
+bool indigo_use_async_log = false;
+int indigo_log_rate_limit = 0;
+
+typedef struct {
+	uint32_t size;										// record size including header, 0 = skip to the beginning of ring
+	uint32_t level;
+	uint64_t sequence;
+	struct timeval timestamp;
+	char text[];
+} log_record;
+
+typedef struct log_ring {
+	struct log_ring *next;
+	uint64_t head;										// written by producer only
+	uint64_t tail;										// written by consumer only
+	bool retired;
+	unsigned long messages;
+	unsigned long rate_limited;
+	unsigned long overflows;
+	unsigned long synchronous;
+	double tokens;
+	double refill_time;
+	char scratch[LOG_RECORD_SIZE];
+	char data[LOG_RING_SIZE];
+} log_ring;
+
+static log_ring *log_rings = NULL;
+static pthread_mutex_t log_rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t log_last_message_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_key_t log_ring_key;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static bool log_writer_running = false;
+static bool log_writer_sleeping = false;
+static uint64_t log_sequence = 0;
+static indigo_log_statistics log_retired_statistics = { 0 };
+static unsigned long log_reported_drops = 0;
+
+static void retire_log_ring(void *data) {
+	__atomic_store_n(&((log_ring *)data)->retired, true, __ATOMIC_RELEASE);
+}
+
+static log_record *peek_log_ring(log_ring *ring) {
+	uint64_t tail = ring->tail;
+	uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	if (tail == head)
+		return NULL;
+	log_record *record = (log_record *)(ring->data + tail % LOG_RING_SIZE);
+	if (record->size == 0) {
+		tail += LOG_RING_SIZE - tail % LOG_RING_SIZE;
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		if (tail == head)
+			return NULL;
+		record = (log_record *)ring->data;
+	}
+	return record;
+}
+
+static bool push_log_ring(log_ring *ring, int level, struct timeval *timestamp, int length) {
+	uint32_t size = (uint32_t)((sizeof(log_record) + length + 1 + 7) & ~7);
+	uint64_t head = ring->head;
+	uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	uint32_t offset = head % LOG_RING_SIZE;
+	uint32_t skip = offset + size > LOG_RING_SIZE ? LOG_RING_SIZE - offset : 0;
+	if (head + skip + size - tail > LOG_RING_SIZE)
+		return false;
+	if (skip) {
+		((log_record *)(ring->data + offset))->size = 0;
+		offset = 0;
+	}
+	log_record *record = (log_record *)(ring->data + offset);
+	record->size = size;
+	record->level = level;
+	record->timestamp = *timestamp;
+	record->sequence = __atomic_fetch_add(&log_sequence, 1, __ATOMIC_RELAXED);
+	memcpy(record->text, ring->scratch, length + 1);
+	__atomic_store_n(&ring->head, head + skip + size, __ATOMIC_RELEASE);
+	return true;
+}
+
+static void collect_log_statistics(indigo_log_statistics *statistics) {
+	*statistics = log_retired_statistics;
+	for (log_ring *ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		statistics->buffers++;
+		statistics->messages += __atomic_load_n(&ring->messages, __ATOMIC_RELAXED);
+		statistics->rate_limited += __atomic_load_n(&ring->rate_limited, __ATOMIC_RELAXED);
+		statistics->overflows += __atomic_load_n(&ring->overflows, __ATOMIC_RELAXED);
+		statistics->synchronous += __atomic_load_n(&ring->synchronous, __ATOMIC_RELAXED);
+	}
+}
+
+// called with log_mutex locked, messages logged after the call started are left for the next call
+static void drain_log_rings(void) {
+	uint64_t last_sequence = __atomic_load_n(&log_sequence, __ATOMIC_ACQUIRE);
+	while (true) {
+		log_ring *first_ring = NULL;
+		log_record *first_record = NULL;
+		for (log_ring *ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+			log_record *record = peek_log_ring(ring);
+			if (record != NULL && (first_record == NULL || record->sequence < first_record->sequence)) {
+				first_ring = ring;
+				first_record = record;
+			}
+		}
+		if (first_ring == NULL || first_record->sequence >= last_sequence)
+			break;
+		write_log_message(&first_record->timestamp, first_record->text);
+		__atomic_store_n(&first_ring->tail, first_ring->tail + first_record->size, __ATOMIC_RELEASE);
+	}
+	indigo_log_statistics statistics;
+	pthread_mutex_lock(&log_rings_mutex);
+	for (log_ring **ring = &log_rings; *ring;) {
+		log_ring *current = *ring;
+		if (__atomic_load_n(&current->retired, __ATOMIC_ACQUIRE) && peek_log_ring(current) == NULL) {
+			*ring = current->next;
+			log_retired_statistics.messages += current->messages;
+			log_retired_statistics.rate_limited += current->rate_limited;
+			log_retired_statistics.overflows += current->overflows;
+			log_retired_statistics.synchronous += current->synchronous;
+			free(current);
+		} else {
+			ring = &current->next;
+		}
+	}
+	collect_log_statistics(&statistics);
+	pthread_mutex_unlock(&log_rings_mutex);
+	unsigned long drops = statistics.rate_limited + statistics.overflows;
+	if (drops > log_reported_drops) {
+		char message[128];
+		struct timeval tmnow;
+		gettimeofday(&tmnow, NULL);
+		snprintf(message, sizeof(message), "%lu log messages dropped (total %lu rate limited, %lu buffer full)", drops - log_reported_drops, statistics.rate_limited, statistics.overflows);
+		log_reported_drops = drops;
+		write_log_message(&tmnow, message);
+	}
+	flush_log_output();
+}
+
+static bool log_rings_empty(void) {
+	for (log_ring *ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		if (ring->tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+			return false;
+	}
+	return true;
+}
+
+static void *log_writer(void *data) {
+	pthread_mutex_lock(&log_mutex);
+	while (true) {
+		drain_log_rings();
+		__atomic_store_n(&log_writer_sleeping, true, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (log_rings_empty()) {
+			// producers signal sleeping writer only, timeout covers the case of missed wakeup
+			struct timespec end;
+			clock_gettime(CLOCK_REALTIME, &end);
+			end.tv_nsec += 100 * 1000000;
+			if (end.tv_nsec >= 1000000000) {
+				end.tv_sec++;
+				end.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&log_writer_cond, &log_mutex, &end);
+		} else {
+			// give synchronous writers a chance
+			pthread_mutex_unlock(&log_mutex);
+			pthread_mutex_lock(&log_mutex);
+		}
+		__atomic_store_n(&log_writer_sleeping, false, __ATOMIC_SEQ_CST);
+	}
+	return NULL;
+}
+
+void indigo_log_flush(void) {
+	if (__atomic_load_n(&log_rings, __ATOMIC_ACQUIRE) != NULL) {
+		pthread_mutex_lock(&log_mutex);
+		drain_log_rings();
+		fflush(stderr);
+		pthread_mutex_unlock(&log_mutex);
+	}
+}
+
+static void start_log_writer(void) {
+	pthread_key_create(&log_ring_key, retire_log_ring);
+	log_writer_running = indigo_start_thread(log_writer, NULL);
+	if (log_writer_running)
+		atexit(indigo_log_flush);
+}
+
+static log_ring *get_log_ring(void) {
+	pthread_once(&log_once, start_log_writer);
+	if (!log_writer_running)
+		return NULL;
+	log_ring *ring = pthread_getspecific(log_ring_key);
+	if (ring == NULL) {
+		ring = malloc(sizeof(log_ring));
+		if (ring == NULL)
+			return NULL;
+		memset(ring, 0, offsetof(log_ring, scratch));
+		pthread_setspecific(log_ring_key, ring);
+		pthread_mutex_lock(&log_rings_mutex);
+		ring->next = log_rings;
+		__atomic_store_n(&log_rings, ring, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&log_rings_mutex);
+	}
+	return ring;
+}
+
+void indigo_get_log_statistics(indigo_log_statistics *statistics) {
+	pthread_mutex_lock(&log_rings_mutex);
+	collect_log_statistics(statistics);
+	pthread_mutex_unlock(&log_rings_mutex);
+}
+
+static void log_message_sync(const char *format, va_list args) {
+	pthread_mutex_lock(&log_mutex);
+	pthread_mutex_lock(&log_last_message_mutex);
+	if (indigo_last_message == NULL) {
+		indigo_last_message = indigo_safe_malloc(LOG_MESSAGE_SIZE);
+		atexit(free_log_buffers);
+	}
+	vsnprintf(indigo_last_message, LOG_MESSAGE_SIZE, format, args);
+	struct timeval tmnow;
+	gettimeofday(&tmnow, NULL);
+	if (log_rings != NULL) {
+		// preserve order of messages already buffered
+		drain_log_rings();
+	}
+	write_log_message(&tmnow, indigo_last_message);
+	flush_log_output();
+	pthread_mutex_unlock(&log_last_message_mutex);
 	pthread_mutex_unlock(&log_mutex);
 }
 
+static void log_message(indigo_log_levels level, const char *format, va_list args) {
+	log_ring *ring;
+	if (!indigo_use_async_log || (ring = get_log_ring()) == NULL) {
+		log_message_sync(format, args);
+		return;
+	}
+	struct timeval tmnow;
+	gettimeofday(&tmnow, NULL);
+	bool droppable = level >= INDIGO_LOG_DEBUG;
+	if (droppable && indigo_log_rate_limit > 0) {
+		double now = tmnow.tv_sec + tmnow.tv_usec / 1000000.0;
+		ring->tokens += (now - ring->refill_time) * indigo_log_rate_limit;
+		ring->refill_time = now;
+		if (ring->tokens > indigo_log_rate_limit)
+			ring->tokens = indigo_log_rate_limit;
+		if (ring->tokens < 1) {
+			__atomic_store_n(&ring->rate_limited, ring->rate_limited + 1, __ATOMIC_RELAXED);
+			return;
+		}
+		ring->tokens -= 1;
+	}
+	va_list args_copy;
+	va_copy(args_copy, args);
+	int length = vsnprintf(ring->scratch, LOG_RECORD_SIZE, format, args_copy);
+	va_end(args_copy);
+	if (length >= 0 && length < LOG_RECORD_SIZE) {
+		if (!droppable) {
+			// keep indigo_last_message for error and info messages
+			pthread_mutex_lock(&log_last_message_mutex);
+			if (indigo_last_message == NULL) {
+				indigo_last_message = indigo_safe_malloc(LOG_MESSAGE_SIZE);
+				atexit(free_log_buffers);
+			}
+			memcpy(indigo_last_message, ring->scratch, length + 1);
+			pthread_mutex_unlock(&log_last_message_mutex);
+		}
+		if (push_log_ring(ring, level, &tmnow, length)) {
+			__atomic_store_n(&ring->messages, ring->messages + 1, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			if (__atomic_exchange_n(&log_writer_sleeping, false, __ATOMIC_SEQ_CST)) {
+				pthread_mutex_lock(&log_mutex);
+				pthread_cond_signal(&log_writer_cond);
+				pthread_mutex_unlock(&log_mutex);
+			}
+			return;
+		}
+		if (droppable) {
+			__atomic_store_n(&ring->overflows, ring->overflows + 1, __ATOMIC_RELAXED);
+			return;
+		}
+	}
+	// too long message or full buffer with error or info message
+	__atomic_store_n(&ring->synchronous, ring->synchronous + 1, __ATOMIC_RELAXED);
+	log_message_sync(format, args);
+}
+
+void indigo_log_message(const char *format, va_list args) {
+	log_message(INDIGO_LOG_ERROR, format, args);
+}
+
 void indigo_error(const char *format, ...) {
 	va_list argList;
 	va_start(argList, format);
-	indigo_log_message(format, argList);
+	log_message(INDIGO_LOG_ERROR, format, argList);
 	va_end(argList);
 }
 
@@ -256,7 +805,7 @@ void indigo_log(const char *format, ...) {
 	if (indigo_log_level >= INDIGO_LOG_INFO) {
 		va_list argList;
 		va_start(argList, format);
-		indigo_log_message(format, argList);
+		log_message(INDIGO_LOG_INFO, format, argList);
 		va_end(argList);
 	}
 }
@@ -265,7 +814,7 @@ void indigo_trace(const char *format, ...) {
 	if (indigo_log_level >= INDIGO_LOG_TRACE) {
 		va_list argList;
 		va_start(argList, format);
-		indigo_log_message(format, argList);
+		log_message(INDIGO_LOG_TRACE, format, argList);
 		va_end(argList);
 	}
 }
@@ -274,7 +823,7 @@ void indigo_debug(const char *format, ...) {
 	if (indigo_log_level >= INDIGO_LOG_DEBUG) {
 		va_list argList;
 		va_start(argList, format);
-		indigo_log_message(format, argList);
+		log_message(INDIGO_LOG_DEBUG, format, argList);
 		va_end(argList);
 	}
 }
@@ -356,12 +905,9 @@ indigo_result indigo_start() {
 			indigo_log_level = INDIGO_LOG_TRACE;
 		}
 	}
-	pthread_mutex_lock(&device_mutex);
-	pthread_mutex_lock(&client_mutex);
+	pthread_mutex_lock(&bus_mutex);
 	INDIGO_TRACE(indigo_trace("INDIGO Bus: start request"));
 	if (!is_started) {
-		memset(devices, 0, MAX_DEVICES * sizeof(indigo_device *));
-		memset(clients, 0, MAX_CLIENTS * sizeof(indigo_client *));
 		memset(blobs, 0, MAX_BLOBS * sizeof(indigo_property *));
 		memset(&INDIGO_ALL_PROPERTIES, 0, sizeof(INDIGO_ALL_PROPERTIES));
 		is_started = true;
@@ -371,136 +917,172 @@ indigo_result indigo_start() {
   WSADATA data;
   WSAStartup(version_requested, &data);
 #endif
-	pthread_mutex_unlock(&client_mutex);
-	pthread_mutex_unlock(&device_mutex);
+	pthread_mutex_unlock(&bus_mutex);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_attach_device(indigo_device *device) {
-	static int max_index = -1;
+	static int max_count = 0;
 	if ((!is_started) || (device == NULL))
 		return INDIGO_FAILED;
-	pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace("INDIGO Bus: device attach request (%s)", device->name));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		if (devices[i] == NULL) {
-			if (i > max_index) {
-				max_index = i;
-				indigo_debug("%d devices attached", max_index + 1);
-			}
-			devices[i] = device;
-			pthread_mutex_unlock(&device_mutex);
-			device->access_token = 0;
-			if (device->attach != NULL)
-				device->last_result = device->attach(device);
-			if (!device->is_remote && device->change_property) {
-				indigo_property *property = indigo_init_switch_property(NULL, device->name, CONFIG_PROPERTY_NAME, NULL, NULL, INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ANY_OF_MANY_RULE, 1);
-				indigo_init_switch_item(property->items, CONFIG_LOAD_ITEM_NAME, NULL, true);
-				device->change_property(device, NULL, property);
-				indigo_release_property(property);
-			}
-			pthread_mutex_lock(&device_mutex);
-			device->access_token = indigo_get_device_token(device->name);
-			pthread_mutex_unlock(&device_mutex);
-			return INDIGO_OK;
-		}
+	if (!bus_table_update(&device_table, device, true, MAX_DEVICES)) {
+		indigo_error("[%s:%d] Max device count reached", __FUNCTION__, __LINE__);
+		return INDIGO_TOO_MANY_ELEMENTS;
+	}
+	if (device_table->count > max_count) {
+		max_count = device_table->count;
+		indigo_debug("%d devices attached", max_count);
+	}
+	device->access_token = 0;
+	device->update_metric = indigo_use_metrics ? indigo_create_metric(INDIGO_METRIC_COUNTER, "indigo_property_updates_total", "Property updates sent by device", "device", device->name) : NULL;
+	if (device->attach != NULL)
+		device->last_result = device->attach(device);
+	if (!device->is_remote && device->change_property) {
+		indigo_property *property = indigo_init_switch_property(NULL, device->name, CONFIG_PROPERTY_NAME, NULL, NULL, INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ANY_OF_MANY_RULE, 1);
+		indigo_init_switch_item(property->items, CONFIG_LOAD_ITEM_NAME, NULL, true);
+		device->change_property(device, NULL, property);
+		indigo_release_property(property);
+	}
+	pthread_mutex_lock(&bus_mutex);
+	device->access_token = indigo_get_device_token(device->name);
+	pthread_mutex_unlock(&bus_mutex);
+	return INDIGO_OK;
+}
+
+static void create_client_metrics(indigo_client *client) {
+	static int client_id = 0;
+	if (!indigo_use_metrics)
+		return;
+	char label[INDIGO_NAME_SIZE + 16];
+	snprintf(label, sizeof(label), "%s #%d", client->name, __atomic_add_fetch(&client_id, 1, __ATOMIC_RELAXED));
+	indigo_client_metrics *metrics = indigo_safe_malloc(sizeof(indigo_client_metrics));
+	metrics->messages = indigo_create_metric(INDIGO_METRIC_COUNTER, "indigo_client_messages_total", "Messages delivered to client", "client", label);
+	if (client->is_remote)
+		metrics->bytes = indigo_create_metric(INDIGO_METRIC_COUNTER, "indigo_client_bytes_total", "Bytes written to remote client", "client", label);
+	metrics->latency = indigo_create_metric(INDIGO_METRIC_HISTOGRAM, "indigo_client_delivery_seconds", "Time spent by bus delivering message to client", "client", label);
+	client->metrics = metrics;
+}
+
+static void release_client_metrics(indigo_client *client) {
+	indigo_client_metrics *metrics = client->metrics;
+	if (metrics) {
+		client->metrics = NULL;
+		indigo_release_metric(metrics->messages);
+		indigo_release_metric(metrics->bytes);
+		indigo_release_metric(metrics->latency);
+		free(metrics);
+	}
+}
+
+static inline double client_delivery_start(indigo_client *client, indigo_metric **written) {
+	if (client->metrics == NULL)
+		return 0;
+	*written = indigo_metric_set_written(client->metrics->bytes);
+	return indigo_metric_time();
+}
+
+static inline void client_delivery_end(indigo_client *client, double start, indigo_metric *written) {
+	if (start == 0)
+		return;
+	indigo_metric_set_written(written);
+	// client could be detached by callback
+	indigo_client_metrics *metrics = client->metrics;
+	if (metrics) {
+		indigo_metric_observe(metrics->latency, indigo_metric_time() - start);
+		indigo_metric_add(metrics->messages, 1);
 	}
-	pthread_mutex_unlock(&device_mutex);
-	indigo_error("[%s:%d] Max device count reached", __FUNCTION__, __LINE__);
-	return INDIGO_TOO_MANY_ELEMENTS;
 }
 
 indigo_result indigo_attach_client(indigo_client *client) {
-	static int max_index = -1;
+	static int max_count = 0;
 	if ((!is_started) || (client == NULL))
 		return INDIGO_FAILED;
-	pthread_mutex_lock(&client_mutex);
-	for (int i = 0; i < MAX_CLIENTS; i++) {
-		if (clients[i] == NULL) {
-			if (i > max_index) {
-				max_index = i;
-				indigo_debug("%d clients attached", max_index + 1);
-			}
-			clients[i] = client;
-			pthread_mutex_unlock(&client_mutex);
-			if (client->attach != NULL)
-				client->last_result = client->attach(client);
-			INDIGO_TRACE(indigo_trace("INDIGO Bus: client attach request (%s)", client->name));
-			return INDIGO_OK;
-		}
+	create_client_metrics(client);
+	if (!bus_table_update(&client_table, client, true, MAX_CLIENTS)) {
+		release_client_metrics(client);
+		indigo_error("[%s:%d] Max client count reached", __FUNCTION__, __LINE__);
+		return INDIGO_TOO_MANY_ELEMENTS;
+	}
+	if (client_table->count > max_count) {
+		max_count = client_table->count;
+		indigo_debug("%d clients attached", max_count);
+	}
+	if (client->attach != NULL) {
+		bool locked = callback_lock(client->is_remote);
+		client->last_result = client->attach(client);
+		callback_unlock(locked);
 	}
-	pthread_mutex_unlock(&client_mutex);
-	indigo_error("[%s:%d] Max client count reached", __FUNCTION__, __LINE__);
-	return INDIGO_TOO_MANY_ELEMENTS;
+	INDIGO_TRACE(indigo_trace("INDIGO Bus: client attach request (%s)", client->name));
+	return INDIGO_OK;
 }
 
 indigo_result indigo_detach_device(indigo_device *device) {
 	if ((!is_started) || (device == NULL))
 		return INDIGO_FAILED;
-	pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace("INDIGO Bus: device detach request (%s)", device->name));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		if (devices[i] == device) {
-			devices[i] = NULL;
-			pthread_mutex_unlock(&device_mutex);
-			if (device->detach != NULL)
-				device->last_result = device->detach(device);
-			return INDIGO_OK;
-		}
+	if (bus_table_update(&device_table, device, false, MAX_DEVICES)) {
+		if (device->detach != NULL)
+			device->last_result = device->detach(device);
+		indigo_metric *metric = device->update_metric;
+		device->update_metric = NULL;
+		indigo_release_metric(metric);
 	}
-	pthread_mutex_unlock(&device_mutex);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_detach_client(indigo_client *client) {
 	if ((!is_started) || (client == NULL))
 		return INDIGO_FAILED;
-	pthread_mutex_lock(&client_mutex);
 	INDIGO_TRACE(indigo_trace("INDIGO Bus: client detach request (%s)", client->name));
-	for (int i = 0; i < MAX_CLIENTS; i++) {
-		if (clients[i] == client) {
-			clients[i] = NULL;
-			pthread_mutex_unlock(&client_mutex);
-			if (client->detach != NULL)
-				client->last_result = client->detach(client);
-			return INDIGO_OK;
+	if (bus_table_update(&client_table, client, false, MAX_CLIENTS)) {
+		// table update waits for bus readers, metrics are no longer used
+		release_client_metrics(client);
+		if (client->detach != NULL) {
+			bool locked = callback_lock(client->is_remote);
+			client->last_result = client->detach(client);
+			callback_unlock(locked);
 		}
 	}
-	pthread_mutex_unlock(&client_mutex);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_enumerate_properties(indigo_client *client, indigo_property *property) {
 	if (!is_started)
 		return INDIGO_FAILED;
-	if (indigo_use_strict_locking)
-		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: property enumeration request", property, false, false));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->enumerate_properties != NULL) {
+	bus_reader reader;
+	bus_table *table = bus_read_lock(&device_table, &reader);
+	for (int i = 0; i < table->count; i++) {
+		indigo_device *device = table->entries[i];
+		if (bus_is_live(&reader, device) && device->enumerate_properties != NULL) {
 			bool route = *property->device == 0;
 			route = route || !strcmp(property->device, device->name);
 			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
 			route = route || (!indigo_use_host_suffix && *device->name == '@');
-			if (route)
-				device->last_result = device->enumerate_properties(device, client, property);
+			if (route) {
+				bool locked = callback_lock(device->is_remote);
+				// device could be detached by callback of other thread holding the lock
+				if (!locked || bus_is_live(&reader, device))
+					device->last_result = device->enumerate_properties(device, client, property);
+				callback_unlock(locked);
+			}
 		}
 	}
-	if (indigo_use_strict_locking)
-		pthread_mutex_unlock(&device_mutex);
+	bus_read_unlock(&reader);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_change_property(indigo_client *client, indigo_property *property) {
 	if ((!is_started) || (property == NULL))
 		return INDIGO_FAILED;
-	if (indigo_use_strict_locking)
-		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: property change request", property, false, true));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->change_property != NULL) {
+	bus_reader reader;
+	bus_table *table = bus_read_lock(&device_table, &reader);
+	INDIGO_TRACING_BEGIN("bus", "change_property", property->name);
+	for (int i = 0; i < table->count; i++) {
+		indigo_device *device = table->entries[i];
+		if (bus_is_live(&reader, device) && device->change_property != NULL) {
 			bool route = *property->device == 0;
 			route = route || !strcmp(property->device, device->name);
 			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
@@ -511,42 +1093,121 @@ indigo_result indigo_change_property(indigo_client *client, indigo_property *pro
 					indigo_send_message(device, "Device '%s' is protected or locked for exclusive access", device->name);
 					continue;
 				}
-				device->last_result = device->change_property(device, client, property);
+				bool locked = callback_lock(device->is_remote);
+				// device could be detached by callback of other thread holding the lock
+				if (!locked || bus_is_live(&reader, device))
+					device->last_result = device->change_property(device, client, property);
+				callback_unlock(locked);
 			}
 		}
 	}
-	if (indigo_use_strict_locking)
-		pthread_mutex_unlock(&device_mutex);
+	INDIGO_TRACING_END("bus", "change_property");
+	bus_read_unlock(&reader);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_enable_blob(indigo_client *client, indigo_property *property, indigo_enable_blob_mode mode) {
 	if ((!is_started) || (property == NULL))
 		return INDIGO_FAILED;
-	if (indigo_use_strict_locking)
-		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: enable BLOB mode change request", property, false, true));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->enable_blob != NULL) {
+	bus_reader reader;
+	bus_table *table = bus_read_lock(&device_table, &reader);
+	for (int i = 0; i < table->count; i++) {
+		indigo_device *device = table->entries[i];
+		if (bus_is_live(&reader, device) && device->enable_blob != NULL) {
 			bool route = *property->device == 0;
 			route = route || !strcmp(property->device, device->name);
 			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
 			route = route || (!indigo_use_host_suffix && *device->name == '@');
-			if (route)
-				device->last_result = device->enable_blob(device, client, property, mode);
+			if (route) {
+				bool locked = callback_lock(device->is_remote);
+				// device could be detached by callback of other thread holding the lock
+				if (!locked || bus_is_live(&reader, device))
+					device->last_result = device->enable_blob(device, client, property, mode);
+				callback_unlock(locked);
+			}
 		}
 	}
-	if (indigo_use_strict_locking)
-		pthread_mutex_unlock(&device_mutex);
+	bus_read_unlock(&reader);
 	return INDIGO_OK;
 }
 
+bool indigo_wildcard_match(const char *pattern, const char *string) {
+	const char *star = NULL, *resume = NULL;
+	while (*string) {
+		if (*pattern == '*') {
+			star = pattern++;
+			resume = string;
+		} else if (*pattern == '?' || *pattern == *string) {
+			pattern++;
+			string++;
+		} else if (star) {
+			pattern = star + 1;
+			string = ++resume;
+		} else {
+			return false;
+		}
+	}
+	while (*pattern == '*')
+		pattern++;
+	return *pattern == 0;
+}
+
+indigo_result indigo_subscribe(indigo_client *client, const char *device, const char *name, const char *group) {
+	if (client == NULL)
+		return INDIGO_FAILED;
+	device = device ? device : "";
+	name = name ? name : "";
+	group = group ? group : "";
+	if (*device == 0 && *name == 0 && *group == 0) {
+		indigo_release_subscriptions(client);
+		return INDIGO_OK;
+	}
+	INDIGO_TRACE(indigo_trace("INDIGO Bus: subscription request (%s) '%s' '%s' '%s'", client->name, device, name, group));
+	indigo_subscription_record *record = indigo_safe_malloc(sizeof(indigo_subscription_record));
+	indigo_copy_name(record->device, device);
+	indigo_copy_name(record->name, name);
+	indigo_copy_name(record->group, group);
+	pthread_mutex_lock(&subscription_mutex);
+	record->next = client->subscription_records;
+	client->subscription_records = record;
+	pthread_mutex_unlock(&subscription_mutex);
+	return INDIGO_OK;
+}
+
+void indigo_release_subscriptions(indigo_client *client) {
+	pthread_mutex_lock(&subscription_mutex);
+	indigo_subscription_record *record = client->subscription_records;
+	client->subscription_records = NULL;
+	pthread_mutex_unlock(&subscription_mutex);
+	while (record) {
+		indigo_subscription_record *next = record->next;
+		free(record);
+		record = next;
+	}
+}
+
+bool indigo_is_subscribed(indigo_client *client, indigo_property *property) {
+	if (client->subscription_records == NULL)
+		return true;
+	bool result = false;
+	pthread_mutex_lock(&subscription_mutex);
+	for (indigo_subscription_record *record = client->subscription_records; record && !result; record = record->next) {
+		if (*record->device && !indigo_wildcard_match(record->device, property->device))
+			continue;
+		// deletion of all device properties is passed to all clients subscribed to the device
+		if (*property->name == 0)
+			result = true;
+		else
+			result = (*record->name == 0 || indigo_wildcard_match(record->name, property->name)) && (*record->group == 0 || indigo_wildcard_match(record->group, property->group));
+	}
+	pthread_mutex_unlock(&subscription_mutex);
+	return result;
+}
+
 indigo_result indigo_define_property(indigo_device *device, indigo_property *property, const char *format, ...) {
 	if ((!is_started) || (property == NULL))
 		return INDIGO_FAILED;
-	if (indigo_use_strict_locking)
-		pthread_mutex_lock(&client_mutex);
 	if (!property->hidden) {
 		INDIGO_TRACE(indigo_trace_property("INDIGO Bus: property definition", property, true, true));
 		char message[INDIGO_VALUE_SIZE];
@@ -556,22 +1217,32 @@ indigo_result indigo_define_property(indigo_device *device, indigo_property *pro
 			vsnprintf(message, INDIGO_VALUE_SIZE, format, args);
 			va_end(args);
 		}
-		for (int i = 0; i < MAX_CLIENTS; i++) {
-			indigo_client *client = clients[i];
-			if (client != NULL && client->define_property != NULL)
-				client->last_result = client->define_property(client, device, property, format != NULL ? message : NULL);
+		bus_reader reader;
+		bus_table *table = bus_read_lock(&client_table, &reader);
+		INDIGO_TRACING_BEGIN("bus", "define_property", property->name);
+		for (int i = 0; i < table->count; i++) {
+			indigo_client *client = table->entries[i];
+			if (bus_is_live(&reader, client) && client->define_property != NULL && indigo_is_subscribed(client, property)) {
+				bool locked = callback_lock(client->is_remote);
+				// client could be detached by callback of other thread holding the lock
+				if (!locked || bus_is_live(&reader, client)) {
+					indigo_metric *written = NULL;
+					double start = client_delivery_start(client, &written);
+					client->last_result = client->define_property(client, device, property, format != NULL ? message : NULL);
+					client_delivery_end(client, start, written);
+				}
+				callback_unlock(locked);
+			}
 		}
+		INDIGO_TRACING_END("bus", "define_property");
+		bus_read_unlock(&reader);
 	}
-	if (indigo_use_strict_locking)
-		pthread_mutex_unlock(&client_mutex);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_update_property(indigo_device *device, indigo_property *property, const char *format, ...) {
 	if ((!is_started) || (property == NULL))
 		return INDIGO_FAILED;
-	if (indigo_use_strict_locking)
-		pthread_mutex_lock(&client_mutex);
 	if (!property->hidden) {
 		char message[INDIGO_VALUE_SIZE];
 		int count = property->count;
@@ -609,42 +1280,52 @@ indigo_result indigo_update_property(indigo_device *device, indigo_property *pro
 				if (entry) {
 					pthread_mutex_lock(&entry->mutext);
 					if (item->blob.size) {
-						entry->content = indigo_safe_realloc(entry->content, entry->size = item->blob.size);
+						entry->content = indigo_resize_image_buffer(entry->content, entry->size = item->blob.size);
 						memcpy(entry->content, item->blob.value, entry->size);
 						strcpy(entry->format, item->blob.format);
 					} else if (entry->content) {
-						free(entry->content);
+						indigo_release_image_buffer(entry->content);
 						entry->size = 0;
 						entry->content = NULL;
 					}
 					pthread_mutex_unlock(&entry->mutext);
 				} else {
 					pthread_mutex_unlock(&blob_mutex);
-					if (indigo_use_strict_locking)
-						pthread_mutex_unlock(&client_mutex);
 					indigo_error("[%s:%d] Max BLOB count reached", __FUNCTION__, __LINE__);
 					return INDIGO_TOO_MANY_ELEMENTS;
 				}
 			}
 			pthread_mutex_unlock(&blob_mutex);
 		}
-		for (int i = 0; i < MAX_CLIENTS; i++) {
-			indigo_client *client = clients[i];
-			if (client != NULL && client->update_property != NULL)
-				client->last_result = client->update_property(client, device, property, format != NULL ? message : NULL);
+		if (device)
+			indigo_metric_add(device->update_metric, 1);
+		bus_reader reader;
+		bus_table *table = bus_read_lock(&client_table, &reader);
+		INDIGO_TRACING_BEGIN("bus", "update_property", property->name);
+		for (int i = 0; i < table->count; i++) {
+			indigo_client *client = table->entries[i];
+			if (bus_is_live(&reader, client) && client->update_property != NULL && indigo_is_subscribed(client, property)) {
+				bool locked = callback_lock(client->is_remote);
+				// client could be detached by callback of other thread holding the lock
+				if (!locked || bus_is_live(&reader, client)) {
+					indigo_metric *written = NULL;
+					double start = client_delivery_start(client, &written);
+					client->last_result = client->update_property(client, device, property, format != NULL ? message : NULL);
+					client_delivery_end(client, start, written);
+				}
+				callback_unlock(locked);
+			}
 		}
+		INDIGO_TRACING_END("bus", "update_property");
+		bus_read_unlock(&reader);
 		property->count = count;
 	}
-	if (indigo_use_strict_locking)
-		pthread_mutex_unlock(&client_mutex);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_delete_property(indigo_device *device, indigo_property *property, const char *format, ...) {
 	if ((!is_started) || (property == NULL))
 		return INDIGO_FAILED;
-	if (indigo_use_strict_locking)
-		pthread_mutex_lock(&client_mutex);
 	if (!property->hidden) {
 		char message[INDIGO_VALUE_SIZE];
 		INDIGO_TRACE(indigo_trace_property("INDIGO Bus: property removal", property, false, false));
@@ -654,22 +1335,32 @@ indigo_result indigo_delete_property(indigo_device *device, indigo_property *pro
 			vsnprintf(message, INDIGO_VALUE_SIZE, format, args);
 			va_end(args);
 		}
-		for (int i = 0; i < MAX_CLIENTS; i++) {
-			indigo_client *client = clients[i];
-			if (client != NULL && client->delete_property != NULL)
-				client->last_result = client->delete_property(client, device, property, format != NULL ? message : NULL);
+		bus_reader reader;
+		bus_table *table = bus_read_lock(&client_table, &reader);
+		INDIGO_TRACING_BEGIN("bus", "delete_property", property->name);
+		for (int i = 0; i < table->count; i++) {
+			indigo_client *client = table->entries[i];
+			if (bus_is_live(&reader, client) && client->delete_property != NULL && indigo_is_subscribed(client, property)) {
+				bool locked = callback_lock(client->is_remote);
+				// client could be detached by callback of other thread holding the lock
+				if (!locked || bus_is_live(&reader, client)) {
+					indigo_metric *written = NULL;
+					double start = client_delivery_start(client, &written);
+					client->last_result = client->delete_property(client, device, property, format != NULL ? message : NULL);
+					client_delivery_end(client, start, written);
+				}
+				callback_unlock(locked);
+			}
 		}
+		INDIGO_TRACING_END("bus", "delete_property");
+		bus_read_unlock(&reader);
 	}
-	if (indigo_use_strict_locking)
-		pthread_mutex_unlock(&client_mutex);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_send_message(indigo_device *device, const char *format, ...) {
 	if (!is_started)
 		return INDIGO_FAILED;
-	if (indigo_use_strict_locking)
-		pthread_mutex_lock(&client_mutex);
 	char message[INDIGO_VALUE_SIZE];
 	if (format != NULL) {
 		va_list args;
@@ -678,35 +1369,53 @@ indigo_result indigo_send_message(indigo_device *device, const char *format, ...
 		va_end(args);
 	}
 	INDIGO_DEBUG(indigo_debug("INDIGO Bus: message sent '%s'", message));
-	for (int i = 0; i < MAX_CLIENTS; i++) {
-		indigo_client *client = clients[i];
-		if (client != NULL && client->send_message != NULL)
-			client->last_result = client->send_message(client, device, format != NULL ? message : NULL);
+	bus_reader reader;
+	bus_table *table = bus_read_lock(&client_table, &reader);
+	INDIGO_TRACING_BEGIN("bus", "send_message", device ? device->name : NULL);
+	for (int i = 0; i < table->count; i++) {
+		indigo_client *client = table->entries[i];
+		if (bus_is_live(&reader, client) && client->send_message != NULL) {
+			bool locked = callback_lock(client->is_remote);
+			// client could be detached by callback of other thread holding the lock
+			if (!locked || bus_is_live(&reader, client)) {
+				indigo_metric *written = NULL;
+				double start = client_delivery_start(client, &written);
+				client->last_result = client->send_message(client, device, format != NULL ? message : NULL);
+				client_delivery_end(client, start, written);
+			}
+			callback_unlock(locked);
+		}
 	}
-	if (indigo_use_strict_locking)
-		pthread_mutex_unlock(&client_mutex);
+	INDIGO_TRACING_END("bus", "send_message");
+	bus_read_unlock(&reader);
 	return INDIGO_OK;
 }
 
 indigo_result indigo_stop() {
-	pthread_mutex_lock(&device_mutex);
-	pthread_mutex_lock(&client_mutex);
+	pthread_mutex_lock(&bus_mutex);
 	INDIGO_TRACE(indigo_trace("INDIGO Bus: stop request"));
 	if (is_started) {
 		is_started = false;
-		for (int i = 0; i < MAX_CLIENTS; i++) {
-			indigo_client *client = clients[i];
-			if (client != NULL && client->detach != NULL)
+		bus_reader reader;
+		bus_table *table = bus_read_lock(&client_table, &reader);
+		for (int i = 0; i < table->count; i++) {
+			indigo_client *client = table->entries[i];
+			if (client->detach != NULL) {
+				bool locked = callback_lock(client->is_remote);
 				client->last_result = client->detach(client);
+				callback_unlock(locked);
+			}
 		}
-		for (int i = 0; i < MAX_DEVICES; i++) {
-			indigo_device *device = devices[i];
-			if (device != NULL && device->detach != NULL)
+		bus_read_unlock(&reader);
+		table = bus_read_lock(&device_table, &reader);
+		for (int i = 0; i < table->count; i++) {
+			indigo_device *device = table->entries[i];
+			if (device->detach != NULL)
 				device->last_result = device->detach(device);
 		}
+		bus_read_unlock(&reader);
 	}
-	pthread_mutex_unlock(&client_mutex);
-	pthread_mutex_unlock(&device_mutex);
+	pthread_mutex_unlock(&bus_mutex);
 	return INDIGO_OK;
 }
 
@@ -845,7 +1554,7 @@ void indigo_release_property(indigo_property *property) {
 				if (entry && entry->item == item) {
 					pthread_mutex_lock(&entry->mutext);
 					blobs[j] = NULL;
-					indigo_safe_free(entry->content);
+					indigo_release_image_buffer(entry->content);
 					pthread_mutex_unlock(&entry->mutext);
 					pthread_mutex_destroy(&entry->mutext);
 					indigo_safe_free(entry);
@@ -932,98 +1641,421 @@ void indigo_init_blob_item(indigo_item *item, const char *name, const char *labe
 
 void *indigo_alloc_blob_buffer(long size) {
 	int mod2880 = size % 2880;
-	if (mod2880) {
-		return indigo_safe_malloc(size + 2880 - mod2880);
+	if (mod2880)
+		size += 2880 - mod2880;
+	void *buffer = indigo_alloc_image_buffer(size);
+	assert(buffer != NULL);
+	memset(buffer, 0, size);
+	return buffer;
+}
+
+void indigo_free_blob_buffer(void *buffer) {
+	indigo_release_image_buffer(buffer);
+}
+
+#define BLOB_FETCH_WORKERS			4
+#define BLOB_FETCH_CONNECTIONS	8
+#define BLOB_FETCH_IDLE_TIME		10
+
+typedef struct {
+	char host[INDIGO_NAME_SIZE];
+	int port;
+	int handle;
+} blob_connection;
+
+typedef struct blob_fetch_job {
+	struct blob_fetch_job *next;
+	indigo_item item;
+	indigo_blob_fetch_callback callback;
+	void *data;
+} blob_fetch_job;
+
+static blob_connection blob_connections[BLOB_FETCH_CONNECTIONS];
+static int blob_connection_count = 0;
+static pthread_mutex_t blob_connection_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static blob_fetch_job *blob_fetch_queue = NULL;
+static struct {
+	bool running;
+	void *data;
+} blob_fetch_workers[BLOB_FETCH_WORKERS];
+static int blob_fetch_idle_workers = 0;
+static pthread_mutex_t blob_fetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t blob_fetch_cond = PTHREAD_COND_INITIALIZER;
+
+static void blob_connection_close(int handle) {
+#if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
+	shutdown(handle, SHUT_RDWR);
+	close(handle);
+#endif
+#if defined(INDIGO_WINDOWS)
+	shutdown(handle, SD_BOTH);
+	closesocket(handle);
+#endif
+}
+
+static int blob_connection_open(const char *host, int port, bool *reused) {
+	pthread_mutex_lock(&blob_connection_mutex);
+	for (int i = blob_connection_count - 1; i >= 0; i--) {
+		if (blob_connections[i].port == port && !strcmp(blob_connections[i].host, host)) {
+			int handle = blob_connections[i].handle;
+			blob_connections[i] = blob_connections[--blob_connection_count];
+			pthread_mutex_unlock(&blob_connection_mutex);
+			*reused = true;
+			return handle;
+		}
+	}
+	pthread_mutex_unlock(&blob_connection_mutex);
+	*reused = false;
+	return indigo_open_tcp(host, port);
+}
+
+static void blob_connection_release(const char *host, int port, int handle) {
+	pthread_mutex_lock(&blob_connection_mutex);
+	if (blob_connection_count == BLOB_FETCH_CONNECTIONS) {
+		blob_connection_close(blob_connections[0].handle);
+		memmove(blob_connections, blob_connections + 1, (BLOB_FETCH_CONNECTIONS - 1) * sizeof(blob_connection));
+		blob_connection_count--;
+	}
+	blob_connection *connection = blob_connections + blob_connection_count++;
+	snprintf(connection->host, sizeof(connection->host), "%s", host);
+	connection->port = port;
+	connection->handle = handle;
+	pthread_mutex_unlock(&blob_connection_mutex);
+}
+
+static long blob_recv(int handle, char *buffer, long length) {
+#if defined(INDIGO_WINDOWS)
+	return recv(handle, buffer, length, 0);
+#else
+	return read(handle, buffer, length);
+#endif
+}
+
+static bool fetch_http_blob(indigo_item *blob_item, int handle, const char *host, int port, const char *file, bool *keep_alive) {
+	char buffer[4 * BUFFER_SIZE];
+	snprintf(buffer, sizeof(buffer), "GET /%s HTTP/1.1\r\nHost: %s:%d\r\nConnection: keep-alive\r\n\r\n", file, host, port);
+	if (!indigo_write(handle, buffer, strlen(buffer)))
+		return false;
+	// read response header in chunks, the tail of the last chunk is the beginning of content
+	long length = 0;
+	char *body = NULL;
+	while (body == NULL) {
+		if (length == sizeof(buffer) - 1) {
+			INDIGO_DEBUG(indigo_debug("%s(): response header too long", __FUNCTION__));
+			return false;
+		}
+		long bytes_read = blob_recv(handle, buffer + length, sizeof(buffer) - 1 - length);
+		if (bytes_read <= 0)
+			return false;
+		length += bytes_read;
+		buffer[length] = 0;
+		body = strstr(buffer, "\r\n\r\n");
+	}
+	*body = 0;
+	body += 4;
+	long prefetched = length - (body - buffer);
+	int http_result = 0;
+	if (sscanf(buffer, "HTTP/1.1 %d", &http_result) != 1 || http_result != 200) {
+		INDIGO_DEBUG(indigo_debug("%s(): http_line = \"%.80s\"", __FUNCTION__, buffer));
+		return false;
+	}
+	long content_len = 0;
+	*keep_alive = false;
+	for (char *line = strstr(buffer, "\r\n"); line; line = strstr(line, "\r\n")) {
+		line += 2;
+		if (!strncasecmp(line, "Content-Length:", 15))
+			content_len = atol(line + 15);
+		else if (!strncasecmp(line, "Connection: keep-alive", 22))
+			*keep_alive = true;
 	}
-	return indigo_safe_malloc(size);
+	INDIGO_DEBUG(indigo_debug("%s(): http_result = %d, content_len = %ld, keep_alive = %d", __FUNCTION__, http_result, content_len, *keep_alive));
+	if (content_len <= 0 || prefetched > content_len)
+		return false;
+	char *image_type = strrchr(file, '.');
+	if (image_type)
+		indigo_copy_name(blob_item->blob.format, image_type);
+	blob_item->blob.value = indigo_resize_image_buffer(blob_item->blob.value, content_len);
+	if (blob_item->blob.value == NULL)
+		return false;
+	blob_item->blob.size = content_len;
+	memcpy(blob_item->blob.value, body, prefetched);
+	for (long offset = prefetched; offset < content_len;) {
+		long bytes_read = blob_recv(handle, (char *)blob_item->blob.value + offset, content_len - offset);
+		if (bytes_read <= 0) {
+			INDIGO_ERROR(indigo_error("%s(): %s", __FUNCTION__, bytes_read < 0 ? strerror(errno) : "connection closed"));
+			return false;
+		}
+		offset += bytes_read;
+	}
+	return true;
 }
 
 bool indigo_populate_http_blob_item(indigo_item *blob_item) {
-	char *host = indigo_safe_malloc(BUFFER_SIZE);
+	char host[BUFFER_SIZE] = "";
 	int port = 80;
-	char *file = indigo_safe_malloc(BUFFER_SIZE);
-	char *request = indigo_safe_malloc(BUFFER_SIZE);
-	char *http_line = indigo_safe_malloc(BUFFER_SIZE);
-	char *http_response = indigo_safe_malloc(BUFFER_SIZE);
-	long content_len = 0;;
-	int http_result = 0;
-	char *image_type;
-	int socket = -1;
-	int res = false;
-	int count;
-	
+	char file[BUFFER_SIZE] = "";
+	bool res = false;
 	if ((blob_item->blob.url[0] == '\0') || strcmp(blob_item->name, CCD_IMAGE_ITEM_NAME)) {
 		INDIGO_DEBUG(indigo_debug("%s(): url == \"\" or item != \"%s\"", __FUNCTION__, CCD_IMAGE_ITEM_NAME));
-		goto clean_return;
+		return false;
 	}
-	
 	sscanf(blob_item->blob.url, "http://%255[^:]:%5d/%256[^\n]", host, &port, file);
-	socket = indigo_open_tcp(host, port);
-	if (socket < 0) {
-		goto clean_return;
+	// connection kept alive by server may be closed meanwhile, retry once with a new one
+	for (int attempt = 0; attempt < 2 && !res; attempt++) {
+		bool reused = false, keep_alive = false;
+		int handle = blob_connection_open(host, port, &reused);
+		if (handle < 0)
+			break;
+		res = fetch_http_blob(blob_item, handle, host, port, file, &keep_alive);
+		if (res && keep_alive)
+			blob_connection_release(host, port, handle);
+		else
+			blob_connection_close(handle);
+		if (!reused)
+			break;
+	}
+	INDIGO_DEBUG(indigo_debug("%s() -> %s", __FUNCTION__, res ? "OK" : "Failed"));
+	return res;
+}
+
+static bool blob_fetch_is_active(void *data) {
+	for (int i = 0; i < BLOB_FETCH_WORKERS; i++)
+		if (blob_fetch_workers[i].running && blob_fetch_workers[i].data == data)
+			return true;
+	return false;
+}
+
+static void *blob_fetch_worker(void *arg) {
+	int slot = (int)(intptr_t)arg;
+	pthread_mutex_lock(&blob_fetch_mutex);
+	while (true) {
+		// jobs with the same callback data are never run concurrently, so they complete in order
+		blob_fetch_job **previous = &blob_fetch_queue, *job = blob_fetch_queue;
+		while (job && job->data && blob_fetch_is_active(job->data)) {
+			previous = &job->next;
+			job = job->next;
+		}
+		if (job == NULL) {
+			struct timespec end;
+			clock_gettime(CLOCK_REALTIME, &end);
+			end.tv_sec += BLOB_FETCH_IDLE_TIME;
+			blob_fetch_idle_workers++;
+			int result = pthread_cond_timedwait(&blob_fetch_cond, &blob_fetch_mutex, &end);
+			blob_fetch_idle_workers--;
+			if (result == ETIMEDOUT && blob_fetch_queue == NULL)
+				break;
+			continue;
+		}
+		*previous = job->next;
+		blob_fetch_workers[slot].data = job->data;
+		pthread_mutex_unlock(&blob_fetch_mutex);
+		bool result = indigo_populate_http_blob_item(&job->item);
+		job->callback(&job->item, result, job->data);
+		free(job);
+		pthread_mutex_lock(&blob_fetch_mutex);
+		blob_fetch_workers[slot].data = NULL;
+		if (blob_fetch_queue)
+			pthread_cond_broadcast(&blob_fetch_cond);
+	}
+	blob_fetch_workers[slot].running = false;
+	pthread_mutex_unlock(&blob_fetch_mutex);
+	return NULL;
+}
+
+void indigo_populate_http_blob_item_async(indigo_item *blob_item, indigo_blob_fetch_callback callback, void *data) {
+	blob_fetch_job *job = indigo_safe_malloc(sizeof(blob_fetch_job));
+	job->item = *blob_item;
+	job->item.blob.value = NULL;
+	job->item.blob.size = 0;
+	job->callback = callback;
+	job->data = data;
+	pthread_mutex_lock(&blob_fetch_mutex);
+	blob_fetch_job **last = &blob_fetch_queue;
+	while (*last)
+		last = &(*last)->next;
+	*last = job;
+	if (blob_fetch_idle_workers == 0) {
+		for (int slot = 0; slot < BLOB_FETCH_WORKERS; slot++) {
+			if (!blob_fetch_workers[slot].running) {
+				pthread_t thread;
+				if (pthread_create(&thread, NULL, blob_fetch_worker, (void *)(intptr_t)slot) == 0) {
+					pthread_detach(thread);
+					blob_fetch_workers[slot].running = true;
+					blob_fetch_workers[slot].data = NULL;
+				}
+				break;
+			}
+		}
+	} else {
+		pthread_cond_signal(&blob_fetch_cond);
 	}
+	pthread_mutex_unlock(&blob_fetch_mutex);
+}
 
-	snprintf(request, BUFFER_SIZE, "GET /%s HTTP/1.1\r\n\r\n", file);
-	res = indigo_write(socket, request, strlen(request));
-	if (res == false)
-		goto clean_return;
+#define DELTA_CACHE_SIZE	256
 
-	res = indigo_read_line(socket, http_line, BUFFER_SIZE);
-	if (res < 0) {
-		res = false;
-		goto clean_return;
+typedef struct {
+	char name[INDIGO_NAME_SIZE];
+	uint64_t values[2];
+} indigo_delta_item;
+
+typedef struct indigo_delta_entry {
+	struct indigo_delta_entry *next;
+	uint32_t hash;
+	char device[INDIGO_NAME_SIZE];
+	char name[INDIGO_NAME_SIZE];
+	int count, size;
+	indigo_delta_item *items;
+} indigo_delta_entry;
+
+struct indigo_delta_cache {
+	indigo_delta_entry *entries[DELTA_CACHE_SIZE];
+};
+
+static uint32_t delta_hash(const char *device, const char *name) {
+	uint32_t hash = 2166136261U;
+	while (*device)
+		hash = (hash ^ (uint8_t)*device++) * 16777619U;
+	hash = (hash ^ '.') * 16777619U;
+	while (*name)
+		hash = (hash ^ (uint8_t)*name++) * 16777619U;
+	return hash;
+}
+
+static void delta_values(indigo_property *property, indigo_item *item, uint64_t *values) {
+	// two words per item: value and target for numbers, hash and length for texts
+	values[0] = values[1] = 0;
+	switch (property->type) {
+		case INDIGO_TEXT_VECTOR: {
+			const char *text = indigo_get_text_item_value(item);
+			uint64_t hash = 14695981039346656037ULL;
+			uint64_t length = 0;
+			while (*text) {
+				hash = (hash ^ (uint8_t)*text++) * 1099511628211ULL;
+				length++;
+			}
+			values[0] = hash;
+			values[1] = length;
+			break;
+		}
+		case INDIGO_NUMBER_VECTOR:
+			memcpy(values, &item->number.value, sizeof(double));
+			memcpy(values + 1, &item->number.target, sizeof(double));
+			break;
+		case INDIGO_LIGHT_VECTOR:
+			values[0] = item->light.value;
+			break;
+		default:
+			break;
 	}
+}
+
+static indigo_delta_entry *delta_entry(struct indigo_delta_cache **cache, indigo_property *property) {
+	if (*cache == NULL)
+		*cache = indigo_safe_malloc(sizeof(struct indigo_delta_cache));
+	uint32_t hash = delta_hash(property->device, property->name);
+	indigo_delta_entry **bucket = (*cache)->entries + hash % DELTA_CACHE_SIZE;
+	for (indigo_delta_entry *entry = *bucket; entry; entry = entry->next) {
+		if (entry->hash == hash && !strcmp(entry->device, property->device) && !strcmp(entry->name, property->name))
+			return entry;
+	}
+	indigo_delta_entry *entry = indigo_safe_malloc(sizeof(indigo_delta_entry));
+	entry->hash = hash;
+	memcpy(entry->device, property->device, INDIGO_NAME_SIZE);
+	memcpy(entry->name, property->name, INDIGO_NAME_SIZE);
+	entry->next = *bucket;
+	*bucket = entry;
+	return entry;
+}
+
+static indigo_delta_item *delta_item(indigo_delta_entry *entry, int index, const char *name, bool *created) {
+	// items are matched by name, partial (e.g. relayed) vectors have different items at the same index
+	*created = false;
+	if (index < entry->count && !strcmp(entry->items[index].name, name))
+		return entry->items + index;
+	for (int i = 0; i < entry->count; i++) {
+		if (!strcmp(entry->items[i].name, name))
+			return entry->items + i;
+	}
+	if (entry->count == entry->size) {
+		entry->size = entry->size ? 2 * entry->size : 8;
+		entry->items = indigo_safe_realloc(entry->items, entry->size * sizeof(indigo_delta_item));
+	}
+	indigo_delta_item *item = entry->items + entry->count++;
+	indigo_copy_name(item->name, name);
+	*created = true;
+	return item;
+}
 
-	count = sscanf(http_line, "HTTP/1.1 %d %255[^\n]", &http_result, http_response);
-	if ((count != 2) || (http_result != 200)) {
-		INDIGO_DEBUG(indigo_debug("%s(): http_line = \"%s\"", __FUNCTION__, http_line));
-		goto clean_return;
+void indigo_delta_define(struct indigo_delta_cache **cache, indigo_property *property) {
+	if (property->type != INDIGO_TEXT_VECTOR && property->type != INDIGO_NUMBER_VECTOR && property->type != INDIGO_LIGHT_VECTOR)
+		return;
+	indigo_delta_entry *entry = delta_entry(cache, property);
+	entry->count = 0;
+	for (int i = 0; i < property->count; i++) {
+		bool created;
+		indigo_delta_item *item = delta_item(entry, i, property->items[i].name, &created);
+		delta_values(property, property->items + i, item->values);
 	}
-	INDIGO_DEBUG(indigo_debug("%s(): http_result = %d, response = \"%s\"", __FUNCTION__, http_result, http_response));
+}
 
-	do {
-		res = indigo_read_line(socket, http_line, BUFFER_SIZE);
-		if (res < 0) {
-			res = false;
-			goto clean_return;
+int indigo_delta_changes(struct indigo_delta_cache **cache, indigo_property *property, bool *changed) {
+	if (property->type != INDIGO_TEXT_VECTOR && property->type != INDIGO_NUMBER_VECTOR && property->type != INDIGO_LIGHT_VECTOR) {
+		for (int i = 0; i < property->count; i++)
+			changed[i] = true;
+		return property->count;
+	}
+	indigo_delta_entry *entry = delta_entry(cache, property);
+	int count = 0;
+	for (int i = 0; i < property->count; i++) {
+		bool created;
+		uint64_t values[2];
+		delta_values(property, property->items + i, values);
+		uint64_t *last = delta_item(entry, i, property->items[i].name, &created)->values;
+		changed[i] = created || values[0] != last[0] || values[1] != last[1];
+		if (changed[i]) {
+			last[0] = values[0];
+			last[1] = values[1];
+			count++;
 		}
-		INDIGO_DEBUG(indigo_debug("%s(): http_line = \"%s\"", __FUNCTION__, http_line));
-		count = sscanf(http_line, "Content-Length: %20ld[^\n]", &content_len);
-	} while (http_line[0] != '\0');
-
-	INDIGO_DEBUG(indigo_debug("%s(): content_len = %ld", __FUNCTION__, content_len));
-
-	if (content_len) {
-		image_type = strrchr(file, '.');
-		if (image_type)
-			indigo_copy_name(blob_item->blob.format, image_type);
-		blob_item->blob.size = content_len;
-		blob_item->blob.value = indigo_safe_realloc(blob_item->blob.value, blob_item->blob.size);
-		res = (indigo_read(socket, blob_item->blob.value, blob_item->blob.size) >= 0) ? true : false;
-	} else {
-		res = false;
 	}
+	return count;
+}
 
-clean_return:
-	INDIGO_DEBUG(indigo_debug("%s() -> %s", __FUNCTION__, res ? "OK" : "Failed"));
-	if (socket >= 0) {
-#if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
-		shutdown(socket, SHUT_RDWR);
-		close(socket);
-#endif
-#if defined(INDIGO_WINDOWS)
-		shutdown(socket, SD_BOTH);
-		closesocket(socket);
-#endif
+void indigo_delta_delete(struct indigo_delta_cache **cache, const char *device, const char *name) {
+	if (*cache == NULL)
+		return;
+	for (int i = 0; i < DELTA_CACHE_SIZE; i++) {
+		indigo_delta_entry **link = (*cache)->entries + i;
+		while (*link) {
+			indigo_delta_entry *entry = *link;
+			if (!strcmp(entry->device, device) && (*name == 0 || !strcmp(entry->name, name))) {
+				*link = entry->next;
+				free(entry->items);
+				free(entry);
+			} else {
+				link = &entry->next;
+			}
+		}
 	}
-	indigo_safe_free(host);
-	indigo_safe_free(file);
-	indigo_safe_free(request);
-	indigo_safe_free(http_line);
-	indigo_safe_free(http_response);
-	return res;
 }
 
+void indigo_delta_release(struct indigo_delta_cache **cache) {
+	if (*cache == NULL)
+		return;
+	for (int i = 0; i < DELTA_CACHE_SIZE; i++) {
+		indigo_delta_entry *entry = (*cache)->entries[i];
+		while (entry) {
+			indigo_delta_entry *next = entry->next;
+			free(entry->items);
+			free(entry);
+			entry = next;
+		}
+	}
+	free(*cache);
+	*cache = NULL;
+}
 
 bool indigo_property_match(indigo_property *property, indigo_property *other) {
 	if (property == NULL)
@@ -1353,18 +2385,228 @@ bool indigo_handle_property_async(
 	phd->client = client;
 	phd->property = property;
 
-	return INDIGO_ASYNC(_indigo_handle_property_async, phd);
+	// handlers for the same device are executed in order
+	return indigo_async_queue(device, (void *(*)(void *))_indigo_handle_property_async, phd);
+}
+
+// Jobs are executed by a bounded pool of threads started on demand and stopped after being idle for a while.
+// Jobs with the same queue key are chained in the key queue and only the first one is in the pool queue,
+// the next one is moved there when the previous one finishes. If all threads are busy and the oldest job waits
+// too long (e.g. some job blocks), an extra thread is started to avoid deadlock.
+
+#define ASYNC_IDLE_TIMEOUT			30
+#define ASYNC_STARVATION_TIME		1.0
+#define ASYNC_MAX_OVERFLOW			64
+
+typedef struct async_job {
+	void *(*fun)(void *data);
+	void *data;
+	struct async_key_queue *key_queue;
+	double queued;
+	struct async_job *next;
+	struct async_job *key_next;
+} async_job;
+
+typedef struct async_key_queue {
+	void *key;
+	async_job *head, *tail;
+	struct async_key_queue *next;
+} async_key_queue;
+
+int indigo_async_pool_size = 0;
+
+static pthread_mutex_t async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;
+static async_job *async_head = NULL, *async_tail = NULL;
+static async_key_queue *async_key_queues = NULL;
+static bool async_supervisor_running = false;
+static indigo_async_statistics async_statistics;
+static double async_latency_sum = 0;
+static int async_runnable = 0;
+
+static double async_time(void) {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int async_pool_size(void) {
+	if (indigo_async_pool_size > 0)
+		return indigo_async_pool_size;
+#if defined(INDIGO_WINDOWS)
+	return 8;
+#else
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 2 ? 2 * (int)cores : 4;
+#endif
+}
+
+static void async_enqueue(async_job *job) {
+	job->next = NULL;
+	if (async_tail)
+		async_tail->next = job;
+	else
+		async_head = job;
+	async_tail = job;
+	async_runnable++;
+}
+
+static void *async_worker(void *arg);
+
+static bool async_start_thread(void) {
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, async_worker, NULL) == 0) {
+		pthread_detach(thread);
+		async_statistics.threads++;
+		return true;
+	}
+	return false;
+}
+
+static void *async_supervisor(void *arg) {
+	pthread_mutex_lock(&async_mutex);
+	while (async_head) {
+		pthread_mutex_unlock(&async_mutex);
+		indigo_usleep(ONE_SECOND_DELAY / 4);
+		pthread_mutex_lock(&async_mutex);
+		if (async_head && async_statistics.busy == async_statistics.threads && async_time() - async_head->queued > ASYNC_STARVATION_TIME && async_statistics.threads < async_pool_size() + ASYNC_MAX_OVERFLOW) {
+			if (async_start_thread()) {
+				async_statistics.overflows++;
+				INDIGO_LOG(indigo_log("indigo_async(): pool exhausted, extra thread started (%d threads)", async_statistics.threads));
+			}
+		}
+	}
+	async_supervisor_running = false;
+	pthread_mutex_unlock(&async_mutex);
+	return NULL;
+}
+
+static void *async_worker(void *arg) {
+	pthread_mutex_lock(&async_mutex);
+	while (true) {
+		while (async_head == NULL) {
+			struct timespec timeout;
+			clock_gettime(CLOCK_REALTIME, &timeout);
+			timeout.tv_sec += ASYNC_IDLE_TIMEOUT;
+			if (pthread_cond_timedwait(&async_cond, &async_mutex, &timeout) == ETIMEDOUT && async_head == NULL) {
+				async_statistics.threads--;
+				pthread_mutex_unlock(&async_mutex);
+				return NULL;
+			}
+		}
+		async_job *job = async_head;
+		if ((async_head = job->next) == NULL)
+			async_tail = NULL;
+		async_runnable--;
+		async_statistics.queued--;
+		async_statistics.busy++;
+		double latency = async_time() - job->queued;
+		async_latency_sum += latency;
+		if (latency > async_statistics.max_queue_latency)
+			async_statistics.max_queue_latency = latency;
+		pthread_mutex_unlock(&async_mutex);
+		job->fun(job->data);
+		pthread_mutex_lock(&async_mutex);
+		async_statistics.busy--;
+		async_statistics.jobs++;
+		async_statistics.queue_latency = async_latency_sum / async_statistics.jobs;
+		async_key_queue *key_queue = job->key_queue;
+		if (key_queue) {
+			if ((key_queue->head = key_queue->head->key_next) == NULL) {
+				key_queue->tail = NULL;
+				for (async_key_queue **pointer = &async_key_queues; *pointer; pointer = &(*pointer)->next) {
+					if (*pointer == key_queue) {
+						*pointer = key_queue->next;
+						break;
+					}
+				}
+				free(key_queue);
+			} else {
+				// next job for the same key keeps its original time to report its real latency
+				async_enqueue(key_queue->head);
+				pthread_cond_signal(&async_cond);
+			}
+		}
+		free(job);
+	}
+}
+
+bool indigo_async_queue(void *key, void *fun(void *data), void *data) {
+	async_job *job = indigo_safe_malloc(sizeof(async_job));
+	job->fun = fun;
+	job->data = data;
+	job->queued = async_time();
+	job->key_next = NULL;
+	job->key_queue = NULL;
+	pthread_mutex_lock(&async_mutex);
+	async_statistics.queued++;
+	if (key) {
+		async_key_queue *key_queue = async_key_queues;
+		while (key_queue && key_queue->key != key)
+			key_queue = key_queue->next;
+		job->key_queue = key_queue;
+		if (key_queue) {
+			// previous job for the same key is queued or running, append to key queue only
+			key_queue->tail->key_next = job;
+			key_queue->tail = job;
+			pthread_mutex_unlock(&async_mutex);
+			return true;
+		}
+		key_queue = indigo_safe_malloc(sizeof(async_key_queue));
+		key_queue->key = key;
+		key_queue->head = key_queue->tail = job;
+		key_queue->next = async_key_queues;
+		async_key_queues = key_queue;
+		job->key_queue = key_queue;
+	}
+	async_enqueue(job);
+	if (async_statistics.threads - async_statistics.busy < async_runnable && async_statistics.threads < async_pool_size())
+		async_start_thread();
+	if (async_statistics.threads == 0) {
+		// thread can't be started at all
+		async_head = async_tail = NULL;
+		async_runnable--;
+		async_statistics.queued--;
+		if (job->key_queue) {
+			async_key_queues = job->key_queue->next;
+			free(job->key_queue);
+		}
+		free(job);
+		pthread_mutex_unlock(&async_mutex);
+		return false;
+	}
+	if (!async_supervisor_running && async_statistics.busy == async_statistics.threads) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, async_supervisor, NULL) == 0) {
+			pthread_detach(thread);
+			async_supervisor_running = true;
+		}
+	}
+	pthread_cond_signal(&async_cond);
+	pthread_mutex_unlock(&async_mutex);
+	return true;
 }
 
 bool indigo_async(void *fun(void *data), void *data) {
-	pthread_t async_thread;
-	if (pthread_create(&async_thread, NULL, fun, data) == 0) {
-		pthread_detach(async_thread);
+	return indigo_async_queue(NULL, fun, data);
+}
+
+bool indigo_start_thread(void *fun(void *data), void *data) {
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, fun, data) == 0) {
+		pthread_detach(thread);
 		return true;
 	}
 	return false;
 }
 
+void indigo_get_async_statistics(indigo_async_statistics *statistics) {
+	pthread_mutex_lock(&async_mutex);
+	*statistics = async_statistics;
+	statistics->pool_size = async_pool_size();
+	pthread_mutex_unlock(&async_mutex);
+}
+
 double indigo_stod(char *string) {
 	char copy[128];
 	strncpy(copy, string, 128);
@@ -19,7 +19,7 @@
 // version history
 // 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
 
-/** INDIGO Mount control agent
+/** INDIGO star and DSO catalog
  \file indigo_cat_data.c
  */
 
@@ -28,10 +28,22 @@
 #include <string.h>
 #include <zlib.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <indigo/indigo_server_tcp.h>
+#include <indigo/indigo_io.h>
 #include <indigo/indigo_novas.h>
-#include "indigo_cat_data.h"
+#include <indigo/indigo_cat_data.h>
 
 indigo_star_entry indigo_star_data[] = {
 	{ 3, 0.0003, 38.8593, 5.24, -2.91, 2.81, 3e-06, 6.61, NULL },
@@ -41292,6 +41304,398 @@ static double h2deg(double ra) {
 	return ra > 12 ? (ra - 24) * 15 : ra * 15;
 }
 
+// -------------------------------------------------------------------------------- Catalog index
+
+// derived data (unit vectors, declination zones sorted by magnitude, HIP lookup and apparent places for the current day)
+// are kept in ~/.indigo/catalog.bin and memory-mapped; the file is rebuilt when the catalog or the day changes
+
+#define CATALOG_MAGIC				0x47544143
+#define CATALOG_VERSION			1
+#define ZONE_COUNT					180
+#define DEG2RAD							(M_PI / 180.0)
+#define RAD2DEG							(180.0 / M_PI)
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t hash;
+	uint32_t star_count;
+	uint32_t dso_count;
+	int32_t day;
+} catalog_header;
+
+typedef struct {
+	void *data;
+	size_t size;
+	bool mapped;
+	catalog_header *header;
+	uint32_t *star_zone_start;
+	uint32_t *star_zone_order;
+	uint32_t *star_mag_order;
+	uint32_t *star_hip_order;
+	double (*star_vectors)[3];
+	double (*star_apparent)[2];
+	uint32_t *dso_zone_start;
+	uint32_t *dso_zone_order;
+	double (*dso_vectors)[3];
+	double (*dso_apparent)[2];
+} catalog_index;
+
+// current generation is published with atomic pointer store, so queries don't take catalog_mutex
+static catalog_index *catalog, *retired_catalog;
+static bool catalog_rebuilding;
+static pthread_mutex_t catalog_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t catalog_layout(catalog_index *index, void *data, uint32_t star_count, uint32_t dso_count) {
+	char *base = data, *ptr = base + sizeof(catalog_header);
+	index->header = data;
+	index->star_zone_start = (uint32_t *)ptr; ptr += (ZONE_COUNT + 1) * sizeof(uint32_t);
+	index->star_zone_order = (uint32_t *)ptr; ptr += star_count * sizeof(uint32_t);
+	index->star_mag_order = (uint32_t *)ptr; ptr += star_count * sizeof(uint32_t);
+	index->star_hip_order = (uint32_t *)ptr; ptr += star_count * sizeof(uint32_t);
+	index->dso_zone_start = (uint32_t *)ptr; ptr += (ZONE_COUNT + 1) * sizeof(uint32_t);
+	index->dso_zone_order = (uint32_t *)ptr; ptr += dso_count * sizeof(uint32_t);
+	ptr = base + ((ptr - base + 7) & ~7);
+	index->star_vectors = (double (*)[3])ptr; ptr += star_count * sizeof(double[3]);
+	index->star_apparent = (double (*)[2])ptr; ptr += star_count * sizeof(double[2]);
+	index->dso_vectors = (double (*)[3])ptr; ptr += dso_count * sizeof(double[3]);
+	index->dso_apparent = (double (*)[2])ptr; ptr += dso_count * sizeof(double[2]);
+	return ptr - base;
+}
+
+static uint32_t catalog_hash(uint32_t *star_count, uint32_t *dso_count) {
+	uint32_t hash = 2166136261u;
+	int i;
+	for (i = 0; indigo_star_data[i].hip; i++) {
+		float values[4] = { indigo_star_data[i].hip, indigo_star_data[i].ra, indigo_star_data[i].dec, indigo_star_data[i].mag };
+		for (int j = 0; j < sizeof(values); j++)
+			hash = (hash ^ ((unsigned char *)values)[j]) * 16777619u;
+	}
+	*star_count = i;
+	for (i = 0; indigo_dso_data[i].id; i++) {
+		float values[3] = { indigo_dso_data[i].ra, indigo_dso_data[i].dec, indigo_dso_data[i].mag };
+		for (int j = 0; j < sizeof(values); j++)
+			hash = (hash ^ ((unsigned char *)values)[j]) * 16777619u;
+	}
+	*dso_count = i;
+	return hash;
+}
+
+static inline int dec_zone(double dec) {
+	int zone = (int)(dec + 90);
+	return zone < 0 ? 0 : (zone >= ZONE_COUNT ? ZONE_COUNT - 1 : zone);
+}
+
+static void radec_to_vector(double ra, double dec, double *v) {
+	ra *= 15 * DEG2RAD;
+	dec *= DEG2RAD;
+	v[0] = cos(dec) * cos(ra);
+	v[1] = cos(dec) * sin(ra);
+	v[2] = sin(dec);
+}
+
+static int compare_star_zone(const void *a, const void *b) {
+	indigo_star_entry *sa = indigo_star_data + *(uint32_t *)a, *sb = indigo_star_data + *(uint32_t *)b;
+	int za = dec_zone(sa->dec), zb = dec_zone(sb->dec);
+	if (za != zb)
+		return za - zb;
+	return sa->mag < sb->mag ? -1 : (sa->mag > sb->mag ? 1 : 0);
+}
+
+static int compare_star_mag(const void *a, const void *b) {
+	indigo_star_entry *sa = indigo_star_data + *(uint32_t *)a, *sb = indigo_star_data + *(uint32_t *)b;
+	return sa->mag < sb->mag ? -1 : (sa->mag > sb->mag ? 1 : 0);
+}
+
+static int compare_star_hip(const void *a, const void *b) {
+	return indigo_star_data[*(uint32_t *)a].hip - indigo_star_data[*(uint32_t *)b].hip;
+}
+
+static int compare_dso_zone(const void *a, const void *b) {
+	indigo_dso_entry *sa = indigo_dso_data + *(uint32_t *)a, *sb = indigo_dso_data + *(uint32_t *)b;
+	int za = dec_zone(sa->dec), zb = dec_zone(sb->dec);
+	if (za != zb)
+		return za - zb;
+	return sa->mag < sb->mag ? -1 : (sa->mag > sb->mag ? 1 : 0);
+}
+
+static void build_zones(uint32_t *order, uint32_t *start, uint32_t count, int (*compare)(const void *, const void *), double (*dec_of)(uint32_t)) {
+	for (uint32_t i = 0; i < count; i++)
+		order[i] = i;
+	qsort(order, count, sizeof(uint32_t), compare);
+	for (uint32_t i = 0, zone = 0; zone <= ZONE_COUNT; zone++) {
+		while (i < count && dec_zone(dec_of(order[i])) < zone)
+			i++;
+		start[zone] = i;
+	}
+}
+
+static double star_dec(uint32_t i) {
+	return indigo_star_data[i].dec;
+}
+
+static double dso_dec(uint32_t i) {
+	return indigo_dso_data[i].dec;
+}
+
+static bool catalog_build(catalog_index *index, const char *path, uint32_t hash, uint32_t star_count, uint32_t dso_count, int32_t day) {
+	catalog_index tmp;
+	size_t size = catalog_layout(&tmp, NULL, star_count, dso_count);
+	void *data = indigo_safe_malloc(size);
+	catalog_layout(index, data, star_count, dso_count);
+	index->data = data;
+	index->size = size;
+	index->mapped = false;
+	*index->header = (catalog_header){ CATALOG_MAGIC, CATALOG_VERSION, hash, star_count, dso_count, day };
+	build_zones(index->star_zone_order, index->star_zone_start, star_count, compare_star_zone, star_dec);
+	build_zones(index->dso_zone_order, index->dso_zone_start, dso_count, compare_dso_zone, dso_dec);
+	for (uint32_t i = 0; i < star_count; i++)
+		index->star_mag_order[i] = index->star_hip_order[i] = i;
+	qsort(index->star_mag_order, star_count, sizeof(uint32_t), compare_star_mag);
+	qsort(index->star_hip_order, star_count, sizeof(uint32_t), compare_star_hip);
+	// apparent places are evaluated at noon UT of the given day, precession and nutation change less than 0.1" per day
+	time_t noon = (time_t)day * 86400 + 43200;
+	uint32_t max_count = star_count > dso_count ? star_count : dso_count;
+	double *ra = indigo_safe_malloc(6 * max_count * sizeof(double));
+	double *dec = ra + max_count, *promora = dec + max_count, *promodec = promora + max_count, *px = promodec + max_count, *rv = px + max_count;
+	for (uint32_t i = 0; i < star_count; i++) {
+		indigo_star_entry *star = indigo_star_data + i;
+		radec_to_vector(star->ra, star->dec, index->star_vectors[i]);
+		ra[i] = star->ra;
+		dec[i] = star->dec;
+		promora[i] = star->promora;
+		promodec[i] = star->promodec;
+		px[i] = star->px;
+		rv[i] = star->rv;
+	}
+	indigo_app_star_batch(&noon, star_count, promora, promodec, px, rv, ra, dec);
+	for (uint32_t i = 0; i < star_count; i++) {
+		index->star_apparent[i][0] = ra[i];
+		index->star_apparent[i][1] = dec[i];
+	}
+	for (uint32_t i = 0; i < dso_count; i++) {
+		indigo_dso_entry *dso = indigo_dso_data + i;
+		radec_to_vector(dso->ra, dso->dec, index->dso_vectors[i]);
+		ra[i] = dso->ra;
+		dec[i] = dso->dec;
+	}
+	indigo_app_star_batch(&noon, dso_count, NULL, NULL, NULL, NULL, ra, dec);
+	for (uint32_t i = 0; i < dso_count; i++) {
+		index->dso_apparent[i][0] = ra[i];
+		index->dso_apparent[i][1] = dec[i];
+	}
+	indigo_safe_free(ra);
+	if (path == NULL)
+		return false;
+	// write to temporary file and rename it to make the update atomic for other processes
+	char tmp_path[PATH_MAX + 16];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, getpid());
+	bool result = false;
+	int handle = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (handle >= 0) {
+		result = indigo_write(handle, (const char *)data, size);
+		close(handle);
+		if (result && rename(tmp_path, path))
+			result = false;
+		if (!result)
+			unlink(tmp_path);
+	}
+	return result;
+}
+
+static bool catalog_map(catalog_index *index, const char *path, uint32_t hash, uint32_t star_count, uint32_t dso_count, int32_t day) {
+	int handle = open(path, O_RDONLY);
+	if (handle < 0)
+		return false;
+	struct stat st;
+	catalog_index tmp;
+	size_t size = catalog_layout(&tmp, NULL, star_count, dso_count);
+	if (fstat(handle, &st) || st.st_size != size) {
+		close(handle);
+		return false;
+	}
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, handle, 0);
+	close(handle);
+	if (mapping == MAP_FAILED)
+		return false;
+	catalog_header *header = mapping;
+	if (header->magic != CATALOG_MAGIC || header->version != CATALOG_VERSION || header->hash != hash || header->star_count != star_count || header->dso_count != dso_count || header->day != day) {
+		munmap(mapping, size);
+		return false;
+	}
+	catalog_layout(index, mapping, star_count, dso_count);
+	index->data = mapping;
+	index->size = size;
+	index->mapped = true;
+	return true;
+}
+
+static void catalog_release(catalog_index *index) {
+	if (index->data) {
+		if (index->mapped)
+			munmap(index->data, index->size);
+		else
+			free(index->data);
+	}
+	memset(index, 0, sizeof(catalog_index));
+}
+
+static catalog_index *catalog_load(int32_t day) {
+	static uint32_t hash, star_count, dso_count;
+	if (hash == 0)
+		hash = catalog_hash(&star_count, &dso_count);
+	catalog_index *index = indigo_safe_malloc(sizeof(catalog_index));
+	char path[PATH_MAX], *home = getenv("HOME");
+	if (home) {
+		snprintf(path, sizeof(path), "%s/.indigo", home);
+		mkdir(path, 0777);
+		snprintf(path, sizeof(path), "%s/.indigo/catalog.bin", home);
+	}
+	if (home == NULL || !catalog_map(index, path, hash, star_count, dso_count, day)) {
+		if (catalog_build(index, home ? path : NULL, hash, star_count, dso_count, day)) {
+			catalog_index built = *index;
+			if (catalog_map(index, path, hash, star_count, dso_count, day))
+				catalog_release(&built);
+			else
+				*index = built;
+			INDIGO_LOG(indigo_log("Catalog index %s created", path));
+		} else {
+			INDIGO_ERROR(indigo_error("Can't write catalog index, using in-memory copy"));
+		}
+	}
+	return index;
+}
+
+// call with catalog_mutex locked
+static void catalog_publish(catalog_index *index) {
+	// previous generation stays valid for callers which obtained it before the rollover
+	if (retired_catalog) {
+		catalog_release(retired_catalog);
+		free(retired_catalog);
+	}
+	retired_catalog = catalog;
+	__atomic_store_n(&catalog, index, __ATOMIC_RELEASE);
+}
+
+static void *catalog_rebuild_worker(void *arg) {
+	catalog_index *index = catalog_load((int32_t)(intptr_t)arg);
+	pthread_mutex_lock(&catalog_mutex);
+	catalog_publish(index);
+	catalog_rebuilding = false;
+	pthread_mutex_unlock(&catalog_mutex);
+	return NULL;
+}
+
+static void catalog_get(catalog_index *index) {
+	int32_t day = (int32_t)(time(NULL) / 86400);
+	catalog_index *current = __atomic_load_n(&catalog, __ATOMIC_ACQUIRE);
+	if (current == NULL) {
+		// the very first query has to wait for the index
+		pthread_mutex_lock(&catalog_mutex);
+		if (catalog == NULL)
+			catalog_publish(catalog_load(day));
+		current = catalog;
+		pthread_mutex_unlock(&catalog_mutex);
+	} else if (current->header->day != day && !__atomic_load_n(&catalog_rebuilding, __ATOMIC_ACQUIRE)) {
+		// on day rollover the index is rebuilt in background, queries use apparent places for the previous day meanwhile
+		pthread_mutex_lock(&catalog_mutex);
+		if (!catalog_rebuilding && catalog->header->day != day) {
+			pthread_t thread;
+			catalog_rebuilding = true;
+			if (pthread_create(&thread, NULL, catalog_rebuild_worker, (void *)(intptr_t)day) == 0)
+				pthread_detach(thread);
+			else
+				catalog_rebuilding = false;
+		}
+		pthread_mutex_unlock(&catalog_mutex);
+	}
+	*index = *current;
+}
+
+static int cone_search(uint32_t *zone_start, uint32_t *zone_order, double (*vectors)[3], float (*mag_of)(uint32_t), double ra, double dec, double radius, double max_mag, void *entries, size_t entry_size, void **result, int max_count) {
+	double v[3], cos_radius = cos(radius * DEG2RAD);
+	radec_to_vector(ra, dec, v);
+	int first = dec_zone(dec - radius), last = dec_zone(dec + radius), count = 0;
+	for (int zone = first; zone <= last && count < max_count; zone++) {
+		for (uint32_t i = zone_start[zone]; i < zone_start[zone + 1] && count < max_count; i++) {
+			uint32_t entry = zone_order[i];
+			// zones are sorted by magnitude, the rest of the zone is fainter
+			if (mag_of(entry) > max_mag)
+				break;
+			double *w = vectors[entry];
+			if (v[0] * w[0] + v[1] * w[1] + v[2] * w[2] >= cos_radius)
+				result[count++] = (char *)entries + entry * entry_size;
+		}
+	}
+	return count;
+}
+
+static float star_mag(uint32_t i) {
+	return indigo_star_data[i].mag;
+}
+
+static float dso_mag(uint32_t i) {
+	return indigo_dso_data[i].mag;
+}
+
+int indigo_cat_star_cone_search(double ra, double dec, double radius, double max_mag, indigo_star_entry **result, int max_count) {
+	catalog_index index;
+	catalog_get(&index);
+	return cone_search(index.star_zone_start, index.star_zone_order, index.star_vectors, star_mag, ra, dec, radius, max_mag, indigo_star_data, sizeof(indigo_star_entry), (void **)result, max_count);
+}
+
+int indigo_cat_dso_cone_search(double ra, double dec, double radius, double max_mag, indigo_dso_entry **result, int max_count) {
+	catalog_index index;
+	catalog_get(&index);
+	return cone_search(index.dso_zone_start, index.dso_zone_order, index.dso_vectors, dso_mag, ra, dec, radius, max_mag, indigo_dso_data, sizeof(indigo_dso_entry), (void **)result, max_count);
+}
+
+int indigo_cat_star_mag_search(double max_mag, indigo_star_entry **result, int max_count) {
+	catalog_index index;
+	catalog_get(&index);
+	int count = 0;
+	for (uint32_t i = 0; i < index.header->star_count && count < max_count; i++) {
+		indigo_star_entry *star = indigo_star_data + index.star_mag_order[i];
+		if (star->mag > max_mag)
+			break;
+		result[count++] = star;
+	}
+	return count;
+}
+
+indigo_star_entry *indigo_cat_star_by_hip(int hip) {
+	catalog_index index;
+	catalog_get(&index);
+	int low = 0, high = (int)index.header->star_count - 1;
+	while (low <= high) {
+		int middle = (low + high) / 2;
+		indigo_star_entry *star = indigo_star_data + index.star_hip_order[middle];
+		if (star->hip == hip)
+			return star;
+		if (star->hip < hip)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+	return NULL;
+}
+
+void indigo_cat_star_apparent_position(indigo_star_entry *star, double *ra, double *dec) {
+	catalog_index index;
+	catalog_get(&index);
+	double *position = index.star_apparent[star - indigo_star_data];
+	*ra = position[0];
+	*dec = position[1];
+}
+
+void indigo_cat_dso_apparent_position(indigo_dso_entry *dso, double *ra, double *dec) {
+	catalog_index index;
+	catalog_get(&index);
+	double *position = index.dso_apparent[dso - indigo_dso_data];
+	*ra = position[0];
+	*dec = position[1];
+}
+
 static void indigo_compress(char *name, char *buffer, unsigned size, unsigned char **data, unsigned *data_size) {
 	z_stream defstream;
 	defstream.zalloc = Z_NULL;
@@ -41313,7 +41717,7 @@ static void indigo_compress(char *name, char *buffer, unsigned size, unsigned ch
 	*data = indigo_safe_realloc(*data, *data_size);
 }
 
-void *indigo_add_star_json_resource(int max_mag) {
+static unsigned char *build_star_json(int max_mag, unsigned *length) {
 	int buffer_size = 1024 * 1024;
 	char *buffer =  malloc(buffer_size);
 	strcpy(buffer, "{\"type\":\"FeatureCollection\",\"features\": [");
@@ -41322,9 +41726,8 @@ void *indigo_add_star_json_resource(int max_mag) {
 	for (int i = 0; indigo_star_data[i].hip; i++) {
 		if (indigo_star_data[i].mag > max_mag)
 			continue;
-		double ra = indigo_star_data[i].ra;
-		double dec = indigo_star_data[i].dec;
-		indigo_app_star(indigo_star_data[i].promora, indigo_star_data[i].promodec, indigo_star_data[i].px, indigo_star_data[i].rv, &ra, &dec);
+		double ra, dec;
+		indigo_cat_star_apparent_position(indigo_star_data + i, &ra, &dec);
     char desig[256] = "";
     char *name = "";
     if (indigo_star_data[i].name) {
@@ -41337,7 +41740,7 @@ void *indigo_add_star_json_resource(int max_mag) {
 				name = "";
 			}
     }
-		size += sprintf(buffer + size, "%s{\"type\":\"Feature\",\"id\":%d,\"properties\":{\"name\": \"%s\",\"desig\":\"%s\",\"mag\": %.2f,\"con\":\"\",\"bv\":0},\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f]}}", sep, indigo_star_data[i].hip, name, desig, indigo_star_data[i].mag, h2deg(indigo_star_data[i].ra = ra), indigo_star_data[i].dec = dec);
+		size += sprintf(buffer + size, "%s{\"type\":\"Feature\",\"id\":%d,\"properties\":{\"name\": \"%s\",\"desig\":\"%s\",\"mag\": %.2f,\"con\":\"\",\"bv\":0},\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f]}}", sep, indigo_star_data[i].hip, name, desig, indigo_star_data[i].mag, h2deg(ra), dec);
 		if (buffer_size - size < 1024) {
 			buffer = indigo_safe_realloc(buffer, buffer_size *= 2);
 		}
@@ -41348,11 +41751,11 @@ void *indigo_add_star_json_resource(int max_mag) {
 	unsigned data_size = buffer_size;
 	indigo_compress("stars.json", buffer, size, &data, &data_size);
 	free(buffer);
-	indigo_server_add_resource("/data/stars.json", data, (int)data_size, "application/json; charset=utf-8");
+	*length = data_size;
 	return data;
 }
 
-void *indigo_add_dso_json_resource(int max_mag) {
+static unsigned char *build_dso_json(int max_mag, unsigned *length) {
 	int buffer_size = 1024 * 1024;
 	char *buffer =  malloc(buffer_size);
 	strcpy(buffer, "{\"type\":\"FeatureCollection\",\"features\": [");
@@ -41361,10 +41764,9 @@ void *indigo_add_dso_json_resource(int max_mag) {
 	for (int i = 0; indigo_dso_data[i].id; i++) {
 		if (indigo_dso_data[i].mag > max_mag)
 			continue;
-		double ra = indigo_dso_data[i].ra;
-		double dec = indigo_dso_data[i].dec;
-		indigo_app_star(0, 0, 0, 0, &ra, &dec);
-		size += sprintf(buffer + size, "%s{\"type\":\"Feature\",\"id\":\"%s\",\"properties\":{\"name\": \"%s\",\"desig\": \"%s\",\"type\":\"oc\",\"mag\": %.2f},\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f]}}", sep, indigo_dso_data[i].id, indigo_dso_data[i].id, indigo_dso_data[i].name, indigo_dso_data[i].mag, h2deg(indigo_dso_data[i].ra = ra), indigo_dso_data[i].dec = dec);
+		double ra, dec;
+		indigo_cat_dso_apparent_position(indigo_dso_data + i, &ra, &dec);
+		size += sprintf(buffer + size, "%s{\"type\":\"Feature\",\"id\":\"%s\",\"properties\":{\"name\": \"%s\",\"desig\": \"%s\",\"type\":\"oc\",\"mag\": %.2f},\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f]}}", sep, indigo_dso_data[i].id, indigo_dso_data[i].id, indigo_dso_data[i].name, indigo_dso_data[i].mag, h2deg(ra), dec);
 		if (buffer_size - size < 1024) {
 			buffer = indigo_safe_realloc(buffer, buffer_size *= 2);
 		}
@@ -41373,38 +41775,40 @@ void *indigo_add_dso_json_resource(int max_mag) {
 	size += sprintf(buffer + size, "]}");
 	unsigned char *data = indigo_safe_malloc(buffer_size);
 	unsigned data_size = buffer_size;
-	indigo_compress("stars.json", buffer, size, &data, &data_size);
+	indigo_compress("dsos.json", buffer, size, &data, &data_size);
 	free(buffer);
-	indigo_server_add_resource("/data/dsos.json", data, (int)data_size, "application/json; charset=utf-8");
+	*length = data_size;
 	return data;
 }
 
+static char *multiline_sep;
+
 static int add_multiline(char *buffer, ...) {
 	int size = 0;
 	va_list ap;
 	va_start(ap, buffer);
 	char *sep = "";
-	static char *sep2 = "";
-	size += sprintf(buffer, "%s[", sep2);
-	sep2 = ",";
+	size += sprintf(buffer, "%s[", multiline_sep);
+	multiline_sep = ",";
 	for (int hip = va_arg(ap, int); hip; hip = va_arg(ap, int)) {
-		for (int i = 0; indigo_star_data[i].hip; i++) {
-			if (indigo_star_data[i].hip == hip) {
-				size += sprintf(buffer + size, "%s[%.4f,%.4f]", sep, h2deg(indigo_star_data[i].ra), indigo_star_data[i].dec);
-				sep = ",";
-				break;
-			}
+		indigo_star_entry *star = indigo_cat_star_by_hip(hip);
+		if (star) {
+			double ra, dec;
+			indigo_cat_star_apparent_position(star, &ra, &dec);
+			size += sprintf(buffer + size, "%s[%.4f,%.4f]", sep, h2deg(ra), dec);
+			sep = ",";
 		}
 	}
 	size += sprintf(buffer + size, "]");
 	return size;
 }
 
-void *indigo_add_constellations_lines_json_resource() {
+static unsigned char *build_constellations_lines_json(int max_mag, unsigned *length) {
 	int buffer_size = 1024 * 1024;
 	char *buffer =  malloc(buffer_size);
 	strcpy(buffer, "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"id\":\"Const\",\"properties\":{},\"geometry\":{\"type\":\"MultiLineString\",\"coordinates\":[");
 	unsigned size = (unsigned)strlen(buffer);
+	multiline_sep = "";
 	size += add_multiline(buffer + size, 25428, 20889, 20455, 20205, 20894, 21421, 26451, 0);
 	size += add_multiline(buffer + size, 114341, 113136, 112716, 112961, 111497, 110960, 110395, 109074, 106278, 102618, 0);
 	size += add_multiline(buffer + size, 78384, 76297, 75264, 74376, 74395, 0);
@@ -41528,6 +41932,145 @@ void *indigo_add_constellations_lines_json_resource() {
 	unsigned data_size = buffer_size;
 	indigo_compress("constellations.lines.json", buffer, size, &data, &data_size);
 	free(buffer);
-	indigo_server_add_resource("/data/constellations.lines.json", data, (int)data_size, "application/json; charset=utf-8");
+	*length = data_size;
 	return data;
 }
+
+// -------------------------------------------------------------------------------- Lazy JSON resources
+
+// resources are generated on the first request and stored to ~/.indigo/<name>.cache prefixed by a key
+// identifying the build and the day, so the next server start just maps the file
+
+#define JSON_CACHE_KEY_SIZE		64
+
+static struct json_resource {
+	const char *path;
+	const char *file_name;
+	unsigned char *(*build)(int max_mag, unsigned *length);
+	int max_mag;
+	int32_t day;
+	unsigned char *data;
+	unsigned length;
+	void *mapping;
+	size_t mapping_size;
+	void *retired;
+	size_t retired_size;
+} json_resources[] = {
+	{ "/data/stars.json", "stars.json", build_star_json },
+	{ "/data/dsos.json", "dsos.json", build_dso_json },
+	{ "/data/constellations.lines.json", "constellations.lines.json", build_constellations_lines_json }
+};
+
+static pthread_mutex_t json_resource_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void json_resource_release(struct json_resource *resource) {
+	// previous generation stays valid for the request which may still be sending it
+	if (resource->retired_size)
+		munmap(resource->retired, resource->retired_size);
+	else
+		indigo_safe_free(resource->retired);
+	resource->retired = NULL;
+	if (resource->mapping) {
+		resource->retired = resource->mapping;
+		resource->retired_size = resource->mapping_size;
+		resource->mapping = NULL;
+	}
+	resource->data = NULL;
+	resource->length = 0;
+}
+
+static bool json_resource_map(struct json_resource *resource, const char *path, const char *key) {
+	int handle = open(path, O_RDONLY);
+	if (handle < 0)
+		return false;
+	struct stat st;
+	if (fstat(handle, &st) || st.st_size <= JSON_CACHE_KEY_SIZE) {
+		close(handle);
+		return false;
+	}
+	void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, handle, 0);
+	close(handle);
+	if (mapping == MAP_FAILED)
+		return false;
+	if (strncmp(mapping, key, JSON_CACHE_KEY_SIZE)) {
+		munmap(mapping, st.st_size);
+		return false;
+	}
+	resource->mapping = mapping;
+	resource->mapping_size = st.st_size;
+	resource->data = (unsigned char *)mapping + JSON_CACHE_KEY_SIZE;
+	resource->length = (unsigned)(st.st_size - JSON_CACHE_KEY_SIZE);
+	return true;
+}
+
+static unsigned char *json_resource_generator(const char *url, unsigned *length) {
+	int32_t day = (int32_t)(time(NULL) / 86400);
+	unsigned char *result = NULL;
+	pthread_mutex_lock(&json_resource_mutex);
+	for (int i = 0; i < sizeof(json_resources) / sizeof(struct json_resource); i++) {
+		struct json_resource *resource = json_resources + i;
+		if (strcmp(resource->path, url))
+			continue;
+		if (resource->data == NULL || resource->day != day) {
+			json_resource_release(resource);
+			resource->day = day;
+			char key[JSON_CACHE_KEY_SIZE] = { 0 }, path[PATH_MAX], *home = getenv("HOME");
+			snprintf(key, sizeof(key), "%s %s %s %d %d", INDIGO_BUILD, __DATE__, __TIME__, resource->max_mag, day);
+			snprintf(path, sizeof(path), "%s/.indigo/%s.cache", home ? home : ".", resource->file_name);
+			if (!json_resource_map(resource, path, key)) {
+				unsigned data_length;
+				unsigned char *data = resource->build(resource->max_mag, &data_length);
+				char tmp_path[PATH_MAX];
+				snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, getpid());
+				int handle = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+				if (handle >= 0) {
+					bool written = indigo_write(handle, key, sizeof(key)) && indigo_write(handle, (const char *)data, data_length);
+					close(handle);
+					if (!written || rename(tmp_path, path))
+						unlink(tmp_path);
+				}
+				if (!json_resource_map(resource, path, key)) {
+					INDIGO_ERROR(indigo_error("Can't cache %s in %s (%s)", url, path, strerror(errno)));
+					// keep data in memory, mapping_size == 0 marks it for free()
+					resource->mapping = data;
+					resource->mapping_size = 0;
+					resource->data = data;
+					resource->length = data_length;
+				} else {
+					free(data);
+				}
+			}
+		}
+		result = resource->data;
+		*length = resource->length;
+		break;
+	}
+	pthread_mutex_unlock(&json_resource_mutex);
+	return result;
+}
+
+static void json_resource_add(int index, int max_mag) {
+	json_resources[index].max_mag = max_mag;
+	indigo_server_add_generated_resource(json_resources[index].path, json_resource_generator, NULL, "application/json; charset=utf-8");
+}
+
+void indigo_add_star_json_resource(int max_mag) {
+	json_resource_add(0, max_mag);
+}
+
+void indigo_add_dso_json_resource(int max_mag) {
+	json_resource_add(1, max_mag);
+}
+
+void indigo_add_constellations_lines_json_resource() {
+	json_resource_add(2, 0);
+}
+
+void indigo_free_json_resources() {
+	pthread_mutex_lock(&json_resource_mutex);
+	for (int i = 0; i < sizeof(json_resources) / sizeof(struct json_resource); i++) {
+		json_resource_release(json_resources + i);
+		json_resource_release(json_resources + i);
+	}
+	pthread_mutex_unlock(&json_resource_mutex);
+}
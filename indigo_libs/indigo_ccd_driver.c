@@ -34,6 +34,7 @@
 #include <math.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #include <jpeglib.h>
 
 #include <indigo/indigo_ccd_driver.h>
@@ -41,6 +42,8 @@
 #include <indigo/indigo_tiff.h>
 #include <indigo/indigo_avi.h>
 #include <indigo/indigo_ser.h>
+#include <indigo/indigo_metrics.h>
+#include <indigo/indigo_image_pool.h>
 
 static void countdown_timer_callback(indigo_device *device) {
 	if (CCD_CONTEXT->countdown_enabled && CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE && CCD_EXPOSURE_ITEM->number.value >= 1) {
@@ -51,6 +54,11 @@ static void countdown_timer_callback(indigo_device *device) {
 	}
 }
 
+static void end_exposure_tracing(indigo_device *device) {
+	if (__atomic_exchange_n(&CCD_CONTEXT->exposure_traced, false, __ATOMIC_RELAXED))
+		INDIGO_TRACING_ASYNC_END("ccd", "exposure", device);
+}
+
 void indigo_ccd_suspend_countdown(indigo_device *device) {
 	CCD_CONTEXT->countdown_enabled = false;
 }
@@ -60,6 +68,264 @@ void indigo_ccd_resume_countdown(indigo_device *device) {
 	indigo_set_timer(device, 1.0, countdown_timer_callback, &CCD_CONTEXT->countdown_timer);
 }
 
+// -------------------------------------------------------------------------------- write-behind image saver
+
+#define SAVER_QUEUE_SIZE				8
+#define SAVER_QUEUE_BYTES				(1024L * 1024 * 1024)
+#define SAVER_IDLE_TIME					10
+#define SAVER_SEQUENCE_CACHE		16
+#define SAVER_DIRECT_IO_BLOCK		4096
+
+typedef struct saver_job {
+	indigo_device *device;
+	char file_name[INDIGO_VALUE_SIZE];
+	void *data;
+	unsigned long size;
+	bool use_fsync;
+	bool direct_io;
+	struct saver_job *next;
+} saver_job;
+
+static pthread_mutex_t saver_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t saver_queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t saver_done_cond = PTHREAD_COND_INITIALIZER;
+static saver_job *saver_queue = NULL;
+static indigo_device *saver_active_device = NULL;
+static int saver_queued = 0;
+static unsigned long saver_queued_bytes = 0;
+static bool saver_running = false;
+
+static pthread_mutex_t sequence_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+	char format[INDIGO_VALUE_SIZE];
+	int next;
+} sequence_cache[SAVER_SEQUENCE_CACHE];
+static int sequence_cache_last = 0;
+
+// find first unused sequence number for file name format, numbers already used by this process are skipped without probing the disk
+static void next_file_name(const char *format, int max, char *file_name) {
+	pthread_mutex_lock(&sequence_mutex);
+	int slot = -1;
+	for (int i = 0; i < SAVER_SEQUENCE_CACHE; i++) {
+		if (!strcmp(sequence_cache[i].format, format)) {
+			slot = i;
+			break;
+		}
+	}
+	if (slot < 0) {
+		slot = sequence_cache_last;
+		sequence_cache_last = (sequence_cache_last + 1) % SAVER_SEQUENCE_CACHE;
+		indigo_copy_value(sequence_cache[slot].format, format);
+		sequence_cache[slot].next = 1;
+	}
+	struct stat sb;
+	int i = sequence_cache[slot].next;
+	if (max > 0 && i >= max)
+		i = max - 1;
+	while (max == 0 || i < max - 1) {
+		snprintf(file_name, INDIGO_VALUE_SIZE, format, i);
+		if (stat(file_name, &sb) == 0 && S_ISREG(sb.st_mode))
+			i++;
+		else
+			break;
+	}
+	// the last number is reused if all are taken
+	snprintf(file_name, INDIGO_VALUE_SIZE, format, i);
+	sequence_cache[slot].next = i + 1;
+	pthread_mutex_unlock(&sequence_mutex);
+}
+
+static bool write_image_file(const char *file_name, void *data, unsigned long size, bool use_fsync, bool direct_io) {
+	int handle = -1;
+#ifdef O_DIRECT
+	if (direct_io) {
+		handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+		// not all file systems support direct I/O
+		if (handle < 0 && errno != EINVAL)
+			return false;
+	}
+#else
+	direct_io = false;
+#endif
+	if (handle < 0) {
+		direct_io = false;
+		handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (handle < 0)
+			return false;
+	}
+	bool result;
+	if (direct_io) {
+		// buffer is page aligned and its capacity is multiple of page size, so the tail can be padded to full block and truncated
+		unsigned long padded_size = (size + SAVER_DIRECT_IO_BLOCK - 1) / SAVER_DIRECT_IO_BLOCK * SAVER_DIRECT_IO_BLOCK;
+		memset((char *)data + size, 0, padded_size - size);
+		result = indigo_write(handle, data, padded_size) && ftruncate(handle, size) == 0;
+	} else {
+		result = indigo_write(handle, data, size);
+	}
+	if (result && use_fsync)
+		result = fsync(handle) == 0;
+	int saved_errno = errno;
+	close(handle);
+	errno = saved_errno;
+	return result;
+}
+
+// call with image_file_mutex locked
+static void record_throughput(indigo_device *device, unsigned long size, double duration) {
+	if (duration > 0) {
+		double throughput = size / 1048576.0 / duration;
+		CCD_CONTEXT->image_file_throughput = CCD_CONTEXT->image_file_throughput == 0 ? throughput : 0.8 * CCD_CONTEXT->image_file_throughput + 0.2 * throughput;
+	}
+}
+
+// call with saver_mutex locked
+static bool saver_has_queued(indigo_device *device) {
+	for (saver_job *job = saver_queue; job; job = job->next)
+		if (job->device == device)
+			return true;
+	return false;
+}
+
+// call with image_file_mutex locked
+static void update_saver_items(indigo_device *device) {
+	snprintf(CCD_IMAGE_FILE_THROUGHPUT_ITEM->text.value, INDIGO_VALUE_SIZE, "%.1f MB/s", CCD_CONTEXT->image_file_throughput);
+	snprintf(CCD_IMAGE_FILE_BACKLOG_ITEM->text.value, INDIGO_VALUE_SIZE, "%d files (%.1f MB)", CCD_CONTEXT->image_files_pending, CCD_CONTEXT->image_bytes_pending / 1048576.0);
+}
+
+static double image_stage_done(indigo_device *device, const char *stage, double start);
+
+static void *saver_worker(void *arg) {
+	pthread_mutex_lock(&saver_mutex);
+	while (true) {
+		if (saver_queue == NULL) {
+			struct timespec end;
+			clock_gettime(CLOCK_REALTIME, &end);
+			end.tv_sec += SAVER_IDLE_TIME;
+			if (pthread_cond_timedwait(&saver_queue_cond, &saver_mutex, &end) == ETIMEDOUT && saver_queue == NULL)
+				break;
+			continue;
+		}
+		saver_job *job = saver_queue;
+		saver_queue = job->next;
+		saver_active_device = job->device;
+		pthread_mutex_unlock(&saver_mutex);
+		indigo_device *device = job->device;
+		double start = indigo_metric_time();
+		bool result = write_image_file(job->file_name, job->data, job->size, job->use_fsync, job->direct_io);
+		char *message = result ? NULL : strerror(errno);
+		double duration = image_stage_done(device, "write", start);
+		indigo_release_image_buffer(job->data);
+		pthread_mutex_lock(&saver_mutex);
+		saver_queued--;
+		saver_queued_bytes -= job->size;
+		pthread_mutex_unlock(&saver_mutex);
+		INDIGO_DEBUG(indigo_debug("%s written in %gs", job->file_name, duration));
+		pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
+		CCD_CONTEXT->image_files_pending--;
+		CCD_CONTEXT->image_bytes_pending -= job->size;
+		if (result)
+			record_throughput(device, job->size, duration);
+		// file name of newer image queued meanwhile is kept, property stays busy until the last one is written
+		bool pending = CCD_CONTEXT->image_files_pending > 0;
+		if (!result || !pending)
+			indigo_copy_value(CCD_IMAGE_FILE_ITEM->text.value, job->file_name);
+		update_saver_items(device);
+		CCD_IMAGE_FILE_PROPERTY->state = result ? (pending ? INDIGO_BUSY_STATE : INDIGO_OK_STATE) : INDIGO_ALERT_STATE;
+		pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
+		// published without the lock, client callbacks may call back into the driver
+		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
+		free(job);
+		pthread_mutex_lock(&saver_mutex);
+		saver_active_device = NULL;
+		pthread_cond_broadcast(&saver_done_cond);
+	}
+	saver_running = false;
+	pthread_mutex_unlock(&saver_mutex);
+	return NULL;
+}
+
+// copy image to queue of write-behind saver, caller waits only if the queue is full
+static bool queue_image_file(indigo_device *device, const char *file_name, void *data, unsigned long size, bool use_fsync, bool direct_io) {
+	void *copy = indigo_alloc_image_buffer(size);
+	if (copy == NULL)
+		return false;
+	memcpy(copy, data, size);
+	saver_job *job = indigo_safe_malloc(sizeof(saver_job));
+	job->device = device;
+	indigo_copy_value(job->file_name, file_name);
+	job->data = copy;
+	job->size = size;
+	job->use_fsync = use_fsync;
+	job->direct_io = direct_io;
+	pthread_mutex_lock(&saver_mutex);
+	while (saver_queued > 0 && (saver_queued >= SAVER_QUEUE_SIZE || saver_queued_bytes + size > SAVER_QUEUE_BYTES))
+		pthread_cond_wait(&saver_done_cond, &saver_mutex);
+	saver_job **last = &saver_queue;
+	while (*last)
+		last = &(*last)->next;
+	*last = job;
+	saver_queued++;
+	saver_queued_bytes += size;
+	if (!saver_running) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, saver_worker, NULL) == 0) {
+			pthread_detach(thread);
+			saver_running = true;
+		} else {
+			*last = NULL;
+			saver_queued--;
+			saver_queued_bytes -= size;
+			pthread_mutex_unlock(&saver_mutex);
+			indigo_release_image_buffer(copy);
+			free(job);
+			return false;
+		}
+	} else {
+		pthread_cond_signal(&saver_queue_cond);
+	}
+	pthread_mutex_unlock(&saver_mutex);
+	return true;
+}
+
+static void wait_for_saved_images(indigo_device *device) {
+	pthread_mutex_lock(&saver_mutex);
+	while (saver_active_device == device || saver_has_queued(device))
+		pthread_cond_wait(&saver_done_cond, &saver_mutex);
+	pthread_mutex_unlock(&saver_mutex);
+}
+
+// save image either synchronously or by write-behind saver, returns NULL or error message, call with image_file_mutex locked
+static char *save_image_file(indigo_device *device, const char *file_name, void *data, unsigned long size) {
+	bool use_fsync = CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_FSYNC_ITEM->sw.value;
+	bool direct_io = CCD_LOCAL_SAVE_MODE_DIRECT_IO_ITEM->sw.value;
+	indigo_copy_value(CCD_IMAGE_FILE_ITEM->text.value, file_name);
+	if (!CCD_LOCAL_SAVE_MODE_SYNCHRONOUS_ITEM->sw.value) {
+		// image is accounted before it is queued, so the saver can't report it written before it is announced
+		CCD_CONTEXT->image_files_pending++;
+		CCD_CONTEXT->image_bytes_pending += size;
+		update_saver_items(device);
+		CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
+		// queue may block until saver writes some image, saver needs the mutex to report it
+		pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
+		bool queued = queue_image_file(device, file_name, data, size, use_fsync, direct_io);
+		pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
+		if (queued)
+			return NULL;
+		CCD_CONTEXT->image_files_pending--;
+		CCD_CONTEXT->image_bytes_pending -= size;
+		INDIGO_DEBUG(indigo_debug("Write-behind saver not available, %s is saved synchronously", file_name));
+	}
+	double start = indigo_metric_time();
+	if (write_image_file(file_name, data, size, use_fsync, false)) {
+		record_throughput(device, size, indigo_metric_time() - start);
+		update_saver_items(device);
+		CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
+		return NULL;
+	}
+	CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+	return strerror(errno);
+}
+
 void indigo_use_shortest_exposure_if_bias(indigo_device *device) {
 	if (CCD_FRAME_TYPE_BIAS_ITEM->sw.value) {
 		CCD_EXPOSURE_ITEM->number.value = CCD_EXPOSURE_ITEM->number.target = CCD_EXPOSURE_ITEM->number.min;
@@ -71,6 +337,7 @@ indigo_result indigo_ccd_attach(indigo_device *device, const char* driver_name,
 	assert(device != NULL);
 	if (CCD_CONTEXT == NULL) {
 		device->device_context = indigo_safe_malloc(sizeof(indigo_ccd_context));
+		pthread_mutex_init(&CCD_CONTEXT->image_file_mutex, NULL);
 	}
 	if (CCD_CONTEXT != NULL) {
 		if (indigo_device_attach(device, driver_name, version, INDIGO_INTERFACE_CCD) == INDIGO_OK) {
@@ -112,6 +379,14 @@ indigo_result indigo_ccd_attach(indigo_device *device, const char* driver_name,
 				return INDIGO_FAILED;
 			indigo_init_text_item(CCD_LOCAL_MODE_DIR_ITEM, CCD_LOCAL_MODE_DIR_ITEM_NAME, "Directory", "%s/", getenv("HOME"));
 			indigo_init_text_item(CCD_LOCAL_MODE_PREFIX_ITEM, CCD_LOCAL_MODE_PREFIX_ITEM_NAME, "File name prefix", "IMAGE_XXX");
+			// -------------------------------------------------------------------------------- CCD_LOCAL_SAVE_MODE
+			CCD_LOCAL_SAVE_MODE_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_LOCAL_SAVE_MODE_PROPERTY_NAME, CCD_MAIN_GROUP, "Save on server mode", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 4);
+			if (CCD_LOCAL_SAVE_MODE_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_switch_item(CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_ITEM, CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_ITEM_NAME, "Write-behind", true);
+			indigo_init_switch_item(CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_FSYNC_ITEM, CCD_LOCAL_SAVE_MODE_WRITE_BEHIND_FSYNC_ITEM_NAME, "Write-behind with fsync", false);
+			indigo_init_switch_item(CCD_LOCAL_SAVE_MODE_DIRECT_IO_ITEM, CCD_LOCAL_SAVE_MODE_DIRECT_IO_ITEM_NAME, "Write-behind, direct I/O", false);
+			indigo_init_switch_item(CCD_LOCAL_SAVE_MODE_SYNCHRONOUS_ITEM, CCD_LOCAL_SAVE_MODE_SYNCHRONOUS_ITEM_NAME, "Synchronous", false);
 			// -------------------------------------------------------------------------------- CCD_MODE
 			CCD_MODE_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_MODE_PROPERTY_NAME, CCD_MAIN_GROUP, "Capture mode", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 64);
 			if (CCD_MODE_PROPERTY == NULL)
@@ -218,10 +493,12 @@ indigo_result indigo_ccd_attach(indigo_device *device, const char* driver_name,
 			CCD_PREVIEW_HISTOGRAM_PROPERTY->hidden = true;
 			indigo_init_blob_item(CCD_PREVIEW_HISTOGRAM_ITEM, CCD_PREVIEW_HISTOGRAM_ITEM_NAME, "Image data");
 			// -------------------------------------------------------------------------------- CCD_LOCAL_FILE
-			CCD_IMAGE_FILE_PROPERTY = indigo_init_text_property(NULL, device->name, CCD_IMAGE_FILE_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image file info", INDIGO_OK_STATE, INDIGO_RO_PERM, 1);
+			CCD_IMAGE_FILE_PROPERTY = indigo_init_text_property(NULL, device->name, CCD_IMAGE_FILE_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image file info", INDIGO_OK_STATE, INDIGO_RO_PERM, 3);
 			if (CCD_IMAGE_FILE_PROPERTY == NULL)
 				return INDIGO_FAILED;
 			indigo_init_text_item(CCD_IMAGE_FILE_ITEM, CCD_IMAGE_FILE_ITEM_NAME, "Filename", "None");
+			indigo_init_text_item(CCD_IMAGE_FILE_THROUGHPUT_ITEM, CCD_IMAGE_FILE_THROUGHPUT_ITEM_NAME, "Disk throughput", "0.0 MB/s");
+			indigo_init_text_item(CCD_IMAGE_FILE_BACKLOG_ITEM, CCD_IMAGE_FILE_BACKLOG_ITEM_NAME, "Write backlog", "0 files (0.0 MB)");
 			// -------------------------------------------------------------------------------- CCD_COOLER
 			CCD_COOLER_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_COOLER_PROPERTY_NAME, CCD_COOLER_GROUP, "Cooler status", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
 			if (CCD_COOLER_PROPERTY == NULL)
@@ -291,6 +568,8 @@ indigo_result indigo_ccd_enumerate_properties(indigo_device *device, indigo_clie
 			indigo_define_property(device, CCD_LENS_PROPERTY, NULL);
 		if (indigo_property_match(CCD_LOCAL_MODE_PROPERTY, property))
 			indigo_define_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
+		if (indigo_property_match(CCD_LOCAL_SAVE_MODE_PROPERTY, property))
+			indigo_define_property(device, CCD_LOCAL_SAVE_MODE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_IMAGE_FILE_PROPERTY, property))
 			indigo_define_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_MODE_PROPERTY, property))
@@ -357,6 +636,7 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_define_property(device, CCD_UPLOAD_MODE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_PREVIEW_PROPERTY, NULL);
 			indigo_define_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
+			indigo_define_property(device, CCD_LOCAL_SAVE_MODE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_MODE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_READ_MODE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_EXPOSURE_PROPERTY, NULL);
@@ -393,6 +673,7 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_delete_property(device, CCD_UPLOAD_MODE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_PREVIEW_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_LOCAL_SAVE_MODE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_MODE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_READ_MODE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_EXPOSURE_PROPERTY, NULL);
@@ -425,6 +706,7 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_save_property(device, NULL, CCD_READ_MODE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_UPLOAD_MODE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_LOCAL_MODE_PROPERTY);
+			indigo_save_property(device, NULL, CCD_LOCAL_SAVE_MODE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_FRAME_PROPERTY);
 			indigo_save_property(device, NULL, CCD_BIN_PROPERTY);
 			indigo_save_property(device, NULL, CCD_OFFSET_PROPERTY);
@@ -444,11 +726,15 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 	} else if (indigo_property_match(CCD_EXPOSURE_PROPERTY, property)) {
 		// -------------------------------------------------------------------------------- CCD_EXPOSURE
 		if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE) {
+			if (indigo_use_tracing && !__atomic_exchange_n(&CCD_CONTEXT->exposure_traced, true, __ATOMIC_RELAXED))
+				INDIGO_TRACING_ASYNC_BEGIN("ccd", "exposure", device->name, device);
 			if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-				if (CCD_IMAGE_FILE_PROPERTY->state != INDIGO_BUSY_STATE) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
+				pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
+				bool changed = CCD_IMAGE_FILE_PROPERTY->state != INDIGO_BUSY_STATE;
+				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
+				pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
+				if (changed)
 					indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
-				}
 			}
 			if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 				if (CCD_IMAGE_PROPERTY->state != INDIGO_BUSY_STATE) {
@@ -475,11 +761,15 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			CCD_PREVIEW_HISTOGRAM_PROPERTY->state = INDIGO_ALERT_STATE;
 			indigo_update_property(device, CCD_PREVIEW_HISTOGRAM_PROPERTY, NULL);
 		}
-		if (CCD_IMAGE_FILE_PROPERTY->state == INDIGO_BUSY_STATE) {
+		pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
+		bool aborted = CCD_IMAGE_FILE_PROPERTY->state == INDIGO_BUSY_STATE;
+		if (aborted)
 			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+		pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
+		if (aborted)
 			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
-		}
 		if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE) {
+			end_exposure_tracing(device);
 			CCD_EXPOSURE_PROPERTY->state = INDIGO_ALERT_STATE;
 			CCD_EXPOSURE_ITEM->number.value = 0;
 			indigo_update_property(device, CCD_EXPOSURE_PROPERTY, NULL);
@@ -661,6 +951,13 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 		if (IS_CONNECTED)
 			indigo_update_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
 		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_LOCAL_SAVE_MODE_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_LOCAL_SAVE_MODE
+		indigo_property_copy_values(CCD_LOCAL_SAVE_MODE_PROPERTY, property, false);
+		CCD_LOCAL_SAVE_MODE_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED)
+			indigo_update_property(device, CCD_LOCAL_SAVE_MODE_PROPERTY, NULL);
+		return INDIGO_OK;
 	} else if (indigo_property_match(CCD_FITS_HEADERS_PROPERTY, property)) {
 		// -------------------------------------------------------------------------------- CCD_FITS_HEADERS
 		indigo_property_copy_values(CCD_FITS_HEADERS_PROPERTY, property, false);
@@ -746,11 +1043,13 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 
 indigo_result indigo_ccd_detach(indigo_device *device) {
 	assert(device != NULL);
+	wait_for_saved_images(device);
 	indigo_release_property(CCD_INFO_PROPERTY);
 	indigo_release_property(CCD_LENS_PROPERTY);
 	indigo_release_property(CCD_UPLOAD_MODE_PROPERTY);
 	indigo_release_property(CCD_PREVIEW_PROPERTY);
 	indigo_release_property(CCD_LOCAL_MODE_PROPERTY);
+	indigo_release_property(CCD_LOCAL_SAVE_MODE_PROPERTY);
 	indigo_release_property(CCD_MODE_PROPERTY);
 	indigo_release_property(CCD_READ_MODE_PROPERTY);
 	indigo_release_property(CCD_EXPOSURE_PROPERTY);
@@ -774,11 +1073,21 @@ indigo_result indigo_ccd_detach(indigo_device *device) {
 	indigo_release_property(CCD_JPEG_SETTINGS_PROPERTY);
 	indigo_release_property(CCD_RBI_FLUSH_ENABLE_PROPERTY);
 	indigo_release_property(CCD_RBI_FLUSH_PROPERTY);
-	if (CCD_CONTEXT->preview_image)
-		free(CCD_CONTEXT->preview_image);
+	indigo_release_image_buffer(CCD_CONTEXT->preview_image);
+	indigo_release_image_buffer(CCD_CONTEXT->preview_histogram);
+	pthread_mutex_destroy(&CCD_CONTEXT->image_file_mutex);
 	return indigo_device_detach(device);
 }
 
+static double image_stage_done(indigo_device *device, const char *stage, double start) {
+	double duration = indigo_metric_time() - start;
+	if (indigo_use_metrics)
+		indigo_metric_observe(indigo_get_metric(INDIGO_METRIC_HISTOGRAM, "indigo_image_stage_seconds", "Image processing stage duration", "stage", stage), duration);
+	if (indigo_use_tracing)
+		indigo_tracing_event('X', "image", stage, device->name, NULL, start, duration);
+	return duration;
+}
+
 static void set_black_white(indigo_device *device, unsigned long *histo, long count) {
 	long black = CCD_JPEG_SETTINGS_BLACK_TRESHOLD_ITEM->number.value * count / 100.0; /* In percenitle */
 	if (black == 0) black = 1;
@@ -823,10 +1132,21 @@ static void set_black_white(indigo_device *device, unsigned long *histo, long co
 	}
 }
 
+static bool copy_preview(void **buffer, unsigned long *buffer_size, unsigned long size) {
+	void *resized = indigo_resize_image_buffer(*buffer, size);
+	if (resized == NULL)
+		return false;
+	*buffer = resized;
+	*buffer_size = indigo_image_buffer_size(resized);
+	return true;
+}
+
 void indigo_raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, void **data_out, unsigned long *size_out, void **histogram_data, unsigned long *histogram_size) {
-	INDIGO_DEBUG(clock_t start = clock());
+	double start = indigo_metric_time();
 	int size_in = frame_width * frame_height;
-	void *copy = indigo_safe_malloc_copy(size_in * bpp / 8, data_in + FITS_HEADER_SIZE);
+	void *copy = indigo_alloc_image_buffer(size_in * bpp / 8);
+	assert(copy != NULL);
+	memcpy(copy, data_in + FITS_HEADER_SIZE, size_in * bpp / 8);
 	unsigned char *mem = NULL;
 	unsigned long mem_size = 0;
 	struct jpeg_compress_struct cinfo;
@@ -903,6 +1223,8 @@ void indigo_raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, i
 		cinfo.input_components = 3;
 		cinfo.in_color_space = JCS_RGB;
 	}
+	image_stage_done(device, "stretch", start);
+	double jpeg_start = indigo_metric_time();
 	jpeg_set_defaults(&cinfo);
 	jpeg_set_quality(&cinfo, CCD_JPEG_SETTINGS_QUALITY_ITEM->number.target, true);
 	JSAMPROW row_pointer[1];
@@ -915,7 +1237,7 @@ void indigo_raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, i
 	jpeg_destroy_compress(&cinfo);
 	*data_out = mem;
 	*size_out = mem_size;
-	free(copy);
+	indigo_release_image_buffer(copy);
 	if (histogram_data != NULL) {
 		uint8_t raw[32][256];
 		memset(raw, 0, sizeof(raw));
@@ -953,7 +1275,8 @@ void indigo_raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, i
 		*histogram_data = mem;
 		*histogram_size = mem_size;
 	}
-	INDIGO_DEBUG(indigo_debug("RAW to preview conversion in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+	image_stage_done(device, "jpeg", jpeg_start);
+	INDIGO_DEBUG(indigo_debug("RAW to preview conversion in %gs", indigo_metric_time() - start));
 }
 
 static void raw_to_tiff(indigo_device *device, void *data_in, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, void **data_out, unsigned long *size_out) {
@@ -999,7 +1322,8 @@ static void raw_to_tiff(indigo_device *device, void *data_in, int frame_width, i
 void indigo_process_image(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords, bool streaming) {
 	assert(device != NULL);
 	assert(data != NULL);
-	INDIGO_DEBUG(clock_t start = clock());
+	double start = indigo_metric_time();
+	end_exposure_tracing(device);
 	int horizontal_bin = CCD_BIN_HORIZONTAL_ITEM->number.value;
 	int vertical_bin = CCD_BIN_VERTICAL_ITEM->number.value;
 	int byte_per_pixel = bpp / 8;
@@ -1023,14 +1347,7 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		if (CCD_PREVIEW_ENABLED_ITEM->sw.value || CCD_PREVIEW_ENABLED_WITH_HISTOGRAM_ITEM->sw.value) {
 			CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_BUSY_STATE;
 			indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
-			if (jpeg_data) {
-				if (CCD_CONTEXT->preview_image) {
-					if (CCD_CONTEXT->preview_image_size < jpeg_size) {
-						CCD_CONTEXT->preview_image = indigo_safe_realloc(CCD_CONTEXT->preview_image, CCD_CONTEXT->preview_image_size = jpeg_size);
-					}
-				} else {
-					CCD_CONTEXT->preview_image = indigo_safe_malloc(CCD_CONTEXT->preview_image_size = jpeg_size);
-				}
+			if (jpeg_data && copy_preview(&CCD_CONTEXT->preview_image, &CCD_CONTEXT->preview_image_size, jpeg_size)) {
 				memcpy(CCD_CONTEXT->preview_image, jpeg_data, jpeg_size);
 				CCD_PREVIEW_IMAGE_ITEM->blob.value = CCD_CONTEXT->preview_image;
 				CCD_PREVIEW_IMAGE_ITEM->blob.size = jpeg_size;
@@ -1043,14 +1360,7 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 			if (CCD_PREVIEW_ENABLED_WITH_HISTOGRAM_ITEM->sw.value) {
 				CCD_PREVIEW_HISTOGRAM_PROPERTY->state = INDIGO_BUSY_STATE;
 				indigo_update_property(device, CCD_PREVIEW_HISTOGRAM_PROPERTY, NULL);
-				if (histogram_data) {
-					if (CCD_CONTEXT->preview_histogram) {
-						if (CCD_CONTEXT->preview_histogram_size < histogram_size) {
-							CCD_CONTEXT->preview_histogram = indigo_safe_realloc(CCD_CONTEXT->preview_histogram, CCD_CONTEXT->preview_histogram_size = histogram_size);
-						}
-					} else {
-						CCD_CONTEXT->preview_histogram = indigo_safe_malloc(CCD_CONTEXT->preview_histogram_size = histogram_size);
-					}
+				if (histogram_data && copy_preview(&CCD_CONTEXT->preview_histogram, &CCD_CONTEXT->preview_histogram_size, histogram_size)) {
 					memcpy(CCD_CONTEXT->preview_histogram, histogram_data, histogram_size);
 					CCD_PREVIEW_HISTOGRAM_ITEM->blob.value = CCD_CONTEXT->preview_histogram;
 					CCD_PREVIEW_HISTOGRAM_ITEM->blob.size = histogram_size;
@@ -1065,7 +1375,7 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 	}
 
 	if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) {
-		INDIGO_DEBUG(clock_t start = clock());
+		double start = indigo_metric_time();
 		time_t timer;
 		struct tm* tm_info;
 		char date_time_end[20];
@@ -1202,7 +1512,8 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 				}
 			}
 		} else if (byte_per_pixel == 1 && naxis == 3) {
-			unsigned char *raw = indigo_safe_malloc(3 * size);
+			unsigned char *raw = indigo_alloc_image_buffer(3 * size);
+			assert(raw != NULL);
 			unsigned char *red = raw;
 			unsigned char *green = raw + size;
 			unsigned char *blue = raw + 2 * size;
@@ -1221,9 +1532,10 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 				}
 			}
 			memcpy(data + FITS_HEADER_SIZE, raw, 3 * size);
-			free(raw);
+			indigo_release_image_buffer(raw);
 		} else if (byte_per_pixel == 2 && naxis == 3) {
-			unsigned short *raw = indigo_safe_malloc(6 * size);
+			unsigned short *raw = indigo_alloc_image_buffer(6 * size);
+			assert(raw != NULL);
 			unsigned short *red = raw;
 			unsigned short *green = raw + size;
 			unsigned short *blue = raw + 2 * size;
@@ -1264,7 +1576,7 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 				}
 			}
 			memcpy(data + FITS_HEADER_SIZE, raw, 6 * size);
-			free(raw);
+			indigo_release_image_buffer(raw);
 		}
 		int mod2880 = blobsize % 2880;
 		if (mod2880) {
@@ -1274,9 +1586,10 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 				blobsize += padding;
 			}
 		}
-		INDIGO_DEBUG(indigo_debug("RAW to FITS conversion in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		double duration = image_stage_done(device, "fits", start);
+		INDIGO_DEBUG(indigo_debug("RAW to FITS conversion in %gs", duration));
 	} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value) {
-		INDIGO_DEBUG(clock_t start = clock());
+		double start = indigo_metric_time();
 		time_t timer;
 		struct tm* tm_info;
 		char date_time_end[21], date_time_start[21], fits_date_obs[21];
@@ -1452,8 +1765,10 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 				}
 			}
 		}
-		INDIGO_DEBUG(indigo_debug("RAW to XISF conversion in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		double duration = image_stage_done(device, "xisf", start);
+		INDIGO_DEBUG(indigo_debug("RAW to XISF conversion in %gs", duration));
 	} else if (CCD_IMAGE_FORMAT_RAW_ITEM->sw.value || CCD_IMAGE_FORMAT_RAW_SER_ITEM->sw.value) {
+		double start = indigo_metric_time();
 		indigo_raw_header *header = (indigo_raw_header *)(data + FITS_HEADER_SIZE - sizeof(indigo_raw_header));
 		if (naxis == 2 && byte_per_pixel == 1)
 			header->signature = INDIGO_RAW_MONO8;
@@ -1515,6 +1830,7 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		}
 		header->width = frame_width;
 		header->height = frame_height;
+		image_stage_done(device, "raw", start);
 	} else if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value || CCD_IMAGE_FORMAT_JPEG_AVI_ITEM->sw.value) {
 		if (jpeg_data && jpeg_size < blobsize) {
 			memcpy(data, jpeg_data, jpeg_size);
@@ -1523,7 +1839,9 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 	} else if (CCD_IMAGE_FORMAT_TIFF_ITEM->sw.value) {
 		void *tiff_data = NULL;
 		unsigned long tiff_size = 0;
+		double start = indigo_metric_time();
 		raw_to_tiff(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, &tiff_data, &tiff_size);
+		image_stage_done(device, "tiff", start);
 		if (tiff_data) {
 			memcpy(data, tiff_data, tiff_size);
 			blobsize = tiff_size;
@@ -1531,6 +1849,8 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		}
 	}
 	if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
+		double save_start = indigo_metric_time();
+		pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
 		char *dir = CCD_LOCAL_MODE_DIR_ITEM->text.value;
 		char *prefix = CCD_LOCAL_MODE_PREFIX_ITEM->text.value;
 		char *suffix = "";
@@ -1562,10 +1882,9 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 			}
 		}
 		char *message = NULL;
-		int handle = 0;
+		char file_name[INDIGO_VALUE_SIZE] = "";
 		if (!(use_avi || use_ser) || CCD_CONTEXT->video_stream == NULL) {
 			if (strlen(dir) + strlen(prefix) + strlen(suffix) < INDIGO_VALUE_SIZE) {
-				char file_name[INDIGO_VALUE_SIZE];
 				char *placeholder = strstr(prefix, "XXX");
 				if (placeholder == NULL) {
 					indigo_copy_value(file_name, dir);
@@ -1583,24 +1902,15 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 						strcat(format, placeholder + 3);
 					}
 					strcat(format, suffix);
-					struct stat sb;
-					int i = 1;
-					while (i < 10000) {
-						snprintf(file_name, sizeof(file_name), format, i);
-						if (stat(file_name, &sb) == 0 && S_ISREG(sb.st_mode))
-							i++;
-						else
-							break;
-					}
+					next_file_name(format, 10000, file_name);
 				}
-				indigo_copy_value(CCD_IMAGE_FILE_ITEM->text.value, file_name);
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
-				if (use_avi) {
-					CCD_CONTEXT->video_stream = gwavi_open(file_name, frame_width, frame_height, "MJPG", 5);
-				} else if (use_ser) {
-					CCD_CONTEXT->video_stream = indigo_ser_open(file_name, data + FITS_HEADER_SIZE - sizeof(indigo_raw_header), little_endian, byte_order_rgb);
-				} else {
-					handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+				if (use_avi || use_ser) {
+					indigo_copy_value(CCD_IMAGE_FILE_ITEM->text.value, file_name);
+					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
+					if (use_avi)
+						CCD_CONTEXT->video_stream = gwavi_open(file_name, frame_width, frame_height, "MJPG", 5);
+					else
+						CCD_CONTEXT->video_stream = indigo_ser_open(file_name, data + FITS_HEADER_SIZE - sizeof(indigo_raw_header), little_endian, byte_order_rgb);
 				}
 			} else {
 				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
@@ -1619,40 +1929,22 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 					message = strerror(errno);
 				}
 			}
-		} else if (handle) {
-			if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) {
-				if (!indigo_write(handle, data, FITS_HEADER_SIZE + blobsize)) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-					message = strerror(errno);
-				}
-			} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value) {
-				if (!indigo_write(handle, data, FITS_HEADER_SIZE + blobsize)) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-					message = strerror(errno);
-				}
+		} else if (*file_name) {
+			if (use_avi || use_ser) {
+				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+				message = strerror(errno);
+			} else if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value || CCD_IMAGE_FORMAT_XISF_ITEM->sw.value) {
+				message = save_image_file(device, file_name, data, FITS_HEADER_SIZE + blobsize);
 			} else if (CCD_IMAGE_FORMAT_RAW_ITEM->sw.value || CCD_IMAGE_FORMAT_RAW_SER_ITEM->sw.value) {
-				if (!indigo_write(handle, data + FITS_HEADER_SIZE - sizeof(indigo_raw_header), blobsize + sizeof(indigo_raw_header))) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-					message = strerror(errno);
-				}
-			} else if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value || CCD_IMAGE_FORMAT_JPEG_AVI_ITEM->sw.value) {
-				if (!indigo_write(handle, data, blobsize)) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-					message = strerror(errno);
-				}
-			} else if (CCD_IMAGE_FORMAT_TIFF_ITEM->sw.value) {
-				if (!indigo_write(handle, data, blobsize)) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-					message = strerror(errno);
-				}
+				message = save_image_file(device, file_name, data + FITS_HEADER_SIZE - sizeof(indigo_raw_header), blobsize + sizeof(indigo_raw_header));
+			} else {
+				message = save_image_file(device, file_name, data, blobsize);
 			}
-			close(handle);
-		} else {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-			message = strerror(errno);
 		}
+		pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
 		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
-		INDIGO_DEBUG(indigo_debug("Local save in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		image_stage_done(device, "save", save_start);
+		INDIGO_DEBUG(indigo_debug("Local save in %gs", indigo_metric_time() - start));
 	}
 	if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 		*CCD_IMAGE_ITEM->blob.url = 0;
@@ -1678,19 +1970,23 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 			strcpy(CCD_IMAGE_ITEM->blob.format, ".tiff");
 		}
 		CCD_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
+		double publish_start = indigo_metric_time();
 		indigo_update_property(device, CCD_IMAGE_PROPERTY, NULL);
-		INDIGO_DEBUG(indigo_debug("Client upload in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		image_stage_done(device, "publish", publish_start);
+		INDIGO_DEBUG(indigo_debug("Client upload in %gs", indigo_metric_time() - start));
 	}
 	if (jpeg_data)
 		free(jpeg_data);
 	if (histogram_data)
 		free(histogram_data);
+	INDIGO_TRACING_COMPLETE("image", "process_image", device->name, start);
 }
 
 void indigo_process_dslr_image(indigo_device *device, void *data, int data_size, const char *suffix, bool streaming) {
 	assert(device != NULL);
 	assert(data != NULL);
-	INDIGO_DEBUG(clock_t start = clock());
+	double start = indigo_metric_time();
+	end_exposure_tracing(device);
 	char standard_suffix[16];
 	strncpy(standard_suffix, suffix, sizeof(standard_suffix));
 	for (char *pnt = standard_suffix; *pnt; pnt++)
@@ -1710,7 +2006,8 @@ void indigo_process_dslr_image(indigo_device *device, void *data, int data_size,
 			int frame_height = cinfo.output_height;
 			int row_stride = frame_width * components;
 			int image_size = frame_height * row_stride;
-			void *intermediate_image = indigo_safe_malloc(image_size + FITS_HEADER_SIZE);
+			void *intermediate_image = indigo_alloc_image_buffer(image_size + FITS_HEADER_SIZE);
+			assert(intermediate_image != NULL);
 			while (cinfo.output_scanline < cinfo.output_height) {
 				unsigned char *buffer_array[1];
 				buffer_array[0] = intermediate_image + FITS_HEADER_SIZE + (cinfo.output_scanline) * row_stride;
@@ -1719,23 +2016,24 @@ void indigo_process_dslr_image(indigo_device *device, void *data, int data_size,
 			jpeg_finish_decompress(&cinfo);
 			jpeg_destroy_decompress(&cinfo);
 			indigo_process_image(device, intermediate_image, frame_width, frame_height, components * 8, true, true, NULL, streaming);
-			free(intermediate_image);
+			indigo_release_image_buffer(intermediate_image);
 			return;
 		}
 	}
 	if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
+		double save_start = indigo_metric_time();
+		pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
 		bool use_avi = false;
 		char *dir = CCD_LOCAL_MODE_DIR_ITEM->text.value;
 		char *prefix = CCD_LOCAL_MODE_PREFIX_ITEM->text.value;
-		int handle = 0;
 		char *message = NULL;
+		char file_name[INDIGO_VALUE_SIZE] = "";
 		if (CCD_IMAGE_FORMAT_NATIVE_AVI_ITEM->sw.value && !strcmp(standard_suffix, ".jpeg") && streaming) {
 			strcpy(standard_suffix, ".avi");
 			use_avi = true;
 		}
 		if (!use_avi || CCD_CONTEXT->video_stream == NULL) {
 			if (strlen(dir) + strlen(prefix) + strlen(standard_suffix) < INDIGO_VALUE_SIZE) {
-				char file_name[INDIGO_VALUE_SIZE];
 				char *placeholder = strstr(prefix, "XXX");
 				if (placeholder == NULL) {
 					strncpy(file_name, dir, INDIGO_VALUE_SIZE - strlen(prefix) - strlen(standard_suffix));
@@ -1748,19 +2046,11 @@ void indigo_process_dslr_image(indigo_device *device, void *data, int data_size,
 					strcat(format, "%03d");
 					strcat(format, placeholder+3);
 					strcat(format, standard_suffix);
-					struct stat sb;
-					int i = 1;
-					while (true) {
-						snprintf(file_name, sizeof(file_name), format, i);
-						if (stat(file_name, &sb) == 0 && S_ISREG(sb.st_mode))
-							i++;
-						else
-							break;
-					}
+					next_file_name(format, 0, file_name);
 				}
-				indigo_copy_value(CCD_IMAGE_FILE_ITEM->text.value, file_name);
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
 				if (use_avi) {
+					indigo_copy_value(CCD_IMAGE_FILE_ITEM->text.value, file_name);
+					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
 					struct jpeg_decompress_struct cinfo;
 					struct jpeg_error_mgr jerr;
 					cinfo.err = jpeg_std_error(&jerr);
@@ -1769,8 +2059,6 @@ void indigo_process_dslr_image(indigo_device *device, void *data, int data_size,
 					jpeg_read_header(&cinfo, TRUE);
 					jpeg_destroy_decompress(&cinfo);
 					CCD_CONTEXT->video_stream = gwavi_open(file_name, cinfo.image_width, cinfo.image_height, "MJPG", 5);
-				} else {
-					handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 				}
 			} else {
 				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
@@ -1784,18 +2072,18 @@ void indigo_process_dslr_image(indigo_device *device, void *data, int data_size,
 					message = strerror(errno);
 				}
 			}
-		} else if (handle) {
-			if (!indigo_write(handle, data, data_size)) {
+		} else if (*file_name) {
+			if (use_avi) {
 				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
 				message = strerror(errno);
+			} else {
+				message = save_image_file(device, file_name, data, data_size);
 			}
-			close(handle);
-		} else {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-			message = strerror(errno);
 		}
+		pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
 		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
-		INDIGO_DEBUG(indigo_debug("Local save in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		image_stage_done(device, "save", save_start);
+		INDIGO_DEBUG(indigo_debug("Local save in %gs", indigo_metric_time() - start));
 	}
 	if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 		*CCD_IMAGE_ITEM->blob.url = 0;
@@ -1803,18 +2091,18 @@ void indigo_process_dslr_image(indigo_device *device, void *data, int data_size,
 		CCD_IMAGE_ITEM->blob.size = data_size;
 		indigo_copy_name(CCD_IMAGE_ITEM->blob.format, standard_suffix);
 		CCD_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
+		double publish_start = indigo_metric_time();
 		indigo_update_property(device, CCD_IMAGE_PROPERTY, NULL);
-		INDIGO_DEBUG(indigo_debug("Client upload in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		image_stage_done(device, "publish", publish_start);
+		INDIGO_DEBUG(indigo_debug("Client upload in %gs", indigo_metric_time() - start));
 	}
 }
 
 void indigo_process_dslr_preview_image(indigo_device *device, void *data, int blobsize) {
-	if (CCD_CONTEXT->preview_image) {
-		if (CCD_CONTEXT->preview_image_size < blobsize) {
-			CCD_CONTEXT->preview_image = indigo_safe_realloc(CCD_CONTEXT->preview_image, CCD_CONTEXT->preview_image_size = blobsize);
-		}
-	} else {
-		CCD_CONTEXT->preview_image = indigo_safe_malloc(CCD_CONTEXT->preview_image_size = blobsize);
+	if (!copy_preview(&CCD_CONTEXT->preview_image, &CCD_CONTEXT->preview_image_size, blobsize)) {
+		CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
+		return;
 	}
 	memcpy(CCD_CONTEXT->preview_image, data, blobsize);
 	CCD_PREVIEW_IMAGE_ITEM->blob.value = CCD_CONTEXT->preview_image;
@@ -1826,25 +2114,35 @@ void indigo_process_dslr_preview_image(indigo_device *device, void *data, int bl
 
 void indigo_finalize_video_stream(indigo_device *device) {
 	if (CCD_CONTEXT->video_stream) {
+		bool closed = false;
+		pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
 		if (CCD_IMAGE_FORMAT_PROPERTY->count == 2) {
 			if (CCD_IMAGE_FORMAT_NATIVE_AVI_ITEM->sw.value) {
 				gwavi_close((struct gwavi_t *)(CCD_CONTEXT->video_stream));
-				CCD_CONTEXT->video_stream = NULL;
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
-				indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+				closed = true;
 			}
 		} else {
 			if (CCD_IMAGE_FORMAT_JPEG_AVI_ITEM->sw.value) {
 				gwavi_close((struct gwavi_t *)(CCD_CONTEXT->video_stream));
-				CCD_CONTEXT->video_stream = NULL;
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
-				indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+				closed = true;
 			} else if (CCD_IMAGE_FORMAT_RAW_SER_ITEM->sw.value) {
 				indigo_ser_close((indigo_ser *)(CCD_CONTEXT->video_stream));
-				CCD_CONTEXT->video_stream = NULL;
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
-				indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+				closed = true;
 			}
 		}
+		if (closed) {
+			CCD_CONTEXT->video_stream = NULL;
+			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
+		}
+		pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
+		if (closed)
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
 	}
 }
+
+void indigo_ccd_set_image_file_state(indigo_device *device, indigo_property_state state) {
+	pthread_mutex_lock(&CCD_CONTEXT->image_file_mutex);
+	CCD_IMAGE_FILE_PROPERTY->state = state;
+	pthread_mutex_unlock(&CCD_CONTEXT->image_file_mutex);
+	indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+}
@@ -50,6 +50,7 @@
 #endif
 
 #include <indigo/indigo_client_xml.h>
+#include <indigo/indigo_client_binary.h>
 #include <indigo/indigo_client.h>
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -429,15 +430,23 @@ static void *server_thread(indigo_server_entry *server) {
 #if defined(INDIGO_WINDOWS)
 			indigo_send_message(server->protocol_adapter, "connected");
 #endif
-			server->protocol_adapter = indigo_xml_client_adapter(server->name, url, server->socket, server->socket);
-			indigo_attach_device(server->protocol_adapter);
-			indigo_xml_parse(server->protocol_adapter, NULL);
-			indigo_detach_device(server->protocol_adapter);
-			if (server->protocol_adapter) {
-				if (server->protocol_adapter->device_context) {
-					free(server->protocol_adapter->device_context);
+			if (indigo_use_binary_protocol) {
+				server->protocol_adapter = indigo_binary_client_adapter(server->name, url, server->socket, server->socket);
+				indigo_attach_device(server->protocol_adapter);
+				indigo_binary_parse(server->protocol_adapter, NULL);
+				indigo_detach_device(server->protocol_adapter);
+				indigo_release_binary_client_adapter(server->protocol_adapter);
+			} else {
+				server->protocol_adapter = indigo_xml_client_adapter(server->name, url, server->socket, server->socket);
+				indigo_attach_device(server->protocol_adapter);
+				indigo_xml_parse(server->protocol_adapter, NULL);
+				indigo_detach_device(server->protocol_adapter);
+				if (server->protocol_adapter) {
+					if (server->protocol_adapter->device_context) {
+						free(server->protocol_adapter->device_context);
+					}
+					free(server->protocol_adapter);
 				}
-				free(server->protocol_adapter);
 			}
 			server->protocol_adapter = NULL;
 			pthread_mutex_lock(&mutex);
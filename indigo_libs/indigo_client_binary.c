@@ -0,0 +1,215 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO binary wire protocol driver side adapter
+ \file indigo_client_binary.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <assert.h>
+
+#if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
+#include <unistd.h>
+#endif
+
+#if defined(INDIGO_WINDOWS)
+#include <io.h>
+#include <winsock2.h>
+#define close closesocket
+#pragma warning(disable:4996)
+#endif
+
+#include <indigo/indigo_io.h>
+#include <indigo/indigo_version.h>
+#include <indigo/indigo_client_binary.h>
+
+static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+	indigo_adapter_context adapter;
+	indigo_binary_buffer buffer;
+	bool signature_sent;
+} binary_adapter_context;
+
+static void remote_device_name(const char *device, char *device_name) {
+	indigo_copy_name(device_name, device);
+	if (indigo_use_host_suffix) {
+		char *at = strrchr(device_name, '@');
+		if (at != NULL) {
+			while (at > device_name && at[-1] == ' ')
+				at--;
+			*at = 0;
+		}
+	}
+}
+
+static bool write_message(binary_adapter_context *context) {
+	int handle = context->adapter.output;
+	if (!context->signature_sent) {
+		if (!indigo_write(handle, INDIGO_BINARY_SIGNATURE, INDIGO_BINARY_SIGNATURE_SIZE))
+			return false;
+		context->signature_sent = true;
+	}
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← message %d, %ld bytes", handle, context->buffer.data[0], context->buffer.length));
+	return indigo_binary_write(handle, &context->buffer, 0);
+}
+
+static void close_connection(binary_adapter_context *context) {
+	if (context->adapter.output == context->adapter.input) {
+		close(context->adapter.input);
+	} else {
+		close(context->adapter.input);
+		close(context->adapter.output);
+	}
+	context->adapter.output = context->adapter.input = -1;
+}
+
+static indigo_result binary_client_parser_enumerate_properties(indigo_device *device, indigo_client *client, indigo_property *property) {
+	assert(device != NULL);
+	if (!indigo_reshare_remote_devices && client && client->is_remote)
+		return INDIGO_OK;
+	binary_adapter_context *context = (binary_adapter_context *)device->device_context;
+	if (context->adapter.output <= 0)
+		return INDIGO_OK;
+	pthread_mutex_lock(&write_mutex);
+	char device_name[INDIGO_NAME_SIZE] = "";
+	if (property != NULL && *property->device)
+		remote_device_name(property->device, device_name);
+	indigo_binary_buffer *buffer = &context->buffer;
+	indigo_binary_begin(buffer, INDIGO_BINARY_GET_PROPERTIES);
+	indigo_binary_put_string(buffer, device_name);
+	indigo_binary_put_string(buffer, property != NULL ? property->name : "");
+	indigo_binary_put_u16(buffer, INDIGO_VERSION_CURRENT);
+	indigo_binary_put_u8(buffer, context->adapter.delta_updates ? INDIGO_BINARY_FLAG_DELTA : 0);
+	if (!write_message(context))
+		close_connection(context);
+	pthread_mutex_unlock(&write_mutex);
+	return INDIGO_OK;
+}
+
+static indigo_result binary_client_parser_change_property(indigo_device *device, indigo_client *client, indigo_property *property) {
+	assert(device != NULL);
+	assert(property != NULL);
+	if (!indigo_reshare_remote_devices && client && client->is_remote)
+		return INDIGO_OK;
+	binary_adapter_context *context = (binary_adapter_context *)device->device_context;
+	if (context->adapter.output <= 0)
+		return INDIGO_OK;
+	if (property->type != INDIGO_TEXT_VECTOR && property->type != INDIGO_NUMBER_VECTOR && property->type != INDIGO_SWITCH_VECTOR)
+		return INDIGO_OK;
+	pthread_mutex_lock(&write_mutex);
+	char device_name[INDIGO_NAME_SIZE];
+	remote_device_name(property->device, device_name);
+	indigo_binary_buffer *buffer = &context->buffer;
+	indigo_binary_begin(buffer, INDIGO_BINARY_NEW_PROPERTY);
+	indigo_binary_put_u8(buffer, property->type);
+	indigo_binary_put_string(buffer, device_name);
+	indigo_binary_put_string(buffer, property->name);
+	indigo_binary_put_u64(buffer, property->access_token);
+	indigo_binary_put_u16(buffer, property->count);
+	for (int i = 0; i < property->count; i++) {
+		indigo_item *item = property->items + i;
+		indigo_binary_put_string(buffer, item->name);
+		switch (property->type) {
+			case INDIGO_TEXT_VECTOR:
+				indigo_binary_put_text(buffer, indigo_get_text_item_value(item));
+				break;
+			case INDIGO_NUMBER_VECTOR:
+				indigo_binary_put_double(buffer, item->number.value);
+				break;
+			case INDIGO_SWITCH_VECTOR:
+				indigo_binary_put_u8(buffer, item->sw.value);
+				break;
+			default:
+				break;
+		}
+	}
+	if (!write_message(context))
+		close_connection(context);
+	pthread_mutex_unlock(&write_mutex);
+	return INDIGO_OK;
+}
+
+static indigo_result binary_client_parser_enable_blob(indigo_device *device, indigo_client *client, indigo_property *property, indigo_enable_blob_mode mode) {
+	assert(device != NULL);
+	assert(property != NULL);
+	if (!indigo_reshare_remote_devices && client && client->is_remote)
+		return INDIGO_OK;
+	binary_adapter_context *context = (binary_adapter_context *)device->device_context;
+	if (context->adapter.output <= 0)
+		return INDIGO_OK;
+	pthread_mutex_lock(&write_mutex);
+	char device_name[INDIGO_NAME_SIZE];
+	remote_device_name(property->device, device_name);
+	indigo_binary_buffer *buffer = &context->buffer;
+	indigo_binary_begin(buffer, INDIGO_BINARY_ENABLE_BLOB);
+	indigo_binary_put_string(buffer, device_name);
+	indigo_binary_put_string(buffer, property->name);
+	indigo_binary_put_u8(buffer, mode);
+	if (!write_message(context))
+		close_connection(context);
+	pthread_mutex_unlock(&write_mutex);
+	return INDIGO_OK;
+}
+
+static indigo_result binary_client_parser_detach(indigo_device *device) {
+	assert(device != NULL);
+	binary_adapter_context *context = (binary_adapter_context *)device->device_context;
+	if (context->adapter.output <= 0)
+		return INDIGO_OK;
+	close(context->adapter.input);
+	close(context->adapter.output);
+	return INDIGO_OK;
+}
+
+indigo_device *indigo_binary_client_adapter(char *name, char *url_prefix, int input, int output) {
+	static indigo_device device_template = INDIGO_DEVICE_INITIALIZER(
+		"Binary Client Adapter", NULL,
+		binary_client_parser_enumerate_properties,
+		binary_client_parser_change_property,
+		binary_client_parser_enable_blob,
+		binary_client_parser_detach
+	);
+	indigo_device *device = indigo_safe_malloc_copy(sizeof(indigo_device), &device_template);
+	sprintf(device->name, "@ %s", name);
+	device->is_remote = input == output;
+	device->version = INDIGO_VERSION_CURRENT;
+	binary_adapter_context *device_context = indigo_safe_malloc(sizeof(binary_adapter_context));
+	device_context->adapter.input = input;
+	device_context->adapter.output = output;
+	device_context->adapter.delta_updates = indigo_use_delta_updates;
+	indigo_copy_name(device_context->adapter.url_prefix, url_prefix);
+	device->device_context = device_context;
+	return device;
+}
+
+void indigo_release_binary_client_adapter(indigo_device *device) {
+	assert(device != NULL);
+	binary_adapter_context *device_context = (binary_adapter_context *)device->device_context;
+	if (device_context) {
+		indigo_safe_free(device_context->buffer.data);
+		free(device_context);
+	}
+	free(device);
+}
@@ -63,6 +63,7 @@ static indigo_result xml_client_parser_enumerate_properties(indigo_device *devic
 	pthread_mutex_lock(&xml_mutex);
 	assert(device_context != NULL);
 	int handle = device_context->output;
+	const char *delta = device_context->delta_updates ? " delta='On'" : "";
 	char device_name[INDIGO_NAME_SIZE];
 	if (property != NULL && *property->device) {
 		indigo_copy_name(device_name, property->device);
@@ -77,16 +78,16 @@ static indigo_result xml_client_parser_enumerate_properties(indigo_device *devic
 	}
 	if (property != NULL) {
 		if (*property->device && *indigo_property_name(device->version, property)) {
-			INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d' device='%s' name='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, indigo_xml_escape(device_name), indigo_property_name(device->version, property));
+			INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d'%s device='%s' name='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, delta, indigo_xml_escape(device_name), indigo_property_name(device->version, property));
 		} else if (*property->device) {
-			INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d' device='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, indigo_xml_escape(device_name));
+			INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d'%s device='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, delta, indigo_xml_escape(device_name));
 		} else if (*indigo_property_name(device->version, property)) {
-			INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d' name='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, indigo_property_name(device->version, property));
+			INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d'%s name='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, delta, indigo_property_name(device->version, property));
 		} else {
-			INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
+			INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d'%s/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, delta);
 		}
 	} else {
-		INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
+		INDIGO_PRINTF(handle, "<getProperties version='1.7' switch='%d.%d'%s/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, delta);
 	}
 	pthread_mutex_unlock(&xml_mutex);
 	return INDIGO_OK;
@@ -239,6 +240,7 @@ indigo_device *indigo_xml_client_adapter(char *name, char *url_prefix, int input
 	indigo_adapter_context *device_context = indigo_safe_malloc(sizeof(indigo_adapter_context));
 	device_context->input = input;
 	device_context->output = output;
+	device_context->delta_updates = indigo_use_delta_updates;
 	indigo_copy_name(device_context->url_prefix, url_prefix);
 	device->device_context = device_context;
 	return device;
@@ -716,7 +716,7 @@ void indigo_start_usb_event_handler() {
 	static bool thread_started = false;
 	if (!thread_started) {
 		libusb_init(NULL);
-		indigo_async(hotplug_thread, NULL);
+		indigo_start_thread(hotplug_thread, NULL);
 		thread_started = true;
 	}
 }
@@ -0,0 +1,368 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO binary wire protocol client side adapter
+ \file indigo_driver_binary.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include <indigo/indigo_io.h>
+#include <indigo/indigo_driver_binary.h>
+
+static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+	char device[INDIGO_NAME_SIZE];
+	char name[INDIGO_NAME_SIZE];
+	uint32_t hash;
+	bool used;
+} property_slot;
+
+typedef struct {
+	indigo_adapter_context adapter;
+	indigo_binary_buffer buffer;
+	int count;
+	property_slot *slots;
+} binary_adapter_context;
+
+static uint32_t property_hash(const char *device, const char *name) {
+	uint32_t hash = 2166136261U;
+	while (*device)
+		hash = (hash ^ (uint8_t)*device++) * 16777619U;
+	hash = (hash ^ '.') * 16777619U;
+	while (*name)
+		hash = (hash ^ (uint8_t)*name++) * 16777619U;
+	return hash;
+}
+
+static int property_id(binary_adapter_context *context, indigo_property *property, bool create) {
+	// called with write_mutex locked, ids are slot indices valid until property is deleted
+	uint32_t hash = property_hash(property->device, property->name);
+	int empty = -1;
+	for (int i = 0; i < context->count; i++) {
+		property_slot *slot = context->slots + i;
+		if (slot->used) {
+			if (slot->hash == hash && !strcmp(slot->device, property->device) && !strcmp(slot->name, property->name))
+				return i;
+		} else if (empty == -1) {
+			empty = i;
+		}
+	}
+	if (!create)
+		return -1;
+	if (empty == -1) {
+		empty = context->count;
+		context->count = context->count ? context->count * 2 : 64;
+		context->slots = indigo_safe_realloc(context->slots, context->count * sizeof(property_slot));
+		memset(context->slots + empty, 0, (context->count - empty) * sizeof(property_slot));
+	}
+	property_slot *slot = context->slots + empty;
+	indigo_copy_name(slot->device, property->device);
+	indigo_copy_name(slot->name, property->name);
+	slot->hash = hash;
+	slot->used = true;
+	return empty;
+}
+
+static bool write_message(binary_adapter_context *context) {
+	bool result = indigo_binary_write(context->adapter.output, &context->buffer, 0);
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← message %d, %ld bytes", context->adapter.output, context->buffer.data[0], context->buffer.length));
+	return result;
+}
+
+static void close_connection(binary_adapter_context *context) {
+	if (context->adapter.output == context->adapter.input) {
+		close(context->adapter.input);
+	} else {
+		close(context->adapter.input);
+		close(context->adapter.output);
+	}
+	context->adapter.output = context->adapter.input = -1;
+}
+
+static indigo_result binary_device_adapter_define_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	assert(device != NULL);
+	assert(client != NULL);
+	assert(property != NULL);
+	if (!indigo_reshare_remote_devices && device->is_remote)
+		return INDIGO_OK;
+	if (client->version == INDIGO_VERSION_NONE)
+		return INDIGO_OK;
+	binary_adapter_context *context = (binary_adapter_context *)client->client_context;
+	if (context->adapter.output <= 0)
+		return INDIGO_OK;
+	pthread_mutex_lock(&write_mutex);
+	indigo_binary_buffer *buffer = &context->buffer;
+	if (context->adapter.delta_updates)
+		indigo_delta_define(&context->adapter.delta_cache, property);
+	indigo_binary_begin(buffer, INDIGO_BINARY_DEF_PROPERTY);
+	indigo_binary_put_u32(buffer, property_id(context, property, true));
+	indigo_binary_put_u8(buffer, property->type);
+	indigo_binary_put_string(buffer, property->device);
+	indigo_binary_put_string(buffer, property->name);
+	indigo_binary_put_string(buffer, property->group);
+	indigo_binary_put_string(buffer, property->label);
+	indigo_binary_put_string(buffer, property->hints);
+	indigo_binary_put_u8(buffer, property->state);
+	indigo_binary_put_u8(buffer, property->perm);
+	indigo_binary_put_u8(buffer, property->rule);
+	indigo_binary_put_string(buffer, message);
+	indigo_binary_put_u16(buffer, property->count);
+	for (int i = 0; i < property->count; i++) {
+		indigo_item *item = property->items + i;
+		indigo_binary_put_string(buffer, item->name);
+		indigo_binary_put_string(buffer, item->label);
+		indigo_binary_put_string(buffer, item->hints);
+		switch (property->type) {
+			case INDIGO_TEXT_VECTOR:
+				indigo_binary_put_text(buffer, indigo_get_text_item_value(item));
+				break;
+			case INDIGO_NUMBER_VECTOR:
+				indigo_binary_put_string(buffer, item->number.format);
+				indigo_binary_put_double(buffer, item->number.min);
+				indigo_binary_put_double(buffer, item->number.max);
+				indigo_binary_put_double(buffer, item->number.step);
+				indigo_binary_put_double(buffer, item->number.value);
+				indigo_binary_put_double(buffer, item->number.target);
+				break;
+			case INDIGO_SWITCH_VECTOR:
+				indigo_binary_put_u8(buffer, item->sw.value);
+				break;
+			case INDIGO_LIGHT_VECTOR:
+				indigo_binary_put_u8(buffer, item->light.value);
+				break;
+			case INDIGO_BLOB_VECTOR:
+				break;
+		}
+	}
+	if (!write_message(context))
+		close_connection(context);
+	pthread_mutex_unlock(&write_mutex);
+	return INDIGO_OK;
+}
+
+static indigo_result binary_device_adapter_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	assert(device != NULL);
+	assert(client != NULL);
+	assert(property != NULL);
+	if (!indigo_reshare_remote_devices && device->is_remote)
+		return INDIGO_OK;
+	if (client->version == INDIGO_VERSION_NONE)
+		return INDIGO_OK;
+	binary_adapter_context *context = (binary_adapter_context *)client->client_context;
+	if (context->adapter.output <= 0)
+		return INDIGO_OK;
+	indigo_enable_blob_mode mode = INDIGO_ENABLE_BLOB_NEVER;
+	if (property->type == INDIGO_BLOB_VECTOR) {
+		indigo_enable_blob_mode_record *record = client->enable_blob_mode_records;
+		while (record) {
+			if ((*record->device == 0 || !strcmp(property->device, record->device)) && (*record->name == 0 || !strcmp(property->name, record->name))) {
+				mode = record->mode;
+				break;
+			}
+			record = record->next;
+		}
+		if (mode == INDIGO_ENABLE_BLOB_NEVER)
+			return INDIGO_OK;
+	}
+	pthread_mutex_lock(&write_mutex);
+	int id = property_id(context, property, false);
+	if (id < 0) {
+		pthread_mutex_unlock(&write_mutex);
+		return INDIGO_OK;
+	}
+	indigo_binary_buffer *buffer = &context->buffer;
+	indigo_binary_begin(buffer, INDIGO_BINARY_SET_PROPERTY);
+	indigo_binary_put_u32(buffer, id);
+	indigo_binary_put_u8(buffer, property->state);
+	indigo_binary_put_string(buffer, message);
+	long payload_tail = 0;
+	if (property->type == INDIGO_BLOB_VECTOR) {
+		if (property->state == INDIGO_OK_STATE) {
+			char path[INDIGO_VALUE_SIZE];
+			indigo_binary_put_u16(buffer, property->count);
+			for (int i = 0; i < property->count; i++) {
+				indigo_item *item = property->items + i;
+				indigo_binary_put_u16(buffer, i);
+				if (mode == INDIGO_ENABLE_BLOB_ALSO && item->blob.value) {
+					indigo_binary_put_u8(buffer, INDIGO_BINARY_BLOB_DATA);
+					indigo_binary_put_string(buffer, item->blob.format);
+					indigo_binary_put_u64(buffer, item->blob.size);
+					payload_tail += item->blob.size;
+				} else if (item->blob.value || indigo_proxy_blob) {
+					indigo_binary_put_u8(buffer, INDIGO_BINARY_BLOB_PATH);
+					indigo_binary_put_string(buffer, item->blob.format);
+					indigo_binary_put_u64(buffer, item->blob.size);
+					snprintf(path, sizeof(path), "/blob/%p%s", item, item->blob.format);
+					indigo_binary_put_string(buffer, path);
+				} else {
+					indigo_binary_put_u8(buffer, INDIGO_BINARY_BLOB_URL);
+					indigo_binary_put_string(buffer, item->blob.format);
+					indigo_binary_put_u64(buffer, item->blob.size);
+					indigo_binary_put_string(buffer, item->blob.url);
+				}
+			}
+		} else {
+			indigo_binary_put_u16(buffer, 0);
+		}
+	} else {
+		bool *changed = NULL;
+		if (context->adapter.delta_updates && property->type != INDIGO_SWITCH_VECTOR) {
+			changed = indigo_safe_malloc(property->count * sizeof(bool));
+			indigo_binary_put_u16(buffer, indigo_delta_changes(&context->adapter.delta_cache, property, changed));
+		} else {
+			indigo_binary_put_u16(buffer, property->count);
+		}
+		for (int i = 0; i < property->count; i++) {
+			indigo_item *item = property->items + i;
+			if (changed && !changed[i])
+				continue;
+			indigo_binary_put_u16(buffer, i);
+			switch (property->type) {
+				case INDIGO_TEXT_VECTOR:
+					indigo_binary_put_text(buffer, indigo_get_text_item_value(item));
+					break;
+				case INDIGO_NUMBER_VECTOR:
+					indigo_binary_put_double(buffer, item->number.value);
+					indigo_binary_put_double(buffer, item->number.target);
+					break;
+				case INDIGO_SWITCH_VECTOR:
+					indigo_binary_put_u8(buffer, item->sw.value);
+					break;
+				case INDIGO_LIGHT_VECTOR:
+					indigo_binary_put_u8(buffer, item->light.value);
+					break;
+				default:
+					break;
+			}
+		}
+		indigo_safe_free(changed);
+	}
+	bool result = indigo_binary_write(context->adapter.output, buffer, payload_tail);
+	if (payload_tail) {
+		// raw BLOB data is written without copying after the metadata
+		for (int i = 0; result && i < property->count; i++) {
+			indigo_item *item = property->items + i;
+			if (item->blob.value)
+				result = indigo_write(context->adapter.output, item->blob.value, item->blob.size);
+		}
+	}
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← message %d, %ld bytes", context->adapter.output, buffer->data[0], buffer->length + payload_tail));
+	if (!result)
+		close_connection(context);
+	pthread_mutex_unlock(&write_mutex);
+	return INDIGO_OK;
+}
+
+static indigo_result binary_device_adapter_delete_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	assert(device != NULL);
+	assert(client != NULL);
+	assert(property != NULL);
+	if (!indigo_reshare_remote_devices && device->is_remote)
+		return INDIGO_OK;
+	if (client->version == INDIGO_VERSION_NONE)
+		return INDIGO_OK;
+	binary_adapter_context *context = (binary_adapter_context *)client->client_context;
+	if (context->adapter.output <= 0)
+		return INDIGO_OK;
+	pthread_mutex_lock(&write_mutex);
+	const char *device_name = *property->name ? property->device : device->name;
+	for (int i = 0; i < context->count; i++) {
+		property_slot *slot = context->slots + i;
+		if (slot->used && !strcmp(slot->device, device_name) && (*property->name == 0 || !strcmp(slot->name, property->name)))
+			slot->used = false;
+	}
+	if (context->adapter.delta_updates)
+		indigo_delta_delete(&context->adapter.delta_cache, device_name, property->name);
+	indigo_binary_buffer *buffer = &context->buffer;
+	indigo_binary_begin(buffer, INDIGO_BINARY_DEL_PROPERTY);
+	indigo_binary_put_string(buffer, device_name);
+	indigo_binary_put_string(buffer, property->name);
+	indigo_binary_put_string(buffer, message);
+	if (!write_message(context))
+		close_connection(context);
+	pthread_mutex_unlock(&write_mutex);
+	return INDIGO_OK;
+}
+
+static indigo_result binary_device_adapter_send_message(indigo_client *client, indigo_device *device, const char *message) {
+	assert(device != NULL);
+	assert(client != NULL);
+	if (!indigo_reshare_remote_devices && device->is_remote)
+		return INDIGO_OK;
+	if (client->version == INDIGO_VERSION_NONE)
+		return INDIGO_OK;
+	binary_adapter_context *context = (binary_adapter_context *)client->client_context;
+	if (context->adapter.output <= 0 || message == NULL)
+		return INDIGO_OK;
+	pthread_mutex_lock(&write_mutex);
+	indigo_binary_buffer *buffer = &context->buffer;
+	indigo_binary_begin(buffer, INDIGO_BINARY_MESSAGE);
+	indigo_binary_put_string(buffer, "");
+	indigo_binary_put_string(buffer, message);
+	if (!write_message(context))
+		close_connection(context);
+	pthread_mutex_unlock(&write_mutex);
+	return INDIGO_OK;
+}
+
+indigo_client *indigo_binary_device_adapter(int input, int ouput) {
+	static indigo_client client_template = {
+		"Binary Driver Adapter", false, NULL, INDIGO_OK, INDIGO_VERSION_NONE, NULL,
+		NULL,
+		binary_device_adapter_define_property,
+		binary_device_adapter_update_property,
+		binary_device_adapter_delete_property,
+		binary_device_adapter_send_message,
+		NULL
+	};
+	indigo_client *client = indigo_safe_malloc_copy(sizeof(indigo_client), &client_template);
+	binary_adapter_context *client_context = indigo_safe_malloc(sizeof(binary_adapter_context));
+	client_context->adapter.input = input;
+	client_context->adapter.output = ouput;
+	client->client_context = client_context;
+	client->is_remote = input == ouput;
+	return client;
+}
+
+void indigo_release_binary_device_adapter(indigo_client *client) {
+	assert(client != NULL);
+	assert(client->client_context != NULL);
+	binary_adapter_context *client_context = (binary_adapter_context *)client->client_context;
+	indigo_enable_blob_mode_record *blob_record = client->enable_blob_mode_records;
+	while (blob_record) {
+		client->enable_blob_mode_records = blob_record->next;
+		free(blob_record);
+		blob_record = client->enable_blob_mode_records;
+	}
+	indigo_release_subscriptions(client);
+	indigo_safe_free(client_context->buffer.data);
+	indigo_safe_free(client_context->slots);
+	indigo_delta_release(&client_context->adapter.delta_cache);
+	free(client_context);
+	free(client);
+}
@@ -33,7 +33,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <arpa/inet.h>
-
+#include <zlib.h>
 
 #include <indigo/indigo_json.h>
 #include <indigo/indigo_io.h>
@@ -43,8 +43,48 @@
 
 static pthread_mutex_t json_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static bool ws_write(int handle, const char *buffer, long length) {
-	uint8_t header[10] = { 0x81 };
+#define WS_OPCODE_TEXT				0x1
+#define WS_OPCODE_BINARY			0x2
+#define WS_DEFLATE_MIN_SIZE		256
+
+static z_stream ws_deflater;
+static bool ws_deflater_initialized = false;
+static unsigned char *ws_deflate_buffer = NULL;
+static long ws_deflate_buffer_size = 0;
+
+static long ws_deflate(const char *buffer, long length) {
+	// called with json_mutex locked, deflater is reset for every message (server_no_context_takeover)
+	if (!ws_deflater_initialized) {
+		if (deflateInit2(&ws_deflater, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			return -1;
+		ws_deflater_initialized = true;
+	} else {
+		deflateReset(&ws_deflater);
+	}
+	long bound = deflateBound(&ws_deflater, length) + 16;
+	if (ws_deflate_buffer_size < bound)
+		ws_deflate_buffer = indigo_safe_realloc(ws_deflate_buffer, ws_deflate_buffer_size = bound);
+	ws_deflater.next_in = (Bytef *)buffer;
+	ws_deflater.avail_in = (uInt)length;
+	ws_deflater.next_out = ws_deflate_buffer;
+	ws_deflater.avail_out = (uInt)bound;
+	if (deflate(&ws_deflater, Z_SYNC_FLUSH) != Z_OK || ws_deflater.avail_in != 0)
+		return -1;
+	// strip 0x00 0x00 0xFF 0xFF trailer of sync flush (RFC7692 7.2.1)
+	return bound - ws_deflater.avail_out - 4;
+}
+
+static bool ws_write(indigo_adapter_context *client_context, uint8_t opcode, const char *buffer, long length) {
+	int handle = client_context->output;
+	uint8_t header[10] = { 0x80 | opcode };
+	if (client_context->web_socket_deflate && opcode == WS_OPCODE_TEXT && length >= WS_DEFLATE_MIN_SIZE) {
+		long compressed_length = ws_deflate(buffer, length);
+		if (compressed_length > 0 && compressed_length < length) {
+			header[0] |= 0x40;
+			buffer = (const char *)ws_deflate_buffer;
+			length = compressed_length;
+		}
+	}
 	bool result;
 	if (length <= 0x7D) {
 		header[1] = length;
@@ -64,6 +104,24 @@ static bool ws_write(int handle, const char *buffer, long length) {
 	return result;
 }
 
+bool indigo_json_ws_control(indigo_client *client, uint8_t opcode, const char *payload, long length) {
+	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	pthread_mutex_lock(&json_mutex);
+	bool result = ws_write(client_context, opcode, payload, length);
+	pthread_mutex_unlock(&json_mutex);
+	return result;
+}
+
+static indigo_enable_blob_mode blob_mode(indigo_client *client, indigo_property *property) {
+	indigo_enable_blob_mode_record *record = client->enable_blob_mode_records;
+	while (record) {
+		if ((*record->device == 0 || !strcmp(property->device, record->device)) && (*record->name == 0 || !strcmp(property->name, record->name)))
+			return record->mode;
+		record = record->next;
+	}
+	return INDIGO_ENABLE_BLOB_URL;
+}
+
 static indigo_result json_define_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
 	assert(device != NULL);
 	assert(client != NULL);
@@ -80,6 +138,8 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 	char *pnt = output_buffer;
 	int size;
 	char b1[32], b2[32], b3[32], b4[32], b5[32];
+	if (client_context->delta_updates)
+		indigo_delta_define(&client_context->delta_cache, property);
 	switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
 			size = sprintf(pnt, "{ \"defTextVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, indigo_json_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state]);
@@ -200,7 +260,7 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 			size += pnt - output_buffer;
 			break;
 	}
-	if (client_context->web_socket ? ws_write(handle, output_buffer, size) : indigo_write(handle, output_buffer, size)) {
+	if (client_context->web_socket ? ws_write(client_context, WS_OPCODE_TEXT, output_buffer, size) : indigo_write(handle, output_buffer, size)) {
 		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
 	} else {
 		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← FAILED\n", handle));
@@ -235,6 +295,14 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 	char *pnt = output_buffer;
 	int size;
 	char b1[32], b2[32];
+	indigo_enable_blob_mode mode;
+	bool inline_blobs = false;
+	bool *changed = NULL;
+	int sent = 0;
+	if (client_context->delta_updates && (property->type == INDIGO_TEXT_VECTOR || property->type == INDIGO_NUMBER_VECTOR || property->type == INDIGO_LIGHT_VECTOR)) {
+		changed = indigo_safe_malloc(property->count * sizeof(bool));
+		indigo_delta_changes(&client_context->delta_cache, property, changed);
+	}
 	switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
 			size = sprintf(pnt, "{ \"setTextVector\": { \"device\": \"%s\", \"name\": \"%s\", \"state\": \"%s\"", property->device, property->name, indigo_property_state_text[property->state]);
@@ -248,7 +316,9 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 			}
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, indigo_json_escape(indigo_get_text_item_value(item)));
+				if (changed && !changed[i])
+					continue;
+				size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"%s\" }",  sent++ > 0 ? "," : "", item->name, indigo_json_escape(indigo_get_text_item_value(item)));
 				pnt += size;
 			}
 			size = sprintf(pnt, " ] } }");
@@ -266,10 +336,12 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 			}
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
+				if (changed && !changed[i])
+					continue;
 				if (property->perm != INDIGO_RO_PERM)
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"target\": %s, \"value\": %s }",  i > 0 ? "," : "", item->name, indigo_dtoa(item->number.target, b1), indigo_dtoa(item->number.value, b2));
+					size = sprintf(pnt, "%s { \"name\": \"%s\", \"target\": %s, \"value\": %s }",  sent++ > 0 ? "," : "", item->name, indigo_dtoa(item->number.target, b1), indigo_dtoa(item->number.value, b2));
 				else
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, indigo_dtoa(item->number.value, b1));
+					size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": %s }",  sent++ > 0 ? "," : "", item->name, indigo_dtoa(item->number.value, b1));
 				pnt += size;
 			}
 			size = sprintf(pnt, " ] } }");
@@ -305,13 +377,22 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 			}
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, indigo_property_state_text[item->light.value]);
+				if (changed && !changed[i])
+					continue;
+				size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"%s\" }",  sent++ > 0 ? "," : "", item->name, indigo_property_state_text[item->light.value]);
 				pnt += size;
 			}
 			size = sprintf(pnt, " ] } }");
 			size += pnt - output_buffer;
 			break;
 		case INDIGO_BLOB_VECTOR:
+			mode = blob_mode(client, property);
+			if (mode == INDIGO_ENABLE_BLOB_NEVER) {
+				free(output_buffer);
+				pthread_mutex_unlock(&json_mutex);
+				return INDIGO_OK;
+			}
+			inline_blobs = client_context->web_socket && mode == INDIGO_ENABLE_BLOB_ALSO && property->state == INDIGO_OK_STATE;
 			size = sprintf(pnt, "{ \"setBLOBVector\": { \"device\": \"%s\", \"name\": \"%s\", \"state\": \"%s\"", property->device, property->name, indigo_property_state_text[property->state]);
 			pnt += size;
 			if (message) {
@@ -323,7 +404,9 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 			}
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				if ((property->state == INDIGO_OK_STATE && item->blob.value) || indigo_proxy_blob)
+				if (inline_blobs && item->blob.value)
+					size = sprintf(pnt, "%s { \"name\": \"%s\", \"format\": \"%s\", \"size\": %ld, \"binary\": true }", i > 0 ? "," : "", item->name, item->blob.format, item->blob.size);
+				else if ((property->state == INDIGO_OK_STATE && item->blob.value) || indigo_proxy_blob)
 					size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"/blob/%p%s\" }", i > 0 ? "," : "", item->name, item, item->blob.format);
 				else if (property->state == INDIGO_OK_STATE && *item->blob.url)
 					size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"%s\" }", i > 0 ? "," : "", item->name, item->blob.url);
@@ -335,8 +418,19 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 			size += pnt - output_buffer;
 			break;
 	}
-	if (client_context->web_socket ? ws_write(handle, output_buffer, size) : indigo_write(handle, output_buffer, size)) {
+	if (client_context->web_socket ? ws_write(client_context, WS_OPCODE_TEXT, output_buffer, size) : indigo_write(handle, output_buffer, size)) {
 		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
+		if (inline_blobs) {
+			// binary frames follow in the same order as items announced with "binary": true
+			for (int i = 0; i < property->count; i++) {
+				indigo_item *item = &property->items[i];
+				if (item->blob.value) {
+					if (!ws_write(client_context, WS_OPCODE_BINARY, item->blob.value, item->blob.size))
+						break;
+					INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %ld bytes of binary data\n", handle, item->blob.size));
+				}
+			}
+		}
 	} else {
 		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← FAILED\n", handle));
 		if (client_context->output == client_context->input) {
@@ -347,6 +441,7 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 		}
 		client_context->output = client_context->input = -1;
 	}
+	indigo_safe_free(changed);
 	free(output_buffer);
 	pthread_mutex_unlock(&json_mutex);
 	return INDIGO_OK;
@@ -367,6 +462,8 @@ static indigo_result json_delete_property(indigo_client *client, indigo_device *
 	char *output_buffer = indigo_safe_malloc(JSON_BUFFER_SIZE);
 	char *pnt = output_buffer;
 	int size;
+	if (client_context->delta_updates)
+		indigo_delta_delete(&client_context->delta_cache, *property->name ? property->device : device->name, property->name);
 	if (*property->name == 0)
 		size = sprintf(pnt, "{ \"deleteProperty\": { \"device\": \"%s\"", device->name);
 	else
@@ -378,11 +475,7 @@ static indigo_result json_delete_property(indigo_client *client, indigo_device *
 		size = sprintf(pnt, " } }");
 	}
 	size += pnt - output_buffer;
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	if (client_context->web_socket ? ws_write(handle, output_buffer, size) : indigo_write(handle, output_buffer, size)) {
+	if (client_context->web_socket ? ws_write(client_context, WS_OPCODE_TEXT, output_buffer, size) : indigo_write(handle, output_buffer, size)) {
 		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
 	} else {
 		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← FAILED\n", handle));
@@ -411,7 +504,7 @@ static indigo_result json_message_property(indigo_client *client, indigo_device
 	char *output_buffer = indigo_safe_malloc(JSON_BUFFER_SIZE);
 	char *pnt = output_buffer;
 	int size = sprintf(pnt, "{ \"message\": \"%s\" }", message);
-	if (client_context->web_socket ? ws_write(handle, output_buffer, size) : indigo_write(handle, output_buffer, size)) {
+	if (client_context->web_socket ? ws_write(client_context, WS_OPCODE_TEXT, output_buffer, size) : indigo_write(handle, output_buffer, size)) {
 		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
 	} else {
 		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← FAILED\n", handle));
@@ -460,6 +553,14 @@ indigo_client *indigo_json_device_adapter(int input, int ouput, bool web_socket)
 void indigo_release_json_device_adapter(indigo_client *client) {
 	assert(client != NULL);
 	assert(client->client_context != NULL);
+	indigo_enable_blob_mode_record *blob_record = client->enable_blob_mode_records;
+	while (blob_record) {
+		client->enable_blob_mode_records = blob_record->next;
+		free(blob_record);
+		blob_record = client->enable_blob_mode_records;
+	}
+	indigo_release_subscriptions(client);
+	indigo_delta_release(&((indigo_adapter_context *)client->client_context)->delta_cache);
 	free(client->client_context);
 	free(client);
 }
@@ -48,6 +48,7 @@
 #include <indigo/indigo_xml.h>
 #include <indigo/indigo_io.h>
 #include <indigo/indigo_base64.h>
+#include <indigo/indigo_metrics.h>
 #include <indigo/indigo_version.h>
 #include <indigo/indigo_driver_xml.h>
 
@@ -87,9 +88,12 @@ static indigo_result xml_device_adapter_define_property(indigo_client *client, i
 	if (client_context->output <= 0)
 		return INDIGO_OK;
 	pthread_mutex_lock(&write_mutex);
+	INDIGO_TRACING_BEGIN("xml", "define_property", property->name);
 	assert(client_context != NULL);
 	int handle = client_context->output;
 	char b1[32], b2[32], b3[32], b4[32], b5[32];
+	if (client_context->delta_updates)
+		indigo_delta_define(&client_context->delta_cache, property);
 	switch (property->type) {
 	case INDIGO_TEXT_VECTOR:
 		INDIGO_PRINTF(handle, "<defTextVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
@@ -136,6 +140,7 @@ static indigo_result xml_device_adapter_define_property(indigo_client *client, i
 		INDIGO_PRINTF(handle, "</defBLOBVector>\n");
 		break;
 	}
+	INDIGO_TRACING_END("xml", "define_property");
 	pthread_mutex_unlock(&write_mutex);
 	return INDIGO_OK;
 failure:
@@ -146,6 +151,7 @@ failure:
 		close(client_context->output);
 	}
 	client_context->output = client_context->input = -1;
+	INDIGO_TRACING_END("xml", "define_property");
 	pthread_mutex_unlock(&write_mutex);
 	return INDIGO_OK;
 }
@@ -164,14 +170,22 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 	if (client_context->output <= 0)
 		return INDIGO_OK;
 	pthread_mutex_lock(&write_mutex);
+	INDIGO_TRACING_BEGIN("xml", "update_property", property->name);
 	assert(client_context != NULL);
 	int handle = client_context->output;
 	char b1[32], b2[32];
+	bool *changed = NULL;
+	if (client_context->delta_updates && (property->type == INDIGO_TEXT_VECTOR || property->type == INDIGO_NUMBER_VECTOR || property->type == INDIGO_LIGHT_VECTOR)) {
+		changed = indigo_safe_malloc(property->count * sizeof(bool));
+		indigo_delta_changes(&client_context->delta_cache, property, changed);
+	}
 	switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
 			INDIGO_PRINTF(handle, "<setTextVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
+				if (changed && !changed[i])
+					continue;
 				INDIGO_PRINTF(handle, "<oneText name='%s'>%s</oneText>\n", indigo_item_name(client->version, property, item), indigo_xml_escape(indigo_get_text_item_value(item)));
 			}
 			INDIGO_PRINTF(handle, "</setTextVector>\n");
@@ -180,6 +194,8 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 			INDIGO_PRINTF(handle, "<setNumberVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
+				if (changed && !changed[i])
+					continue;
 				if (client->version >= INDIGO_VERSION_2_0 && property->perm != INDIGO_RO_PERM) {
 					INDIGO_PRINTF(handle, "<oneNumber name='%s' target='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.target, b1), indigo_dtoa(item->number.value, b2));
 				} else {
@@ -200,6 +216,8 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 			INDIGO_PRINTF(handle, "<setLightVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
+				if (changed && !changed[i])
+					continue;
 				INDIGO_PRINTF(handle, "<oneLight name='%s'>%s</oneLight>\n", indigo_item_name(client->version, property, item), indigo_property_state_text[item->light.value]);
 			}
 			INDIGO_PRINTF(handle, "</setLightVector>\n");
@@ -237,6 +255,7 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 									long len = (RAW_BUF_SIZE < input_length) ?  RAW_BUF_SIZE : input_length;
 									long enclen = base64_encode((unsigned char*)encoded_data, (unsigned char*)data, len);
 									fwrite(encoded_data, 1, enclen, fh);
+									indigo_metric_written(enclen);
 									input_length -= len;
 									data += len;
 								}
@@ -248,6 +267,7 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 									long enclen = base64_encode((unsigned char*)encoded_data, (unsigned char*)data, len);
 									encoded_data[enclen] = '\n';
 									fwrite(encoded_data, 1, enclen, fh);
+									indigo_metric_written(enclen);
 									input_length -= len;
 									data += len;
 								}
@@ -263,6 +283,8 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 			break;
 		}
 	}
+	indigo_safe_free(changed);
+	INDIGO_TRACING_END("xml", "update_property");
 	pthread_mutex_unlock(&write_mutex);
 	return INDIGO_OK;
 failure:
@@ -273,6 +295,8 @@ failure:
 		close(client_context->output);
 	}
 	client_context->output = client_context->input = -1;
+	indigo_safe_free(changed);
+	INDIGO_TRACING_END("xml", "update_property");
 	pthread_mutex_unlock(&write_mutex);
 	return INDIGO_OK;
 }
@@ -291,6 +315,8 @@ static indigo_result xml_device_adapter_delete_property(indigo_client *client, i
 	pthread_mutex_lock(&write_mutex);
 	assert(client_context != NULL);
 	int handle = client_context->output;
+	if (client_context->delta_updates)
+		indigo_delta_delete(&client_context->delta_cache, *property->name ? property->device : device->name, property->name);
 	if (*property->name) {
 		INDIGO_PRINTF(handle, "<delProperty device='%s' name='%s'%s/>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), message_attribute(message));
 	} else {
@@ -367,6 +393,8 @@ void indigo_release_xml_device_adapter(indigo_client *client) {
 		free(blob_record);
 		blob_record = client->enable_blob_mode_records;
 	}
+	indigo_release_subscriptions(client);
+	indigo_delta_release(&((indigo_adapter_context *)client->client_context)->delta_cache);
 	free(client->client_context);
 	free(client);
 }
@@ -46,8 +46,10 @@ indigo_result indigo_filter_device_attach(indigo_device *device, const char* dri
 	if (FILTER_DEVICE_CONTEXT == NULL) {
 		device->device_context = indigo_safe_malloc(sizeof(indigo_filter_context));
 	}
-	FILTER_DEVICE_CONTEXT->device = device;
 	if (FILTER_DEVICE_CONTEXT != NULL) {
+		FILTER_DEVICE_CONTEXT->device = device;
+		pthread_mutex_init(&FILTER_DEVICE_CONTEXT->wait_mutex, NULL);
+		pthread_cond_init(&FILTER_DEVICE_CONTEXT->wait_cond, NULL);
 		if (indigo_device_attach(device, driver_name, version, INDIGO_INTERFACE_AGENT | device_interface) == INDIGO_OK) {
 			CONNECTION_PROPERTY->hidden = true;
 			// -------------------------------------------------------------------------------- CCD property
@@ -423,6 +425,8 @@ indigo_result indigo_filter_device_detach(indigo_device *device) {
 		indigo_release_property(FILTER_DEVICE_CONTEXT->filter_related_device_list_properties[i]);
 	}
 	indigo_release_property(FILTER_DEVICE_CONTEXT->filter_related_agent_list_property);
+	pthread_cond_destroy(&FILTER_DEVICE_CONTEXT->wait_cond);
+	pthread_mutex_destroy(&FILTER_DEVICE_CONTEXT->wait_mutex);
 	return indigo_device_detach(device);
 }
 
@@ -604,7 +608,20 @@ indigo_result indigo_filter_define_property(indigo_client *client, indigo_device
 	return INDIGO_OK;
 }
 
-indigo_result indigo_filter_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+static void notify_waiting(indigo_filter_context *context) {
+	pthread_mutex_lock(&context->wait_mutex);
+	pthread_cond_broadcast(&context->wait_cond);
+	pthread_mutex_unlock(&context->wait_mutex);
+}
+
+static void mark_removed(indigo_filter_context *context) {
+	pthread_mutex_lock(&context->wait_mutex);
+	context->property_removed = true;
+	pthread_cond_broadcast(&context->wait_cond);
+	pthread_mutex_unlock(&context->wait_mutex);
+}
+
+static indigo_result update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
 	if (device == FILTER_CLIENT_CONTEXT->device)
 		return INDIGO_OK;
 	device = FILTER_CLIENT_CONTEXT->device;
@@ -670,6 +687,12 @@ indigo_result indigo_filter_update_property(indigo_client *client, indigo_device
 	return INDIGO_OK;
 }
 
+indigo_result indigo_filter_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	indigo_result result = update_property(client, device, property, message);
+	notify_waiting(FILTER_CLIENT_CONTEXT);
+	return result;
+}
+
 static void remove_from_list(indigo_device *device, indigo_property *device_list, indigo_property *property, char *device_name) {
 	for (int i = 1; i < device_list->count; i++) {
 		if (!strcmp(property->device, device_list->items[i].name)) {
@@ -702,7 +725,7 @@ indigo_result indigo_filter_delete_property(indigo_client *client, indigo_device
 	if (*property->name) {
 		for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
 			if (device_cache[i] == property) {
-				FILTER_CLIENT_CONTEXT->property_removed = true;
+				mark_removed(FILTER_CLIENT_CONTEXT);
 				device_cache[i] = NULL;
 				if (agent_cache[i]) {
 					indigo_delete_property(device, agent_cache[i], NULL);
@@ -725,7 +748,7 @@ indigo_result indigo_filter_delete_property(indigo_client *client, indigo_device
 	} else {
 		for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
 			if (device_cache[i] && !strcmp(device_cache[i]->device, property->device)) {
-				FILTER_CLIENT_CONTEXT->property_removed = true;
+				mark_removed(FILTER_CLIENT_CONTEXT);
 				device_cache[i] = NULL;
 				if (agent_cache[i]) {
 					indigo_delete_property(device, agent_cache[i], message);
@@ -814,3 +837,52 @@ indigo_result indigo_filter_forward_change_property(indigo_client *client, indig
 	indigo_release_property(copy);
 	return result;
 }
+
+indigo_filter_wait_result indigo_filter_wait_state(indigo_device *device, indigo_property *property, indigo_property_state state, bool enter, indigo_property *abort_property, indigo_property *pause_property, double timeout) {
+	indigo_filter_context *context = FILTER_DEVICE_CONTEXT;
+	struct timespec end;
+	if (timeout > 0) {
+		clock_gettime(CLOCK_REALTIME, &end);
+		end.tv_sec += (int)timeout;
+		end.tv_nsec += 1000000000L * (timeout - (int)timeout);
+		normalize_timespec(&end);
+	}
+	indigo_filter_wait_result result;
+	// removal of cached properties is relevant only for waits on cached properties, agent's own properties are never removed
+	bool cached = false;
+	for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES && !cached; i++)
+		cached = context->agent_property_cache[i] == property;
+	pthread_mutex_lock(&context->wait_mutex);
+	while (true) {
+		if (cached && context->property_removed) {
+			result = INDIGO_FILTER_WAIT_REMOVED;
+			break;
+		}
+		if (abort_property && abort_property->state == INDIGO_BUSY_STATE) {
+			result = INDIGO_FILTER_WAIT_ABORTED;
+			break;
+		}
+		if (pause_property && pause_property->state == INDIGO_BUSY_STATE) {
+			result = INDIGO_FILTER_WAIT_PAUSED;
+			break;
+		}
+		if ((property->state == state) == enter) {
+			result = INDIGO_FILTER_WAIT_OK;
+			break;
+		}
+		if (timeout > 0) {
+			if (pthread_cond_timedwait(&context->wait_cond, &context->wait_mutex, &end) == ETIMEDOUT) {
+				result = (property->state == state) == enter ? INDIGO_FILTER_WAIT_OK : INDIGO_FILTER_WAIT_TIMEOUT;
+				break;
+			}
+		} else {
+			pthread_cond_wait(&context->wait_cond, &context->wait_mutex);
+		}
+	}
+	pthread_mutex_unlock(&context->wait_mutex);
+	return result;
+}
+
+void indigo_filter_notify(indigo_device *device) {
+	notify_waiting(FILTER_DEVICE_CONTEXT);
+}
@@ -0,0 +1,283 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO image buffer pool
+ \file indigo_image_pool.c
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(INDIGO_WINDOWS)
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_image_pool.h>
+
+#define POOL_MAGIC						0x494D4750		// 'IMGP'
+#define POOL_MIN_SHIFT				16						// smallest class is 64KB
+#define POOL_CLASS_STEPS			8							// classes per power of two
+#define POOL_HUGE_PAGE_SIZE		(2 * 1024 * 1024)
+
+typedef struct pool_buffer {
+	uint32_t magic;
+	int references;
+	long capacity;
+	struct pool_buffer *prev, *next;
+} pool_buffer;
+
+long indigo_image_pool_budget = 0;
+bool indigo_image_pool_huge_pages = false;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static long page_size = 4096;
+static long default_budget = 1L << 30;
+static pool_buffer *idle_head = NULL;		// most recently released
+static pool_buffer *idle_tail = NULL;		// least recently released
+static indigo_image_pool_statistics statistics;
+
+#define BUFFER_HEADER(data)		((pool_buffer *)((char *)(data) - page_size))
+#define BUFFER_DATA(header)		((void *)((char *)(header) + page_size))
+
+static void pool_init(void) {
+#if defined(INDIGO_WINDOWS)
+	page_size = 4096;
+#else
+	long size = sysconf(_SC_PAGESIZE);
+	if (size >= (long)sizeof(pool_buffer))
+		page_size = size;
+#endif
+#if defined(_SC_PHYS_PAGES)
+	long pages = sysconf(_SC_PHYS_PAGES);
+	if (pages > 0)
+		default_budget = pages / 2 * page_size;
+#endif
+}
+
+static long pool_budget(void) {
+	return indigo_image_pool_budget > 0 ? indigo_image_pool_budget : default_budget;
+}
+
+static long class_capacity(long size) {
+	long min = 1L << POOL_MIN_SHIFT;
+	if (size <= min)
+		return min;
+	int shift = 63 - __builtin_clzll((unsigned long long)(size - 1));
+	long step = (1L << shift) / POOL_CLASS_STEPS;
+	return (size + step - 1) / step * step;
+}
+
+static pool_buffer *map_buffer(long capacity) {
+	long length = page_size + capacity;
+	void *memory;
+#if defined(INDIGO_WINDOWS)
+	memory = _aligned_malloc(length, page_size);
+#else
+	memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		memory = NULL;
+#if defined(MADV_HUGEPAGE)
+	if (memory && indigo_image_pool_huge_pages && capacity >= POOL_HUGE_PAGE_SIZE)
+		madvise((char *)memory + page_size, capacity, MADV_HUGEPAGE);
+#endif
+#endif
+	if (memory == NULL)
+		return NULL;
+	pool_buffer *header = memory;
+	header->magic = POOL_MAGIC;
+	header->capacity = capacity;
+	header->prev = header->next = NULL;
+	return header;
+}
+
+static void unmap_buffer(pool_buffer *header) {
+	header->magic = 0;
+#if defined(INDIGO_WINDOWS)
+	_aligned_free(header);
+#else
+	munmap(header, page_size + header->capacity);
+#endif
+}
+
+static void unlink_idle(pool_buffer *header) {
+	if (header->prev)
+		header->prev->next = header->next;
+	else
+		idle_head = header->next;
+	if (header->next)
+		header->next->prev = header->prev;
+	else
+		idle_tail = header->prev;
+	header->prev = header->next = NULL;
+	statistics.idle -= header->capacity;
+	statistics.idle_buffers--;
+}
+
+static bool evict_idle(long needed) {
+	// release least recently used idle buffers until needed bytes fit into budget
+	long budget = pool_budget();
+	while (idle_tail && statistics.used + statistics.idle + needed > budget) {
+		pool_buffer *header = idle_tail;
+		unlink_idle(header);
+		unmap_buffer(header);
+		statistics.evictions++;
+	}
+	return statistics.used + statistics.idle + needed <= budget;
+}
+
+static inline pool_buffer *checked_header(void *buffer) {
+	pool_buffer *header = BUFFER_HEADER(buffer);
+	assert(header->magic == POOL_MAGIC);
+	return header;
+}
+
+void *indigo_alloc_image_buffer(long size) {
+	pthread_once(&pool_once, pool_init);
+	long capacity = class_capacity(size);
+	pthread_mutex_lock(&pool_mutex);
+	statistics.allocations++;
+	pool_buffer *header = NULL;
+	for (pool_buffer *idle = idle_head; idle; idle = idle->next) {
+		if (idle->capacity == capacity) {
+			header = idle;
+			unlink_idle(header);
+			statistics.reuses++;
+			break;
+		}
+	}
+	if (header == NULL) {
+		if (!evict_idle(capacity)) {
+			if (statistics.over_budget++ == 0)
+				INDIGO_LOG(indigo_log("Image buffer pool exceeds budget of %ldMB", pool_budget() / 1048576));
+		}
+		header = map_buffer(capacity);
+		if (header == NULL) {
+			// try once again without any idle buffers
+			while (idle_tail) {
+				pool_buffer *idle = idle_tail;
+				unlink_idle(idle);
+				unmap_buffer(idle);
+				statistics.evictions++;
+			}
+			header = map_buffer(capacity);
+		}
+		if (header == NULL) {
+			pthread_mutex_unlock(&pool_mutex);
+			INDIGO_ERROR(indigo_error("Failed to allocate image buffer of %ld bytes", size));
+			return NULL;
+		}
+	}
+	header->references = 1;
+	statistics.used += capacity;
+	statistics.buffers++;
+	if (statistics.used + statistics.idle > statistics.peak)
+		statistics.peak = statistics.used + statistics.idle;
+	pthread_mutex_unlock(&pool_mutex);
+	return BUFFER_DATA(header);
+}
+
+void *indigo_resize_image_buffer(void *buffer, long size) {
+	if (buffer == NULL)
+		return indigo_alloc_image_buffer(size);
+	pool_buffer *header = checked_header(buffer);
+	assert(__atomic_load_n(&header->references, __ATOMIC_ACQUIRE) == 1);
+	if (header->capacity >= size)
+		return buffer;
+	void *resized = indigo_alloc_image_buffer(size);
+	if (resized == NULL)
+		return NULL;
+	memcpy(resized, buffer, header->capacity);
+	indigo_release_image_buffer(buffer);
+	return resized;
+}
+
+void *indigo_retain_image_buffer(void *buffer) {
+	if (buffer)
+		__atomic_add_fetch(&checked_header(buffer)->references, 1, __ATOMIC_RELAXED);
+	return buffer;
+}
+
+void indigo_release_image_buffer(void *buffer) {
+	if (buffer == NULL)
+		return;
+	pool_buffer *header = checked_header(buffer);
+	int references = __atomic_sub_fetch(&header->references, 1, __ATOMIC_ACQ_REL);
+	assert(references >= 0);
+	if (references > 0)
+		return;
+	pthread_mutex_lock(&pool_mutex);
+	statistics.used -= header->capacity;
+	statistics.buffers--;
+	if (statistics.used + statistics.idle + header->capacity > pool_budget()) {
+		unmap_buffer(header);
+		statistics.evictions++;
+	} else {
+		header->prev = NULL;
+		header->next = idle_head;
+		if (idle_head)
+			idle_head->prev = header;
+		else
+			idle_tail = header;
+		idle_head = header;
+		statistics.idle += header->capacity;
+		statistics.idle_buffers++;
+	}
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+long indigo_image_buffer_size(void *buffer) {
+	return buffer ? checked_header(buffer)->capacity : 0;
+}
+
+void indigo_set_image_pool_budget(long budget) {
+	pthread_once(&pool_once, pool_init);
+	pthread_mutex_lock(&pool_mutex);
+	indigo_image_pool_budget = budget;
+	evict_idle(0);
+	pthread_mutex_unlock(&pool_mutex);
+	INDIGO_DEBUG(indigo_debug("Image buffer pool budget set to %ldMB", pool_budget() / 1048576));
+}
+
+void indigo_trim_image_pool(void) {
+	pthread_mutex_lock(&pool_mutex);
+	while (idle_tail) {
+		pool_buffer *header = idle_tail;
+		unlink_idle(header);
+		unmap_buffer(header);
+	}
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+void indigo_get_image_pool_statistics(indigo_image_pool_statistics *result) {
+	pthread_once(&pool_once, pool_init);
+	pthread_mutex_lock(&pool_mutex);
+	*result = statistics;
+	result->budget = pool_budget();
+	pthread_mutex_unlock(&pool_mutex);
+}
@@ -36,6 +36,7 @@
 #include <unistd.h>
 #include <termios.h>
 #include <netdb.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -53,6 +54,7 @@
 
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_io.h>
+#include <indigo/indigo_metrics.h>
 
 #if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
 
@@ -410,8 +412,10 @@ bool indigo_write(int handle, const char *buffer, long length) {
 			INDIGO_ERROR(indigo_error("%s(): %s", __FUNCTION__, strerror(errno)));
 			return false;
 		}
-		if (bytes_written == remains)
+		if (bytes_written == remains) {
+			indigo_metric_written(length);
 			return true;
+		}
 		buffer += bytes_written;
 		remains -= bytes_written;
 	}
@@ -448,3 +452,169 @@ int indigo_scanf(int handle, const char *format, ...) {
 	free(buffer);
 	return count;
 }
+
+static long wait_and_read(int handle, char *buffer, long length, long timeout) {
+	fd_set readout;
+	FD_ZERO(&readout);
+	FD_SET(handle, &readout);
+	struct timeval tv;
+	tv.tv_sec = timeout / 1000000;
+	tv.tv_usec = timeout % 1000000;
+	long result = select(handle + 1, &readout, NULL, NULL, &tv);
+	if (result <= 0)
+		return result;
+#if defined(INDIGO_WINDOWS)
+	result = recv(handle, buffer, length, 0);
+#else
+	result = read(handle, buffer, length);
+#endif
+	if (result == 0)
+		errno = ECONNRESET;
+	return result < 1 ? -1 : result;
+}
+
+bool indigo_drain(int handle) {
+#if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
+	if (isatty(handle))
+		tcflush(handle, TCIFLUSH);
+#endif
+	char buffer[256];
+	while (true) {
+		long result = wait_and_read(handle, buffer, sizeof(buffer), 0);
+		if (result == 0)
+			return true;
+		if (result < 0) {
+			INDIGO_ERROR(indigo_error("%s(): %s", __FUNCTION__, strerror(errno)));
+			return false;
+		}
+	}
+}
+
+static bool read_response(int handle, char *buffer, int size, int *start, int *end, indigo_transaction *transaction) {
+	transaction->length = 0;
+	transaction->complete = false;
+	char *response = transaction->response;
+	int max = transaction->response_size - 1;
+	if (transaction->response_length > 0 && transaction->response_length < max)
+		max = transaction->response_length;
+	long timeout = transaction->timeout;
+	bool done = max == 0;
+	while (!done) {
+		while (*start < *end) {
+			char c = buffer[(*start)++];
+			if (transaction->response_length == 0 && c && transaction->terminators && strchr(transaction->terminators, c)) {
+				if (transaction->keep_terminator && transaction->length < transaction->response_size - 1)
+					response[transaction->length++] = c;
+				transaction->complete = done = true;
+				break;
+			}
+			if (c && transaction->ignored && strchr(transaction->ignored, c))
+				continue;
+			response[transaction->length++] = c;
+			if (transaction->length == max) {
+				transaction->complete = transaction->response_length > 0;
+				done = true;
+				break;
+			}
+		}
+		if (done)
+			break;
+		// read whatever is available, unused bytes are kept for the next response
+		*start = 0;
+		*end = (int)wait_and_read(handle, buffer, size, timeout);
+		if (*end == 0)
+			break;
+		if (*end < 0) {
+			*end = 0;
+			response[transaction->length] = 0;
+			INDIGO_ERROR(indigo_error("%s(): %s", __FUNCTION__, strerror(errno)));
+			return false;
+		}
+		if (transaction->char_timeout > 0)
+			timeout = transaction->char_timeout;
+	}
+	response[transaction->length] = 0;
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d → %s%s", handle, response, transaction->complete ? "" : " (incomplete)"));
+	return true;
+}
+
+bool indigo_read_buffered(int handle, indigo_read_buffer *buffer, indigo_transaction *transaction) {
+	if (transaction->response == NULL || transaction->response_size < 1)
+		return true;
+	if (!read_response(handle, buffer->data, sizeof(buffer->data), &buffer->start, &buffer->end, transaction))
+		return false;
+	if (!transaction->complete && transaction->length > 0 && transaction->length < transaction->response_size - 1 && transaction->ignored == NULL) {
+		// timeout in the middle of response, keep partial data for the next read
+		memcpy(buffer->data, transaction->response, transaction->length);
+		buffer->start = 0;
+		buffer->end = transaction->length;
+		transaction->length = 0;
+		*transaction->response = 0;
+	}
+	return true;
+}
+
+static bool execute_transactions(int handle, indigo_transaction *transactions, int count, bool flush, bool pipeline) {
+	indigo_read_buffer buffer = { .start = 0, .end = 0 };
+	if (flush && !indigo_drain(handle))
+		return false;
+	if (pipeline) {
+		// all commands are written with a single write to avoid round trip for every command
+		long length = 0, delay = 0;
+		for (int i = 0; i < count; i++) {
+			indigo_transaction *transaction = transactions + i;
+			if (transaction->command) {
+				long command_length = transaction->command_length ? transaction->command_length : strlen(transaction->command);
+				if (length + command_length > sizeof(buffer.data)) {
+					if (!indigo_write(handle, buffer.data, length))
+						return false;
+					length = 0;
+				}
+				memcpy(buffer.data + length, transaction->command, command_length);
+				length += command_length;
+			}
+			if (transaction->delay > delay)
+				delay = transaction->delay;
+		}
+		if (length > 0 && !indigo_write(handle, buffer.data, length))
+			return false;
+		if (delay > 0)
+			indigo_usleep((unsigned)delay);
+	}
+	for (int i = 0; i < count; i++) {
+		indigo_transaction *transaction = transactions + i;
+		transaction->length = 0;
+		transaction->complete = false;
+		if (!pipeline && transaction->command) {
+			if (!indigo_write(handle, transaction->command, transaction->command_length ? transaction->command_length : strlen(transaction->command)))
+				return false;
+			if (transaction->delay > 0)
+				indigo_usleep((unsigned)transaction->delay);
+		}
+		// unterminated response is returned on timeout, buffer is not kept for the next call
+		if (transaction->response && transaction->response_size > 0 && !read_response(handle, buffer.data, sizeof(buffer.data), &buffer.start, &buffer.end, transaction))
+			return false;
+	}
+	return true;
+}
+
+static pthread_once_t transaction_metrics_once = PTHREAD_ONCE_INIT;
+static indigo_metric *transaction_round_trip = NULL, *transaction_failures = NULL;
+
+static void create_transaction_metrics(void) {
+	transaction_round_trip = indigo_get_metric(INDIGO_METRIC_HISTOGRAM, "indigo_serial_round_trip_seconds", "Serial command transactions round trip time", NULL, NULL);
+	transaction_failures = indigo_get_metric(INDIGO_METRIC_COUNTER, "indigo_serial_failures_total", "Failed serial command transactions", NULL, NULL);
+}
+
+bool indigo_execute_transactions(int handle, indigo_transaction *transactions, int count, bool flush, bool pipeline) {
+	if (!indigo_use_metrics)
+		return execute_transactions(handle, transactions, count, flush, pipeline);
+	pthread_once(&transaction_metrics_once, create_transaction_metrics);
+	double start = indigo_metric_time();
+	bool result = execute_transactions(handle, transactions, count, flush, pipeline);
+	if (result)
+		indigo_metric_observe(transaction_round_trip, indigo_metric_time() - start);
+	else
+		indigo_metric_add(transaction_failures, 1);
+	return result;
+}
@@ -34,9 +34,12 @@
 #include <assert.h>
 #include <stdint.h>
 #include <arpa/inet.h>
+#include <zlib.h>
 
 #include <indigo/indigo_json.h>
+#include <indigo/indigo_driver_json.h>
 #include <indigo/indigo_io.h>
+#include <indigo/indigo_xml.h>
 
 //#undef INDIGO_TRACE_PARSER
 //#define INDIGO_TRACE_PARSER(c) c
@@ -46,42 +49,176 @@
 
 #define PROPERTY_SIZE sizeof(indigo_property)+INDIGO_MAX_ITEMS*(sizeof(indigo_item))
 
-static long ws_read(int handle, char *buffer, long length) {
-	uint8_t header[14];
-	int bytes_read = indigo_read(handle, (char *)header, 6);
-	if (bytes_read <= 0) {
-		return bytes_read;
+#define WS_MAX_MESSAGE_SIZE	(16 * 1024 * 1024)
+#define WS_EMPTY_MESSAGE		(-2)
+
+#define WS_OPCODE_CLOSE			0x8
+#define WS_OPCODE_PING			0x9
+#define WS_OPCODE_PONG			0xA
+
+typedef struct {
+	bool deflate;
+	bool inflater_initialized;
+	z_stream inflater;
+	uint8_t *frame_buffer;
+	long frame_buffer_size;
+} ws_context;
+
+static void ws_unmask(uint8_t *data, uint64_t length, const uint8_t *masking_key) {
+	uint64_t mask;
+	uint8_t *mask_bytes = (uint8_t *)&mask;
+	for (int i = 0; i < 8; i++)
+		mask_bytes[i] = masking_key[i % 4];
+	uint64_t i = 0;
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		word ^= mask;
+		memcpy(data + i, &word, 8);
 	}
-	INDIGO_TRACE_PARSER(indigo_trace("ws_read -> %2x", header[0]));
-	uint8_t *masking_key = header+2;
-	uint64_t payload_length = header[1] & 0x7F;
-	if (payload_length == 0x7E) {
-		bytes_read = indigo_read(handle, (char *)header + 6, 2);
-		if (bytes_read <= 0) {
-			return bytes_read;
+	for (; i < length; i++)
+		data[i] ^= masking_key[i % 4];
+}
+
+static long ws_inflate(ws_context *ws, uint8_t *input, long input_length, char **buffer, long *size) {
+	if (!ws->inflater_initialized) {
+		if (inflateInit2(&ws->inflater, -MAX_WBITS) != Z_OK) {
+			errno = EPROTO;
+			return -1;
 		}
-		masking_key = header + 4;
-		payload_length = ntohs(*((uint16_t *)(header+2)));
-	} else if (payload_length == 0x7F) {
-		bytes_read = indigo_read(handle, (char *)header + 6, 8);
+		ws->inflater_initialized = true;
+	}
+	// restore 0x00 0x00 0xFF 0xFF trailer removed by sender (RFC7692 7.2.2), input buffer has room for it
+	memcpy(input + input_length, "\x00\x00\xFF\xFF", 4);
+	ws->inflater.next_in = input;
+	ws->inflater.avail_in = (uInt)(input_length + 4);
+	long length = 0;
+	while (true) {
+		if (*size - length < 1024) {
+			if (*size >= WS_MAX_MESSAGE_SIZE) {
+				errno = ENODATA;
+				return -1;
+			}
+			*buffer = indigo_safe_realloc(*buffer, *size *= 2);
+		}
+		ws->inflater.next_out = (Bytef *)*buffer + length;
+		ws->inflater.avail_out = (uInt)(*size - length - 1);
+		int result = inflate(&ws->inflater, Z_SYNC_FLUSH);
+		length = (char *)ws->inflater.next_out - *buffer;
+		if (result == Z_STREAM_END) {
+			inflateReset(&ws->inflater);
+			break;
+		}
+		if (result != Z_OK && result != Z_BUF_ERROR) {
+			errno = EPROTO;
+			return -1;
+		}
+		if (ws->inflater.avail_in == 0 && ws->inflater.avail_out != 0)
+			break;
+	}
+	return length;
+}
+
+// returns message length, 0 on EOF or close, -1 on error or WS_EMPTY_MESSAGE for message without payload
+static long ws_read(int handle, indigo_client *client, ws_context *ws, char **buffer, long *size) {
+	uint8_t header[8];
+	uint8_t control[125];
+	uint8_t masking_key[4];
+	uint8_t *payload = NULL;
+	long length = 0;
+	bool compressed = false, binary = false;
+	while (true) {
+		int bytes_read = indigo_read(handle, (char *)header, 2);
 		if (bytes_read <= 0) {
 			return bytes_read;
 		}
-		masking_key = header+10;
-		payload_length = ntohll(*((uint64_t *)(header+2)));
-	}
-	if (length < payload_length) {
-		errno = ENODATA;
-		return -1;
-	}
-	bytes_read = indigo_read(handle, buffer, payload_length);
-	if (bytes_read <= 0) {
-		return bytes_read;
-	}
-	for (uint64_t i = 0; i < payload_length; i++) {
-		buffer[i] ^= masking_key[i%4];
+		INDIGO_TRACE_PARSER(indigo_trace("ws_read -> %2x", header[0]));
+		bool fin = header[0] & 0x80;
+		uint8_t opcode = header[0] & 0x0F;
+		bool masked = header[1] & 0x80;
+		uint64_t payload_length = header[1] & 0x7F;
+		if (payload_length == 0x7E) {
+			bytes_read = indigo_read(handle, (char *)header, 2);
+			if (bytes_read <= 0) {
+				return bytes_read;
+			}
+			payload_length = ntohs(*((uint16_t *)header));
+		} else if (payload_length == 0x7F) {
+			bytes_read = indigo_read(handle, (char *)header, 8);
+			if (bytes_read <= 0) {
+				return bytes_read;
+			}
+			payload_length = ntohll(*((uint64_t *)header));
+		}
+		if (masked) {
+			bytes_read = indigo_read(handle, (char *)masking_key, 4);
+			if (bytes_read <= 0) {
+				return bytes_read;
+			}
+		}
+		if (opcode & 0x08) {
+			// control frame, may be interleaved with fragments of data message
+			if (payload_length > sizeof(control)) {
+				errno = EPROTO;
+				return -1;
+			}
+			if (payload_length > 0) {
+				bytes_read = indigo_read(handle, (char *)control, payload_length);
+				if (bytes_read <= 0) {
+					return bytes_read;
+				}
+				if (masked)
+					ws_unmask(control, payload_length, masking_key);
+			}
+			if (opcode == WS_OPCODE_CLOSE) {
+				// echo status code back to complete closing handshake (RFC6455 5.5.1)
+				indigo_json_ws_control(client, WS_OPCODE_CLOSE, (char *)control, payload_length >= 2 ? 2 : 0);
+				return 0;
+			}
+			if (opcode == WS_OPCODE_PING) {
+				indigo_json_ws_control(client, WS_OPCODE_PONG, (char *)control, (long)payload_length);
+			}
+			continue;
+		}
+		if (opcode != 0) {
+			compressed = ws->deflate && (header[0] & 0x40);
+			binary = opcode == 0x2;
+			length = 0;
+		}
+		if (length + payload_length + 5 > WS_MAX_MESSAGE_SIZE) {
+			errno = ENODATA;
+			return -1;
+		}
+		// leave room for deflate trailer or string terminator
+		if (compressed) {
+			if (ws->frame_buffer_size < length + payload_length + 5)
+				ws->frame_buffer = indigo_safe_realloc(ws->frame_buffer, ws->frame_buffer_size = length + payload_length + 5);
+			payload = ws->frame_buffer;
+		} else {
+			if (*size < length + payload_length + 5)
+				*buffer = indigo_safe_realloc(*buffer, *size = length + payload_length + 5);
+			payload = (uint8_t *)*buffer;
+		}
+		if (payload_length > 0) {
+			bytes_read = indigo_read(handle, (char *)payload + length, payload_length);
+			if (bytes_read <= 0) {
+				return bytes_read;
+			}
+			if (masked)
+				ws_unmask(payload + length, payload_length, masking_key);
+			length += payload_length;
+		}
+		if (!fin)
+			continue;
+		if (binary) {
+			// binary messages are not expected from clients
+			INDIGO_DEBUG_PROTOCOL(indigo_debug("%d → %ld bytes of binary data ignored", handle, length));
+			continue;
+		}
+		if (compressed)
+			length = ws_inflate(ws, payload, length, buffer, size);
+		return length == 0 ? WS_EMPTY_MESSAGE : length;
 	}
-	return payload_length;
 }
 
 typedef enum {
@@ -130,13 +267,85 @@ static void *get_properties_handler(parser_state state, char *name, char *value,
 	INDIGO_TRACE_PARSER(indigo_trace("JSON Parser: %s %s '%s' '%s'", __FUNCTION__, parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == NUMBER_VALUE && !strcmp(name, "version")) {
 		client->version = (int)atol(value);
+	} else if (state == LOGICAL_VALUE && !strcmp(name, "delta")) {
+		((indigo_adapter_context *)client->client_context)->delta_updates = !strcmp(value, "true");
+	} else if (state == LOGICAL_VALUE && !strcmp(name, "subscribe")) {
+		// subscription request is kept in label until the whole request is parsed
+		indigo_copy_name(property->label, strcmp(value, "true") ? "" : "On");
+	} else if (state == TEXT_VALUE) {
+		if (!strcmp(name, "device")) {
+			indigo_copy_name(property->device, value);
+		} else if (!strcmp(name, "name")) {
+			indigo_copy_name(property->name, value);
+		} else if (!strcmp(name, "group")) {
+			indigo_copy_name(property->group, value);
+		}
 	} else if (state == END_STRUCT) {
+		if (!strcmp(property->label, "On")) {
+			indigo_subscribe(client, property->device, property->name, property->group);
+			// wildcards are resolved by subscription filter
+			if (strpbrk(property->device, "*?"))
+				*property->device = 0;
+			if (strpbrk(property->name, "*?"))
+				*property->name = 0;
+		} else {
+			// device and name are used for subscription only, plain request enumerates all properties
+			*property->device = *property->name = 0;
+		}
 		indigo_enumerate_properties(client, property);
 		return top_level_handler;
 	}
 	return get_properties_handler;
 }
 
+static void *enable_blob_handler(parser_state state, char *name, char *value, indigo_property *property, indigo_device *device, indigo_client *client, char *message) {
+	INDIGO_TRACE_PARSER(indigo_trace("JSON Parser: %s %s '%s' '%s'", __FUNCTION__, parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
+	if (state == TEXT_VALUE) {
+		if (!strcmp(name, "device")) {
+			indigo_copy_name(property->device, value);
+		} else if (!strcmp(name, "name")) {
+			indigo_copy_name(property->name, value);
+		} else if (!strcmp(name, "value")) {
+			// requested mode is kept in label until the whole request is parsed
+			indigo_copy_name(property->label, value);
+		}
+	} else if (state == END_STRUCT) {
+		// unlike XML, missing record means URL mode, so "Never" has to be recorded as well
+		indigo_enable_blob_mode mode = INDIGO_ENABLE_BLOB_URL;
+		if (!strcmp(property->label, "Never"))
+			mode = INDIGO_ENABLE_BLOB_NEVER;
+		else if (!strcmp(property->label, "Also") || !indigo_use_blob_urls)
+			mode = INDIGO_ENABLE_BLOB_ALSO;
+		indigo_enable_blob_mode_record *record = client->enable_blob_mode_records;
+		indigo_enable_blob_mode_record *prev = NULL;
+		while (record) {
+			if (!strcmp(property->device, record->device) && (*record->name == 0 || !strcmp(property->name, record->name))) {
+				if (prev) {
+					prev->next = record->next;
+					free(record);
+					record = prev->next;
+				} else {
+					client->enable_blob_mode_records = record->next;
+					free(record);
+					record = client->enable_blob_mode_records;
+				}
+			} else {
+				prev = record;
+				record = record->next;
+			}
+		}
+		record = indigo_safe_malloc(sizeof(indigo_enable_blob_mode_record));
+		indigo_copy_name(record->device, property->device);
+		indigo_copy_name(record->name, property->name);
+		record->mode = mode;
+		record->next = client->enable_blob_mode_records;
+		client->enable_blob_mode_records = record;
+		indigo_enable_blob(client, property, mode);
+		return top_level_handler;
+	}
+	return enable_blob_handler;
+}
+
 static void *one_text_handler(parser_state state, char *name, char *value, indigo_property *property, indigo_device *device, indigo_client *client, char *message) {
 	INDIGO_TRACE_PARSER(indigo_trace("JSON Parser: %s %s '%s' '%s'", __FUNCTION__, parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == END_ARRAY)
@@ -259,6 +468,8 @@ static void *top_level_handler(parser_state state, char *name, char *value, indi
 		if (name != NULL) {
 			if (!strcmp(name, "getProperties"))
 				return get_properties_handler;
+			if (!strcmp(name, "enableBLOB"))
+				return enable_blob_handler;
 			if (!strcmp(name, "newTextVector")) {
 				property->type = INDIGO_TEXT_VECTOR;
 				property->version = client->version;
@@ -282,7 +493,9 @@ static void *top_level_handler(parser_state state, char *name, char *value, indi
 void indigo_json_parse(indigo_device *device, indigo_client *client) {
 	indigo_adapter_context *context = (indigo_adapter_context*)client->client_context;
 	int handle = context->input;
-	char *buffer = indigo_safe_malloc(JSON_BUFFER_SIZE);
+	long buffer_size = JSON_BUFFER_SIZE;
+	char *buffer = indigo_safe_malloc(buffer_size);
+	ws_context ws = { context->web_socket_deflate };
 	char *value_buffer = indigo_safe_malloc(JSON_BUFFER_SIZE);
 	char *name_buffer = indigo_safe_malloc(INDIGO_NAME_SIZE);
 	indigo_property *property = indigo_safe_malloc(PROPERTY_SIZE);
@@ -299,14 +512,19 @@ void indigo_json_parse(indigo_device *device, indigo_client *client) {
 	parser_handler handler = top_level_handler;
 	parser_state state = IDLE;
 	while (true) {
-		assert(pointer - buffer <= JSON_BUFFER_SIZE);
+		assert(pointer - buffer <= buffer_size);
 		assert(name_pointer - name_buffer <= INDIGO_NAME_SIZE);
 		if (state == ERROR) {
 			indigo_error("JSON Parser: syntax error");
 			goto exit_loop;
 		}
 		while ((c = *pointer++) == 0) {
-			ssize_t count = (int)context->web_socket ? ws_read(handle, buffer, JSON_BUFFER_SIZE) : indigo_read_line(handle, buffer, JSON_BUFFER_SIZE);
+			ssize_t count = (int)context->web_socket ? ws_read(handle, client, &ws, &buffer, &buffer_size) : indigo_read_line(handle, buffer, JSON_BUFFER_SIZE);
+			if (count == WS_EMPTY_MESSAGE) {
+				pointer = buffer;
+				*buffer = 0;
+				continue;
+			}
 			if (count <= 0) {
 				goto exit_loop;
 			}
@@ -494,6 +712,9 @@ void indigo_json_parse(indigo_device *device, indigo_client *client) {
 		}
 	}
 exit_loop:
+	if (ws.inflater_initialized)
+		inflateEnd(&ws.inflater);
+	indigo_safe_free(ws.frame_buffer);
 	indigo_safe_free(buffer);
 	indigo_safe_free(value_buffer);
 	indigo_safe_free(name_buffer);
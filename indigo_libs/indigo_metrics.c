@@ -0,0 +1,494 @@
+// Copyright (c) 2016 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO performance metrics and event tracing
+ \file indigo_metrics.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <zlib.h>
+
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_metrics.h>
+
+#define METRICS_TABLE_SIZE		1024
+#define METRICS_BUCKET_BASE		10000		// ns
+#define METRICS_CACHE_TIME		1.0
+#define TRACING_DETAIL_SIZE		48
+
+bool indigo_use_metrics = true;
+
+static pthread_mutex_t metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+static indigo_metric *metrics = NULL;
+static indigo_metric *metrics_table[METRICS_TABLE_SIZE];
+
+static pthread_key_t written_key;
+static pthread_once_t written_once = PTHREAD_ONCE_INIT;
+
+static unsigned metric_hash(const char *name, const char *label_value) {
+	unsigned hash = 2166136261u;
+	for (const char *c = name; *c; c++)
+		hash = (hash ^ (unsigned char)*c) * 16777619u;
+	if (label_value) {
+		for (const char *c = label_value; *c; c++)
+			hash = (hash ^ (unsigned char)*c) * 16777619u;
+	}
+	return hash;
+}
+
+static bool metric_match(indigo_metric *metric, const char *name, const char *label_value) {
+	return !strcmp(metric->name, name) && !strcmp(metric->label_value, label_value ? label_value : "");
+}
+
+static indigo_metric *new_metric(indigo_metric_type type, const char *name, const char *help, const char *label_name, const char *label_value) {
+	indigo_metric *metric = indigo_safe_malloc(sizeof(indigo_metric));
+	metric->type = type;
+	metric->name = name;
+	metric->help = help;
+	metric->label_name = label_name;
+	if (label_value)
+		strncpy(metric->label_value, label_value, sizeof(metric->label_value) - 1);
+	return metric;
+}
+
+static void append_metric(indigo_metric *metric) {
+	indigo_metric **last = &metrics;
+	while (*last)
+		last = &(*last)->next;
+	*last = metric;
+}
+
+indigo_metric *indigo_get_metric(indigo_metric_type type, const char *name, const char *help, const char *label_name, const char *label_value) {
+	if (!indigo_use_metrics)
+		return NULL;
+	unsigned hash = metric_hash(name, label_value);
+	// lookup is lock free, metrics are never removed from the table
+	for (int i = 0; i < METRICS_TABLE_SIZE; i++) {
+		indigo_metric *metric = __atomic_load_n(metrics_table + (hash + i) % METRICS_TABLE_SIZE, __ATOMIC_ACQUIRE);
+		if (metric == NULL)
+			break;
+		if (metric_match(metric, name, label_value))
+			return metric;
+	}
+	indigo_metric *result = NULL;
+	pthread_mutex_lock(&metrics_mutex);
+	for (int i = 0; i < METRICS_TABLE_SIZE; i++) {
+		indigo_metric **slot = metrics_table + (hash + i) % METRICS_TABLE_SIZE;
+		if (*slot == NULL) {
+			result = new_metric(type, name, help, label_name, label_value);
+			append_metric(result);
+			__atomic_store_n(slot, result, __ATOMIC_RELEASE);
+			break;
+		}
+		if (metric_match(*slot, name, label_value)) {
+			result = *slot;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&metrics_mutex);
+	if (result == NULL)
+		INDIGO_ERROR(indigo_error("Can't register metric %s, registry is full", name));
+	return result;
+}
+
+indigo_metric *indigo_create_metric(indigo_metric_type type, const char *name, const char *help, const char *label_name, const char *label_value) {
+	if (!indigo_use_metrics)
+		return NULL;
+	indigo_metric *metric = new_metric(type, name, help, label_name, label_value);
+	pthread_mutex_lock(&metrics_mutex);
+	append_metric(metric);
+	pthread_mutex_unlock(&metrics_mutex);
+	return metric;
+}
+
+void indigo_release_metric(indigo_metric *metric) {
+	if (metric == NULL)
+		return;
+	pthread_mutex_lock(&metrics_mutex);
+	for (indigo_metric **previous = &metrics; *previous; previous = &(*previous)->next) {
+		if (*previous == metric) {
+			*previous = metric->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&metrics_mutex);
+	free(metric);
+}
+
+void indigo_metric_add(indigo_metric *metric, uint64_t value) {
+	if (metric)
+		__atomic_fetch_add(&metric->value, value, __ATOMIC_RELAXED);
+}
+
+void indigo_metric_observe(indigo_metric *metric, double seconds) {
+	if (metric == NULL)
+		return;
+	uint64_t ns = seconds > 0 ? (uint64_t)(seconds * 1e9) : 0;
+	uint64_t quotient = (ns + METRICS_BUCKET_BASE - 1) / METRICS_BUCKET_BASE;
+	int index = quotient <= 1 ? 0 : 64 - __builtin_clzll(quotient - 1);
+	if (index >= INDIGO_METRIC_BUCKETS)
+		index = INDIGO_METRIC_BUCKETS - 1;
+	__atomic_fetch_add(metric->buckets + index, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&metric->sum, ns, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&metric->value, 1, __ATOMIC_RELAXED);
+	uint64_t max = __atomic_load_n(&metric->max, __ATOMIC_RELAXED);
+	while (ns > max && !__atomic_compare_exchange_n(&metric->max, &max, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+double indigo_metric_time(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void create_written_key(void) {
+	pthread_key_create(&written_key, NULL);
+}
+
+void indigo_metric_written(long length) {
+	if (indigo_use_metrics && length > 0) {
+		pthread_once(&written_once, create_written_key);
+		indigo_metric_add(pthread_getspecific(written_key), length);
+	}
+}
+
+indigo_metric *indigo_metric_set_written(indigo_metric *metric) {
+	pthread_once(&written_once, create_written_key);
+	indigo_metric *previous = pthread_getspecific(written_key);
+	pthread_setspecific(written_key, metric);
+	return previous;
+}
+
+void indigo_enumerate_metrics(void (*callback)(indigo_metric *metric, void *data), void *data) {
+	pthread_mutex_lock(&metrics_mutex);
+	for (indigo_metric *metric = metrics; metric; metric = metric->next)
+		callback(metric, data);
+	pthread_mutex_unlock(&metrics_mutex);
+}
+
+typedef struct {
+	char *data;
+	long length;
+	long size;
+} text_buffer;
+
+static void append(text_buffer *buffer, const char *format, ...) {
+	while (true) {
+		va_list args;
+		va_start(args, format);
+		long length = vsnprintf(buffer->data + buffer->length, buffer->size - buffer->length, format, args);
+		va_end(args);
+		if (buffer->length + length < buffer->size) {
+			buffer->length += length;
+			return;
+		}
+		buffer->data = indigo_safe_realloc(buffer->data, buffer->size *= 2);
+	}
+}
+
+static void append_labels(text_buffer *buffer, indigo_metric *metric, const char *le) {
+	if (metric->label_name == NULL && le == NULL)
+		return;
+	append(buffer, "{");
+	if (metric->label_name) {
+		append(buffer, "%s=\"", metric->label_name);
+		for (char *c = metric->label_value; *c; c++) {
+			if (*c == '"' || *c == '\\')
+				append(buffer, "\\%c", *c);
+			else if (*c == '\n')
+				append(buffer, "\\n");
+			else
+				append(buffer, "%c", *c);
+		}
+		append(buffer, "\"%s", le ? "," : "");
+	}
+	if (le)
+		append(buffer, "le=\"%s\"", le);
+	append(buffer, "}");
+}
+
+char *indigo_metrics_text(long *length) {
+	text_buffer buffer = { indigo_safe_malloc(16 * 1024), 0, 16 * 1024 };
+	pthread_mutex_lock(&metrics_mutex);
+	for (indigo_metric *first = metrics; first; first = first->next) {
+		// HELP and TYPE lines are written once, all series of the metric are grouped together
+		bool done = false;
+		for (indigo_metric *metric = metrics; metric != first; metric = metric->next) {
+			if (!strcmp(metric->name, first->name)) {
+				done = true;
+				break;
+			}
+		}
+		if (done)
+			continue;
+		append(&buffer, "# HELP %s %s\n", first->name, first->help);
+		append(&buffer, "# TYPE %s %s\n", first->name, first->type == INDIGO_METRIC_COUNTER ? "counter" : "histogram");
+		for (indigo_metric *metric = first; metric; metric = metric->next) {
+			if (strcmp(metric->name, first->name))
+				continue;
+			uint64_t value = __atomic_load_n(&metric->value, __ATOMIC_RELAXED);
+			if (metric->type == INDIGO_METRIC_COUNTER) {
+				append(&buffer, "%s", metric->name);
+				append_labels(&buffer, metric, NULL);
+				append(&buffer, " %llu\n", (unsigned long long)value);
+			} else {
+				uint64_t cumulative = 0;
+				for (int i = 0; i < INDIGO_METRIC_BUCKETS; i++) {
+					char le[32];
+					if (i == INDIGO_METRIC_BUCKETS - 1)
+						strcpy(le, "+Inf");
+					else
+						snprintf(le, sizeof(le), "%g", METRICS_BUCKET_BASE * (double)(1ULL << i) / 1e9);
+					cumulative += __atomic_load_n(metric->buckets + i, __ATOMIC_RELAXED);
+					append(&buffer, "%s_bucket", metric->name);
+					append_labels(&buffer, metric, le);
+					append(&buffer, " %llu\n", (unsigned long long)cumulative);
+				}
+				append(&buffer, "%s_sum", metric->name);
+				append_labels(&buffer, metric, NULL);
+				append(&buffer, " %.9f\n", __atomic_load_n(&metric->sum, __ATOMIC_RELAXED) / 1e9);
+				append(&buffer, "%s_count", metric->name);
+				append_labels(&buffer, metric, NULL);
+				append(&buffer, " %llu\n", (unsigned long long)cumulative);
+			}
+		}
+	}
+	pthread_mutex_unlock(&metrics_mutex);
+	*length = buffer.length;
+	return buffer.data;
+}
+
+typedef struct {
+	int references;
+	unsigned length;
+	unsigned char data[];
+} resource_data;
+
+typedef struct {
+	pthread_mutex_t mutex;
+	resource_data *current;
+	double time;
+} resource_cache;
+
+static void release_resource_data(resource_data *data) {
+	if (data && __atomic_sub_fetch(&data->references, 1, __ATOMIC_ACQ_REL) == 0)
+		free(data);
+}
+
+void indigo_metrics_resource_release(unsigned char *data) {
+	release_resource_data((resource_data *)(data - offsetof(resource_data, data)));
+}
+
+static unsigned char *compressed_resource(resource_cache *cache, char *(*text_generator)(long *length), unsigned *length) {
+	// compressed text is cached for a second, every request holds a reference until it is sent, so it can be replaced meanwhile
+	pthread_mutex_lock(&cache->mutex);
+	double now = indigo_metric_time();
+	if (cache->current == NULL || now - cache->time > METRICS_CACHE_TIME) {
+		long text_length;
+		char *text = text_generator(&text_length);
+		z_stream stream = { 0 };
+		resource_data *data = NULL;
+		if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+			unsigned size = (unsigned)deflateBound(&stream, text_length);
+			data = indigo_safe_malloc(sizeof(resource_data) + size);
+			stream.next_in = (Bytef *)text;
+			stream.avail_in = (uInt)text_length;
+			stream.next_out = data->data;
+			stream.avail_out = size;
+			if (deflate(&stream, Z_FINISH) == Z_STREAM_END) {
+				data->references = 1;
+				data->length = (unsigned)stream.total_out;
+				release_resource_data(cache->current);
+				cache->current = data;
+				cache->time = now;
+			} else {
+				free(data);
+			}
+			deflateEnd(&stream);
+		}
+		free(text);
+	}
+	unsigned char *result = NULL;
+	if (cache->current) {
+		__atomic_add_fetch(&cache->current->references, 1, __ATOMIC_RELAXED);
+		result = cache->current->data;
+		*length = cache->current->length;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+	return result;
+}
+
+unsigned char *indigo_metrics_resource_generator(const char *path, unsigned *length) {
+	static resource_cache cache = { PTHREAD_MUTEX_INITIALIZER };
+	return compressed_resource(&cache, indigo_metrics_text, length);
+}
+
+// -------------------------------------------------------------------------------- event tracing
+
+typedef struct {
+	uint64_t sequence;
+	double time;
+	double duration;
+	const char *category;
+	const char *name;
+	const void *id;
+	int thread;
+	char phase;
+	char detail[TRACING_DETAIL_SIZE];
+} tracing_record;
+
+bool indigo_use_tracing = false;
+int indigo_tracing_buffer_size = 32768;
+
+static pthread_mutex_t tracing_mutex = PTHREAD_MUTEX_INITIALIZER;
+static tracing_record *tracing_ring = NULL;
+static uint64_t tracing_ring_size = 0;
+static uint64_t tracing_head = 0;
+static int tracing_thread_count = 0;
+static pthread_key_t tracing_thread_key;
+static pthread_once_t tracing_thread_once = PTHREAD_ONCE_INIT;
+
+static void create_tracing_thread_key(void) {
+	pthread_key_create(&tracing_thread_key, NULL);
+}
+
+void indigo_enable_tracing(bool enable) {
+	pthread_mutex_lock(&tracing_mutex);
+	if (enable && tracing_ring == NULL) {
+		tracing_ring_size = indigo_tracing_buffer_size > 1024 ? indigo_tracing_buffer_size : 1024;
+		__atomic_store_n(&tracing_ring, indigo_safe_malloc(tracing_ring_size * sizeof(tracing_record)), __ATOMIC_RELEASE);
+	}
+	indigo_use_tracing = enable;
+	pthread_mutex_unlock(&tracing_mutex);
+	INDIGO_DEBUG(indigo_debug("Event tracing %s", enable ? "enabled" : "disabled"));
+}
+
+void indigo_tracing_event(char phase, const char *category, const char *name, const char *detail, const void *id, double time, double duration) {
+	tracing_record *ring = __atomic_load_n(&tracing_ring, __ATOMIC_ACQUIRE);
+	if (ring == NULL)
+		return;
+	pthread_once(&tracing_thread_once, create_tracing_thread_key);
+	int thread = (int)(intptr_t)pthread_getspecific(tracing_thread_key);
+	if (thread == 0) {
+		thread = __atomic_add_fetch(&tracing_thread_count, 1, __ATOMIC_RELAXED);
+		pthread_setspecific(tracing_thread_key, (void *)(intptr_t)thread);
+	}
+	// slot is claimed with single atomic increment, sequence number marks record as complete for reader
+	uint64_t index = __atomic_fetch_add(&tracing_head, 1, __ATOMIC_RELAXED);
+	tracing_record *record = ring + index % tracing_ring_size;
+	__atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	record->time = time;
+	record->duration = duration;
+	record->category = category;
+	record->name = name;
+	record->id = id;
+	record->thread = thread;
+	record->phase = phase;
+	if (detail)
+		strncpy(record->detail, detail, TRACING_DETAIL_SIZE - 1);
+	else
+		record->detail[0] = 0;
+	record->detail[TRACING_DETAIL_SIZE - 1] = 0;
+	__atomic_store_n(&record->sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+static void append_json_string(text_buffer *buffer, const char *string) {
+	append(buffer, "\"");
+	for (const char *c = string; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			append(buffer, "\\%c", *c);
+		else if ((unsigned char)*c < 0x20)
+			append(buffer, "\\u%04x", *c);
+		else
+			append(buffer, "%c", *c);
+	}
+	append(buffer, "\"");
+}
+
+char *indigo_tracing_json(long *length) {
+	text_buffer buffer = { indigo_safe_malloc(64 * 1024), 0, 64 * 1024 };
+	int pid = getpid();
+	append(&buffer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	tracing_record *ring = __atomic_load_n(&tracing_ring, __ATOMIC_ACQUIRE);
+	if (ring) {
+		bool first = true;
+		uint64_t head = __atomic_load_n(&tracing_head, __ATOMIC_ACQUIRE);
+		uint64_t index = head > tracing_ring_size ? head - tracing_ring_size : 0;
+		for (; index < head; index++) {
+			tracing_record *source = ring + index % tracing_ring_size, record;
+			if (__atomic_load_n(&source->sequence, __ATOMIC_ACQUIRE) != index + 1)
+				continue;
+			memcpy(&record, source, sizeof(record));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			// skip records overwritten while being copied
+			if (__atomic_load_n(&source->sequence, __ATOMIC_RELAXED) != index + 1)
+				continue;
+			record.detail[TRACING_DETAIL_SIZE - 1] = 0;
+			append(&buffer, "%s\n{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", first ? "" : ",", record.phase, record.category, record.name, pid, record.thread, record.time * 1e6);
+			if (record.phase == 'X')
+				append(&buffer, ",\"dur\":%.3f", record.duration * 1e6);
+			else if (record.phase == 'b' || record.phase == 'e')
+				append(&buffer, ",\"id\":\"%p\"", record.id);
+			else if (record.phase == 'i')
+				append(&buffer, ",\"s\":\"t\"");
+			if (*record.detail) {
+				append(&buffer, ",\"args\":{\"detail\":");
+				append_json_string(&buffer, record.detail);
+				append(&buffer, "}");
+			}
+			append(&buffer, "}");
+			first = false;
+		}
+	}
+	append(&buffer, "\n]}\n");
+	*length = buffer.length;
+	return buffer.data;
+}
+
+bool indigo_tracing_save(const char *path) {
+	long length;
+	char *text = indigo_tracing_json(&length);
+	FILE *file = fopen(path, "w");
+	bool result = false;
+	if (file) {
+		result = fwrite(text, 1, length, file) == length;
+		result = fclose(file) == 0 && result;
+	}
+	if (!result)
+		INDIGO_ERROR(indigo_error("Can't save trace to %s (%s)", path, strerror(errno)));
+	free(text);
+	return result;
+}
+
+unsigned char *indigo_tracing_resource_generator(const char *path, unsigned *length) {
+	static resource_cache cache = { PTHREAD_MUTEX_INITIALIZER };
+	return compressed_resource(&cache, indigo_tracing_json, length);
+}
@@ -50,6 +50,7 @@ indigo_result indigo_mount_attach(indigo_device *device, const char* driver_name
 	assert(device != NULL);
 	if (MOUNT_CONTEXT == NULL) {
 		device->device_context = indigo_safe_malloc(sizeof(indigo_mount_context));
+		pthread_mutex_init(&MOUNT_CONTEXT->alignment_model_mutex, NULL);
 	}
 	if (MOUNT_CONTEXT != NULL) {
 		if (indigo_device_attach(device, driver_name, version, INDIGO_INTERFACE_MOUNT) == INDIGO_OK) {
@@ -260,6 +261,9 @@ indigo_result indigo_mount_attach(indigo_device *device, const char* driver_name
 }
 
 void indigo_mount_load_alignment_points(indigo_device *device) {
+	pthread_mutex_lock(&MOUNT_CONTEXT->alignment_model_mutex);
+	MOUNT_CONTEXT->alignment_model.valid = false;
+	pthread_mutex_unlock(&MOUNT_CONTEXT->alignment_model_mutex);
 	int handle = indigo_open_config_file(device->name, 0, O_RDONLY, ".alignment");
 	if (handle > 0) {
 		int count;
@@ -290,6 +294,9 @@ void indigo_mount_load_alignment_points(indigo_device *device) {
 }
 
 void indigo_mount_save_alignment_points(indigo_device *device) {
+	pthread_mutex_lock(&MOUNT_CONTEXT->alignment_model_mutex);
+	MOUNT_CONTEXT->alignment_model.valid = false;
+	pthread_mutex_unlock(&MOUNT_CONTEXT->alignment_model_mutex);
 	int handle = indigo_open_config_file(device->name, 0, O_WRONLY | O_CREAT | O_TRUNC, ".alignment");
 	if (handle > 0) {
 		int count = MOUNT_CONTEXT->alignment_point_count;
@@ -849,6 +856,7 @@ indigo_result indigo_mount_detach(indigo_device *device) {
 	indigo_release_property(MOUNT_SNOOP_DEVICES_PROPERTY);
 	indigo_release_property(MOUNT_PEC_PROPERTY);
 	indigo_release_property(MOUNT_PEC_TRAINING_PROPERTY);
+	pthread_mutex_destroy(&MOUNT_CONTEXT->alignment_model_mutex);
 	return indigo_device_detach(device);
 }
 
@@ -1022,13 +1030,226 @@ static indigo_alignment_point* indigo_nearest_alignment_point(indigo_device* dev
 	return nearest_point;
 }
 
+//  Multi point model: raw - observed HA/DEC offsets are fitted by least squares to terms
+//  IH (HA index), ID (DEC index), CH (collimation), NP (HA/DEC non-perpendicularity), MA and ME (polar axis azimuth and elevation error)
+//  and TF (tube flexure). ID, CH and NP change sign with side of pier. What the terms don't explain is interpolated from
+//  residuals of nearby points found in a k-d tree, so the model still passes through the alignment points.
+
+#define MODEL_LOCAL_RADIUS	30.0
+#define MODEL_MAX_DEC				89.5
+
+static void indigo_alignment_model_row(indigo_alignment_model *model, double ha, double dec, int side_of_pier, double *ha_row, double *dec_row) {
+	double s = side_of_pier == MOUNT_SIDE_EAST ? -1 : 1;
+	double sin_h = sin(ha * DEG2RAD), cos_h = cos(ha * DEG2RAD);
+	dec = fmax(-MODEL_MAX_DEC, fmin(MODEL_MAX_DEC, dec));
+	double sin_d = sin(dec * DEG2RAD), cos_d = cos(dec * DEG2RAD), tan_d = sin_d / cos_d;
+	double sin_f = sin(model->latitude * DEG2RAD), cos_f = cos(model->latitude * DEG2RAD);
+	double ha_terms[MOUNT_ALIGNMENT_MODEL_TERMS] = { 1, 0, s / cos_d, s * tan_d, -cos_h * tan_d, sin_h * tan_d, cos_f * sin_h / cos_d };
+	double dec_terms[MOUNT_ALIGNMENT_MODEL_TERMS] = { 0, s, 0, 0, sin_h, cos_h, cos_f * cos_h * sin_d - sin_f * cos_d };
+	memcpy(ha_row, ha_terms, sizeof(ha_terms));
+	memcpy(dec_row, dec_terms, sizeof(dec_terms));
+}
+
+static void indigo_alignment_model_terms(indigo_alignment_model *model, double ha, double dec, int side_of_pier, double *dha, double *ddec) {
+	double ha_row[MOUNT_ALIGNMENT_MODEL_TERMS], dec_row[MOUNT_ALIGNMENT_MODEL_TERMS];
+	indigo_alignment_model_row(model, ha, dec, side_of_pier, ha_row, dec_row);
+	*dha = *ddec = 0;
+	for (int i = 0; i < model->term_count; i++) {
+		*dha += ha_row[i] * model->terms[i];
+		*ddec += dec_row[i] * model->terms[i];
+	}
+}
+
+static void indigo_alignment_model_vector(double ha, double dec, double *v) {
+	v[0] = cos(dec * DEG2RAD) * cos(ha * DEG2RAD);
+	v[1] = cos(dec * DEG2RAD) * sin(ha * DEG2RAD);
+	v[2] = sin(dec * DEG2RAD);
+}
+
+static int indigo_alignment_model_build_tree(indigo_alignment_model *model, int *indices, int count) {
+	if (count == 0)
+		return -1;
+	//  Split on the axis with the largest spread
+	double min[3] = { 2, 2, 2 }, max[3] = { -2, -2, -2 };
+	for (int i = 0; i < count; i++) {
+		for (int j = 0; j < 3; j++) {
+			min[j] = fmin(min[j], model->nodes[indices[i]].v[j]);
+			max[j] = fmax(max[j], model->nodes[indices[i]].v[j]);
+		}
+	}
+	int axis = 0;
+	for (int j = 1; j < 3; j++) {
+		if (max[j] - min[j] > max[axis] - min[axis])
+			axis = j;
+	}
+	//  Insertion sort is fine for at most MOUNT_MAX_ALIGNMENT_POINTS
+	for (int i = 1; i < count; i++) {
+		int index = indices[i], j = i - 1;
+		while (j >= 0 && model->nodes[indices[j]].v[axis] > model->nodes[index].v[axis]) {
+			indices[j + 1] = indices[j];
+			j--;
+		}
+		indices[j + 1] = index;
+	}
+	int median = count / 2;
+	indigo_alignment_node *node = model->nodes + indices[median];
+	node->axis = axis;
+	node->left = indigo_alignment_model_build_tree(model, indices, median);
+	node->right = indigo_alignment_model_build_tree(model, indices + median + 1, count - median - 1);
+	return indices[median];
+}
+
+static void indigo_alignment_model_local(indigo_alignment_model *model, int index, const double *v, int side_of_pier, double chord, double *sum_w, double *sum_ha, double *sum_dec) {
+	if (index < 0)
+		return;
+	indigo_alignment_node *node = model->nodes + index;
+	double delta = v[node->axis] - node->v[node->axis];
+	if (node->side_of_pier == side_of_pier) {
+		double dx = v[0] - node->v[0], dy = v[1] - node->v[1], dz = v[2] - node->v[2];
+		double d = sqrt(dx * dx + dy * dy + dz * dz);
+		if (d < chord) {
+			//  Franke-Little weights, exact at the point and zero at the radius
+			double w = (chord - d) / (chord * fmax(d, 1e-9));
+			w *= w;
+			*sum_w += w;
+			*sum_ha += w * node->dha;
+			*sum_dec += w * node->ddec;
+		}
+	}
+	indigo_alignment_model_local(model, delta < 0 ? node->left : node->right, v, side_of_pier, chord, sum_w, sum_ha, sum_dec);
+	if (fabs(delta) < chord)
+		indigo_alignment_model_local(model, delta < 0 ? node->right : node->left, v, side_of_pier, chord, sum_w, sum_ha, sum_dec);
+}
+
+static void indigo_alignment_model_fit(indigo_device *device, indigo_alignment_model *model) {
+	memset(model, 0, sizeof(indigo_alignment_model));
+	model->latitude = MOUNT_GEOGRAPHIC_COORDINATES_LATITUDE_ITEM->number.value;
+	model->root = -1;
+	int count = 0;
+	for (int i = 0; i < MOUNT_CONTEXT->alignment_point_count; i++) {
+		if (MOUNT_CONTEXT->alignment_points[i].used)
+			count++;
+	}
+	model->term_count = count >= 4 ? 7 : (count >= 2 ? 4 : (count == 1 ? 2 : 0));
+	//  Terms are ordered so that the first 2 or 4 of them make sense for 1 or 2 - 3 points
+	static const int order[MOUNT_ALIGNMENT_MODEL_TERMS] = { 0, 1, 4, 5, 2, 3, 6 };
+	double ata[MOUNT_ALIGNMENT_MODEL_TERMS][MOUNT_ALIGNMENT_MODEL_TERMS + 1] = { 0 };
+	int n = model->term_count;
+	for (int i = 0; i < MOUNT_CONTEXT->alignment_point_count; i++) {
+		indigo_alignment_point *point = MOUNT_CONTEXT->alignment_points + i;
+		if (!point->used)
+			continue;
+		double ha = 15 * indigo_range24(point->lst - point->ra);
+		double dha = 15 * (point->ra - point->raw_ra), ddec = point->raw_dec - point->dec;
+		dha = fmod(dha + 540, 360) - 180;
+		double ha_row[MOUNT_ALIGNMENT_MODEL_TERMS], dec_row[MOUNT_ALIGNMENT_MODEL_TERMS];
+		indigo_alignment_model_row(model, ha, point->dec, point->side_of_pier, ha_row, dec_row);
+		//  HA equations are weighted by cos(dec) to minimize errors on the sky
+		double w = cos(fmin(MODEL_MAX_DEC, fabs(point->dec)) * DEG2RAD);
+		for (int j = 0; j < n; j++) {
+			for (int k = 0; k < n; k++)
+				ata[j][k] += w * w * ha_row[order[j]] * ha_row[order[k]] + dec_row[order[j]] * dec_row[order[k]];
+			ata[j][n] += w * w * ha_row[order[j]] * dha + dec_row[order[j]] * ddec;
+		}
+	}
+	//  Solve normal equations with a small damping for degenerate point sets
+	double damping = 0;
+	for (int j = 0; j < n; j++)
+		damping = fmax(damping, ata[j][j]);
+	damping *= 1e-6;
+	for (int j = 0; j < n; j++)
+		ata[j][j] += damping;
+	for (int j = 0; j < n; j++) {
+		int pivot = j;
+		for (int k = j + 1; k < n; k++) {
+			if (fabs(ata[k][j]) > fabs(ata[pivot][j]))
+				pivot = k;
+		}
+		for (int k = 0; k <= n; k++) {
+			double tmp = ata[j][k];
+			ata[j][k] = ata[pivot][k];
+			ata[pivot][k] = tmp;
+		}
+		if (ata[j][j] == 0)
+			continue;
+		for (int k = 0; k < n; k++) {
+			if (k == j)
+				continue;
+			double f = ata[k][j] / ata[j][j];
+			for (int l = j; l <= n; l++)
+				ata[k][l] -= f * ata[j][l];
+		}
+	}
+	for (int j = 0; j < n; j++)
+		model->terms[order[j]] = ata[j][j] ? ata[j][n] / ata[j][j] : 0;
+	model->term_count = n ? MOUNT_ALIGNMENT_MODEL_TERMS : 0;
+	//  Store residuals and build k-d tree
+	int indices[MOUNT_MAX_ALIGNMENT_POINTS];
+	double sum = 0;
+	for (int i = 0; i < MOUNT_CONTEXT->alignment_point_count; i++) {
+		indigo_alignment_point *point = MOUNT_CONTEXT->alignment_points + i;
+		if (!point->used)
+			continue;
+		indigo_alignment_node *node = model->nodes + model->node_count;
+		double ha = 15 * indigo_range24(point->lst - point->ra), dha, ddec;
+		indigo_alignment_model_terms(model, ha, point->dec, point->side_of_pier, &dha, &ddec);
+		node->dha = fmod(15 * (point->ra - point->raw_ra) + 540, 360) - 180 - dha;
+		node->ddec = point->raw_dec - point->dec - ddec;
+		node->side_of_pier = point->side_of_pier;
+		indigo_alignment_model_vector(ha, point->dec, node->v);
+		sum += node->dha * node->dha * cos(point->dec * DEG2RAD) * cos(point->dec * DEG2RAD) + node->ddec * node->ddec;
+		indices[model->node_count] = model->node_count;
+		model->node_count++;
+	}
+	model->root = indigo_alignment_model_build_tree(model, indices, model->node_count);
+	model->rms = model->node_count ? sqrt(sum / model->node_count) * 3600 : 0;
+	model->valid = true;
+	INDIGO_DEBUG(indigo_debug("%s: alignment model from %d points, IH = %.1f\" ID = %.1f\" CH = %.1f\" NP = %.1f\" MA = %.1f\" ME = %.1f\" TF = %.1f\", RMS = %.1f\"", device->name, model->node_count, model->terms[0] * 3600, model->terms[1] * 3600, model->terms[2] * 3600, model->terms[3] * 3600, model->terms[4] * 3600, model->terms[5] * 3600, model->terms[6] * 3600, model->rms));
+}
+
+//  Returns raw - observed offsets in degrees for observed HA (in degrees) and DEC
+static void indigo_alignment_model_offsets(indigo_device *device, double ha, double dec, int side_of_pier, double *dha, double *ddec) {
+	indigo_alignment_model *model = &MOUNT_CONTEXT->alignment_model;
+	pthread_mutex_lock(&MOUNT_CONTEXT->alignment_model_mutex);
+	if (!model->valid || model->latitude != MOUNT_GEOGRAPHIC_COORDINATES_LATITUDE_ITEM->number.value) {
+		//  Fit aside and publish complete model, so it is never evaluated half built
+		indigo_alignment_model fitted;
+		indigo_alignment_model_fit(device, &fitted);
+		*model = fitted;
+	}
+	indigo_alignment_model_terms(model, ha, dec, side_of_pier, dha, ddec);
+	double v[3], sum_w = 0, sum_ha = 0, sum_dec = 0;
+	indigo_alignment_model_vector(ha, dec, v);
+	double chord = 2 * sin(MODEL_LOCAL_RADIUS * DEG2RAD / 2);
+	indigo_alignment_model_local(model, model->root, v, side_of_pier, chord, &sum_w, &sum_ha, &sum_dec);
+	if (sum_w > 0) {
+		//  Constant weight of zero residual fades the correction out towards the radius
+		double w0 = 1 / (chord * chord);
+		*dha += sum_ha / (sum_w + w0);
+		*ddec += sum_dec / (sum_w + w0);
+	}
+	pthread_mutex_unlock(&MOUNT_CONTEXT->alignment_model_mutex);
+}
+
+static void indigo_normalize_coordinates(double *ra, double *dec) {
+	if (*dec > 90.0) {
+		*dec = 180.0 - *dec;
+		*ra += 12.0;
+	}
+	if (*dec < -90.0) {
+		*dec = -180.0 - *dec;
+		*ra += 12.0;
+	}
+	*ra = indigo_range24(*ra);
+}
+
 //  Called to transform an observed position into a position for mount
 indigo_result indigo_translated_to_raw(indigo_device *device, double ra, double dec, double *raw_ra, double *raw_dec) {
 	if (MOUNT_ALIGNMENT_MODE_CONTROLLER_ITEM->sw.value) {
 		*raw_ra = ra;
 		*raw_dec = dec;
 		return INDIGO_OK;
-	} else if (MOUNT_ALIGNMENT_MODE_NEAREST_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_SINGLE_POINT_ITEM->sw.value) {
+	} else if (MOUNT_ALIGNMENT_MODE_NEAREST_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_SINGLE_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
 		time_t utc = indigo_get_mount_utc(device);
 		double lst = indigo_lst(&utc, MOUNT_GEOGRAPHIC_COORDINATES_LONGITUDE_ITEM->number.value);
 		double ha = indigo_range24(lst - ra);
@@ -1036,11 +1257,6 @@ indigo_result indigo_translated_to_raw(indigo_device *device, double ra, double
 			ha -= 24.0;
 		int side_of_pier = (ha >= 0.0) ? MOUNT_SIDE_WEST : MOUNT_SIDE_EAST;
 		return indigo_translated_to_raw_with_lst(device, lst, ra, dec, side_of_pier, raw_ra, raw_dec);
-	} else if (MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
-
-		// TBD Rumen
-
-		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
 }
@@ -1096,9 +1312,11 @@ indigo_result indigo_translated_to_raw_with_lst(indigo_device *device, double ls
 		}
 		return INDIGO_OK;
 	} else if (MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
-
-		// TBD Rumen
-
+		double dha, ddec;
+		indigo_alignment_model_offsets(device, 15 * indigo_range24(lst - ra), dec, side_of_pier, &dha, &ddec);
+		*raw_ra = ra - dha / 15;
+		*raw_dec = dec + ddec;
+		indigo_normalize_coordinates(raw_ra, raw_dec);
 		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
@@ -1110,7 +1328,7 @@ indigo_result indigo_raw_to_translated(indigo_device *device, double raw_ra, dou
 		*ra = raw_ra;
 		*dec = raw_dec;
 		return INDIGO_OK;
-	} else if (MOUNT_ALIGNMENT_MODE_NEAREST_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_SINGLE_POINT_ITEM->sw.value) {
+	} else if (MOUNT_ALIGNMENT_MODE_NEAREST_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_SINGLE_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
 		time_t utc = indigo_get_mount_utc(device);
 		double lst = indigo_lst(&utc, MOUNT_GEOGRAPHIC_COORDINATES_LONGITUDE_ITEM->number.value);
 		double ha = indigo_range24(lst - raw_ra);
@@ -1118,11 +1336,6 @@ indigo_result indigo_raw_to_translated(indigo_device *device, double raw_ra, dou
 			ha -= 24.0;
 		int side_of_pier = (ha >= 0.0) ? MOUNT_SIDE_WEST : MOUNT_SIDE_EAST;
 		return indigo_raw_to_translated_with_lst(device, lst, raw_ra, raw_dec, side_of_pier, ra, dec);
-	} else if (MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
-
-		// TBD Rumen
-
-		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
 }
@@ -1178,9 +1391,14 @@ indigo_result indigo_raw_to_translated_with_lst(indigo_device *device, double ls
 		}
 		return INDIGO_OK;
 	} else if (MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
-
-		// TBD Rumen
-
+		//  Model is defined for observed coordinates, invert it by fixed point iteration
+		double dha = 0, ddec = 0;
+		for (int i = 0; i < 3; i++) {
+			indigo_alignment_model_offsets(device, 15 * indigo_range24(lst - raw_ra - dha / 15), raw_dec - ddec, side_of_pier, &dha, &ddec);
+		}
+		*ra = raw_ra + dha / 15;
+		*dec = raw_dec - ddec;
+		indigo_normalize_coordinates(ra, dec);
 		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
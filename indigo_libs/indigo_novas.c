@@ -27,9 +27,13 @@
 #include <novas.h>
 #include <eph_manager.h>
 
+#include <string.h>
+#include <pthread.h>
+
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_novas.h>
 
+
 #define UT2JD(t) ((t) / 86400.0 + 2440587.5 + DELTA_UTC_UT1)
 double DELTA_T = 34+32.184+0.477677;
 double DELTA_UTC_UT1 = -0.477677/86400.0;
@@ -44,57 +48,245 @@ static void init() {
 	}
 }
 
-double indigo_lst(time_t *utc, double longitude) {
-	double ut1;
-	if (utc)
-		ut1 = UT2JD(*utc);
-	else
-		ut1 = UT2JD(time(NULL));
+// Frames below are cached per second of UTC, so that repeated calls for the same time (e.g. mount drivers updating
+// coordinates at high rate or catalog processing) don't repeat sidereal time, precession, nutation and ephemeris evaluation.
+
+static pthread_mutex_t frame_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+	bool valid;
+	time_t utc;
+	double lst;
+} sidereal_frame;
+
+static struct {
+	bool valid;
+	time_t utc;
+	double latitude, longitude;
+	double uz[3], un[3], uw[3];
+} horizon_frame;
 
+typedef struct {
+	bool valid;
+	time_t utc;
+	int error;
+	double jd_tdb;
+	double peb[3], veb[3], psb[3];
+	double matrix[3][3];
+} place_frame_t;
+
+static place_frame_t place_frame;
+
+static struct {
+	bool valid;
+	time_t utc;
+	double latitude, longitude, elevation;
+	double pog[3], vog[3];
+} observer_frame;
+
+static time_t utc_or_now(time_t *utc) {
+	return utc ? *utc : time(NULL);
+}
+
+double indigo_lst(time_t *utc, double longitude) {
+	time_t t = utc_or_now(utc);
 	double gst;
-	int error = sidereal_time(ut1, 0.0, DELTA_T, 0, 0, 0, &gst);
-	if (error != 0) {
-		indigo_error("sidereal_time() -> %d", error);
-		return 0;
+	pthread_mutex_lock(&frame_mutex);
+	if (!sidereal_frame.valid || sidereal_frame.utc != t) {
+		int error = sidereal_time(UT2JD(t), 0.0, DELTA_T, 0, 0, 0, &gst);
+		if (error != 0) {
+			pthread_mutex_unlock(&frame_mutex);
+			indigo_error("sidereal_time() -> %d", error);
+			return 0;
+		}
+		sidereal_frame.lst = gst;
+		sidereal_frame.utc = t;
+		sidereal_frame.valid = true;
 	}
+	gst = sidereal_frame.lst;
+	pthread_mutex_unlock(&frame_mutex);
 	return fmod(gst + longitude/15.0 + 24.0, 24.0);
 }
 
 void indigo_eq2hor(time_t *utc, double latitude, double longitude, double elevation, double ra, double dec, double *alt, double *az) {
-	double ut1;
-	if (utc)
-		ut1 = UT2JD(*utc);
-	else
-		ut1 = UT2JD(time(NULL));
+	indigo_eq2hor_batch(utc, latitude, longitude, elevation, 1, &ra, &dec, alt, az);
+}
 
-	on_surface position = { latitude, longitude, elevation, 0.0, 0.0 };
-	equ2hor(ut1, DELTA_T, 1, 0.0, 0.0, &position, ra, dec, 0, alt, az, &ra, &dec);
-	*alt = 90 - *alt;
+void indigo_eq2hor_batch(time_t *utc, double latitude, double longitude, double elevation, int count, const double *ra, const double *dec, double *alt, double *az) {
+	time_t t = utc_or_now(utc);
+	double uz[3], un[3], uw[3];
+	pthread_mutex_lock(&frame_mutex);
+	if (!horizon_frame.valid || horizon_frame.utc != t || horizon_frame.latitude != latitude || horizon_frame.longitude != longitude) {
+		// rotate local zenith, north and west to celestial system wrt equator and equinox of date in the same way as equ2hor() does
+		double sinlat = sin(latitude * DEG2RAD), coslat = cos(latitude * DEG2RAD), sinlon = sin(longitude * DEG2RAD), coslon = cos(longitude * DEG2RAD);
+		double uze[3] = { coslat * coslon, coslat * sinlon, sinlat };
+		double une[3] = { -sinlat * coslon, -sinlat * sinlon, coslat };
+		double uwe[3] = { sinlon, -coslon, 0.0 };
+		double ut1 = UT2JD(t);
+		ter2cel(ut1, 0.0, DELTA_T, 1, 1, 1, 0.0, 0.0, uze, horizon_frame.uz);
+		ter2cel(ut1, 0.0, DELTA_T, 1, 1, 1, 0.0, 0.0, une, horizon_frame.un);
+		ter2cel(ut1, 0.0, DELTA_T, 1, 1, 1, 0.0, 0.0, uwe, horizon_frame.uw);
+		horizon_frame.utc = t;
+		horizon_frame.latitude = latitude;
+		horizon_frame.longitude = longitude;
+		horizon_frame.valid = true;
+	}
+	memcpy(uz, horizon_frame.uz, sizeof(uz));
+	memcpy(un, horizon_frame.un, sizeof(un));
+	memcpy(uw, horizon_frame.uw, sizeof(uw));
+	pthread_mutex_unlock(&frame_mutex);
+	for (int i = 0; i < count; i++) {
+		double cosdc = cos(dec[i] * DEG2RAD);
+		double p[3] = { cosdc * cos(ra[i] * 15.0 * DEG2RAD), cosdc * sin(ra[i] * 15.0 * DEG2RAD), sin(dec[i] * DEG2RAD) };
+		double pz = p[0] * uz[0] + p[1] * uz[1] + p[2] * uz[2];
+		double pn = p[0] * un[0] + p[1] * un[1] + p[2] * un[2];
+		double pw = p[0] * uw[0] + p[1] * uw[1] + p[2] * uw[2];
+		double proj = sqrt(pn * pn + pw * pw);
+		double a = proj > 0.0 ? -atan2(pw, pn) * RAD2DEG : 0.0;
+		if (a < 0.0)
+			a += 360.0;
+		if (a >= 360.0)
+			a -= 360.0;
+		az[i] = a;
+		alt[i] = 90 - atan2(proj, pz) * RAD2DEG;
+	}
 }
 
-void indigo_app_star(double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
-	double ut1_now = time(NULL) / 86400.0 + 2440587.5 + DELTA_UTC_UT1;
-	double tt_now = ut1_now + DELTA_T / 86400.0;
-	cat_entry star;
-	init();
-	make_cat_entry("HIP 1", "HP2", 1, *ra, *dec, promora, promodec, parallax, rv, &star);
-	int error = app_star(tt_now, &star, 1, ra, dec);
-	if (error != 0) {
-		indigo_error("app_star() -> %d", error);
+static bool get_place_frame(time_t t, place_frame_t *frame) {
+	pthread_mutex_lock(&frame_mutex);
+	if (!place_frame.valid || place_frame.utc != t) {
+		static object earth, sun;
+		static bool objects_ready = false;
+		if (!objects_ready) {
+			cat_entry null_star;
+			make_cat_entry("NULL_STAR", "   ", 0L, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, &null_star);
+			make_object(0, 3, "Earth", &null_star, &earth);
+			make_object(0, 10, "Sun", &null_star, &sun);
+			objects_ready = true;
+		}
+		init();
+		double jd_tt = UT2JD(t) + DELTA_T / 86400.0, x, secdif;
+		tdb2tt(jd_tt, &x, &secdif);
+		double jd[2] = { jd_tt + secdif / 86400.0, 0.0 };
+		place_frame.jd_tdb = jd[0];
+		place_frame.error = ephemeris(jd, &earth, 0, 1, place_frame.peb, place_frame.veb);
+		if (place_frame.error == 0) {
+			double vsb[3];
+			place_frame.error = ephemeris(jd, &sun, 0, 1, place_frame.psb, vsb);
+		}
+		// frame tie, precession and nutation are linear, so columns of the matrix are images of base vectors
+		for (int i = 0; i < 3; i++) {
+			double e[3] = { i == 0, i == 1, i == 2 }, p1[3], p2[3], p3[3];
+			frame_tie(e, 1, p1);
+			precession(T0, p1, place_frame.jd_tdb, p2);
+			nutation(place_frame.jd_tdb, 0, 1, p2, p3);
+			for (int j = 0; j < 3; j++)
+				place_frame.matrix[j][i] = p3[j];
+		}
+		place_frame.utc = t;
+		place_frame.valid = true;
 	}
+	*frame = place_frame;
+	pthread_mutex_unlock(&frame_mutex);
+	if (frame->error) {
+		indigo_error("ephemeris() -> %d", frame->error);
+		return false;
+	}
+	return true;
 }
 
-void indigo_topo_star(double latitude, double longitude, double elevation, double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
-	double ut1_now = time(NULL) / 86400.0 + 2440587.5 + DELTA_UTC_UT1;
-	double tt_now = ut1_now + DELTA_T / 86400.0;
-	cat_entry star;
-	init();
-	make_cat_entry("HIP1", "HP2", 1, *ra, *dec, promora, promodec, parallax, rv, &star);
-	on_surface position = { latitude, longitude, elevation, 0.0, 0.0 };
-	int error = topo_star(tt_now, DELTA_T, &star, &position, 1, ra, dec);
-	if (error != 0) {
-		indigo_error("topo_star() -> %d", error);
+static void get_observer_frame(time_t t, double latitude, double longitude, double elevation, double jd_tt, double *pog, double *vog) {
+	pthread_mutex_lock(&frame_mutex);
+	if (!observer_frame.valid || observer_frame.utc != t || observer_frame.latitude != latitude || observer_frame.longitude != longitude || observer_frame.elevation != elevation) {
+		observer location;
+		make_observer_on_surface(latitude, longitude, elevation, 0.0, 0.0, &location);
+		geo_posvel(jd_tt, DELTA_T, 1, &location, observer_frame.pog, observer_frame.vog);
+		observer_frame.utc = t;
+		observer_frame.latitude = latitude;
+		observer_frame.longitude = longitude;
+		observer_frame.elevation = elevation;
+		observer_frame.valid = true;
 	}
+	memcpy(pog, observer_frame.pog, 3 * sizeof(double));
+	memcpy(vog, observer_frame.vog, 3 * sizeof(double));
+	pthread_mutex_unlock(&frame_mutex);
+}
+
+#define PLACE_CHUNK	256
+
+// the same steps as place() does for a star with reduced accuracy and output wrt true equator and equinox of date, just frame
+// dependent values are computed once per batch and light deflection uses position of the Sun at observation time
+static void place_batch(time_t *utc, bool topocentric, double latitude, double longitude, double elevation, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec) {
+	time_t t = utc_or_now(utc);
+	place_frame_t frame;
+	if (!get_place_frame(t, &frame)) {
+		for (int i = 0; i < count; i++)
+			ra[i] = dec[i] = NAN;
+		return;
+	}
+	double pog[3] = { 0 }, vog[3] = { 0 }, pob[3], vob[3];
+	if (topocentric)
+		get_observer_frame(t, latitude, longitude, elevation, UT2JD(t) + DELTA_T / 86400.0, pog, vog);
+	for (int j = 0; j < 3; j++) {
+		pob[j] = frame.peb[j] + pog[j];
+		vob[j] = frame.veb[j] + vog[j];
+	}
+	double x[PLACE_CHUNK], y[PLACE_CHUNK], z[PLACE_CHUNK];
+	for (int base = 0; base < count; base += PLACE_CHUNK) {
+		int n = count - base < PLACE_CHUNK ? count - base : PLACE_CHUNK;
+		for (int i = 0; i < n; i++) {
+			int k = base + i;
+			cat_entry star = { .ra = ra[k], .dec = dec[k], .promora = promora ? promora[k] : 0, .promodec = promodec ? promodec[k] : 0, .parallax = parallax ? parallax[k] : 0, .radialvelocity = rv ? rv[k] : 0 };
+			double pos1[3], vel1[3], pos2[3], pos3[3], pos4[3], pos5[3], t_light, limb, frlimb;
+			starvectors(&star, pos1, vel1);
+			proper_motion(T0, pos1, vel1, frame.jd_tdb + d_light(pos1, pob), pos2);
+			bary2obs(pos2, pob, pos3, &t_light);
+			grav_vec(pos3, pob, frame.psb, RMASS[10], pos4);
+			if (topocentric) {
+				limb_angle(pos3, pog, &limb, &frlimb);
+				if (frlimb >= 0.8)
+					grav_vec(pos4, pob, frame.peb, RMASS[3], pos4);
+			}
+			aberration(pos4, vob, t_light, pos5);
+			x[i] = pos5[0];
+			y[i] = pos5[1];
+			z[i] = pos5[2];
+		}
+		// rotation to true equator and equinox of date is done on plain arrays, so the compiler can vectorize it
+		double (*m)[3] = frame.matrix;
+		for (int i = 0; i < n; i++) {
+			double px = m[0][0] * x[i] + m[0][1] * y[i] + m[0][2] * z[i];
+			double py = m[1][0] * x[i] + m[1][1] * y[i] + m[1][2] * z[i];
+			double pz = m[2][0] * x[i] + m[2][1] * y[i] + m[2][2] * z[i];
+			x[i] = px;
+			y[i] = py;
+			z[i] = pz;
+		}
+		for (int i = 0; i < n; i++) {
+			double pos[3] = { x[i], y[i], z[i] };
+			vector2radec(pos, ra + base + i, dec + base + i);
+		}
+	}
+}
+
+void indigo_app_star(double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
+	indigo_app_star_at(NULL, promora, promodec, parallax, rv, ra, dec);
+}
+
+void indigo_app_star_at(time_t *utc, double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
+	place_batch(utc, false, 0, 0, 0, 1, &promora, &promodec, &parallax, &rv, ra, dec);
+}
+
+void indigo_app_star_batch(time_t *utc, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec) {
+	place_batch(utc, false, 0, 0, 0, count, promora, promodec, parallax, rv, ra, dec);
+}
+
+void indigo_topo_star(double latitude, double longitude, double elevation, double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
+	place_batch(NULL, true, latitude, longitude, elevation, 1, &promora, &promodec, &parallax, &rv, ra, dec);
+}
+
+void indigo_topo_star_batch(time_t *utc, double latitude, double longitude, double elevation, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec) {
+	place_batch(utc, true, latitude, longitude, elevation, count, promora, promodec, parallax, rv, ra, dec);
 }
 
 void indigo_topo_planet(double latitude, double longitude, double elevation, int id, double *ra, double *dec) {
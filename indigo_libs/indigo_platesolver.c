@@ -33,11 +33,138 @@
 #include <math.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <jpeglib.h>
 
 #include <indigo/indigo_agent.h>
 #include <indigo/indigo_filter.h>
 
 #include <indigo/indigo_platesolver.h>
+#include <indigo/indigo_ccd_driver.h>
+#include <indigo/indigo_image_pool.h>
+
+#define MAX_BINNED_PIXELS		(2 * 1024 * 1024)
+
+static uint16_t *bin_image(const uint8_t *data, int byte_per_pixel, bool big_endian, int bzero, int components, int width, int height, int bin, int *binned_width, int *binned_height) {
+	// average bin x bin blocks of luminance into 16 bit mono image
+	int w = width / bin, h = height / bin, divider = bin * bin * components;
+	uint16_t *binned = indigo_safe_malloc(w * h * sizeof(uint16_t)), *out = binned;
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			unsigned sum = 0;
+			for (int j = 0; j < bin; j++) {
+				const uint8_t *in = data + ((long)(y * bin + j) * width + x * bin) * components * byte_per_pixel;
+				for (int i = 0; i < bin * components; i++) {
+					if (byte_per_pixel == 1)
+						sum += in[i];
+					else if (big_endian)
+						sum += (uint16_t)((int16_t)(in[2 * i] << 8 | in[2 * i + 1]) + bzero);
+					else
+						sum += ((uint16_t *)in)[i];
+				}
+			}
+			*out++ = sum / divider;
+		}
+	}
+	*binned_width = w;
+	*binned_height = h;
+	return binned;
+}
+
+bool indigo_platesolver_find_stars(void *image, unsigned long image_size, int bin, int max_stars, indigo_star_detection *stars, int *star_count, int *frame_width, int *frame_height) {
+	void *intermediate_image = NULL;
+	int byte_per_pixel = 0, components = 0, bzero = 0, width = 0, height = 0;
+	bool big_endian = false;
+	*star_count = 0;
+	if (!strncmp("SIMPLE", (const char *)image, 6)) {
+		// FITS - use 8 and 16 bit mono data (or the first plane) directly
+		char *end = (char *)image + image_size, *data = NULL;
+		int bitpix = 0, naxis = 0;
+		for (char *card = image; card + 80 <= end; card += 80) {
+			if (!strncmp(card, "END     ", 8)) {
+				data = (char *)image + ((card - (char *)image) / FITS_HEADER_SIZE + 1) * FITS_HEADER_SIZE;
+				break;
+			}
+			sscanf(card, "BITPIX  = %d", &bitpix);
+			sscanf(card, "NAXIS   = %d", &naxis);
+			sscanf(card, "NAXIS1  = %d", &width);
+			sscanf(card, "NAXIS2  = %d", &height);
+			sscanf(card, "BZERO   = %d", &bzero);
+		}
+		if (data && (bitpix == 8 || bitpix == 16) && naxis >= 2 && data + (long)width * height * (bitpix / 8) <= end) {
+			byte_per_pixel = bitpix / 8;
+			components = 1;
+			big_endian = true;
+			image = data;
+		}
+	} else if (!strncmp("RAW", (const char *)image, 3)) {
+		indigo_raw_header *header = (indigo_raw_header *)image;
+		switch (header->signature) {
+			case INDIGO_RAW_MONO8:
+				byte_per_pixel = 1;
+				components = 1;
+				break;
+			case INDIGO_RAW_MONO16:
+				byte_per_pixel = 2;
+				components = 1;
+				break;
+			case INDIGO_RAW_RGB24:
+				byte_per_pixel = 1;
+				components = 3;
+				break;
+			case INDIGO_RAW_RGB48:
+				byte_per_pixel = 2;
+				components = 3;
+				break;
+		}
+		width = header->width;
+		height = header->height;
+		image = (char *)image + sizeof(indigo_raw_header);
+	} else if (!strncmp("JFIF", (const char *)image + 6, 4)) {
+		// JPEG
+		struct jpeg_decompress_struct cinfo;
+		struct jpeg_error_mgr jerr;
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_decompress(&cinfo);
+		jpeg_mem_src(&cinfo, image, image_size);
+		if (jpeg_read_header(&cinfo, TRUE) >= 0) {
+			jpeg_start_decompress(&cinfo);
+			byte_per_pixel = 1;
+			components = cinfo.output_components;
+			width = cinfo.output_width;
+			height = cinfo.output_height;
+			int row_stride = width * components;
+			image = intermediate_image = indigo_safe_malloc(height * row_stride);
+			while (cinfo.output_scanline < cinfo.output_height) {
+				unsigned char *buffer_array[1];
+				buffer_array[0] = intermediate_image + (cinfo.output_scanline) * row_stride;
+				jpeg_read_scanlines(&cinfo, buffer_array, 1);
+			}
+			jpeg_finish_decompress(&cinfo);
+		}
+		jpeg_destroy_decompress(&cinfo);
+	}
+	*frame_width = width;
+	*frame_height = height;
+	if (byte_per_pixel == 0 || width == 0 || height == 0)
+		return false;
+	// binned image keeps find_stars fast enough for large frames
+	if (bin < 1)
+		bin = 1;
+	while ((long)(width / bin) * (height / bin) > MAX_BINNED_PIXELS)
+		bin++;
+	int binned_width, binned_height;
+	uint16_t *binned_image = bin_image(image, byte_per_pixel, big_endian, bzero, components, width, height, bin, &binned_width, &binned_height);
+	indigo_find_stars_precise(INDIGO_RAW_MONO16, binned_image, 5, binned_width, binned_height, max_stars, stars, star_count);
+	// centroids are pixel edge based, convert them to 0-based pixel centers in full resolution frame
+	for (int i = 0; i < *star_count; i++) {
+		stars[i].x = stars[i].x * bin - 0.5;
+		stars[i].y = stars[i].y * bin - 0.5;
+	}
+	INDIGO_DEBUG(indigo_debug("%s(): %d stars found in %dx%d frame binned %dx%d", __FUNCTION__, *star_count, width, height, bin, bin));
+	free(binned_image);
+	indigo_safe_free(intermediate_image);
+	return true;
+}
 
 // -------------------------------------------------------------------------------- INDIGO agent device implementation
 
@@ -89,6 +216,73 @@ void indigo_platesolver_sync(indigo_device *device) {
 	}
 }
 
+static double monotonic_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *solver_worker(indigo_device *device) {
+	platesolver_private_data *private_data = INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA;
+	double total_latency = 0;
+	pthread_mutex_lock(&private_data->queue_mutex);
+	while (true) {
+		while (!private_data->pending_ready && !private_data->worker_exit)
+			pthread_cond_wait(&private_data->queue_cond, &private_data->queue_mutex);
+		if (private_data->worker_exit)
+			break;
+		// swap buffers, so the next image can be queued while this one is solved
+		indigo_platesolver_task task = private_data->current;
+		private_data->current = private_data->pending;
+		private_data->pending = task;
+		private_data->pending.size = 0;
+		private_data->pending_ready = false;
+		AGENT_PLATESOLVER_STATS_QUEUE_ITEM->number.value = 0;
+		pthread_mutex_unlock(&private_data->queue_mutex);
+		private_data->solve(&private_data->current);
+		pthread_mutex_lock(&private_data->queue_mutex);
+		double latency = monotonic_time() - private_data->current.timestamp;
+		total_latency += latency;
+		AGENT_PLATESOLVER_STATS_PROCESSED_ITEM->number.value++;
+		AGENT_PLATESOLVER_STATS_LATENCY_ITEM->number.value = latency;
+		AGENT_PLATESOLVER_STATS_AVG_LATENCY_ITEM->number.value = total_latency / AGENT_PLATESOLVER_STATS_PROCESSED_ITEM->number.value;
+		pthread_mutex_unlock(&private_data->queue_mutex);
+		indigo_update_property(device, AGENT_PLATESOLVER_STATS_PROPERTY, NULL);
+		pthread_mutex_lock(&private_data->queue_mutex);
+	}
+	pthread_mutex_unlock(&private_data->queue_mutex);
+	return NULL;
+}
+
+// queue image for solving, pending image not processed yet is replaced, the buffer is copied to reused slot or taken over without copying if owned is true
+static void queue_image(indigo_device *device, void *image, unsigned long size, bool owned) {
+	platesolver_private_data *private_data = INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA;
+	pthread_mutex_lock(&private_data->queue_mutex);
+	if (private_data->pending_ready)
+		AGENT_PLATESOLVER_STATS_REPLACED_ITEM->number.value++;
+	if (owned) {
+		indigo_release_image_buffer(private_data->pending.image);
+		private_data->pending.image = image;
+		private_data->pending.capacity = indigo_image_buffer_size(image);
+	} else {
+		if (private_data->pending.capacity < size) {
+			indigo_release_image_buffer(private_data->pending.image);
+			private_data->pending.image = indigo_alloc_image_buffer(size);
+			assert(private_data->pending.image != NULL);
+			private_data->pending.capacity = indigo_image_buffer_size(private_data->pending.image);
+		}
+		memcpy(private_data->pending.image, image, size);
+	}
+	private_data->pending.device = device;
+	private_data->pending.size = size;
+	private_data->pending.timestamp = monotonic_time();
+	private_data->pending_ready = true;
+	AGENT_PLATESOLVER_STATS_QUEUE_ITEM->number.value = 1;
+	pthread_cond_signal(&private_data->queue_cond);
+	pthread_mutex_unlock(&private_data->queue_mutex);
+	indigo_update_property(device, AGENT_PLATESOLVER_STATS_PROPERTY, NULL);
+}
+
 indigo_result indigo_platesolver_device_attach(indigo_device *device, const char* driver_name, unsigned version, indigo_device_interface device_interface) {
 	assert(device != NULL);
 	if (indigo_filter_device_attach(device, driver_name, version, device_interface) == INDIGO_OK) {
@@ -134,12 +328,30 @@ indigo_result indigo_platesolver_device_attach(indigo_device *device, const char
 		indigo_init_switch_item(AGENT_PLATESOLVER_SYNC_DISABLED_ITEM, AGENT_PLATESOLVER_SYNC_DISABLED_ITEM_NAME, "Disabled", true);
 		indigo_init_switch_item(AGENT_PLATESOLVER_SYNC_SYNC_ITEM, AGENT_PLATESOLVER_SYNC_SYNC_ITEM_NAME, "Sync only", false);
 		indigo_init_switch_item(AGENT_PLATESOLVER_SYNC_CENTER_ITEM, AGENT_PLATESOLVER_SYNC_CENTER_ITEM_NAME, "Sync and center", false);
+		// -------------------------------------------------------------------------------- Stats property
+		AGENT_PLATESOLVER_STATS_PROPERTY = indigo_init_number_property(NULL, device->name, AGENT_PLATESOLVER_STATS_PROPERTY_NAME, PLATESOLVER_MAIN_GROUP, "Solver statistics", INDIGO_OK_STATE, INDIGO_RO_PERM, 5);
+		if (AGENT_PLATESOLVER_STATS_PROPERTY == NULL)
+			return INDIGO_FAILED;
+		indigo_init_number_item(AGENT_PLATESOLVER_STATS_QUEUE_ITEM, AGENT_PLATESOLVER_STATS_QUEUE_ITEM_NAME, "Queued images", 0, 1, 0, 0);
+		indigo_init_number_item(AGENT_PLATESOLVER_STATS_PROCESSED_ITEM, AGENT_PLATESOLVER_STATS_PROCESSED_ITEM_NAME, "Processed images", 0, 0xFFFFFFFF, 0, 0);
+		indigo_init_number_item(AGENT_PLATESOLVER_STATS_REPLACED_ITEM, AGENT_PLATESOLVER_STATS_REPLACED_ITEM_NAME, "Replaced images", 0, 0xFFFFFFFF, 0, 0);
+		indigo_init_number_item(AGENT_PLATESOLVER_STATS_LATENCY_ITEM, AGENT_PLATESOLVER_STATS_LATENCY_ITEM_NAME, "Last latency (seconds)", 0, 3600, 0, 0);
+		indigo_init_number_item(AGENT_PLATESOLVER_STATS_AVG_LATENCY_ITEM, AGENT_PLATESOLVER_STATS_AVG_LATENCY_ITEM_NAME, "Average latency (seconds)", 0, 3600, 0, 0);
+		strcpy(AGENT_PLATESOLVER_STATS_LATENCY_ITEM->number.format, "%.3f");
+		strcpy(AGENT_PLATESOLVER_STATS_AVG_LATENCY_ITEM->number.format, "%.3f");
 		// --------------------------------------------------------------------------------
 		CONFIG_PROPERTY->hidden = true;
 		PROFILE_PROPERTY->hidden = true;
 		CONNECTION_PROPERTY->hidden = true;
 		// --------------------------------------------------------------------------------
 		pthread_mutex_init(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->mutex, NULL);
+		pthread_mutex_init(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex, NULL);
+		pthread_cond_init(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_cond, NULL);
+		INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->worker_exit = false;
+		if (pthread_create(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->worker, NULL, (void *(*)(void *))solver_worker, device)) {
+			INDIGO_ERROR(indigo_error("%s: can't start solver thread", device->name));
+			return INDIGO_FAILED;
+		}
 		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
@@ -154,6 +366,8 @@ indigo_result indigo_platesolver_enumerate_properties(indigo_device *device, ind
 		indigo_define_property(device, AGENT_PLATESOLVER_WCS_PROPERTY, NULL);
 	if (indigo_property_match(AGENT_PLATESOLVER_SYNC_PROPERTY, property))
 		indigo_define_property(device, AGENT_PLATESOLVER_SYNC_PROPERTY, NULL);
+	if (indigo_property_match(AGENT_PLATESOLVER_STATS_PROPERTY, property))
+		indigo_define_property(device, AGENT_PLATESOLVER_STATS_PROPERTY, NULL);
 	return indigo_filter_enumerate_properties(device, client, property);
 }
 
@@ -190,16 +404,42 @@ indigo_result indigo_platesolver_change_property(indigo_device *device, indigo_c
 
 indigo_result indigo_platesolver_device_detach(indigo_device *device) {
 	assert(device != NULL);
+	pthread_mutex_lock(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex);
+	// image_fetched() may still be called for HTTP fetches in progress
+	while (INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->pending_fetches > 0)
+		pthread_cond_wait(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_cond, &INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex);
+	INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->worker_exit = true;
+	pthread_cond_signal(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_cond);
+	pthread_mutex_unlock(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex);
+	pthread_join(INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->worker, NULL);
+	pthread_cond_destroy(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_cond);
+	pthread_mutex_destroy(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex);
+	indigo_release_image_buffer(INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->pending.image);
+	indigo_release_image_buffer(INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->current.image);
 	indigo_release_property(AGENT_PLATESOLVER_USE_INDEX_PROPERTY);
 	indigo_release_property(AGENT_PLATESOLVER_HINTS_PROPERTY);
 	indigo_release_property(AGENT_PLATESOLVER_WCS_PROPERTY);
 	indigo_release_property(AGENT_PLATESOLVER_SYNC_PROPERTY);
+	indigo_release_property(AGENT_PLATESOLVER_STATS_PROPERTY);
 	pthread_mutex_destroy(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->mutex);
 	return indigo_filter_device_detach(device);
 }
 
 // -------------------------------------------------------------------------------- INDIGO agent client implementation
 
+static void image_fetched(indigo_item *blob_item, bool success, indigo_device *device) {
+	if (success) {
+		queue_image(device, blob_item->blob.value, blob_item->blob.size, true);
+	} else {
+		indigo_release_image_buffer(blob_item->blob.value);
+		INDIGO_ERROR(indigo_error("%s: failed to fetch image from %s", device->name, blob_item->blob.url));
+	}
+	pthread_mutex_lock(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex);
+	INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->pending_fetches--;
+	pthread_cond_broadcast(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_cond);
+	pthread_mutex_unlock(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex);
+}
+
 indigo_result indigo_platesolver_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
 	if (property->state == INDIGO_OK_STATE) {
 		char *device_name = device->name;
@@ -212,10 +452,14 @@ indigo_result indigo_platesolver_update_property(indigo_client *client, indigo_d
 					for (int i = 0; i < property->count; i++) {
 						indigo_item *item = property->items + i;
 						if (!strcmp(item->name, CCD_IMAGE_ITEM_NAME)) {
-							indigo_platesolver_task *task = indigo_safe_malloc(sizeof(indigo_platesolver_task));
-							task->device = FILTER_CLIENT_CONTEXT->device;
-							task->image = indigo_safe_malloc_copy(task->size = item->blob.size, item->blob.value);
-							indigo_async((void *(*)(void *))INDIGO_PLATESOLVER_CLIENT_PRIVATE_DATA->solve, task);
+							if (item->blob.value == NULL && *item->blob.url) {
+								pthread_mutex_lock(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex);
+								INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->pending_fetches++;
+								pthread_mutex_unlock(&INDIGO_PLATESOLVER_DEVICE_PRIVATE_DATA->queue_mutex);
+								indigo_populate_http_blob_item_async(item, (indigo_blob_fetch_callback)image_fetched, FILTER_CLIENT_CONTEXT->device);
+							} else if (item->blob.value) {
+								queue_image(FILTER_CLIENT_CONTEXT->device, item->blob.value, item->blob.size, false);
+							}
 						}
 					}
 					break;
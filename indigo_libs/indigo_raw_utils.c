@@ -1473,7 +1473,7 @@ indigo_result indigo_find_stars_precise(indigo_raw_type raw_type, const void *da
 				for (int i = star_x; i <= max_i; i++) {
 					int off = j * width + i;
 					if (buf[off] > threshold_hist) {
-						luminance += buf[off] - threshold;
+						luminance += (double)buf[off] - threshold;
 						buf[off] = 0;
 					} else {
 						break;
@@ -1486,7 +1486,7 @@ indigo_result indigo_find_stars_precise(indigo_raw_type raw_type, const void *da
 				for (int i = star_x - 1; i >= min_i; i--) {
 					int off = j * width + i;
 					if (buf[off] > threshold_hist) {
-						luminance += buf[off] - threshold;
+						luminance += (double)buf[off] - threshold;
 						buf[off] = 0;
 					} else {
 						break;
@@ -1499,7 +1499,7 @@ indigo_result indigo_find_stars_precise(indigo_raw_type raw_type, const void *da
 				for (int i = star_x; i <= max_i; i++) {
 					int off = j * width + i;
 					if (buf[off] > threshold_hist) {
-						luminance += buf[off] - threshold;
+						luminance += (double)buf[off] - threshold;
 						buf[off] = 0;
 					} else {
 						break;
@@ -1512,7 +1512,7 @@ indigo_result indigo_find_stars_precise(indigo_raw_type raw_type, const void *da
 				for (int i = star_x - 1; i >= min_i; i--) {
 					int off = j * width + i;
 					if (buf[off] > threshold_hist) {
-						luminance += buf[off] - threshold;
+						luminance += (double)buf[off] - threshold;
 						buf[off] = 0;
 					} else {
 						break;
@@ -49,9 +49,11 @@
 #include <indigo/indigo_server_tcp.h>
 #include <indigo/indigo_driver_xml.h>
 #include <indigo/indigo_driver_json.h>
+#include <indigo/indigo_driver_binary.h>
 #include <indigo/indigo_client_xml.h>
 #include <indigo/indigo_base64.h>
 #include <indigo/indigo_io.h>
+#include <indigo/indigo_image_pool.h>
 
 #define SHA1_SIZE 20
 #if _MSC_VER
@@ -78,12 +80,42 @@ static struct resource {
 	unsigned char *data;
 	unsigned length;
 	const char *file_name;
+	indigo_server_resource_generator generator;
+	indigo_server_resource_release release;
 	char *content_type;
 	struct resource *next;
 } *resources = NULL;
 
 #define BUFFER_SIZE	1024
 
+static bool ws_deflate_offered(char *extensions) {
+	// accept "permessage-deflate" offer unless it restricts server window size (shared deflater always uses 15 bits)
+	char *offer, *offer_context;
+	for (offer = strtok_r(extensions, ",", &offer_context); offer; offer = strtok_r(NULL, ",", &offer_context)) {
+		char *param, *param_context;
+		bool is_deflate = false, is_acceptable = true;
+		for (param = strtok_r(offer, ";", &param_context); param; param = strtok_r(NULL, ";", &param_context)) {
+			while (*param == ' ')
+				param++;
+			if (!strncasecmp(param, "permessage-deflate", 18)) {
+				is_deflate = true;
+			} else if (!strncasecmp(param, "server_max_window_bits", 22)) {
+				char *value = strchr(param, '=');
+				if (value) {
+					value++;
+					if (*value == '"')
+						value++;
+					if (atoi(value) < 15)
+						is_acceptable = false;
+				}
+			}
+		}
+		if (is_deflate && is_acceptable)
+			return true;
+	}
+	return false;
+}
+
 static void start_worker_thread(int *client_socket) {
 	int socket = *client_socket;
 	INDIGO_LOG(indigo_log("Worker thread started socket = %d", socket));
@@ -107,6 +139,14 @@ static void start_worker_thread(int *client_socket) {
 			indigo_json_parse(NULL, protocol_adapter);
 			indigo_detach_client(protocol_adapter);
 			indigo_release_json_device_adapter(protocol_adapter);
+		} else if (c == INDIGO_BINARY_SIGNATURE[0]) {
+			INDIGO_LOG(indigo_log("Protocol switched to binary"));
+			indigo_client *protocol_adapter = indigo_binary_device_adapter(socket, socket);
+			assert(protocol_adapter != NULL);
+			indigo_attach_client(protocol_adapter);
+			indigo_binary_parse(NULL, protocol_adapter);
+			indigo_detach_client(protocol_adapter);
+			indigo_release_binary_device_adapter(protocol_adapter);
 		} else if (c == 'G') {
 			char request[BUFFER_SIZE];
 			char header[BUFFER_SIZE];
@@ -121,9 +161,12 @@ static void start_worker_thread(int *client_socket) {
 					if (param)
 						*param = 0;
 					char websocket_key[256] = "";
+					bool websocket_deflate = false;
 					while (indigo_read_line(socket, header, BUFFER_SIZE) > 0) {
 						if (!strncasecmp(header, "Sec-WebSocket-Key: ", 19))
 							strncpy(websocket_key, header + 19, sizeof(websocket_key));
+						if (!strncasecmp(header, "Sec-WebSocket-Extensions: ", 26))
+							websocket_deflate = websocket_deflate || ws_deflate_offered(header + 26);
 						if (!strcasecmp(header, "Connection: keep-alive"))
 							keep_alive = true;
 					}
@@ -139,10 +182,13 @@ static void start_worker_thread(int *client_socket) {
 							INDIGO_PRINTF(socket, "Connection: upgrade\r\n");
 							base64_encode((unsigned char *)websocket_key, shaHash, 20);
 							INDIGO_PRINTF(socket, "Sec-WebSocket-Accept: %s\r\n", websocket_key);
+							if (websocket_deflate)
+								INDIGO_PRINTF(socket, "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover\r\n");
 							INDIGO_PRINTF(socket, "\r\n");
-							INDIGO_LOG(indigo_log("Protocol switched to JSON-over-WebSockets"));
+							INDIGO_LOG(indigo_log("Protocol switched to JSON-over-WebSockets%s", websocket_deflate ? " (permessage-deflate)" : ""));
 							indigo_client *protocol_adapter = indigo_json_device_adapter(socket, socket, true);
 							assert(protocol_adapter != NULL);
+							((indigo_adapter_context *)protocol_adapter->client_context)->web_socket_deflate = websocket_deflate;
 							indigo_attach_client(protocol_adapter);
 							indigo_json_parse(NULL, protocol_adapter);
 							indigo_detach_client(protocol_adapter);
@@ -174,7 +220,7 @@ static void start_worker_thread(int *client_socket) {
 									INDIGO_ERROR(indigo_error("Failed to populate BLOB"));
 								}
 							}
-							void *working_copy = indigo_use_blob_buffering ? malloc(working_size) : entry->content;
+							void *working_copy = indigo_use_blob_buffering ? indigo_alloc_image_buffer(working_size) : entry->content;
 							if (working_copy) {
 								char working_format[INDIGO_NAME_SIZE];
 								strcpy(working_format, entry->format);
@@ -201,7 +247,7 @@ static void start_worker_thread(int *client_socket) {
 									keep_alive = false;
 								}
 								if (indigo_use_blob_buffering) {
-									free(working_copy);
+									indigo_release_image_buffer(working_copy);
 								} else {
 									pthread_mutex_unlock(&entry->mutext);
 								}
@@ -242,15 +288,30 @@ static void start_worker_thread(int *client_socket) {
 							INDIGO_PRINTF(socket, "%s not found!\r\n", path);
 							INDIGO_LOG(indigo_log("%s -> Failed", request));
 							keep_alive = false;
-						} else if (resource->data) {
-							INDIGO_PRINTF(socket, "HTTP/1.1 200 OK\r\n");
-							INDIGO_PRINTF(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							INDIGO_PRINTF(socket, "Content-Type: %s\r\n", resource->content_type);
-							INDIGO_PRINTF(socket, "Content-Length: %d\r\n", resource->length);
-							INDIGO_PRINTF(socket, "Content-Encoding: gzip\r\n");
-							INDIGO_PRINTF(socket, "\r\n");
-							indigo_write(socket, (const char *)resource->data, resource->length);
-							INDIGO_LOG(indigo_log("%s -> OK (%d bytes)", request, resource->length));
+						} else if (resource->data || resource->generator) {
+							unsigned char *data = resource->data;
+							unsigned length = resource->length;
+							if (resource->generator)
+								data = resource->generator(resource->path, &length);
+							if (data) {
+								INDIGO_PRINTF(socket, "HTTP/1.1 200 OK\r\n");
+								INDIGO_PRINTF(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+								INDIGO_PRINTF(socket, "Content-Type: %s\r\n", resource->content_type);
+								INDIGO_PRINTF(socket, "Content-Length: %d\r\n", length);
+								INDIGO_PRINTF(socket, "Content-Encoding: gzip\r\n");
+								INDIGO_PRINTF(socket, "\r\n");
+								indigo_write(socket, (const char *)data, length);
+								if (resource->generator && resource->release)
+									resource->release(data);
+								INDIGO_LOG(indigo_log("%s -> OK (%d bytes)", request, length));
+							} else {
+								INDIGO_PRINTF(socket, "HTTP/1.1 500 Internal server error\r\n");
+								INDIGO_PRINTF(socket, "Content-Type: text/plain\r\n");
+								INDIGO_PRINTF(socket, "\r\n");
+								INDIGO_PRINTF(socket, "Failed to generate %s!\r\n", path);
+								INDIGO_LOG(indigo_log("%s -> Failed", request));
+								keep_alive = false;
+							}
 						} else if (resource->file_name) {
 							char file_name[256];
 							struct stat file_stat;
@@ -327,6 +388,17 @@ void indigo_server_add_resource(const char *path, unsigned char *data, unsigned
 	INDIGO_LOG(indigo_log("Resource %s (%d, %s) added", path, length, content_type));
 }
 
+void indigo_server_add_generated_resource(const char *path, indigo_server_resource_generator generator, indigo_server_resource_release release, const char *content_type) {
+	struct resource *resource = indigo_safe_malloc(sizeof(struct resource));
+	resource->path = path;
+	resource->generator = generator;
+	resource->release = release;
+	resource->content_type = (char *)content_type;
+	resource->next = resources;
+	resources = resource;
+	INDIGO_LOG(indigo_log("Resource %s (%s) added", path, content_type));
+}
+
 void indigo_server_add_file_resource(const char *path, const char *file_name, const char *content_type) {
 	struct resource *resource = indigo_safe_malloc(sizeof(struct resource));
 	resource->path = path;
@@ -431,7 +503,7 @@ indigo_result indigo_server_start(indigo_server_tcp_callback callback) {
 				indigo_error("Can't set send() timeout (%s)", strerror(errno));
 			int *pointer = indigo_safe_malloc(sizeof(int));
 			*pointer = client_socket;
-			if (!indigo_async((void *(*)(void *))&start_worker_thread, pointer))
+			if (!indigo_start_thread((void *(*)(void *))&start_worker_thread, pointer))
 				indigo_error("Can't create worker thread for connection (%s)", strerror(errno));
 		}
 	}
@@ -32,6 +32,7 @@
 #include <indigo/indigo_timer.h>
 
 #include <indigo/indigo_driver.h>
+#include <indigo/indigo_metrics.h>
 
 
 //#ifdef __MACH__ /* Mac OSX prior Sierra is missing clock_gettime() */
@@ -73,8 +74,14 @@ static void *timer_func(indigo_timer *timer) {
 					pthread_mutex_lock(&timer->mutex);
 					int rc = pthread_cond_timedwait(&timer->cond, &timer->mutex, &end);
 					pthread_mutex_unlock(&timer->mutex);
-					if (rc == ETIMEDOUT)
+					if (rc == ETIMEDOUT) {
+						if (indigo_use_metrics) {
+							struct timespec now;
+							utc_time(&now);
+							indigo_metric_observe(indigo_get_metric(INDIGO_METRIC_HISTOGRAM, "indigo_timer_lateness_seconds", "Delay between scheduled and real timer callback start", NULL, NULL), (now.tv_sec - end.tv_sec) + (now.tv_nsec - end.tv_nsec) / 1e9);
+						}
 						break;
+					}
 				}
 			}
 
@@ -83,10 +90,16 @@ static void *timer_func(indigo_timer *timer) {
 				pthread_mutex_lock(&timer->callback_mutex);
 				timer->callback_running = true;
 				INDIGO_TRACE(indigo_trace("timer callback: %p started", timer->callback));
+				double start = indigo_use_metrics || indigo_use_tracing ? indigo_metric_time() : 0;
 				if (timer->data)
 					((indigo_timer_with_data_callback)timer->callback)(timer->device, timer->data);
 				else
 					((indigo_timer_callback)timer->callback)(timer->device);
+				if (start) {
+					if (indigo_use_metrics)
+						indigo_metric_observe(indigo_get_metric(INDIGO_METRIC_HISTOGRAM, "indigo_timer_callback_seconds", "Timer callback execution time", NULL, NULL), indigo_metric_time() - start);
+					INDIGO_TRACING_COMPLETE("timer", "callback", timer->device ? timer->device->name : NULL, start);
+				}
 				timer->callback_running = false;
 				if (!timer->scheduled && timer->reference)
 					*timer->reference = NULL;
@@ -51,6 +51,8 @@
 #include <indigo/indigo_io.h>
 #include <indigo/indigo_version.h>
 #include <indigo/indigo_names.h>
+#include <indigo/indigo_metrics.h>
+#include <indigo/indigo_image_pool.h>
 
 #define BUFFER_SIZE 524288  /* BUFFER_SIZE % 4 == 0, inportant for base64 */
 
@@ -229,12 +231,28 @@ static void *get_properties_handler(parser_state state, parser_context *context,
 				indigo_printf(handle, "<switchProtocol version='%d.%d'/>\n", (version >> 8) & 0xFF, version & 0xFF);
 				client->version = version;
 			}
+		} else if (!strcmp(name, "delta")) {
+			assert(client->client_context != NULL);
+			((indigo_adapter_context *)(client->client_context))->delta_updates = !strcmp(value, "On");
+		} else if (!strcmp(name, "subscribe")) {
+			// subscription request is kept in label until the whole request is parsed
+			indigo_copy_name(property->label, value);
 		} else if (!strncmp(name, "device",INDIGO_NAME_SIZE)) {
 			indigo_copy_name(property->device, value);
 		} else if (!strncmp(name, "name",INDIGO_NAME_SIZE)) {
 			indigo_copy_property_name(client->version, property, value);;
+		} else if (!strncmp(name, "group",INDIGO_NAME_SIZE)) {
+			indigo_copy_name(property->group, value);
 		}
 	} else if (state == END_TAG) {
+		if (!strcmp(property->label, "On")) {
+			indigo_subscribe(client, property->device, property->name, property->group);
+			// wildcards are resolved by subscription filter
+			if (strpbrk(property->device, "*?"))
+				*property->device = 0;
+			if (strpbrk(property->name, "*?"))
+				*property->name = 0;
+		}
 		indigo_enumerate_properties(client, property);
 		memset(property, 0, PROPERTY_SIZE);
 		return top_level_handler;
@@ -447,17 +465,14 @@ static void set_property(parser_context *context, indigo_property *other, char *
 								indigo_copy_name(property_item->blob.format, other_item->blob.format);
 								indigo_copy_value(property_item->blob.url, other_item->blob.url);
 								property_item->blob.size = other_item->blob.size;
+								// cached value is a pool buffer, client may still hold a reference to the previous one
+								indigo_release_image_buffer(property_item->blob.value);
+								property_item->blob.value = NULL;
 								if (other_item->blob.value) {
-									if (property_item->blob.value != NULL)
-										property_item->blob.value = indigo_safe_realloc(property_item->blob.value, property_item->blob.size);
-									else
-										property_item->blob.value = indigo_safe_malloc(property_item->blob.size);
+									property_item->blob.value = indigo_alloc_image_buffer(property_item->blob.size);
+									assert(property_item->blob.value != NULL);
 									memcpy(property_item->blob.value, other_item->blob.value, property_item->blob.size);
 								} else {
-									if (property_item->blob.value != NULL) {
-										free(property_item->blob.value);
-										property_item->blob.value = NULL;
-									}
 									char *ext = strrchr(property_item->blob.url, '.');
 									if (ext)
 										strcpy(property_item->blob.format, ext);
@@ -1134,9 +1149,7 @@ static void *del_property_handler(parser_state state, parser_context *context, c
 					indigo_delete_property(device, tmp, *message ? message : NULL);
 					if (tmp->type == INDIGO_BLOB_VECTOR) {
 						for (int i = 0; i < tmp->count; i++) {
-							void *blob = tmp->items[i].blob.value;
-							if (blob)
-								free(blob);
+							indigo_release_image_buffer(tmp->items[i].blob.value);
 						}
 					}
 					indigo_release_property(tmp);
@@ -1269,6 +1282,8 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 	long blob_size = 0;
 	char q = '"';
 	int depth = 0;
+	double element_start = 0;
+	char element_name[32];
 	char c = 0;
 	char entity_buffer[8];
 	char *entity_pointer = NULL;
@@ -1398,6 +1413,11 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 				} else {
 					*name_pointer = 0;
 					depth++;
+					if (depth == 1 && indigo_use_tracing) {
+						element_start = indigo_metric_time();
+						strncpy(element_name, name_buffer, sizeof(element_name) - 1);
+						element_name[sizeof(element_name) - 1] = 0;
+					}
 					handler = handler(BEGIN_TAG, context, name_buffer, NULL, message);
 					if (isspace(c)) {
 						state = ATTRIBUTE_NAME1;
@@ -1420,6 +1440,10 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 					INDIGO_TRACE_PARSER(indigo_trace("XML Parser: '%c' END_TAG1 -> IDLE", c));
 					handler = handler(END_TAG, context, NULL, NULL, message);
 					depth--;
+					if (depth == 0 && element_start) {
+						INDIGO_TRACING_COMPLETE("xml", "parse", element_name, element_start);
+						element_start = 0;
+					}
 					state = IDLE;
 				} else {
 					state = ERROR;
@@ -1441,6 +1465,10 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 				} else if (c == '>') {
 					handler = handler(END_TAG, context, NULL, NULL, message);
 					depth--;
+					if (depth == 0 && element_start) {
+						INDIGO_TRACING_COMPLETE("xml", "parse", element_name, element_start);
+						element_start = 0;
+					}
 					state = IDLE;
 					INDIGO_TRACE_PARSER(indigo_trace("XML Parser: '%c' END_TAG -> IDLE", c));
 				} else {
@@ -1662,9 +1690,7 @@ exit_loop:
 			if (property != NULL && !strncmp(remote_device.name, property->device, INDIGO_NAME_SIZE)) {
 				if (property->type == INDIGO_BLOB_VECTOR) {
 					for (int i = 0; i < property->count; i++) {
-						void *blob = property->items[i].blob.value;
-						if (blob)
-							free(blob);
+						indigo_release_image_buffer(property->items[i].blob.value);
 					}
 				}
 				indigo_release_property(property);
@@ -1010,7 +1010,7 @@ static void ccd_connect_callback(indigo_device *device) {
 			}
 
 			if (PRIVATE_DATA->buffer != NULL) {
-				free(PRIVATE_DATA->buffer);
+				indigo_free_blob_buffer(PRIVATE_DATA->buffer);
 				PRIVATE_DATA->buffer = NULL;
 			}
 			device->is_connected = false;
@@ -1604,7 +1604,7 @@ indigo_result indigo_ccd_andor(indigo_driver_action action, indigo_driver_info *
 					if (private_data != NULL) {
 						pthread_mutex_destroy(&driver_mutex);
 						if (private_data->buffer != NULL) {
-							free(private_data->buffer);
+							indigo_free_blob_buffer(private_data->buffer);
 							private_data->buffer = NULL;
 						}
 						free(private_data);
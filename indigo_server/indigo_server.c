@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
 #include <syslog.h>
 #include <assert.h>
 #include <signal.h>
@@ -47,9 +48,12 @@
 #include <indigo/indigo_driver.h>
 #include <indigo/indigo_client.h>
 #include <indigo/indigo_xml.h>
+#include <indigo/indigo_binary.h>
 #include <indigo/indigo_token.h>
+#include <indigo/indigo_metrics.h>
+#include <indigo/indigo_image_pool.h>
 
-#include "indigo_cat_data.h"
+#include <indigo/indigo_cat_data.h>
 
 #include "ccd_simulator/indigo_ccd_simulator.h"
 #include "mount_simulator/indigo_mount_simulator.h"
@@ -139,6 +143,7 @@
 #include "wheel_qhy/indigo_wheel_qhy.h"
 #include "focuser_mypro2/indigo_focuser_mypro2.h"
 #include "agent_astrometry/indigo_agent_astrometry.h"
+#include "agent_platesolver/indigo_agent_platesolver.h"
 #ifndef __aarch64__
 #include "ccd_sbig/indigo_ccd_sbig.h"
 #endif
@@ -173,6 +178,7 @@ driver_entry_point static_drivers[] = {
 	indigo_agent_lx200_server,
 	indigo_agent_scripting,
 	indigo_agent_mount,
+	indigo_agent_platesolver,
 	indigo_agent_snoop,
 	indigo_ao_sx,
 	indigo_aux_arteskyflat,
@@ -301,6 +307,16 @@ static indigo_property *log_level_property;
 static indigo_property *blob_buffering_property;
 static indigo_property *blob_proxy_property;
 static indigo_property *server_features_property;
+static indigo_property *bus_statistics_property;
+static indigo_property *async_statistics_property;
+static indigo_property *log_statistics_property;
+static indigo_property *image_pool_property;
+static indigo_property *image_pool_statistics_property;
+static indigo_property *metrics_property;
+static indigo_property *tracing_property;
+static indigo_property *trace_dump_property;
+static indigo_property *trace_property;
+static indigo_timer *bus_statistics_timer;
 
 #ifdef RPI_MANAGEMENT
 static indigo_property *wifi_ap_property;
@@ -316,9 +332,6 @@ static pthread_mutex_t install_property_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DNSServiceRef sd_http;
 static DNSServiceRef sd_indigo;
 
-static void *star_data = NULL;
-static void *dso_data = NULL;
-static void *constellation_data = NULL;
 
 #ifdef INDIGO_MACOS
 static bool runLoop = true;
@@ -360,6 +373,61 @@ static bool runLoop = true;
 #define SERVER_CTRL_PANEL_ITEM										(SERVER_FEATURES_PROPERTY->items + 1)
 #define SERVER_WEB_APPS_ITEM											(SERVER_FEATURES_PROPERTY->items + 2)
 
+#define SERVER_BUS_STATISTICS_PROPERTY						bus_statistics_property
+#define SERVER_BUS_BROADCASTS_ITEM								(SERVER_BUS_STATISTICS_PROPERTY->items + 0)
+#define SERVER_BUS_CONTENDED_ITEM									(SERVER_BUS_STATISTICS_PROPERTY->items + 1)
+#define SERVER_BUS_CONCURRENT_ITEM								(SERVER_BUS_STATISTICS_PROPERTY->items + 2)
+#define SERVER_BUS_MAX_CONCURRENT_ITEM						(SERVER_BUS_STATISTICS_PROPERTY->items + 3)
+#define SERVER_BUS_TABLE_UPDATES_ITEM							(SERVER_BUS_STATISTICS_PROPERTY->items + 4)
+#define SERVER_BUS_GRACE_WAITS_ITEM								(SERVER_BUS_STATISTICS_PROPERTY->items + 5)
+#define SERVER_BUS_GRACE_WAIT_TIME_ITEM						(SERVER_BUS_STATISTICS_PROPERTY->items + 6)
+#define SERVER_BUS_DEVICES_ITEM										(SERVER_BUS_STATISTICS_PROPERTY->items + 7)
+#define SERVER_BUS_CLIENTS_ITEM										(SERVER_BUS_STATISTICS_PROPERTY->items + 8)
+
+#define SERVER_ASYNC_STATISTICS_PROPERTY					async_statistics_property
+#define SERVER_ASYNC_POOL_SIZE_ITEM								(SERVER_ASYNC_STATISTICS_PROPERTY->items + 0)
+#define SERVER_ASYNC_THREADS_ITEM									(SERVER_ASYNC_STATISTICS_PROPERTY->items + 1)
+#define SERVER_ASYNC_BUSY_ITEM										(SERVER_ASYNC_STATISTICS_PROPERTY->items + 2)
+#define SERVER_ASYNC_QUEUED_ITEM									(SERVER_ASYNC_STATISTICS_PROPERTY->items + 3)
+#define SERVER_ASYNC_JOBS_ITEM										(SERVER_ASYNC_STATISTICS_PROPERTY->items + 4)
+#define SERVER_ASYNC_OVERFLOWS_ITEM								(SERVER_ASYNC_STATISTICS_PROPERTY->items + 5)
+#define SERVER_ASYNC_QUEUE_LATENCY_ITEM						(SERVER_ASYNC_STATISTICS_PROPERTY->items + 6)
+#define SERVER_ASYNC_MAX_QUEUE_LATENCY_ITEM				(SERVER_ASYNC_STATISTICS_PROPERTY->items + 7)
+
+#define SERVER_LOG_STATISTICS_PROPERTY						log_statistics_property
+#define SERVER_LOG_BUFFERS_ITEM										(SERVER_LOG_STATISTICS_PROPERTY->items + 0)
+#define SERVER_LOG_MESSAGES_ITEM									(SERVER_LOG_STATISTICS_PROPERTY->items + 1)
+#define SERVER_LOG_RATE_LIMITED_ITEM							(SERVER_LOG_STATISTICS_PROPERTY->items + 2)
+#define SERVER_LOG_OVERFLOWS_ITEM									(SERVER_LOG_STATISTICS_PROPERTY->items + 3)
+#define SERVER_LOG_SYNCHRONOUS_ITEM								(SERVER_LOG_STATISTICS_PROPERTY->items + 4)
+
+#define SERVER_IMAGE_POOL_PROPERTY								image_pool_property
+#define SERVER_IMAGE_POOL_BUDGET_ITEM							(SERVER_IMAGE_POOL_PROPERTY->items + 0)
+
+#define SERVER_IMAGE_POOL_STATISTICS_PROPERTY			image_pool_statistics_property
+#define SERVER_IMAGE_POOL_USED_ITEM								(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 0)
+#define SERVER_IMAGE_POOL_IDLE_ITEM								(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 1)
+#define SERVER_IMAGE_POOL_PEAK_ITEM								(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 2)
+#define SERVER_IMAGE_POOL_BUFFERS_ITEM						(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 3)
+#define SERVER_IMAGE_POOL_IDLE_BUFFERS_ITEM				(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 4)
+#define SERVER_IMAGE_POOL_ALLOCATIONS_ITEM				(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 5)
+#define SERVER_IMAGE_POOL_REUSES_ITEM							(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 6)
+#define SERVER_IMAGE_POOL_EVICTIONS_ITEM					(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 7)
+#define SERVER_IMAGE_POOL_OVER_BUDGET_ITEM				(SERVER_IMAGE_POOL_STATISTICS_PROPERTY->items + 8)
+
+#define SERVER_METRICS_PROPERTY										metrics_property
+#define MAX_METRICS_ITEMS													256
+
+#define SERVER_TRACING_PROPERTY										tracing_property
+#define SERVER_TRACING_DISABLED_ITEM							(SERVER_TRACING_PROPERTY->items + 0)
+#define SERVER_TRACING_ENABLED_ITEM								(SERVER_TRACING_PROPERTY->items + 1)
+
+#define SERVER_TRACE_DUMP_PROPERTY								trace_dump_property
+#define SERVER_TRACE_DUMP_ITEM										(SERVER_TRACE_DUMP_PROPERTY->items + 0)
+
+#define SERVER_TRACE_PROPERTY											trace_property
+#define SERVER_TRACE_ITEM													(SERVER_TRACE_PROPERTY->items + 0)
+
 #define SERVER_WIFI_AP_PROPERTY										wifi_ap_property
 #define SERVER_WIFI_AP_SSID_ITEM									(SERVER_WIFI_AP_PROPERTY->items + 0)
 #define SERVER_WIFI_AP_PASSWORD_ITEM							(SERVER_WIFI_AP_PROPERTY->items + 1)
@@ -391,6 +459,7 @@ static bool server_startup = true;
 static bool use_bonjour = true;
 static bool use_ctrl_panel = true;
 static bool use_web_apps = true;
+static bool use_async_log = true;
 
 #ifdef RPI_MANAGEMENT
 static bool use_rpi_management = false;
@@ -404,6 +473,103 @@ static indigo_result enumerate_properties(indigo_device *device, indigo_client *
 static indigo_result change_property(indigo_device *device, indigo_client *client, indigo_property *property);
 static indigo_result detach(indigo_device *device);
 
+static void get_bus_statistics(void) {
+	indigo_bus_statistics statistics;
+	indigo_get_bus_statistics(&statistics);
+	SERVER_BUS_BROADCASTS_ITEM->number.value = statistics.broadcasts;
+	SERVER_BUS_CONTENDED_ITEM->number.value = statistics.contended;
+	SERVER_BUS_CONCURRENT_ITEM->number.value = statistics.concurrent;
+	SERVER_BUS_MAX_CONCURRENT_ITEM->number.value = statistics.max_concurrent;
+	SERVER_BUS_TABLE_UPDATES_ITEM->number.value = statistics.table_updates;
+	SERVER_BUS_GRACE_WAITS_ITEM->number.value = statistics.grace_waits;
+	SERVER_BUS_GRACE_WAIT_TIME_ITEM->number.value = statistics.grace_wait_time;
+	SERVER_BUS_DEVICES_ITEM->number.value = statistics.devices;
+	SERVER_BUS_CLIENTS_ITEM->number.value = statistics.clients;
+}
+
+static void get_async_statistics(void) {
+	indigo_async_statistics statistics;
+	indigo_get_async_statistics(&statistics);
+	SERVER_ASYNC_POOL_SIZE_ITEM->number.value = statistics.pool_size;
+	SERVER_ASYNC_THREADS_ITEM->number.value = statistics.threads;
+	SERVER_ASYNC_BUSY_ITEM->number.value = statistics.busy;
+	SERVER_ASYNC_QUEUED_ITEM->number.value = statistics.queued;
+	SERVER_ASYNC_JOBS_ITEM->number.value = statistics.jobs;
+	SERVER_ASYNC_OVERFLOWS_ITEM->number.value = statistics.overflows;
+	SERVER_ASYNC_QUEUE_LATENCY_ITEM->number.value = statistics.queue_latency;
+	SERVER_ASYNC_MAX_QUEUE_LATENCY_ITEM->number.value = statistics.max_queue_latency;
+}
+
+static void get_log_statistics(void) {
+	indigo_log_statistics statistics;
+	indigo_get_log_statistics(&statistics);
+	SERVER_LOG_BUFFERS_ITEM->number.value = statistics.buffers;
+	SERVER_LOG_MESSAGES_ITEM->number.value = statistics.messages;
+	SERVER_LOG_RATE_LIMITED_ITEM->number.value = statistics.rate_limited;
+	SERVER_LOG_OVERFLOWS_ITEM->number.value = statistics.overflows;
+	SERVER_LOG_SYNCHRONOUS_ITEM->number.value = statistics.synchronous;
+}
+
+static void get_image_pool_statistics(void) {
+	indigo_image_pool_statistics statistics;
+	indigo_get_image_pool_statistics(&statistics);
+	SERVER_IMAGE_POOL_BUDGET_ITEM->number.value = statistics.budget / 1048576.0;
+	SERVER_IMAGE_POOL_USED_ITEM->number.value = statistics.used / 1048576.0;
+	SERVER_IMAGE_POOL_IDLE_ITEM->number.value = statistics.idle / 1048576.0;
+	SERVER_IMAGE_POOL_PEAK_ITEM->number.value = statistics.peak / 1048576.0;
+	SERVER_IMAGE_POOL_BUFFERS_ITEM->number.value = statistics.buffers;
+	SERVER_IMAGE_POOL_IDLE_BUFFERS_ITEM->number.value = statistics.idle_buffers;
+	SERVER_IMAGE_POOL_ALLOCATIONS_ITEM->number.value = statistics.allocations;
+	SERVER_IMAGE_POOL_REUSES_ITEM->number.value = statistics.reuses;
+	SERVER_IMAGE_POOL_EVICTIONS_ITEM->number.value = statistics.evictions;
+	SERVER_IMAGE_POOL_OVER_BUDGET_ITEM->number.value = statistics.over_budget;
+}
+
+static void metric_item(indigo_item *item, indigo_metric *metric, const char *suffix, const char *label_suffix, double value) {
+	char name[INDIGO_NAME_SIZE], label[INDIGO_VALUE_SIZE];
+	if (metric->label_name) {
+		snprintf(name, sizeof(name), "%s%s{%s}", metric->name, suffix, metric->label_value);
+		snprintf(label, sizeof(label), "%s%s (%s)", metric->help, label_suffix, metric->label_value);
+	} else {
+		snprintf(name, sizeof(name), "%s%s", metric->name, suffix);
+		snprintf(label, sizeof(label), "%s%s", metric->help, label_suffix);
+	}
+	for (char *c = name; *c; c++)
+		if (!isalnum(*c) && *c != '_' && *c != '{' && *c != '}')
+			*c = '_';
+	indigo_init_number_item(item, name, label, 0, 1e15, 0, value);
+}
+
+static void add_metric_items(indigo_metric *metric, void *data) {
+	indigo_property *property = (indigo_property *)data;
+	if (metric->type == INDIGO_METRIC_COUNTER) {
+		if (property->count < MAX_METRICS_ITEMS)
+			metric_item(property->items + property->count++, metric, "", "", metric->value);
+	} else if (property->count + 1 < MAX_METRICS_ITEMS) {
+		uint64_t count = metric->value;
+		metric_item(property->items + property->count++, metric, "_count", " count", count);
+		indigo_item *item = property->items + property->count++;
+		metric_item(item, metric, "_avg", " average (s)", count ? metric->sum / 1e9 / count : 0);
+		strcpy(item->number.format, "%.6f");
+	}
+}
+
+static bool get_metrics(void) {
+	// returns true if set of items changed and property has to be redefined
+	static char names[MAX_METRICS_ITEMS][INDIGO_NAME_SIZE];
+	int count = SERVER_METRICS_PROPERTY->count;
+	for (int i = 0; i < count; i++)
+		strcpy(names[i], SERVER_METRICS_PROPERTY->items[i].name);
+	SERVER_METRICS_PROPERTY->count = 0;
+	indigo_enumerate_metrics(add_metric_items, SERVER_METRICS_PROPERTY);
+	if (count != SERVER_METRICS_PROPERTY->count)
+		return true;
+	for (int i = 0; i < count; i++)
+		if (strcmp(names[i], SERVER_METRICS_PROPERTY->items[i].name))
+			return true;
+	return false;
+}
+
 static indigo_device server_device = INDIGO_DEVICE_INITIALIZER(
 	"Server",
 	attach,
@@ -545,6 +711,27 @@ static void check_versions(indigo_device *device) {
 
 #endif
 
+static void bus_statistics_timer_callback(indigo_device *device) {
+	// refreshed periodically in debug or trace log level only, otherwise on request
+	if (indigo_get_log_level() >= INDIGO_LOG_DEBUG) {
+		get_bus_statistics();
+		indigo_update_property(&server_device, SERVER_BUS_STATISTICS_PROPERTY, NULL);
+		get_async_statistics();
+		indigo_update_property(&server_device, SERVER_ASYNC_STATISTICS_PROPERTY, NULL);
+		get_log_statistics();
+		indigo_update_property(&server_device, SERVER_LOG_STATISTICS_PROPERTY, NULL);
+		get_image_pool_statistics();
+		indigo_update_property(&server_device, SERVER_IMAGE_POOL_STATISTICS_PROPERTY, NULL);
+		if (get_metrics()) {
+			indigo_delete_property(&server_device, SERVER_METRICS_PROPERTY, NULL);
+			indigo_define_property(&server_device, SERVER_METRICS_PROPERTY, NULL);
+		} else {
+			indigo_update_property(&server_device, SERVER_METRICS_PROPERTY, NULL);
+		}
+	}
+	indigo_reschedule_timer(NULL, 5, &bus_statistics_timer);
+}
+
 static indigo_result attach(indigo_device *device) {
 	assert(device != NULL);
 	SERVER_INFO_PROPERTY = indigo_init_text_property(NULL, server_device.name, SERVER_INFO_PROPERTY_NAME, MAIN_GROUP, "Server info", INDIGO_OK_STATE, INDIGO_RO_PERM, 2);
@@ -599,6 +786,59 @@ static indigo_result attach(indigo_device *device) {
 	indigo_init_switch_item(SERVER_BONJOUR_ITEM, SERVER_BONJOUR_ITEM_NAME, "Bonjour", use_bonjour);
 	indigo_init_switch_item(SERVER_CTRL_PANEL_ITEM, SERVER_CTRL_PANEL_ITEM_NAME, "Control panel / Server manager", use_ctrl_panel);
 	indigo_init_switch_item(SERVER_WEB_APPS_ITEM, SERVER_WEB_APPS_ITEM_NAME, "Web applications", use_web_apps);
+	SERVER_BUS_STATISTICS_PROPERTY = indigo_init_number_property(NULL, device->name, SERVER_BUS_STATISTICS_PROPERTY_NAME, "Debug", "Bus statistics", INDIGO_OK_STATE, INDIGO_RO_PERM, 9);
+	indigo_init_number_item(SERVER_BUS_BROADCASTS_ITEM, SERVER_BUS_BROADCASTS_ITEM_NAME, "Broadcasts", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_BUS_CONTENDED_ITEM, SERVER_BUS_CONTENDED_ITEM_NAME, "Table reference retries", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_BUS_CONCURRENT_ITEM, SERVER_BUS_CONCURRENT_ITEM_NAME, "Concurrent broadcasts", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_BUS_MAX_CONCURRENT_ITEM, SERVER_BUS_MAX_CONCURRENT_ITEM_NAME, "Max concurrent broadcasts", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_BUS_TABLE_UPDATES_ITEM, SERVER_BUS_TABLE_UPDATES_ITEM_NAME, "Attach/detach count", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_BUS_GRACE_WAITS_ITEM, SERVER_BUS_GRACE_WAITS_ITEM_NAME, "Detach waits", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_BUS_GRACE_WAIT_TIME_ITEM, SERVER_BUS_GRACE_WAIT_TIME_ITEM_NAME, "Detach wait time (s)", 0, 1e15, 0, 0);
+	strcpy(SERVER_BUS_GRACE_WAIT_TIME_ITEM->number.format, "%.6f");
+	indigo_init_number_item(SERVER_BUS_DEVICES_ITEM, SERVER_BUS_DEVICES_ITEM_NAME, "Attached devices", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_BUS_CLIENTS_ITEM, SERVER_BUS_CLIENTS_ITEM_NAME, "Attached clients", 0, 1e15, 0, 0);
+	SERVER_ASYNC_STATISTICS_PROPERTY = indigo_init_number_property(NULL, device->name, SERVER_ASYNC_STATISTICS_PROPERTY_NAME, "Debug", "Thread pool statistics", INDIGO_OK_STATE, INDIGO_RO_PERM, 8);
+	indigo_init_number_item(SERVER_ASYNC_POOL_SIZE_ITEM, SERVER_ASYNC_POOL_SIZE_ITEM_NAME, "Pool size", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_ASYNC_THREADS_ITEM, SERVER_ASYNC_THREADS_ITEM_NAME, "Threads", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_ASYNC_BUSY_ITEM, SERVER_ASYNC_BUSY_ITEM_NAME, "Busy threads", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_ASYNC_QUEUED_ITEM, SERVER_ASYNC_QUEUED_ITEM_NAME, "Queued jobs", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_ASYNC_JOBS_ITEM, SERVER_ASYNC_JOBS_ITEM_NAME, "Executed jobs", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_ASYNC_OVERFLOWS_ITEM, SERVER_ASYNC_OVERFLOWS_ITEM_NAME, "Threads over pool size", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_ASYNC_QUEUE_LATENCY_ITEM, SERVER_ASYNC_QUEUE_LATENCY_ITEM_NAME, "Average queue latency (s)", 0, 1e15, 0, 0);
+	strcpy(SERVER_ASYNC_QUEUE_LATENCY_ITEM->number.format, "%.6f");
+	indigo_init_number_item(SERVER_ASYNC_MAX_QUEUE_LATENCY_ITEM, SERVER_ASYNC_MAX_QUEUE_LATENCY_ITEM_NAME, "Max queue latency (s)", 0, 1e15, 0, 0);
+	strcpy(SERVER_ASYNC_MAX_QUEUE_LATENCY_ITEM->number.format, "%.6f");
+	SERVER_LOG_STATISTICS_PROPERTY = indigo_init_number_property(NULL, device->name, SERVER_LOG_STATISTICS_PROPERTY_NAME, "Debug", "Log statistics", INDIGO_OK_STATE, INDIGO_RO_PERM, 5);
+	indigo_init_number_item(SERVER_LOG_BUFFERS_ITEM, SERVER_LOG_BUFFERS_ITEM_NAME, "Thread buffers", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_LOG_MESSAGES_ITEM, SERVER_LOG_MESSAGES_ITEM_NAME, "Buffered messages", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_LOG_RATE_LIMITED_ITEM, SERVER_LOG_RATE_LIMITED_ITEM_NAME, "Dropped by rate limiter", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_LOG_OVERFLOWS_ITEM, SERVER_LOG_OVERFLOWS_ITEM_NAME, "Dropped on full buffer", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_LOG_SYNCHRONOUS_ITEM, SERVER_LOG_SYNCHRONOUS_ITEM_NAME, "Written synchronously", 0, 1e15, 0, 0);
+	SERVER_IMAGE_POOL_PROPERTY = indigo_init_number_property(NULL, device->name, SERVER_IMAGE_POOL_PROPERTY_NAME, MAIN_GROUP, "Image buffer pool", INDIGO_OK_STATE, INDIGO_RW_PERM, 1);
+	indigo_init_number_item(SERVER_IMAGE_POOL_BUDGET_ITEM, SERVER_IMAGE_POOL_BUDGET_ITEM_NAME, "Memory budget (MB, 0 = half of RAM)", 0, 1e9, 64, 0);
+	SERVER_IMAGE_POOL_STATISTICS_PROPERTY = indigo_init_number_property(NULL, device->name, SERVER_IMAGE_POOL_STATISTICS_PROPERTY_NAME, "Debug", "Image buffer pool statistics", INDIGO_OK_STATE, INDIGO_RO_PERM, 9);
+	indigo_init_number_item(SERVER_IMAGE_POOL_USED_ITEM, SERVER_IMAGE_POOL_USED_ITEM_NAME, "Buffers in use (MB)", 0, 1e15, 0, 0);
+	strcpy(SERVER_IMAGE_POOL_USED_ITEM->number.format, "%.1f");
+	indigo_init_number_item(SERVER_IMAGE_POOL_IDLE_ITEM, SERVER_IMAGE_POOL_IDLE_ITEM_NAME, "Idle buffers (MB)", 0, 1e15, 0, 0);
+	strcpy(SERVER_IMAGE_POOL_IDLE_ITEM->number.format, "%.1f");
+	indigo_init_number_item(SERVER_IMAGE_POOL_PEAK_ITEM, SERVER_IMAGE_POOL_PEAK_ITEM_NAME, "Peak size (MB)", 0, 1e15, 0, 0);
+	strcpy(SERVER_IMAGE_POOL_PEAK_ITEM->number.format, "%.1f");
+	indigo_init_number_item(SERVER_IMAGE_POOL_BUFFERS_ITEM, SERVER_IMAGE_POOL_BUFFERS_ITEM_NAME, "Buffers in use", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_IMAGE_POOL_IDLE_BUFFERS_ITEM, SERVER_IMAGE_POOL_IDLE_BUFFERS_ITEM_NAME, "Idle buffers", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_IMAGE_POOL_ALLOCATIONS_ITEM, SERVER_IMAGE_POOL_ALLOCATIONS_ITEM_NAME, "Requests", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_IMAGE_POOL_REUSES_ITEM, SERVER_IMAGE_POOL_REUSES_ITEM_NAME, "Requests served by idle buffer", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_IMAGE_POOL_EVICTIONS_ITEM, SERVER_IMAGE_POOL_EVICTIONS_ITEM_NAME, "Idle buffers released", 0, 1e15, 0, 0);
+	indigo_init_number_item(SERVER_IMAGE_POOL_OVER_BUDGET_ITEM, SERVER_IMAGE_POOL_OVER_BUDGET_ITEM_NAME, "Requests over budget", 0, 1e15, 0, 0);
+	SERVER_METRICS_PROPERTY = indigo_init_number_property(NULL, device->name, SERVER_METRICS_PROPERTY_NAME, "Debug", "Metrics", INDIGO_OK_STATE, INDIGO_RO_PERM, MAX_METRICS_ITEMS);
+	SERVER_METRICS_PROPERTY->count = 0;
+	SERVER_TRACING_PROPERTY = indigo_init_switch_property(NULL, device->name, SERVER_TRACING_PROPERTY_NAME, "Debug", "Event tracing", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
+	indigo_init_switch_item(SERVER_TRACING_DISABLED_ITEM, SERVER_TRACING_DISABLED_ITEM_NAME, "Disabled", !indigo_use_tracing);
+	indigo_init_switch_item(SERVER_TRACING_ENABLED_ITEM, SERVER_TRACING_ENABLED_ITEM_NAME, "Enabled", indigo_use_tracing);
+	SERVER_TRACE_DUMP_PROPERTY = indigo_init_switch_property(NULL, device->name, SERVER_TRACE_DUMP_PROPERTY_NAME, "Debug", "Dump trace", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_AT_MOST_ONE_RULE, 1);
+	indigo_init_switch_item(SERVER_TRACE_DUMP_ITEM, SERVER_TRACE_DUMP_ITEM_NAME, "Dump", false);
+	SERVER_TRACE_PROPERTY = indigo_init_blob_property(NULL, device->name, SERVER_TRACE_PROPERTY_NAME, "Debug", "Trace (Chrome trace format)", INDIGO_OK_STATE, 1);
+	indigo_init_blob_item(SERVER_TRACE_ITEM, SERVER_TRACE_ITEM_NAME, "Trace data");
+	indigo_set_timer(NULL, 5, bus_statistics_timer_callback, &bus_statistics_timer);
 #ifdef RPI_MANAGEMENT
 	if (use_rpi_management) {
 		char *line;
@@ -641,7 +881,7 @@ static indigo_result attach(indigo_device *device) {
 		indigo_init_switch_item(SERVER_SHUTDOWN_ITEM, SERVER_SHUTDOWN_ITEM_NAME, "Shutdown", false);
 		SERVER_REBOOT_PROPERTY = indigo_init_switch_property(NULL, server_device.name, SERVER_REBOOT_PROPERTY_NAME, MAIN_GROUP, "Reboot host computer", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ANY_OF_MANY_RULE, 1);
 		indigo_init_switch_item(SERVER_REBOOT_ITEM, SERVER_REBOOT_ITEM_NAME, "Reboot", false);
-		indigo_async((void *(*)(void *))check_versions, device);
+		indigo_start_thread((void *(*)(void *))check_versions, device);
 	}
 #endif /* RPI_MANAGEMENT */
 	indigo_log_levels log_level = indigo_get_log_level();
@@ -678,6 +918,21 @@ static indigo_result enumerate_properties(indigo_device *device, indigo_client *
 	indigo_define_property(device, SERVER_BLOB_BUFFERING_PROPERTY, NULL);
 	indigo_define_property(device, SERVER_BLOB_PROXY_PROPERTY, NULL);
 	indigo_define_property(device, SERVER_FEATURES_PROPERTY, NULL);
+	get_bus_statistics();
+	indigo_define_property(device, SERVER_BUS_STATISTICS_PROPERTY, NULL);
+	get_async_statistics();
+	indigo_define_property(device, SERVER_ASYNC_STATISTICS_PROPERTY, NULL);
+	get_log_statistics();
+	indigo_define_property(device, SERVER_LOG_STATISTICS_PROPERTY, NULL);
+	get_image_pool_statistics();
+	indigo_define_property(device, SERVER_IMAGE_POOL_PROPERTY, NULL);
+	indigo_define_property(device, SERVER_IMAGE_POOL_STATISTICS_PROPERTY, NULL);
+	if (get_metrics())
+		indigo_delete_property(device, SERVER_METRICS_PROPERTY, NULL);
+	indigo_define_property(device, SERVER_METRICS_PROPERTY, NULL);
+	indigo_define_property(device, SERVER_TRACING_PROPERTY, NULL);
+	indigo_define_property(device, SERVER_TRACE_DUMP_PROPERTY, NULL);
+	indigo_define_property(device, SERVER_TRACE_PROPERTY, NULL);
 #ifdef RPI_MANAGEMENT
 	if (use_rpi_management) {
 		indigo_define_property(device, SERVER_WIFI_AP_PROPERTY, NULL);
@@ -883,6 +1138,15 @@ static indigo_result change_property(indigo_device *device, indigo_client *clien
 		SERVER_BLOB_BUFFERING_PROPERTY->state = INDIGO_OK_STATE;
 		indigo_update_property(device, SERVER_BLOB_BUFFERING_PROPERTY, NULL);
 		return INDIGO_OK;
+	} else if (indigo_property_match(SERVER_IMAGE_POOL_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- SERVER_IMAGE_POOL
+		indigo_property_copy_values(SERVER_IMAGE_POOL_PROPERTY, property, false);
+		indigo_set_image_pool_budget((long)SERVER_IMAGE_POOL_BUDGET_ITEM->number.value * 1048576);
+		get_image_pool_statistics();
+		SERVER_IMAGE_POOL_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, SERVER_IMAGE_POOL_PROPERTY, NULL);
+		indigo_update_property(device, SERVER_IMAGE_POOL_STATISTICS_PROPERTY, NULL);
+		return INDIGO_OK;
 	} else if (indigo_property_match(SERVER_BLOB_PROXY_PROPERTY, property)) {
 		// -------------------------------------------------------------------------------- SERVER_BLOB_PROXY
 		indigo_property_copy_values(SERVER_BLOB_PROXY_PROPERTY, property, false);
@@ -890,6 +1154,32 @@ static indigo_result change_property(indigo_device *device, indigo_client *clien
 		SERVER_BLOB_PROXY_PROPERTY->state = INDIGO_OK_STATE;
 		indigo_update_property(device, SERVER_BLOB_PROXY_PROPERTY, NULL);
 		return INDIGO_OK;
+	} else if (indigo_property_match(SERVER_TRACING_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- SERVER_TRACING
+		indigo_property_copy_values(SERVER_TRACING_PROPERTY, property, false);
+		indigo_enable_tracing(SERVER_TRACING_ENABLED_ITEM->sw.value);
+		SERVER_TRACING_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, SERVER_TRACING_PROPERTY, NULL);
+		return INDIGO_OK;
+	} else if (indigo_property_match(SERVER_TRACE_DUMP_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- SERVER_TRACE_DUMP
+		indigo_property_copy_values(SERVER_TRACE_DUMP_PROPERTY, property, false);
+		if (SERVER_TRACE_DUMP_ITEM->sw.value) {
+			// previous trace is kept until the next dump as it can still be downloaded
+			static void *previous_trace = NULL;
+			long length;
+			indigo_safe_free(previous_trace);
+			previous_trace = SERVER_TRACE_ITEM->blob.value;
+			SERVER_TRACE_ITEM->blob.value = indigo_tracing_json(&length);
+			SERVER_TRACE_ITEM->blob.size = length;
+			strcpy(SERVER_TRACE_ITEM->blob.format, ".json");
+			SERVER_TRACE_PROPERTY->state = INDIGO_OK_STATE;
+			indigo_update_property(device, SERVER_TRACE_PROPERTY, NULL);
+			SERVER_TRACE_DUMP_ITEM->sw.value = false;
+		}
+		SERVER_TRACE_DUMP_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, SERVER_TRACE_DUMP_PROPERTY, NULL);
+		return INDIGO_OK;
 #ifdef RPI_MANAGEMENT
 	} else if (indigo_property_match(SERVER_WIFI_AP_PROPERTY, property)) {
 		// -------------------------------------------------------------------------------- WIFI_AP
@@ -945,6 +1235,16 @@ static indigo_result detach(indigo_device *device) {
 	indigo_delete_property(device, SERVER_BLOB_BUFFERING_PROPERTY, NULL);
 	indigo_delete_property(device, SERVER_BLOB_PROXY_PROPERTY, NULL);
 	indigo_delete_property(device, SERVER_FEATURES_PROPERTY, NULL);
+	indigo_cancel_timer_sync(NULL, &bus_statistics_timer);
+	indigo_delete_property(device, SERVER_BUS_STATISTICS_PROPERTY, NULL);
+	indigo_delete_property(device, SERVER_ASYNC_STATISTICS_PROPERTY, NULL);
+	indigo_delete_property(device, SERVER_LOG_STATISTICS_PROPERTY, NULL);
+	indigo_delete_property(device, SERVER_IMAGE_POOL_PROPERTY, NULL);
+	indigo_delete_property(device, SERVER_IMAGE_POOL_STATISTICS_PROPERTY, NULL);
+	indigo_delete_property(device, SERVER_METRICS_PROPERTY, NULL);
+	indigo_delete_property(device, SERVER_TRACING_PROPERTY, NULL);
+	indigo_delete_property(device, SERVER_TRACE_DUMP_PROPERTY, NULL);
+	indigo_delete_property(device, SERVER_TRACE_PROPERTY, NULL);
 #ifdef RPI_MANAGEMENT
 	if (use_rpi_management) {
 		indigo_delete_property(device, SERVER_WIFI_AP_PROPERTY, NULL);
@@ -966,6 +1266,16 @@ static indigo_result detach(indigo_device *device) {
 	indigo_release_property(SERVER_BLOB_BUFFERING_PROPERTY);
 	indigo_release_property(SERVER_BLOB_PROXY_PROPERTY);
 	indigo_release_property(SERVER_FEATURES_PROPERTY);
+	indigo_release_property(SERVER_BUS_STATISTICS_PROPERTY);
+	indigo_release_property(SERVER_ASYNC_STATISTICS_PROPERTY);
+	indigo_release_property(SERVER_LOG_STATISTICS_PROPERTY);
+	indigo_release_property(SERVER_IMAGE_POOL_PROPERTY);
+	indigo_release_property(SERVER_IMAGE_POOL_STATISTICS_PROPERTY);
+	indigo_release_property(SERVER_METRICS_PROPERTY);
+	indigo_release_property(SERVER_TRACING_PROPERTY);
+	indigo_release_property(SERVER_TRACE_DUMP_PROPERTY);
+	indigo_safe_free(SERVER_TRACE_ITEM->blob.value);
+	indigo_release_property(SERVER_TRACE_PROPERTY);
 #ifdef RPI_MANAGEMENT
 	indigo_release_property(SERVER_WIFI_AP_PROPERTY);
 	indigo_release_property(SERVER_WIFI_INFRASTRUCTURE_PROPERTY);
@@ -1049,16 +1359,40 @@ static void server_main() {
 	indigo_start();
 	indigo_log("INDIGO server %d.%d-%s built on %s %s", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD, __DATE__, __TIME__);
 
-	/* Make sure master token and ACL are loaded before drivers */
+	/* Make sure master token, ACL and remote server protocol are set before drivers and remote servers */
 	for (int i = 1; i < server_argc; i++) {
 		if ((!strcmp(server_argv[i], "-T") || !strcmp(server_argv[i], "--master-token")) && i < server_argc - 1) {
 			indigo_set_master_token(indigo_string_to_token(server_argv[i + 1]));
 			i++;
+		} else if (!strcmp(server_argv[i], "-B") || !strcmp(server_argv[i], "--use-binary-protocol")) {
+			indigo_use_binary_protocol = true;
+		} else if (!strcmp(server_argv[i], "-D") || !strcmp(server_argv[i], "--use-delta-updates")) {
+			indigo_use_delta_updates = true;
 		} else if ((!strcmp(server_argv[i], "-a") || !strcmp(server_argv[i], "--acl-file")) && i < server_argc - 1) {
 			indigo_load_device_tokens_from_file(server_argv[i + 1]);
 			i++;
+		} else if ((!strcmp(server_argv[i], "-t") || !strcmp(server_argv[i], "--async-threads")) && i < server_argc - 1) {
+			indigo_async_pool_size = atoi(server_argv[i + 1]);
+			i++;
+		} else if ((!strcmp(server_argv[i], "-m") || !strcmp(server_argv[i], "--image-pool-budget")) && i < server_argc - 1) {
+			indigo_set_image_pool_budget(atol(server_argv[i + 1]) * 1048576);
+			i++;
+		} else if (!strcmp(server_argv[i], "-H") || !strcmp(server_argv[i], "--use-huge-pages")) {
+			indigo_image_pool_huge_pages = true;
+		} else if (!strcmp(server_argv[i], "-L-") || !strcmp(server_argv[i], "--disable-async-log")) {
+			use_async_log = false;
+		} else if ((!strcmp(server_argv[i], "-R") || !strcmp(server_argv[i], "--log-rate-limit")) && i < server_argc - 1) {
+			indigo_log_rate_limit = atoi(server_argv[i + 1]);
+			i++;
+		} else if (!strcmp(server_argv[i], "-M-") || !strcmp(server_argv[i], "--disable-metrics")) {
+			indigo_use_metrics = false;
+		} else if ((!strcmp(server_argv[i], "-P") || !strcmp(server_argv[i], "--trace-buffer")) && i < server_argc - 1) {
+			indigo_tracing_buffer_size = atoi(server_argv[i + 1]);
+			indigo_enable_tracing(true);
+			i++;
 		}
 	}
+	indigo_use_async_log = use_async_log;
 	for (int i = 1; i < server_argc; i++) {
 		if ((!strcmp(server_argv[i], "-p") || !strcmp(server_argv[i], "--port")) && i < server_argc - 1) {
 			indigo_server_tcp_port = atoi(server_argv[i + 1]);
@@ -1087,6 +1421,24 @@ static void server_main() {
 		} else if ((!strcmp(server_argv[i], "-a") || !strcmp(server_argv[i], "--acl-file")) && i < server_argc - 1) {
 			/* just skip it - handled above */
 			i++;
+		} else if ((!strcmp(server_argv[i], "-t") || !strcmp(server_argv[i], "--async-threads")) && i < server_argc - 1) {
+			/* just skip it - handled above */
+			i++;
+		} else if ((!strcmp(server_argv[i], "-m") || !strcmp(server_argv[i], "--image-pool-budget")) && i < server_argc - 1) {
+			/* just skip it - handled above */
+			i++;
+		} else if (!strcmp(server_argv[i], "-H") || !strcmp(server_argv[i], "--use-huge-pages")) {
+			/* just skip it - handled above */
+		} else if (!strcmp(server_argv[i], "-L-") || !strcmp(server_argv[i], "--disable-async-log")) {
+			/* just skip it - handled above */
+		} else if ((!strcmp(server_argv[i], "-R") || !strcmp(server_argv[i], "--log-rate-limit")) && i < server_argc - 1) {
+			/* just skip it - handled above */
+			i++;
+		} else if (!strcmp(server_argv[i], "-M-") || !strcmp(server_argv[i], "--disable-metrics")) {
+			/* just skip it - handled above */
+		} else if ((!strcmp(server_argv[i], "-P") || !strcmp(server_argv[i], "--trace-buffer")) && i < server_argc - 1) {
+			/* just skip it - handled above */
+			i++;
 		} else if (!strcmp(server_argv[i], "-b-") || !strcmp(server_argv[i], "--disable-bonjour")) {
 			use_bonjour = false;
 		} else if (!strcmp(server_argv[i], "-b") || !strcmp(server_argv[i], "--bonjour")) {
@@ -1123,6 +1475,10 @@ static void server_main() {
 		}
 	}
 
+	if (indigo_use_metrics)
+		indigo_server_add_generated_resource("/metrics", indigo_metrics_resource_generator, indigo_metrics_resource_release, "text/plain; version=0.0.4");
+	indigo_server_add_generated_resource("/trace.json", indigo_tracing_resource_generator, indigo_metrics_resource_release, "application/json");
+
 	use_ctrl_panel |= use_web_apps;
 
 	if (use_ctrl_panel) {
@@ -1235,9 +1591,9 @@ static void server_main() {
 			#include "resource/data/planets.json.data"
 		};
 		indigo_server_add_resource("/data/planets.json", planets_json, sizeof(planets_json), "application/json; charset=utf-8");
-		star_data = indigo_add_star_json_resource(6);
-		dso_data = indigo_add_dso_json_resource(10);
-		constellation_data = indigo_add_constellations_lines_json_resource();
+		indigo_add_star_json_resource(6);
+		indigo_add_dso_json_resource(10);
+		indigo_add_constellations_lines_json_resource();
 		// INDIGO Guider
 		static unsigned char guider_html[] = {
 			#include "resource/guider.html.data"
@@ -1282,7 +1638,7 @@ static void server_main() {
 	indigo_server_start(server_callback);
 #endif
 #ifdef INDIGO_MACOS
-	if (!indigo_async((void * (*)(void *))indigo_server_start, server_callback)) {
+	if (!indigo_start_thread((void * (*)(void *))indigo_server_start, server_callback)) {
 		INDIGO_ERROR(indigo_error("Error creating thread for server"));
 	}
 	runLoop = true;
@@ -1308,12 +1664,7 @@ static void server_main() {
 	indigo_detach_device(&server_device);
 	indigo_stop();
 	indigo_server_remove_resources();
-	if (star_data)
-		free(star_data);
-	if (dso_data)
-		free(dso_data);
-	if (constellation_data)
-		free(constellation_data);
+	indigo_free_json_resources();
 	for (int i = 0; i < INDIGO_MAX_SERVERS; i++) {
 		if (indigo_available_servers[i].thread_started)
 			indigo_disconnect_server(&indigo_available_servers[i]);
@@ -1367,10 +1718,17 @@ int main(int argc, const char * argv[]) {
 			printf("options:\n"
 			       "       --  | --do-not-fork\n"
 			       "       -l  | --use-syslog\n"
+			       "       -L- | --disable-async-log\n"
+			       "       -R  | --log-rate-limit count          (debug and trace messages per second and thread, default: 0 = unlimited)\n"
+			       "       -M- | --disable-metrics\n"
+			       "       -P  | --trace-buffer count            (enable event tracing to ring of given size, default: disabled)\n"
 			       "       -p  | --port port                     (default: 7624)\n"
 			       "       -b  | --bonjour name                  (default: hostname)\n"
 			       "       -T  | --master-token token            (master token for devce access default: 0 = none)\n"
 			       "       -a  | --acl-file file\n"
+			       "       -t  | --async-threads count           (default: 0 = twice the number of CPU cores)\n"
+			       "       -m  | --image-pool-budget MB          (image buffer pool memory budget, default: 0 = half of RAM)\n"
+			       "       -H  | --use-huge-pages                (back large image buffers with huge pages)\n"
 			       "       -b- | --disable-bonjour\n"
 			       "       -u- | --disable-blob-urls\n"
 			       "       -d  | --enable-blob-buffering\n"
@@ -1383,6 +1741,8 @@ int main(int argc, const char * argv[]) {
 			       "       -vv | --enable-debug\n"
 			       "       -vvv| --enable-trace\n"
 			       "       -r  | --remote-server host[:port]     (default port: 7624)\n"
+			       "       -B  | --use-binary-protocol           (for remote servers)\n"
+			       "       -D  | --use-delta-updates             (for remote servers)\n"
 			       "       -x  | --enable-blob-proxy\n"
 			       "       -i  | --indi-driver driver_executable\n"
 			);
@@ -0,0 +1,197 @@
+// Copyright (c) 2018 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO wire protocol bandwidth benchmark
+ \file indigo_delta_bench.c
+
+ Replays one minute of guiding traffic (guider statistics, guiding pulses, exposure countdown and mount coordinates)
+ through XML, JSON and binary device adapters with and without delta updates and prints bytes per minute as JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <pthread.h>
+
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_names.h>
+#include <indigo/indigo_driver_xml.h>
+#include <indigo/indigo_client_xml.h>
+#include <indigo/indigo_driver_json.h>
+#include <indigo/indigo_driver_binary.h>
+
+#define SECONDS		60
+
+static indigo_device device = { "Guider Agent" };
+static indigo_property *stats_property;
+static indigo_property *exposure_property;
+static indigo_property *guide_dec_property;
+static indigo_property *guide_ra_property;
+static indigo_property *coordinates_property;
+
+typedef struct {
+	int handle;
+	long total;
+} drain_context;
+
+static void *drain(drain_context *context) {
+	char buffer[16 * 1024];
+	long length;
+	while ((length = read(context->handle, buffer, sizeof(buffer))) > 0)
+		context->total += length;
+	return NULL;
+}
+
+static void init_properties(void) {
+	stats_property = indigo_init_number_property(NULL, device.name, AGENT_GUIDER_STATS_PROPERTY_NAME, "Guider", "Stats", INDIGO_OK_STATE, INDIGO_RO_PERM, 15);
+	indigo_init_number_item(stats_property->items + 0, AGENT_GUIDER_STATS_PHASE_ITEM_NAME, "Phase", -1, 100, 0, 0);
+	indigo_init_number_item(stats_property->items + 1, AGENT_GUIDER_STATS_FRAME_ITEM_NAME, "Frame", -1, 0xFFFFFFFF, 0, 0);
+	indigo_init_number_item(stats_property->items + 2, AGENT_GUIDER_STATS_REFERENCE_X_ITEM_NAME, "Reference X", 0, 100000, 0, 512.25);
+	indigo_init_number_item(stats_property->items + 3, AGENT_GUIDER_STATS_REFERENCE_Y_ITEM_NAME, "Reference Y", 0, 100000, 0, 384.75);
+	indigo_init_number_item(stats_property->items + 4, AGENT_GUIDER_STATS_DRIFT_X_ITEM_NAME, "Drift X", -1000, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 5, AGENT_GUIDER_STATS_DRIFT_Y_ITEM_NAME, "Drift Y", -1000, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 6, AGENT_GUIDER_STATS_DRIFT_RA_ITEM_NAME, "Drift RA", -1000, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 7, AGENT_GUIDER_STATS_DRIFT_DEC_ITEM_NAME, "Drift Dec", -1000, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 8, AGENT_GUIDER_STATS_CORR_RA_ITEM_NAME, "Correction RA", -1000, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 9, AGENT_GUIDER_STATS_CORR_DEC_ITEM_NAME, "Correction Dec", -1000, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 10, AGENT_GUIDER_STATS_RMSE_RA_ITEM_NAME, "RMSE RA", 0, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 11, AGENT_GUIDER_STATS_RMSE_DEC_ITEM_NAME, "RMSE Dec", 0, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 12, AGENT_GUIDER_STATS_SNR_ITEM_NAME, "SNR", 0, 1000, 0, 0);
+	indigo_init_number_item(stats_property->items + 13, AGENT_GUIDER_STATS_DELAY_ITEM_NAME, "Delay", 0, 100, 0, 0);
+	indigo_init_number_item(stats_property->items + 14, AGENT_GUIDER_STATS_DITHERING_ITEM_NAME, "Dithering", 0, 100, 0, 0);
+	exposure_property = indigo_init_number_property(NULL, device.name, CCD_EXPOSURE_PROPERTY_NAME, "Camera", "Start exposure", INDIGO_OK_STATE, INDIGO_RW_PERM, 1);
+	indigo_init_number_item(exposure_property->items, CCD_EXPOSURE_ITEM_NAME, "Start exposure", 0, 10000, 1, 0);
+	guide_dec_property = indigo_init_number_property(NULL, device.name, GUIDER_GUIDE_DEC_PROPERTY_NAME, "Guider", "DEC guiding", INDIGO_OK_STATE, INDIGO_RW_PERM, 2);
+	indigo_init_number_item(guide_dec_property->items + 0, GUIDER_GUIDE_NORTH_ITEM_NAME, "Guide north", 0, 10000, 1, 0);
+	indigo_init_number_item(guide_dec_property->items + 1, GUIDER_GUIDE_SOUTH_ITEM_NAME, "Guide south", 0, 10000, 1, 0);
+	guide_ra_property = indigo_init_number_property(NULL, device.name, GUIDER_GUIDE_RA_PROPERTY_NAME, "Guider", "RA guiding", INDIGO_OK_STATE, INDIGO_RW_PERM, 2);
+	indigo_init_number_item(guide_ra_property->items + 0, GUIDER_GUIDE_EAST_ITEM_NAME, "Guide east", 0, 10000, 1, 0);
+	indigo_init_number_item(guide_ra_property->items + 1, GUIDER_GUIDE_WEST_ITEM_NAME, "Guide west", 0, 10000, 1, 0);
+	coordinates_property = indigo_init_number_property(NULL, device.name, MOUNT_EQUATORIAL_COORDINATES_PROPERTY_NAME, "Mount", "Coordinates", INDIGO_OK_STATE, INDIGO_RW_PERM, 2);
+	indigo_init_number_item(coordinates_property->items + 0, MOUNT_EQUATORIAL_COORDINATES_RA_ITEM_NAME, "RA", 0, 24, 0, 5.58813);
+	indigo_init_number_item(coordinates_property->items + 1, MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM_NAME, "Dec", -90, 90, 0, -5.39111);
+}
+
+static void replay(indigo_client *client) {
+	srand(1);
+	client->define_property(client, &device, stats_property, NULL);
+	client->define_property(client, &device, exposure_property, NULL);
+	client->define_property(client, &device, guide_dec_property, NULL);
+	client->define_property(client, &device, guide_ra_property, NULL);
+	client->define_property(client, &device, coordinates_property, NULL);
+	double rmse_ra = 0, rmse_dec = 0;
+	for (int frame = 1; frame <= SECONDS; frame++) {
+		// exposure start and countdown
+		exposure_property->state = INDIGO_BUSY_STATE;
+		exposure_property->items[0].number.target = exposure_property->items[0].number.value = 1;
+		client->update_property(client, &device, exposure_property, NULL);
+		exposure_property->state = INDIGO_OK_STATE;
+		exposure_property->items[0].number.value = 0;
+		client->update_property(client, &device, exposure_property, NULL);
+		// guiding statistics
+		double drift_ra = (rand() % 2001 - 1000) / 2000.0;
+		double drift_dec = (rand() % 2001 - 1000) / 4000.0;
+		rmse_ra = sqrt((rmse_ra * rmse_ra * (frame - 1) + drift_ra * drift_ra) / frame);
+		rmse_dec = sqrt((rmse_dec * rmse_dec * (frame - 1) + drift_dec * drift_dec) / frame);
+		stats_property->items[0].number.value = 5;
+		stats_property->items[1].number.value = frame;
+		stats_property->items[4].number.value = drift_ra * 0.8 + drift_dec * 0.6;
+		stats_property->items[5].number.value = drift_dec * 0.8 - drift_ra * 0.6;
+		stats_property->items[6].number.value = drift_ra;
+		stats_property->items[7].number.value = drift_dec;
+		stats_property->items[8].number.value = -drift_ra * 0.7;
+		stats_property->items[9].number.value = fabs(drift_dec) > 0.1 ? -drift_dec * 0.7 : 0;
+		stats_property->items[10].number.value = round(rmse_ra * 1000) / 1000;
+		stats_property->items[11].number.value = round(rmse_dec * 1000) / 1000;
+		stats_property->items[12].number.value = 40 + rand() % 5;
+		client->update_property(client, &device, stats_property, NULL);
+		// guiding pulses
+		int ra_pulse = (int)(fabs(drift_ra) * 700);
+		guide_ra_property->state = INDIGO_BUSY_STATE;
+		guide_ra_property->items[drift_ra > 0 ? 1 : 0].number.value = ra_pulse;
+		client->update_property(client, &device, guide_ra_property, NULL);
+		guide_ra_property->state = INDIGO_OK_STATE;
+		guide_ra_property->items[0].number.value = guide_ra_property->items[1].number.value = 0;
+		client->update_property(client, &device, guide_ra_property, NULL);
+		if (stats_property->items[9].number.value != 0) {
+			int dec_pulse = (int)(fabs(drift_dec) * 700);
+			guide_dec_property->state = INDIGO_BUSY_STATE;
+			guide_dec_property->items[drift_dec > 0 ? 1 : 0].number.value = dec_pulse;
+			client->update_property(client, &device, guide_dec_property, NULL);
+			guide_dec_property->state = INDIGO_OK_STATE;
+			guide_dec_property->items[0].number.value = guide_dec_property->items[1].number.value = 0;
+			client->update_property(client, &device, guide_dec_property, NULL);
+		}
+		// tracking mount reports position twice a second, declination changes with guiding pulses only
+		for (int i = 0; i < 2; i++) {
+			if (i == 0 && stats_property->items[9].number.value != 0)
+				coordinates_property->items[1].number.value += stats_property->items[9].number.value / 3600.0;
+			client->update_property(client, &device, coordinates_property, NULL);
+		}
+	}
+	client->delete_property(client, &device, stats_property, NULL);
+}
+
+static long measure(const char *protocol, bool delta) {
+	int handles[2];
+	if (pipe(handles) < 0)
+		return -1;
+	indigo_client *client;
+	if (!strcmp(protocol, "xml"))
+		client = indigo_xml_device_adapter(handles[1], handles[1]);
+	else if (!strcmp(protocol, "json"))
+		client = indigo_json_device_adapter(handles[1], handles[1], false);
+	else
+		client = indigo_binary_device_adapter(handles[1], handles[1]);
+	client->version = INDIGO_VERSION_CURRENT;
+	((indigo_adapter_context *)client->client_context)->delta_updates = delta;
+	drain_context context = { handles[0], 0 };
+	pthread_t thread;
+	pthread_create(&thread, NULL, (void *(*)(void *))drain, &context);
+	replay(client);
+	close(handles[1]);
+	pthread_join(thread, NULL);
+	close(handles[0]);
+	if (!strcmp(protocol, "xml"))
+		indigo_release_xml_device_adapter(client);
+	else if (!strcmp(protocol, "json"))
+		indigo_release_json_device_adapter(client);
+	else
+		indigo_release_binary_device_adapter(client);
+	return context.total;
+}
+
+int main(int argc, const char * argv[]) {
+	static const char *protocols[] = { "xml", "json", "binary" };
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	init_properties();
+	printf("[\n");
+	for (int i = 0; i < 3; i++) {
+		long full = measure(protocols[i], false);
+		long delta = measure(protocols[i], true);
+		printf("  { \"protocol\": \"%s\", \"full_bytes_per_minute\": %ld, \"delta_bytes_per_minute\": %ld, \"saving\": %.3f }%s\n", protocols[i], full * 60 / SECONDS, delta * 60 / SECONDS, full > 0 ? 1.0 - (double)delta / full : 0, i < 2 ? "," : "");
+	}
+	printf("]\n");
+	return 0;
+}
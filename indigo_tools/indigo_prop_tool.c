@@ -35,6 +35,7 @@
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_client.h>
 #include <indigo/indigo_xml.h>
+#include <indigo/indigo_image_pool.h>
 
 #define INDIGO_DEFAULT_PORT 7624
 #define REMINDER_MAX_SIZE 2048
@@ -372,7 +373,7 @@ void print_property_list(indigo_property *property, const char *message) {
 					snprintf(filename, PATH_MAX, "%s.%s.%s%s", property->device, property->name, item->name, item->blob.format);
 					printf("%s.%s.%s = <%s => %s>\n", property->device, property->name, item->name, item->blob.url, filename);
 					save_blob(filename, item->blob.value, item->blob.size);
-					free(item->blob.value);
+					indigo_release_image_buffer(item->blob.value);
 					item->blob.value = NULL;
 				} else {
 					INDIGO_ERROR(indigo_error("Can not retrieve data from %s", item->blob.url));
@@ -458,7 +459,7 @@ static void print_property_get_filtered(indigo_property *property, const char *m
 						snprintf(filename, PATH_MAX, "%s.%s.%s%s", property->device, property->name, item->name, item->blob.format);
 						sprintf(value_string[items_found], "file://%s/%s", getcwd(NULL, 0), filename);
 						save_blob(filename, item->blob.value, item->blob.size);
-						free(item->blob.value);
+						indigo_release_image_buffer(item->blob.value);
 						item->blob.value = NULL;
 					} else {
 						INDIGO_ERROR(indigo_error("Can not retrieve data from %s", item->blob.url));
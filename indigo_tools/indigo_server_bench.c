@@ -0,0 +1,937 @@
+// Copyright (c) 2018 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// version history
+// 2.0 by Peter Polakovic <peter.polakovic@cloudmakers.eu>
+
+/** INDIGO end-to-end server throughput benchmark
+ \file indigo_server_bench.c
+
+ Starts in-process server with CCD and mount simulators, connects synthetic XML, JSON and JSON-over-WebSocket clients
+ over TCP and drives exposure, streaming and guiding workloads. Every image or guiding pulse published on the bus
+ is time stamped by local observer and matched with its arrival (including BLOB download) in each remote client.
+ Results (throughput, latency percentiles, CPU time and RSS) are printed as JSON, no hardware is needed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_client.h>
+#include <indigo/indigo_server_tcp.h>
+
+#include "ccd_simulator/indigo_ccd_simulator.h"
+#include "mount_simulator/indigo_mount_simulator.h"
+
+#define MAX_CLIENTS		64
+#define MAX_EVENTS		100000
+#define MAX_FORMATS		8
+#define TIMEOUT				30
+#define FINGERPRINT_HEAD	4096
+#define FINGERPRINT_SAMPLES	4096
+
+#define XML_PROTOCOL	0
+#define JSON_PROTOCOL	1
+#define WS_PROTOCOL		2
+
+static const char *protocol_names[] = { "xml", "json", "ws" };
+
+typedef struct {
+	int index;
+	int protocol;
+	int socket;
+	pthread_t thread;
+	clockid_t cpu_clock;
+	char *buffer;
+	long buffer_size, buffer_used;
+	char *blob;
+	long blob_size;
+	bool pending_blob;
+	bool pending_binary;
+	long messages, bytes, markers, blobs, blob_bytes, errors;
+	double *latency;
+	long latency_count;
+	long matched;
+} bench_client;
+
+typedef struct {
+	unsigned long key;
+	double time;
+} bench_event;
+
+typedef struct {
+	const char *device;
+	const char *name;
+	indigo_property_state state;
+	long serial;
+} bench_watch;
+
+static bench_client clients[MAX_CLIENTS];
+static int client_count = 0;
+static int clients_per_protocol[3] = { 2, 2, 2 };
+static int frames = 50;
+static int sensor_width = 0, sensor_height = 0;
+static const char *generator = "MONO";
+static const char *formats[MAX_FORMATS] = { "FITS", "XISF", "RAW", "JPEG" };
+static int format_count = 4;
+static bool run_exposure = true, run_streaming = true, run_guiding = true;
+static int server_port = 0;
+
+static pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bench_cond = PTHREAD_COND_INITIALIZER;
+static bool server_ready = false;
+
+// marker is the property update (Ok state) matched between local observer and remote clients by its key,
+// BLOB fingerprint for images or pulse sequence number for guiding, state is guarded by bench_mutex
+
+static char marker_xml[256], marker_json[256];
+static const char *marker_device, *marker_name;
+static bool marker_blob;
+static long marker_generation;
+static unsigned long marker_sequence;
+static bench_event published[MAX_EVENTS];
+static long published_count;
+
+static bench_watch watches[] = {
+	{ CCD_SIMULATOR_IMAGER_CAMERA_NAME, CONNECTION_PROPERTY_NAME },
+	{ CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_EXPOSURE_PROPERTY_NAME },
+	{ CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_STREAMING_PROPERTY_NAME },
+	{ CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_IMAGE_FORMAT_PROPERTY_NAME },
+	{ CCD_SIMULATOR_GUIDER_NAME, CONNECTION_PROPERTY_NAME },
+	{ CCD_SIMULATOR_GUIDER_NAME, GUIDER_GUIDE_RA_PROPERTY_NAME },
+	{ MOUNT_SIMULATOR_NAME, CONNECTION_PROPERTY_NAME },
+	{ NULL }
+};
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_time(clockid_t clock) {
+	struct timespec ts;
+	if (clock_gettime(clock, &ts))
+		return 0;
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long rss_kb(void) {
+	long pages = 0, resident = 0;
+	FILE *file = fopen("/proc/self/statm", "r");
+	if (file) {
+		if (fscanf(file, "%ld %ld", &pages, &resident) != 2)
+			resident = 0;
+		fclose(file);
+	}
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void set_marker(const char *device, const char *name, bool blob) {
+	pthread_mutex_lock(&bench_mutex);
+	marker_device = device;
+	marker_name = name;
+	marker_blob = blob;
+	if (device) {
+		snprintf(marker_xml, sizeof(marker_xml), "device='%s' name='%s' state='Ok'", device, name);
+		snprintf(marker_json, sizeof(marker_json), "\"device\": \"%s\", \"name\": \"%s\", \"state\": \"Ok\"", device, name);
+	}
+	marker_generation++;
+	marker_sequence = 0;
+	published_count = 0;
+	for (int i = 0; i < client_count; i++) {
+		bench_client *client = clients + i;
+		client->messages = client->bytes = client->markers = client->blobs = client->blob_bytes = client->errors = 0;
+		client->latency_count = client->matched = 0;
+		client->pending_blob = client->pending_binary = false;
+	}
+	pthread_mutex_unlock(&bench_mutex);
+}
+
+static void set_marker_sequence(unsigned long sequence) {
+	pthread_mutex_lock(&bench_mutex);
+	marker_sequence = sequence;
+	pthread_mutex_unlock(&bench_mutex);
+}
+
+static long published_markers(void) {
+	pthread_mutex_lock(&bench_mutex);
+	long count = published_count;
+	pthread_mutex_unlock(&bench_mutex);
+	return count;
+}
+
+// FNV-1a of BLOB size, header and evenly spaced samples, simulator noise makes it unique for each frame
+
+static unsigned long blob_fingerprint(const void *data, long size) {
+	const unsigned char *bytes = data;
+	unsigned long hash = 14695981039346656037UL ^ size;
+	long head = size < FINGERPRINT_HEAD ? size : FINGERPRINT_HEAD, step = size / FINGERPRINT_SAMPLES + 1;
+	for (long i = 0; i < head; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211UL;
+	for (long i = head; i < size; i += step)
+		hash = (hash ^ bytes[i]) * 1099511628211UL;
+	return hash;
+}
+
+// -------------------------------------------------------------------------------- synthetic remote clients
+
+static int open_socket(void) {
+	int handle = socket(AF_INET, SOCK_STREAM, 0);
+	if (handle < 0)
+		return -1;
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(server_port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(handle, (struct sockaddr *)&address, sizeof(address)) < 0) {
+		close(handle);
+		return -1;
+	}
+	int value = 1;
+	setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+	return handle;
+}
+
+static bool write_all(int handle, const void *data, long length) {
+	while (length > 0) {
+		long written = send(handle, data, length, MSG_NOSIGNAL);
+		if (written <= 0)
+			return false;
+		data = (const char *)data + written;
+		length -= written;
+	}
+	return true;
+}
+
+static bool ws_send_text(int handle, const char *text) {
+	unsigned char header[8];
+	long length = strlen(text), header_length;
+	unsigned char mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+	header[0] = 0x81;
+	if (length < 126) {
+		header[1] = 0x80 | length;
+		header_length = 2;
+	} else {
+		header[1] = 0x80 | 126;
+		header[2] = (length >> 8) & 0xFF;
+		header[3] = length & 0xFF;
+		header_length = 4;
+	}
+	memcpy(header + header_length, mask, 4);
+	header_length += 4;
+	char *payload = indigo_safe_malloc(length);
+	for (long i = 0; i < length; i++)
+		payload[i] = text[i] ^ mask[i & 3];
+	bool result = write_all(handle, header, header_length) && write_all(handle, payload, length);
+	free(payload);
+	return result;
+}
+
+// called with bench_mutex locked, markers are delivered in order so the search starts after the last match
+
+static void record_marker(bench_client *client, unsigned long key) {
+	double time = now();
+	client->markers++;
+	for (long i = client->matched; i < published_count; i++) {
+		if (published[i].key == key) {
+			if (client->latency_count < MAX_EVENTS)
+				client->latency[client->latency_count++] = time - published[i].time;
+			client->matched = i + 1;
+			break;
+		}
+	}
+}
+
+// returns BLOB size or -1 on failure
+
+static long download_blob(bench_client *client, const char *request) {
+	int handle = open_socket();
+	if (handle < 0)
+		return -1;
+	if (!write_all(handle, request, strlen(request))) {
+		close(handle);
+		return -1;
+	}
+	char header[4096];
+	long header_length = 0, content_length = -1;
+	while (header_length < sizeof(header) - 1) {
+		if (recv(handle, header + header_length, 1, 0) != 1)
+			break;
+		header_length++;
+		if (header_length >= 4 && !strncmp(header + header_length - 4, "\r\n\r\n", 4))
+			break;
+	}
+	header[header_length] = 0;
+	char *length = strstr(header, "Content-Length:");
+	if (strncmp(header, "HTTP/1.1 200", 12) || length == NULL || (content_length = atol(length + 15)) < 0) {
+		close(handle);
+		return -1;
+	}
+	if (client->blob_size < content_length) {
+		client->blob = indigo_safe_realloc(client->blob, content_length);
+		client->blob_size = content_length;
+	}
+	long received = 0;
+	while (received < content_length) {
+		long bytes = recv(handle, client->blob + received, content_length - received, 0);
+		if (bytes <= 0)
+			break;
+		received += bytes;
+	}
+	close(handle);
+	return received == content_length ? received : -1;
+}
+
+// called with bench_mutex locked, the lock is released for the download
+
+static void fetch_blob(bench_client *client, const char *path) {
+	long generation = marker_generation;
+	char request[512];
+	snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+	pthread_mutex_unlock(&bench_mutex);
+	long received = download_blob(client, request);
+	unsigned long key = received < 0 ? 0 : blob_fingerprint(client->blob, received);
+	pthread_mutex_lock(&bench_mutex);
+	if (generation != marker_generation)
+		return;
+	if (received < 0) {
+		client->errors++;
+	} else {
+		client->blobs++;
+		client->blob_bytes += received;
+		record_marker(client, key);
+	}
+}
+
+static void process_xml_line(bench_client *client, char *line) {
+	if (*line != '<')
+		return;
+	if (!strncmp(line, "<set", 4) || !strncmp(line, "<def", 4) || !strncmp(line, "<del", 4) || !strncmp(line, "<message", 8)) {
+		client->messages++;
+		if (!strncmp(line, "<set", 4) && strstr(line, marker_xml)) {
+			if (marker_blob)
+				client->pending_blob = true;
+			else
+				record_marker(client, marker_sequence);
+		}
+	} else if (client->pending_blob && !strncmp(line, "<oneBLOB", 8)) {
+		client->pending_blob = false;
+		char *path = strstr(line, "path='");
+		if (path) {
+			path += 6;
+			char *end = strchr(path, '\'');
+			if (end) {
+				*end = 0;
+				fetch_blob(client, path);
+				return;
+			}
+		}
+		client->errors++;
+	}
+}
+
+static void process_json_message(bench_client *client, char *message) {
+	client->messages++;
+	if (strncmp(message, "{ \"set", 6) || strstr(message, marker_json) == NULL)
+		return;
+	if (!marker_blob) {
+		record_marker(client, marker_sequence);
+	} else if (strstr(message, "\"binary\": true")) {
+		client->pending_binary = true;
+	} else {
+		char *path = strstr(message, "\"value\": \"/blob/");
+		if (path) {
+			path += 10;
+			char *end = strchr(path, '"');
+			if (end) {
+				*end = 0;
+				fetch_blob(client, path);
+				return;
+			}
+		}
+		client->errors++;
+	}
+}
+
+// consumes complete messages from client buffer, returns number of processed bytes, called with bench_mutex locked
+
+static long process_buffer(bench_client *client) {
+	char *buffer = client->buffer;
+	long used = client->buffer_used, start = 0;
+	if (client->protocol == XML_PROTOCOL) {
+		for (long i = 0; i < used; i++) {
+			if (buffer[i] == '\n') {
+				buffer[i] = 0;
+				process_xml_line(client, buffer + start);
+				start = i + 1;
+			}
+		}
+	} else if (client->protocol == JSON_PROTOCOL) {
+		int depth = 0;
+		bool string = false, escape = false;
+		for (long i = 0; i < used; i++) {
+			char c = buffer[i];
+			if (string) {
+				if (escape)
+					escape = false;
+				else if (c == '\\')
+					escape = true;
+				else if (c == '"')
+					string = false;
+			} else if (c == '"') {
+				string = true;
+			} else if (c == '{') {
+				if (depth++ == 0)
+					start = i;
+			} else if (c == '}' && --depth == 0) {
+				char saved = buffer[i + 1];
+				buffer[i + 1] = 0;
+				process_json_message(client, buffer + start);
+				buffer[i + 1] = saved;
+				start = i + 1;
+			}
+		}
+		if (depth == 0)
+			start = used;
+	} else {
+		while (used - start >= 2) {
+			unsigned char *frame = (unsigned char *)buffer + start;
+			int opcode = frame[0] & 0x0F;
+			long length = frame[1] & 0x7F, header_length = 2;
+			if (length == 126) {
+				if (used - start < 4)
+					break;
+				length = (frame[2] << 8) | frame[3];
+				header_length = 4;
+			} else if (length == 127) {
+				if (used - start < 10)
+					break;
+				length = 0;
+				for (int i = 2; i < 10; i++)
+					length = (length << 8) | frame[i];
+				header_length = 10;
+			}
+			if (used - start < header_length + length)
+				break;
+			char *payload = (char *)frame + header_length;
+			if (opcode == 1) {
+				char saved = payload[length];
+				payload[length] = 0;
+				process_json_message(client, payload);
+				payload[length] = saved;
+			} else if (opcode == 2 && client->pending_binary) {
+				client->pending_binary = false;
+				client->blobs++;
+				client->blob_bytes += length;
+				record_marker(client, blob_fingerprint(payload, length));
+			}
+			start += header_length + length;
+		}
+	}
+	return start;
+}
+
+static void *client_thread(bench_client *client) {
+	char request[1024];
+	if (client->protocol == XML_PROTOCOL) {
+		snprintf(request, sizeof(request), "<getProperties version='2.0' client='Benchmark XML %d'/>\n<enableBLOB device='%s' name='%s'>URL</enableBLOB>\n", client->index, CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_IMAGE_PROPERTY_NAME);
+		write_all(client->socket, request, strlen(request));
+	} else if (client->protocol == JSON_PROTOCOL) {
+		snprintf(request, sizeof(request), "{ \"getProperties\": { \"version\": 512, \"client\": \"Benchmark JSON %d\" } }\n{ \"enableBLOB\": { \"device\": \"%s\", \"name\": \"%s\", \"value\": \"URL\" } }\n", client->index, CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_IMAGE_PROPERTY_NAME);
+		write_all(client->socket, request, strlen(request));
+	} else {
+		snprintf(request, sizeof(request), "GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+		write_all(client->socket, request, strlen(request));
+		int length = 0;
+		while (length < sizeof(request) - 1 && recv(client->socket, request + length, 1, 0) == 1) {
+			length++;
+			if (length >= 4 && !strncmp(request + length - 4, "\r\n\r\n", 4))
+				break;
+		}
+		request[length] = 0;
+		if (strncmp(request, "HTTP/1.1 101", 12)) {
+			indigo_error("WebSocket client %d: upgrade failed", client->index);
+			return NULL;
+		}
+		snprintf(request, sizeof(request), "{ \"getProperties\": { \"version\": 512, \"client\": \"Benchmark WS %d\" } }", client->index);
+		ws_send_text(client->socket, request);
+		snprintf(request, sizeof(request), "{ \"enableBLOB\": { \"device\": \"%s\", \"name\": \"%s\", \"value\": \"Also\" } }", CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_IMAGE_PROPERTY_NAME);
+		ws_send_text(client->socket, request);
+	}
+	while (true) {
+		if (client->buffer_size - client->buffer_used < 64 * 1024) {
+			client->buffer_size *= 2;
+			client->buffer = indigo_safe_realloc(client->buffer, client->buffer_size);
+		}
+		long bytes = recv(client->socket, client->buffer + client->buffer_used, client->buffer_size - client->buffer_used - 1, 0);
+		if (bytes <= 0)
+			break;
+		client->buffer_used += bytes;
+		pthread_mutex_lock(&bench_mutex);
+		client->bytes += bytes;
+		long processed = process_buffer(client);
+		pthread_mutex_unlock(&bench_mutex);
+		if (processed > 0) {
+			memmove(client->buffer, client->buffer + processed, client->buffer_used - processed);
+			client->buffer_used -= processed;
+		}
+	}
+	return NULL;
+}
+
+static bool start_clients(void) {
+	for (int protocol = 0; protocol < 3; protocol++) {
+		for (int i = 0; i < clients_per_protocol[protocol] && client_count < MAX_CLIENTS; i++) {
+			bench_client *client = clients + client_count;
+			client->index = client_count++;
+			client->protocol = protocol;
+			client->socket = open_socket();
+			if (client->socket < 0) {
+				indigo_error("Can't connect to server (%s)", strerror(errno));
+				return false;
+			}
+			client->buffer_size = 256 * 1024;
+			client->buffer = indigo_safe_malloc(client->buffer_size);
+			client->latency = indigo_safe_malloc(MAX_EVENTS * sizeof(double));
+			pthread_create(&client->thread, NULL, (void * (*)(void *))client_thread, client);
+			pthread_getcpuclockid(client->thread, &client->cpu_clock);
+		}
+	}
+	return true;
+}
+
+static void stop_clients(void) {
+	for (int i = 0; i < client_count; i++)
+		shutdown(clients[i].socket, SHUT_RDWR);
+	for (int i = 0; i < client_count; i++) {
+		pthread_join(clients[i].thread, NULL);
+		close(clients[i].socket);
+		indigo_safe_free(clients[i].buffer);
+		indigo_safe_free(clients[i].blob);
+		indigo_safe_free(clients[i].latency);
+	}
+}
+
+// -------------------------------------------------------------------------------- local observer and controller
+
+static void observe(indigo_property *property) {
+	pthread_mutex_lock(&bench_mutex);
+	for (bench_watch *watch = watches; watch->device; watch++) {
+		if (!strcmp(watch->device, property->device) && !strcmp(watch->name, property->name)) {
+			watch->state = property->state;
+			watch->serial++;
+			pthread_cond_broadcast(&bench_cond);
+		}
+	}
+	if (marker_device && property->state == INDIGO_OK_STATE && !strcmp(marker_device, property->device) && !strcmp(marker_name, property->name) && published_count < MAX_EVENTS) {
+		bench_event *event = published + published_count++;
+		event->time = now();
+		if (marker_blob)
+			event->key = property->items->blob.value ? blob_fingerprint(property->items->blob.value, property->items->blob.size) : 0;
+		else
+			event->key = marker_sequence;
+	}
+	pthread_mutex_unlock(&bench_mutex);
+}
+
+static indigo_result bench_attach(indigo_client *client) {
+	indigo_enumerate_properties(client, &INDIGO_ALL_PROPERTIES);
+	return INDIGO_OK;
+}
+
+static indigo_result bench_define_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	observe(property);
+	return INDIGO_OK;
+}
+
+static indigo_result bench_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	observe(property);
+	return INDIGO_OK;
+}
+
+static indigo_client bench_client_instance = {
+	"Benchmark", false, NULL, INDIGO_OK, INDIGO_VERSION_CURRENT, NULL,
+	bench_attach,
+	bench_define_property,
+	bench_update_property,
+	NULL,
+	NULL,
+	NULL
+};
+
+static bench_watch *find_watch(const char *device, const char *name) {
+	for (bench_watch *watch = watches; watch->device; watch++)
+		if (!strcmp(watch->device, device) && !strcmp(watch->name, name))
+			return watch;
+	return NULL;
+}
+
+static long watch_serial(bench_watch *watch) {
+	pthread_mutex_lock(&bench_mutex);
+	long serial = watch->serial;
+	pthread_mutex_unlock(&bench_mutex);
+	return serial;
+}
+
+// waits for update after serial with given state, alert state terminates the wait
+
+static bool wait_for(bench_watch *watch, long serial, indigo_property_state state) {
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += TIMEOUT;
+	bool result = false;
+	pthread_mutex_lock(&bench_mutex);
+	while (true) {
+		if (watch->serial > serial && (watch->state == state || watch->state == INDIGO_ALERT_STATE)) {
+			result = watch->state == state;
+			break;
+		}
+		if (pthread_cond_timedwait(&bench_cond, &bench_mutex, &deadline) == ETIMEDOUT)
+			break;
+	}
+	pthread_mutex_unlock(&bench_mutex);
+	if (!result)
+		indigo_error("%s.%s: %s", watch->device, watch->name, watch->state == INDIGO_ALERT_STATE ? "failed" : "timeout");
+	return result;
+}
+
+static bool connect_device(const char *device) {
+	bench_watch *watch = find_watch(device, CONNECTION_PROPERTY_NAME);
+	long serial = watch_serial(watch);
+	indigo_device_connect(&bench_client_instance, (char *)device);
+	return wait_for(watch, serial, INDIGO_OK_STATE);
+}
+
+static void disconnect_device(const char *device) {
+	bench_watch *watch = find_watch(device, CONNECTION_PROPERTY_NAME);
+	long serial = watch_serial(watch);
+	indigo_device_disconnect(&bench_client_instance, (char *)device);
+	wait_for(watch, serial, INDIGO_OK_STATE);
+}
+
+static void change_switch(const char *device, const char *property, const char *item) {
+	const char *items[] = { item };
+	bool values[] = { true };
+	indigo_change_switch_property(&bench_client_instance, device, property, 1, items, values);
+}
+
+// waits until remote clients receive everything published or until they stop making progress
+
+static void drain_clients(long expected) {
+	long last = -1;
+	double stalled = now();
+	while (true) {
+		long delivered = 0;
+		pthread_mutex_lock(&bench_mutex);
+		for (int i = 0; i < client_count; i++)
+			delivered += clients[i].markers;
+		pthread_mutex_unlock(&bench_mutex);
+		if (delivered >= expected * client_count)
+			break;
+		if (delivered != last) {
+			last = delivered;
+			stalled = now();
+		} else if (now() - stalled > 5) {
+			break;
+		}
+		indigo_usleep(10000);
+	}
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double da = *(double *)a, db = *(double *)b;
+	return da < db ? -1 : da > db ? 1 : 0;
+}
+
+static void print_percentiles(double *values, long count) {
+	if (count == 0) {
+		printf("{ \"count\": 0 }");
+		return;
+	}
+	qsort(values, count, sizeof(double), compare_doubles);
+	printf("{ \"count\": %ld, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f }", count, values[count / 2] * 1000, values[count * 90 / 100] * 1000, values[count * 99 / 100] * 1000, values[count - 1] * 1000);
+}
+
+typedef struct {
+	double time, process_cpu, clients_cpu[MAX_CLIENTS];
+} bench_sample;
+
+static void take_sample(bench_sample *sample) {
+	sample->time = now();
+	sample->process_cpu = cpu_time(CLOCK_PROCESS_CPUTIME_ID);
+	for (int i = 0; i < client_count; i++)
+		sample->clients_cpu[i] = cpu_time(clients[i].cpu_clock);
+}
+
+static bool first_result = true;
+
+static void report(const char *workload, const char *format, bench_sample *start, bench_sample *end) {
+	double duration = end->time - start->time;
+	double clients_cpu = 0;
+	for (int i = 0; i < client_count; i++)
+		clients_cpu += end->clients_cpu[i] - start->clients_cpu[i];
+	double process_cpu = end->process_cpu - start->process_cpu;
+	pthread_mutex_lock(&bench_mutex);
+	long messages = 0, bytes = 0, delivered = 0, blob_bytes = 0, errors = 0, latency_count = 0;
+	for (int i = 0; i < client_count; i++) {
+		messages += clients[i].messages;
+		bytes += clients[i].bytes;
+		delivered += clients[i].markers;
+		blob_bytes += clients[i].blob_bytes;
+		errors += clients[i].errors;
+		latency_count += clients[i].latency_count;
+	}
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	printf("%s    { \"workload\": \"%s\"", first_result ? "" : ",\n", workload);
+	first_result = false;
+	if (format)
+		printf(", \"format\": \"%s\"", format);
+	printf(", \"duration\": %.3f, \"published\": %ld, \"published_per_second\": %.1f", duration, published_count, published_count / duration);
+	printf(", \"delivered\": %ld, \"delivered_per_second\": %.1f, \"errors\": %ld", delivered, delivered / duration, errors);
+	printf(", \"messages_per_second\": %.1f, \"protocol_bytes_per_second\": %.0f, \"blob_bytes_per_second\": %.0f", messages / duration, bytes / duration, blob_bytes / duration);
+	printf(", \"server_cpu\": %.3f, \"clients_cpu\": %.3f, \"rss_kb\": %ld, \"max_rss_kb\": %ld", process_cpu - clients_cpu, clients_cpu, rss_kb(), (long)usage.ru_maxrss);
+	double *latency = indigo_safe_malloc((latency_count + 1) * sizeof(double));
+	printf(",\n      \"latency_ms\": ");
+	long count = 0;
+	for (int i = 0; i < client_count; i++) {
+		memcpy(latency + count, clients[i].latency, clients[i].latency_count * sizeof(double));
+		count += clients[i].latency_count;
+	}
+	print_percentiles(latency, count);
+	for (int protocol = 0; protocol < 3; protocol++) {
+		if (clients_per_protocol[protocol] == 0)
+			continue;
+		count = 0;
+		delivered = 0;
+		for (int i = 0; i < client_count; i++) {
+			if (clients[i].protocol == protocol) {
+				memcpy(latency + count, clients[i].latency, clients[i].latency_count * sizeof(double));
+				count += clients[i].latency_count;
+				delivered += clients[i].markers;
+			}
+		}
+		printf(",\n      \"%s\": { \"delivered_per_second\": %.1f, \"latency_ms\": ", protocol_names[protocol], delivered / duration);
+		print_percentiles(latency, count);
+		printf(" }");
+	}
+	printf(" }");
+	fflush(stdout);
+	pthread_mutex_unlock(&bench_mutex);
+	free(latency);
+}
+
+static void exposure_workload(const char *format) {
+	bench_watch *watch = find_watch(CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_EXPOSURE_PROPERTY_NAME);
+	bench_sample start, end;
+	set_marker(CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_IMAGE_PROPERTY_NAME, true);
+	take_sample(&start);
+	for (int i = 0; i < frames; i++) {
+		long serial = watch_serial(watch);
+		static const char *items[] = { CCD_EXPOSURE_ITEM_NAME };
+		static double values[] = { 0.001 };
+		indigo_change_number_property(&bench_client_instance, CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_EXPOSURE_PROPERTY_NAME, 1, items, values);
+		if (!wait_for(watch, serial, INDIGO_OK_STATE))
+			break;
+	}
+	drain_clients(published_markers());
+	take_sample(&end);
+	report("exposure", format, &start, &end);
+}
+
+static void streaming_workload(const char *format) {
+	bench_watch *watch = find_watch(CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_STREAMING_PROPERTY_NAME);
+	bench_sample start, end;
+	set_marker(CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_IMAGE_PROPERTY_NAME, true);
+	take_sample(&start);
+	long serial = watch_serial(watch);
+	static const char *items[] = { CCD_STREAMING_EXPOSURE_ITEM_NAME, CCD_STREAMING_COUNT_ITEM_NAME };
+	double values[] = { 0.001, frames };
+	indigo_change_number_property(&bench_client_instance, CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_STREAMING_PROPERTY_NAME, 2, items, values);
+	wait_for(watch, serial, INDIGO_OK_STATE);
+	drain_clients(published_markers());
+	take_sample(&end);
+	report("streaming", format, &start, &end);
+}
+
+static void guiding_workload(void) {
+	bench_watch *watch = find_watch(CCD_SIMULATOR_GUIDER_NAME, GUIDER_GUIDE_RA_PROPERTY_NAME);
+	bench_sample start, end;
+	set_marker(CCD_SIMULATOR_GUIDER_NAME, GUIDER_GUIDE_RA_PROPERTY_NAME, false);
+	// slewing mount adds coordinate updates to the traffic
+	static const char *coordinates[] = { MOUNT_EQUATORIAL_COORDINATES_RA_ITEM_NAME, MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM_NAME };
+	static double target[] = { 5.5, 45 };
+	indigo_change_number_property(&bench_client_instance, MOUNT_SIMULATOR_NAME, MOUNT_EQUATORIAL_COORDINATES_PROPERTY_NAME, 2, coordinates, target);
+	take_sample(&start);
+	for (int i = 0; i < 10 * frames; i++) {
+		long serial = watch_serial(watch);
+		set_marker_sequence(i + 1);
+		const char *items[] = { i & 1 ? GUIDER_GUIDE_EAST_ITEM_NAME : GUIDER_GUIDE_WEST_ITEM_NAME };
+		double values[] = { 10 };
+		indigo_change_number_property(&bench_client_instance, CCD_SIMULATOR_GUIDER_NAME, GUIDER_GUIDE_RA_PROPERTY_NAME, 1, items, values);
+		if (!wait_for(watch, serial, INDIGO_OK_STATE))
+			break;
+		// next pulse would change property state before Ok state is written to all remote clients
+		drain_clients(i + 1);
+	}
+	drain_clients(published_markers());
+	take_sample(&end);
+	report("guiding", NULL, &start, &end);
+}
+
+static void server_callback(int count) {
+	pthread_mutex_lock(&bench_mutex);
+	server_ready = true;
+	pthread_cond_broadcast(&bench_cond);
+	pthread_mutex_unlock(&bench_mutex);
+}
+
+static void *server_thread(void *data) {
+	indigo_server_start(server_callback);
+	return NULL;
+}
+
+static int split(char *value, const char **list, int max) {
+	int count = 0;
+	for (char *token = strtok(value, ","); token && count < max; token = strtok(NULL, ","))
+		list[count++] = token;
+	return count;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [options]\n", name);
+	fprintf(stderr, "       -c  | --clients xml,json,ws      (number of clients per protocol, default 2,2,2)\n");
+	fprintf(stderr, "       -n  | --frames count             (frames per workload, guiding uses 10 x count 10ms pulses, default 50)\n");
+	fprintf(stderr, "       -f  | --formats list             (image formats, default FITS,XISF,RAW,JPEG)\n");
+	fprintf(stderr, "       -w  | --workloads list           (exposure,streaming,guiding, default all)\n");
+	fprintf(stderr, "       -s  | --sensor WIDTHxHEIGHT      (synthetic sensor size, default built-in 1600x1200 image)\n");
+	fprintf(stderr, "       -g  | --generator MONO|RGB|BAYER (synthetic image type, default MONO)\n");
+	fprintf(stderr, "       -v  | --enable-info\n");
+}
+
+int main(int argc, const char * argv[]) {
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	indigo_set_log_level(INDIGO_LOG_ERROR);
+	static char buffer[1024];
+	for (int i = 1; i < argc; i++) {
+		if ((!strcmp(argv[i], "-c") || !strcmp(argv[i], "--clients")) && i < argc - 1) {
+			const char *counts[3] = { "0", "0", "0" };
+			strncpy(buffer, argv[++i], sizeof(buffer) - 1);
+			split(buffer, counts, 3);
+			for (int j = 0; j < 3; j++)
+				clients_per_protocol[j] = atoi(counts[j]);
+		} else if ((!strcmp(argv[i], "-n") || !strcmp(argv[i], "--frames")) && i < argc - 1) {
+			frames = atoi(argv[++i]);
+		} else if ((!strcmp(argv[i], "-f") || !strcmp(argv[i], "--formats")) && i < argc - 1) {
+			format_count = split(strdup(argv[++i]), formats, MAX_FORMATS);
+		} else if ((!strcmp(argv[i], "-w") || !strcmp(argv[i], "--workloads")) && i < argc - 1) {
+			const char *value = argv[++i];
+			run_exposure = strstr(value, "exposure") != NULL;
+			run_streaming = strstr(value, "streaming") != NULL;
+			run_guiding = strstr(value, "guiding") != NULL;
+		} else if ((!strcmp(argv[i], "-s") || !strcmp(argv[i], "--sensor")) && i < argc - 1) {
+			if (sscanf(argv[++i], "%dx%d", &sensor_width, &sensor_height) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((!strcmp(argv[i], "-g") || !strcmp(argv[i], "--generator")) && i < argc - 1) {
+			generator = argv[++i];
+		} else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--enable-info")) {
+			indigo_set_log_level(INDIGO_LOG_INFO);
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (frames <= 0 || frames > MAX_EVENTS / 10) {
+		usage(argv[0]);
+		return 1;
+	}
+	indigo_start();
+	indigo_attach_client(&bench_client_instance);
+	indigo_ccd_simulator(INDIGO_DRIVER_INIT, NULL);
+	indigo_mount_simulator(INDIGO_DRIVER_INIT, NULL);
+	indigo_server_tcp_port = 0;
+	pthread_t server;
+	pthread_create(&server, NULL, server_thread, NULL);
+	pthread_mutex_lock(&bench_mutex);
+	while (!server_ready)
+		pthread_cond_wait(&bench_cond, &bench_mutex);
+	pthread_mutex_unlock(&bench_mutex);
+	server_port = indigo_server_tcp_port;
+	if (sensor_width > 0) {
+		change_switch(CCD_SIMULATOR_IMAGER_CAMERA_NAME, "IMAGER_GENERATOR", generator);
+		static const char *items[] = { "WIDTH", "HEIGHT" };
+		double values[] = { sensor_width, sensor_height };
+		indigo_change_number_property(&bench_client_instance, CCD_SIMULATOR_IMAGER_CAMERA_NAME, "IMAGER_GENERATOR_SETUP", 2, items, values);
+	}
+	if (!start_clients() || !connect_device(CCD_SIMULATOR_IMAGER_CAMERA_NAME) || !connect_device(CCD_SIMULATOR_GUIDER_NAME) || !connect_device(MOUNT_SIMULATOR_NAME)) {
+		indigo_error("Failed to start benchmark");
+		return 1;
+	}
+	change_switch(CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_UPLOAD_MODE_PROPERTY_NAME, CCD_UPLOAD_MODE_CLIENT_ITEM_NAME);
+	change_switch(CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_PREVIEW_PROPERTY_NAME, CCD_PREVIEW_DISABLED_ITEM_NAME);
+	change_switch(MOUNT_SIMULATOR_NAME, MOUNT_PARK_PROPERTY_NAME, MOUNT_PARK_UNPARKED_ITEM_NAME);
+	// let clients process initial definitions
+	indigo_usleep(ONE_SECOND_DELAY);
+	int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	printf("{\n  \"config\": { \"xml_clients\": %d, \"json_clients\": %d, \"ws_clients\": %d, \"frames\": %d, \"sensor\": \"%s\", \"cpus\": %d },\n  \"results\": [\n", clients_per_protocol[0], clients_per_protocol[1], clients_per_protocol[2], frames, sensor_width > 0 ? generator : "DEFAULT", cpus);
+	for (int i = 0; i < format_count; i++) {
+		if (!run_exposure && !run_streaming)
+			break;
+		bench_watch *watch = find_watch(CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_IMAGE_FORMAT_PROPERTY_NAME);
+		long serial = watch_serial(watch);
+		change_switch(CCD_SIMULATOR_IMAGER_CAMERA_NAME, CCD_IMAGE_FORMAT_PROPERTY_NAME, formats[i]);
+		if (!wait_for(watch, serial, INDIGO_OK_STATE))
+			continue;
+		if (run_exposure)
+			exposure_workload(formats[i]);
+		if (run_streaming)
+			streaming_workload(formats[i]);
+	}
+	if (run_guiding)
+		guiding_workload();
+	printf("\n  ]\n}\n");
+	fflush(stdout);
+	set_marker(NULL, NULL, false);
+	disconnect_device(MOUNT_SIMULATOR_NAME);
+	disconnect_device(CCD_SIMULATOR_GUIDER_NAME);
+	disconnect_device(CCD_SIMULATOR_IMAGER_CAMERA_NAME);
+	stop_clients();
+	indigo_detach_client(&bench_client_instance);
+	indigo_server_shutdown();
+	pthread_join(server, NULL);
+	indigo_ccd_simulator(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_mount_simulator(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_stop();
+	return 0;
+}